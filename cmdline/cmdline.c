@@ -6,8 +6,11 @@ your library */
 #include "../src/dc_context.h"
 #include "../src/dc_aheader.h"
 #include "../src/dc_apeerstate.h"
+#include "../src/dc_jobqueue.h"
+#include "../src/dc_objcache.h"
 #include "../src/dc_key.h"
 #include "../src/dc_pgp.h"
+#include "../src/dc_mimeparser.h"
 
 
 
@@ -28,6 +31,7 @@ int dc_reset_tables(dc_context_t* context, int bits)
 
 	if (bits & 1) {
 		dc_sqlite3_execute(context->sql, "DELETE FROM jobs;");
+		dc_jobqueue_reset(context->jobqueue);
 		dc_log_info(context, 0, "(1) Jobs reset.");
 	}
 
@@ -46,7 +50,12 @@ int dc_reset_tables(dc_context_t* context, int bits)
 		dc_sqlite3_execute(context->sql, "DELETE FROM chats WHERE id>" DC_STRINGIFY(DC_CHAT_ID_LAST_SPECIAL) ";");
 		dc_sqlite3_execute(context->sql, "DELETE FROM chats_contacts;");
 		dc_sqlite3_execute(context->sql, "DELETE FROM msgs WHERE id>" DC_STRINGIFY(DC_MSG_ID_LAST_SPECIAL) ";");
+		dc_objcache_clear(context->contact_cache); /* messages and chats are uncached by the event below */
+		if (context->sql->fts_state!=DC_FTS_NONE) {
+			dc_sqlite3_execute(context->sql, "DELETE FROM msgs_fts;");
+		}
 		dc_sqlite3_execute(context->sql, "DELETE FROM config WHERE keyname LIKE 'imap.%' OR keyname LIKE 'configured%';");
+		dc_sqlite3_reload_config_cache(context->sql);
 		dc_sqlite3_execute(context->sql, "DELETE FROM leftgrps;");
 		dc_log_info(context, 0, "(8) Rest but server config reset.");
 	}
@@ -243,6 +252,61 @@ cleanup:
 }
 
 
+static char* bench_mimeparser(dc_context_t* context, const char* dir_name)
+{
+	/* parse all .eml files in a directory and count the allocations for the parts and texts:
+	without the arena, each of them would be a malloc() call; with the arena, only the chunks are */
+	DIR*             dir = NULL;
+	struct dirent*   dir_entry = NULL;
+	dc_mimeparser_t* mimeparser = NULL;
+	clock_t          start = clock();
+	int              msg_cnt = 0, part_cnt = 0;
+	size_t           alloc_cnt = 0, malloc_cnt = 0;
+
+	if ((dir=opendir(dir_name))==NULL) {
+		return dc_mprintf("ERROR: Cannot open directory \"%s\".", dir_name);
+	}
+
+	mimeparser = dc_mimeparser_new(context->blobdir, context);
+	while ((dir_entry=readdir(dir))!=NULL) {
+		const char* name = dir_entry->d_name;
+		if (strlen(name)>=4 && strcmp(&name[strlen(name)-4], ".eml")==0) {
+			char*  path_plus_name = dc_mprintf("%s/%s", dir_name, name);
+			char*  data = NULL;
+			size_t data_bytes = 0;
+			if (dc_read_file(context, path_plus_name, (void**)&data, &data_bytes)) {
+				dc_mimeparser_parse(mimeparser, data, data_bytes);
+				msg_cnt++;
+				for (int i = 0; i < carray_count(mimeparser->parts); i++) {
+					dc_mimepart_t* part = (dc_mimepart_t*)carray_get(mimeparser->parts, i);
+					char* file = dc_param_get(part->param, DC_PARAM_FILE, NULL);
+					if (file) {
+						dc_delete_file(context, file); /* attachments are written to the blob directory on parsing */
+						free(file);
+					}
+					part_cnt++;
+				}
+			}
+			free(data);
+			free(path_plus_name);
+		}
+	}
+	closedir(dir);
+
+	dc_mimeparser_empty(mimeparser);
+	alloc_cnt  = mimeparser->arena.alloc_cnt;
+	malloc_cnt = mimeparser->arena.chunk_cnt;
+	dc_mimeparser_unref(mimeparser);
+
+	return dc_mprintf("%i messages with %i parts parsed in %.3f s.\n"
+		"without arena: %i malloc() calls for parts and texts (%.1f per message)\n"
+		"with arena:    %i malloc() calls for parts and texts (%.1f per message)",
+		msg_cnt, part_cnt, (double)(clock()-start)/CLOCKS_PER_SEC,
+		(int)alloc_cnt, msg_cnt? (double)alloc_cnt/msg_cnt : 0.0,
+		(int)malloc_cnt, msg_cnt? (double)malloc_cnt/msg_cnt : 0.0);
+}
+
+
 static void log_msglist(dc_context_t* context, dc_array_t* msglist)
 {
 	int i, cnt = dc_array_get_cnt(msglist), lines_out = 0;
@@ -456,6 +520,7 @@ char* dc_cmdline(dc_context_t* context, const char* cmdline)
 				"checkqr <qr-content>\n"
 				"event <event-id to test>\n"
 				"fileinfo <file>\n"
+				"benchmime <folder with eml-files>\n"
 				"clear -- clear screen\n" /* must be implemented by  the caller */
 				"exit\n" /* must be implemented by  the caller */
 				"============================================="
@@ -1193,6 +1258,15 @@ char* dc_cmdline(dc_context_t* context, const char* cmdline)
 			ret = dc_strdup("ERROR: Argument <file> missing.");
 		}
 	}
+	else if (strcmp(cmd, "benchmime")==0)
+	{
+		if (arg1) {
+			ret = bench_mimeparser(context, arg1);
+		}
+		else {
+			ret = dc_strdup("ERROR: Argument <folder> missing.");
+		}
+	}
 	else
 	{
 		ret = COMMAND_UNKNOWN;
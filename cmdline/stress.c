@@ -15,6 +15,12 @@ $ valgrind --leak-check=full --tool=memcheck ./deltachat-core <db>
 #include "../src/dc_aheader.h"
 #include "../src/dc_keyring.h"
 #include "../src/dc_saxparser.h"
+#include "../src/dc_midfilter.h"
+#include "../src/dc_chat.h"
+#include "../src/dc_rcvpipe.h"
+#include "../src/dc_job.h"
+#include "../src/dc_jobqueue.h"
+#include "../src/dc_imap.h"
 
 
 /* some data used for testing
@@ -151,6 +157,52 @@ static const char* s_em_setupfile =
 "-----END PGP MESSAGE-----\n";
 
 
+/* some helpers used for testing
+ ******************************************************************************/
+
+static int member_set_matches(dc_context_t* context, uint32_t chat_id)
+{
+	/* check chats.member_set against the hash of the members in chats_contacts */
+	dc_array_t*   contact_ids = dc_array_new(context, 16);
+	sqlite3_stmt* stmt = NULL;
+	int           matches = 0;
+
+	stmt = dc_sqlite3_prepare(context->sql,
+		"SELECT contact_id FROM chats_contacts WHERE chat_id=? AND contact_id!=? ORDER BY contact_id;");
+	sqlite3_bind_int(stmt, 1, chat_id);
+	sqlite3_bind_int(stmt, 2, DC_CONTACT_ID_SELF);
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		dc_array_add_id(contact_ids, sqlite3_column_int(stmt, 0));
+	}
+	sqlite3_finalize(stmt);
+
+	stmt = dc_sqlite3_prepare(context->sql, "SELECT member_set FROM chats WHERE id=?;");
+	sqlite3_bind_int(stmt, 1, chat_id);
+	if (sqlite3_step(stmt)==SQLITE_ROW) {
+		matches = ((uint64_t)sqlite3_column_int64(stmt, 0)==dc_get_member_set_hash(contact_ids));
+	}
+	sqlite3_finalize(stmt);
+
+	dc_array_unref(contact_ids);
+	return matches;
+}
+
+
+static int ids_equal(const dc_array_t* ids1, const dc_array_t* ids2)
+{
+	size_t i = 0, cnt = dc_array_get_cnt(ids1);
+	if (cnt!=dc_array_get_cnt(ids2)) {
+		return 0;
+	}
+	for (i = 0; i < cnt; i++) {
+		if (dc_array_get_id(ids1, i)!=dc_array_get_id(ids2, i)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
 void stress_functions(dc_context_t* context)
 {
 	/* test dc_saxparser_t
@@ -641,14 +693,20 @@ void stress_functions(dc_context_t* context)
 		dc_param_set_int(p1, 'b', 2);
 		dc_param_set    (p1, 'c', NULL);
 		dc_param_set_int(p1, 'd', 4);
-		assert( strcmp(p1->packed, "a=foo\nb=2\nd=4")==0 );
+		assert( strcmp(dc_param_get_packed(p1), "a=foo\nb=2\nd=4")==0 );
 
 		dc_param_set    (p1, 'b', NULL);
-		assert( strcmp(p1->packed, "a=foo\nd=4")==0 );
+		assert( strcmp(dc_param_get_packed(p1), "a=foo\nd=4")==0 );
 
 		dc_param_set    (p1, 'a', NULL);
 		dc_param_set    (p1, 'd', NULL);
-		assert( strcmp(p1->packed, "")==0 );
+		assert( strcmp(dc_param_get_packed(p1), "")==0 );
+
+		dc_param_set    (p1, 'L', "line1\nline2");  /* line breaks would split the packed form */
+		dc_param_set    (p1, 'E', "x");
+		assert( strcmp(dc_param_get_packed(p1), "L=line1 line2\nE=x")==0 );
+		dc_param_set    (p1, 'E', "\n");           /* also when overwriting in place */
+		assert( strcmp(dc_param_get_packed(p1), "L=line1 line2\nE= ")==0 );
 
 		dc_param_unref(p1);
 	}
@@ -954,6 +1012,119 @@ void stress_functions(dc_context_t* context)
 			dc_keyring_unref(public_keyring);
 		}
 
+		{
+			/* sign once, encrypt to different recipients */
+			void* signed_packet = NULL;
+			size_t signed_bytes = 0;
+			int ok = dc_pgp_sign(context, original_text, strlen(original_text), private_key, &signed_packet, &signed_bytes);
+			assert( ok && signed_packet && signed_bytes>0 );
+
+			dc_key_t* recipients[2] = { public_key, public_key2 };
+			dc_key_t* decrypt_keys[2] = { private_key, private_key2 };
+			for (int i = 0; i < 2; i++) {
+				dc_keyring_t* keyring = dc_keyring_new();
+				dc_keyring_add(keyring, recipients[i]);
+				void* ctext = NULL;
+				size_t ctext_bytes = 0;
+				ok = dc_pgp_pk_encrypt_signed(context, signed_packet, signed_bytes, keyring, 1, &ctext, &ctext_bytes);
+				assert( ok && ctext && ctext_bytes>0 );
+				assert( strncmp((char*)ctext, "-----BEGIN PGP MESSAGE-----", 27)==0 );
+				dc_keyring_unref(keyring);
+
+				dc_keyring_t* private_keyring = dc_keyring_new();
+				dc_keyring_add(private_keyring, decrypt_keys[i]);
+				dc_keyring_t* public_keyring = dc_keyring_new();
+				dc_keyring_add(public_keyring, public_key);
+				dc_hash_t valid_signatures;
+				dc_hash_init(&valid_signatures, DC_HASH_STRING, 1/*copy key*/);
+				void* plain = NULL;
+				ok = dc_pgp_pk_decrypt(context, ctext, ctext_bytes, private_keyring, public_keyring/*for validate*/, 1, &plain, &plain_bytes, &valid_signatures);
+				assert( ok && plain && plain_bytes>0 );
+				assert( strncmp((char*)plain, original_text, strlen(original_text))==0 );
+				assert( dc_hash_cnt(&valid_signatures) == 1 );
+				free(plain);
+				dc_hash_clear(&valid_signatures);
+				dc_keyring_unref(private_keyring);
+				dc_keyring_unref(public_keyring);
+				free(ctext);
+			}
+
+			free(signed_packet);
+		}
+
+		{
+			/* the jobs of several dc_send_msg_to_chats() calls may interleave, the signed bodies are cached by their shared ID */
+			const char* ids[2] = { "shared-a", "shared-b" };
+			const char* headers[2] = { "Subject: a\r\n", "Subject: b\r\n" };
+			const char* bodies[2] = { "body a", "body b" };
+			void*  signed_packets[2] = { NULL, NULL };
+			size_t signed_bytes[2] = { 0, 0 };
+			void*  cached = NULL;
+			size_t cached_bytes = 0;
+
+			dc_e2ee_forget_shared(context);
+			for (int i = 0; i < 2; i++) {
+				int ok = dc_pgp_sign(context, bodies[i], strlen(bodies[i]), private_key, &signed_packets[i], &signed_bytes[i]);
+				assert( ok && signed_packets[i] && signed_bytes[i]>0 );
+				dc_e2ee_set_shared_signed(context, ids[i], headers[i], private_key, signed_packets[i], signed_bytes[i]);
+			}
+
+			for (int round = 0; round < 2; round++) {
+				for (int i = 0; i < 2; i++) {
+					cached = dc_e2ee_get_shared_signed(context, ids[i], headers[i], private_key, &cached_bytes);
+					assert( cached && cached_bytes==signed_bytes[i] && memcmp(cached, signed_packets[i], cached_bytes)==0 );
+					free(cached);
+				}
+			}
+
+			assert( dc_e2ee_get_shared_signed(context, ids[0], headers[1], private_key, &cached_bytes)==NULL );
+			assert( dc_e2ee_get_shared_signed(context, ids[0], headers[0], private_key2, &cached_bytes)==NULL );
+
+			/* the body taken from the cache is encrypted and verified as usual */
+			cached = dc_e2ee_get_shared_signed(context, ids[1], headers[1], private_key, &cached_bytes);
+			dc_keyring_t* keyring = dc_keyring_new();
+			dc_keyring_add(keyring, public_key2);
+			void* ctext = NULL;
+			size_t ctext_bytes = 0;
+			int ok = dc_pgp_pk_encrypt_signed(context, cached, cached_bytes, keyring, 1, &ctext, &ctext_bytes);
+			assert( ok && ctext && ctext_bytes>0 );
+			dc_keyring_unref(keyring);
+			free(cached);
+
+			dc_keyring_t* private_keyring = dc_keyring_new();
+			dc_keyring_add(private_keyring, private_key2);
+			dc_keyring_t* public_keyring = dc_keyring_new();
+			dc_keyring_add(public_keyring, public_key);
+			dc_hash_t valid_signatures;
+			dc_hash_init(&valid_signatures, DC_HASH_STRING, 1/*copy key*/);
+			void* plain = NULL;
+			ok = dc_pgp_pk_decrypt(context, ctext, ctext_bytes, private_keyring, public_keyring/*for validate*/, 1, &plain, &plain_bytes, &valid_signatures);
+			assert( ok && plain && plain_bytes==strlen(bodies[1]) && strncmp((char*)plain, bodies[1], plain_bytes)==0 );
+			assert( dc_hash_cnt(&valid_signatures) == 1 );
+			free(plain);
+			dc_hash_clear(&valid_signatures);
+			dc_keyring_unref(private_keyring);
+			dc_keyring_unref(public_keyring);
+			free(ctext);
+
+			/* a full cache drops the least recently used body, which is "shared-a" now */
+			for (int i = 0; i < DC_SHARED_SIGNED_CACHE_SIZE-1; i++) {
+				char* id = dc_mprintf("shared-%i", i);
+				dc_e2ee_set_shared_signed(context, id, headers[0], private_key, signed_packets[0], signed_bytes[0]);
+				free(id);
+			}
+			assert( dc_e2ee_get_shared_signed(context, ids[0], headers[0], private_key, &cached_bytes)==NULL );
+			cached = dc_e2ee_get_shared_signed(context, ids[1], headers[1], private_key, &cached_bytes);
+			assert( cached );
+			free(cached);
+
+			dc_e2ee_forget_shared(context);
+			assert( dc_e2ee_get_shared_signed(context, ids[1], headers[1], private_key, &cached_bytes)==NULL );
+
+			free(signed_packets[0]);
+			free(signed_packets[1]);
+		}
+
 		free(ctext_signed);
 		free(ctext_unsigned);
 		dc_key_unref(public_key2);
@@ -991,4 +1162,449 @@ void stress_functions(dc_context_t* context)
 		assert( res->id != 0 );
 		dc_lot_unref(res);
 	}
+
+	/* test dc_jobqueue_t
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		/* a queue of our own, the pending jobs of the context are loaded by the first access and are dropped from memory */
+		dc_jobqueue_t*      jobqueue = dc_jobqueue_new(context);
+		dc_jobqueue_entry_t entry;
+		int                 i = 0;
+
+		while (dc_jobqueue_pop_due(jobqueue, DC_IMAP_THREAD, 0x7FFFFFFF, &entry)) {
+			free(entry.param);
+		}
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_IMAP_THREAD)==0 );
+
+		/* job_id, action, desired_timestamp, added_timestamp and is_retry of the jobs to push;
+		the expected order is: due first, then higher action, then older */
+		static const int jobs[][5] = {
+			{ 1, DC_JOB_DELETE_MSG_ON_IMAP,     0, 5, 0 },
+			{ 2, DC_JOB_MARKSEEN_MSG_ON_IMAP,   0, 9, 0 },
+			{ 3, DC_JOB_MARKSEEN_MSG_ON_IMAP,   0, 3, 0 },
+			{ 4, DC_JOB_CONFIGURE_IMAP,       100, 1, 0 },
+			{ 5, DC_JOB_FTS_BACKFILL,          50, 1, 0 },
+			{ 6, DC_JOB_SEND_MSG_TO_IMAP,     200, 1, 1 },
+			{ 7, DC_JOB_SEND_MSG_TO_IMAP,     200, 2, 0 }
+		};
+		for (i = 0; i < (int)(sizeof(jobs)/sizeof(jobs[0])); i++) {
+			memset(&entry, 0, sizeof(dc_jobqueue_entry_t));
+			entry.job_id            = jobs[i][0];
+			entry.action            = jobs[i][1];
+			entry.desired_timestamp = jobs[i][2];
+			entry.added_timestamp   = jobs[i][3];
+			entry.is_retry          = jobs[i][4];
+			entry.param             = "a=b";
+			dc_jobqueue_push(jobqueue, DC_IMAP_THREAD, &entry);
+		}
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_IMAP_THREAD)==1 ); /* 0 is returned only if there are no jobs */
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_SMTP_THREAD)==0 );
+
+		static const uint32_t due_order[] = { 3, 2, 1 };
+		for (i = 0; i < 3; i++) {
+			assert( dc_jobqueue_pop_due(jobqueue, DC_IMAP_THREAD, 10, &entry) );
+			assert( entry.job_id==due_order[i] );
+			assert( strcmp(entry.param, "a=b")==0 );
+			free(entry.param);
+		}
+		assert( !dc_jobqueue_pop_due(jobqueue, DC_IMAP_THREAD, 10, &entry) ); /* the other jobs are not yet due */
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_IMAP_THREAD)==50 );
+
+		/* on interrupts, the retry is made due, the job added with a delay keeps its time */
+		dc_jobqueue_make_retries_due(jobqueue, DC_IMAP_THREAD);
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_IMAP_THREAD)==1 );
+
+		static const uint32_t later_order[] = { 6, 5, 4, 7 };
+		for (i = 0; i < 4; i++) {
+			assert( dc_jobqueue_pop_due(jobqueue, DC_IMAP_THREAD, 1000, &entry) );
+			assert( entry.job_id==later_order[i] );
+			free(entry.param);
+		}
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_IMAP_THREAD)==0 );
+
+		dc_jobqueue_unref(jobqueue);
+	}
+
+	/* test collecting the jobs to pipeline
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		#define PIPELINE_TEST_CNT 40
+		dc_jobqueue_t*      jobqueue = dc_jobqueue_new(context);
+		dc_jobqueue_entry_t entry;
+		dc_jobqueue_entry_t entries[PIPELINE_TEST_CNT];
+		int                 i = 0, cnt = 0, seen_cnt = 0;
+
+		while (dc_jobqueue_pop_due(jobqueue, DC_IMAP_THREAD, 0x7FFFFFFF, &entry)) {
+			free(entry.param);
+		}
+
+		/* every third job deletes a message, the markseen-jobs with odd IDs are not yet due */
+		for (i = 0; i < PIPELINE_TEST_CNT; i++) {
+			memset(&entry, 0, sizeof(dc_jobqueue_entry_t));
+			entry.job_id            = i+1;
+			entry.action            = i%3==0? DC_JOB_DELETE_MSG_ON_IMAP : DC_JOB_MARKSEEN_MSG_ON_IMAP;
+			entry.foreign_id        = 100+i;
+			entry.desired_timestamp = (i%3!=0 && entry.job_id%2)? 1000 : 0;
+			entry.added_timestamp   = 1;
+			entry.param             = "";
+			dc_jobqueue_push(jobqueue, DC_IMAP_THREAD, &entry);
+			if (entry.action==DC_JOB_MARKSEEN_MSG_ON_IMAP && entry.desired_timestamp==0) {
+				seen_cnt++;
+			}
+		}
+
+		cnt = dc_jobqueue_pop_due_action(jobqueue, DC_IMAP_THREAD, DC_JOB_MARKSEEN_MSG_ON_IMAP, 10, entries, PIPELINE_TEST_CNT);
+		assert( cnt==seen_cnt );
+		for (i = 0; i < cnt; i++) {
+			assert( entries[i].action==DC_JOB_MARKSEEN_MSG_ON_IMAP && entries[i].desired_timestamp==0 );
+			assert( entries[i].foreign_id==entries[i].job_id-1+100 );
+			free(entries[i].param);
+		}
+
+		/* the limit is respected, the other jobs are left in the queue in order */
+		cnt = dc_jobqueue_pop_due_action(jobqueue, DC_IMAP_THREAD, DC_JOB_DELETE_MSG_ON_IMAP, 10, entries, 5);
+		assert( cnt==5 );
+		for (i = 0; i < cnt; i++) {
+			free(entries[i].param);
+		}
+		uint32_t last_job_id = 0;
+		while (dc_jobqueue_pop_due(jobqueue, DC_IMAP_THREAD, 10, &entry)) {
+			assert( entry.action==DC_JOB_DELETE_MSG_ON_IMAP && entry.job_id > last_job_id );
+			last_job_id = entry.job_id;
+			free(entry.param);
+		}
+		assert( dc_jobqueue_get_next_timestamp(jobqueue, DC_IMAP_THREAD)==1000 );
+		assert( dc_jobqueue_pop_due_action(jobqueue, DC_IMAP_THREAD, DC_JOB_MARKSEEN_MSG_ON_IMAP, 10, entries, PIPELINE_TEST_CNT)==0 );
+
+		dc_jobqueue_unref(jobqueue);
+	}
+
+	if (dc_is_open(context) && !dc_imap_is_connected(context->imap))
+	{
+		/* without a connection, nothing is handled and the caller falls back to the per-message functions */
+		dc_imap_msgref_t refs[2];
+		char*            moveto_folder = NULL;
+		memset(refs, 0, sizeof(refs));
+		refs[0].server_uid     = 7;
+		refs[0].new_server_uid = 3;
+		refs[0].handled        = 1;
+		refs[1].server_uid     = 8;
+		refs[1].rfc724_mid     = "foo@bar.example";
+		refs[1].handled        = 1;
+
+		dc_imap_markseen_msgs(context->imap, "INBOX", refs, 2, &moveto_folder);
+		assert( !refs[0].handled && !refs[1].handled && refs[0].new_server_uid==0 );
+		assert( moveto_folder==NULL );
+
+		refs[0].handled = 1;
+		dc_imap_delete_msgs(context->imap, "INBOX", refs, 2);
+		assert( !refs[0].handled && !refs[1].handled );
+	}
+
+	/* test the retry policies
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		time_t delay = 0;
+		int    i = 0;
+
+		for (i = 0; i < 20; i++) /* the delays are randomized between the half and the full delay */
+		{
+			delay = dc_job_get_retry_delay(context, DC_JOB_SEND_MSG_TO_SMTP, DC_JOB_ERR_NETWORK, 0);
+			assert( delay>=1 && delay<=2 ); /* offline, no try was counted */
+			delay = dc_job_get_retry_delay(context, DC_JOB_SEND_MSG_TO_SMTP, DC_JOB_ERR_NETWORK, 1);
+			assert( delay>=1 && delay<=2 );
+			delay = dc_job_get_retry_delay(context, DC_JOB_SEND_MSG_TO_SMTP, DC_JOB_ERR_NETWORK, 2);
+			assert( delay>=2 && delay<=4 );
+
+			delay = dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_NETWORK, 2);
+			assert( delay>=5 && delay<=10 );
+			delay = dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_AUTH, 2);
+			assert( delay>=60 && delay<=120 );
+		}
+
+		assert( dc_job_get_retry_delay(context, DC_JOB_SEND_MSG_TO_SMTP, DC_JOB_ERR_NETWORK, 3)==-1 );
+		assert( dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 4)>=0 );
+		assert( dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 5)==-1 );
+		assert( dc_job_get_retry_delay(context, DC_JOB_SEND_MSG_TO_SMTP, DC_JOB_ERR_PERMANENT, 0)==-1 );
+
+		/* the delay is doubled up to the maximum, the policy can be overwritten by the config */
+		dc_sqlite3_set_config(context->sql, "job_retry_quota", "10,15,9");
+		delay = dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 1);
+		assert( delay>=5 && delay<=10 );
+		delay = dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 8);
+		assert( delay>=7 && delay<=15 );
+		assert( dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 9)==-1 );
+
+		dc_sqlite3_set_config(context->sql, "job_retry_quota", "bad");
+		assert( dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 4)>=0 ); /* the defaults are used */
+		assert( dc_job_get_retry_delay(context, DC_JOB_MARKSEEN_MSG_ON_IMAP, DC_JOB_ERR_QUOTA, 5)==-1 );
+		dc_sqlite3_set_config(context->sql, "job_retry_quota", NULL);
+	}
+
+	/* test dc_rcvpipe_t
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		#define RCVPIPE_TEST_CNT (DC_RCVPIPE_QUEUE_SIZE*2+3) /* the queue runs full */
+		dc_rcvpipe_t* rcvpipe = dc_rcvpipe_new(context);
+		char*         imf_raw[RCVPIPE_TEST_CNT];
+		char*         mids[RCVPIPE_TEST_CNT];
+		int           stamp = (int)time(NULL);
+		int           i = 0;
+		uint32_t      last_msg_id = 0;
+
+		for (i = 0; i < RCVPIPE_TEST_CNT; i++) {
+			mids[i] = dc_mprintf("rcvpipe%i.%i@stress.example", i, stamp);
+			imf_raw[i] = dc_mprintf(
+				"From: Pipe <rcvpipe@stress.example>\n"
+				"To: me@stress.example\n"
+				"Subject: rcvpipe %i\n"
+				"Message-ID: <%s>\n"
+				"Date: Fri, 14 Jul 2017 02:40:00 +0000\n"
+				"\n"
+				"text %i\n", i, mids[i], i);
+			dc_rcvpipe_add(rcvpipe, imf_raw[i], strlen(imf_raw[i]), "INBOX", 1000+i, 0);
+		}
+		dc_rcvpipe_flush(rcvpipe);
+		dc_rcvpipe_flush(rcvpipe); /* nothing left to receive */
+
+		for (i = 0; i < RCVPIPE_TEST_CNT; i++) {
+			char*    server_folder = NULL;
+			uint32_t server_uid = 0;
+			uint32_t msg_id = dc_rfc724_mid_exists(context, mids[i], &server_folder, &server_uid);
+			assert( msg_id > last_msg_id ); /* received in the order added */
+			assert( server_folder && strcmp(server_folder, "INBOX")==0 );
+			assert( server_uid==(uint32_t)(1000+i) );
+			last_msg_id = msg_id;
+			free(server_folder);
+			free(mids[i]);
+			free(imf_raw[i]);
+		}
+
+		dc_rcvpipe_unref(rcvpipe);
+	}
+
+	/* test chats.member_set
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		uint32_t chat_id = dc_create_group_chat(context, 0, "member set");
+		uint32_t contact1 = dc_create_contact(context, "", "member.set1@stress.example");
+		uint32_t contact2 = dc_create_contact(context, "", "member.set2@stress.example");
+		assert( chat_id > DC_CHAT_ID_LAST_SPECIAL && contact1 && contact2 && contact1 < contact2 );
+		assert( member_set_matches(context, chat_id) );
+
+		dc_array_t* contact_ids = dc_array_new(context, 16);
+		dc_array_add_id(contact_ids, contact1);
+		dc_array_add_id(contact_ids, contact2);
+		uint64_t hash12 = dc_get_member_set_hash(contact_ids);
+		dc_array_empty(contact_ids);
+		dc_array_add_id(contact_ids, contact2);
+		dc_array_add_id(contact_ids, contact1);
+		assert( dc_get_member_set_hash(contact_ids)!=hash12 ); /* the order matters, the IDs must be sorted */
+		dc_array_empty(contact_ids);
+		assert( dc_get_member_set_hash(contact_ids)!=hash12 );
+		dc_array_unref(contact_ids);
+
+		assert( dc_add_contact_to_chat(context, chat_id, contact2) );
+		assert( member_set_matches(context, chat_id) );
+		assert( dc_add_contact_to_chat(context, chat_id, contact1) );
+		assert( member_set_matches(context, chat_id) );
+
+		sqlite3_stmt* stmt = dc_sqlite3_prepare(context->sql, "SELECT member_set FROM chats WHERE id=?;");
+		sqlite3_bind_int(stmt, 1, chat_id);
+		assert( sqlite3_step(stmt)==SQLITE_ROW );
+		assert( (uint64_t)sqlite3_column_int64(stmt, 0)==hash12 ); /* independent of the order of adding, SELF is not included */
+		sqlite3_finalize(stmt);
+
+		assert( dc_remove_contact_from_chat(context, chat_id, contact1) );
+		assert( member_set_matches(context, chat_id) );
+
+		dc_delete_chat(context, chat_id);
+	}
+
+	/* test dc_get_chat_msgs_page()
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		#define PAGING_TEST_MAX_PAGES 16
+		uint32_t      chat_id = dc_create_group_chat(context, 0, "paging");
+		sqlite3_stmt* stmt = NULL;
+		int           i = 0, j = 0, f = 0;
+
+		for (i = 0; i < 10; i++) {
+			char* text = dc_mprintf("page %i", i);
+			dc_add_device_msg(context, chat_id, text);
+			free(text);
+		}
+
+		/* most messages get the same timestamp and the newest message is moved to the front,
+		so the pages must be sorted by timestamp and ID */
+		stmt = dc_sqlite3_prepare(context->sql,
+			"UPDATE msgs SET timestamp=CASE WHEN id=(SELECT MAX(id) FROM msgs WHERE chat_id=?1) THEN ?2-10 ELSE ?2 END WHERE chat_id=?1;");
+		sqlite3_bind_int  (stmt, 1, chat_id);
+		sqlite3_bind_int64(stmt, 2, 1500000000);
+		assert( sqlite3_step(stmt)==SQLITE_DONE );
+		sqlite3_finalize(stmt);
+
+		for (f = 0; f <= 1; f++)
+		{
+			uint32_t    flags = f? DC_GCM_ADDDAYMARKER : 0;
+			dc_array_t* full = dc_get_chat_msgs(context, chat_id, flags, 0);
+			dc_array_t* joined = dc_array_new(context, 16);
+			dc_array_t* pages[PAGING_TEST_MAX_PAGES];
+			int         page_cnt = 0;
+			uint32_t    anchor = 0;
+			assert( dc_array_get_cnt(full)==(f? 11 : 10) );
+
+			/* scroll up from the newest messages, the pages are put in front of each other */
+			while (1) {
+				dc_array_t* page = dc_get_chat_msgs_page(context, chat_id, flags, 0, anchor, 3);
+				assert( page );
+				if (dc_array_get_cnt(page)==0) {
+					dc_array_unref(page);
+					break;
+				}
+				assert( page_cnt < PAGING_TEST_MAX_PAGES );
+				pages[page_cnt++] = page;
+				j = 0;
+				while (dc_array_get_id(page, j)==DC_MSG_ID_DAYMARKER) {
+					j++;
+				}
+				anchor = dc_array_get_id(page, j);
+			}
+			assert( page_cnt==4 );
+			for (i = page_cnt-1; i >= 0; i--) {
+				for (j = 0; j < (int)dc_array_get_cnt(pages[i]); j++) {
+					dc_array_add_id(joined, dc_array_get_id(pages[i], j));
+				}
+				dc_array_unref(pages[i]);
+			}
+			assert( ids_equal(joined, full) );
+
+			/* scroll down from the oldest messages */
+			dc_array_empty(joined);
+			anchor = 0;
+			while (1) {
+				dc_array_t* page = dc_get_chat_msgs_page(context, chat_id, flags|DC_GCM_NEWER, 0, anchor, 4);
+				assert( page );
+				if (dc_array_get_cnt(page)==0) {
+					dc_array_unref(page);
+					break;
+				}
+				for (j = 0; j < (int)dc_array_get_cnt(page); j++) {
+					dc_array_add_id(joined, dc_array_get_id(page, j));
+				}
+				anchor = dc_array_get_id(page, dc_array_get_cnt(page)-1);
+				dc_array_unref(page);
+			}
+			assert( ids_equal(joined, full) );
+
+			dc_array_unref(joined);
+			dc_array_unref(full);
+		}
+
+		assert( dc_get_chat_msgs_page(context, chat_id, 0, 0, 0x7FFFFFFF, 3)==NULL ); /* the anchor does not exist */
+
+		dc_delete_chat(context, chat_id);
+	}
+
+	/* test dc_import_address_book()
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		int   stamp = (int)time(NULL);
+		char* addr_upper = dc_mprintf("Stress.Import%i@Test.Example", stamp);
+		char* addr_lower = dc_mprintf("stress.import%i@test.example", stamp);
+		char* adr_book = dc_mprintf("Import One\n%s\n\n%s\nBad\nno-address\nImport Two\nstress.import2.%i@test.example",
+			addr_upper, addr_lower, stamp);
+
+		dc_array_t* outcomes = dc_import_address_book(context, adr_book);
+		assert( outcomes && dc_array_get_cnt(outcomes)==4 );
+		assert( dc_array_get_id(outcomes, 0)==DC_IMPORT_CREATED );
+		assert( dc_array_get_id(outcomes, 1)==DC_IMPORT_CREATED ); /* the same contact, differing only in case */
+		assert( dc_array_get_id(outcomes, 2)==DC_IMPORT_INVALID );
+		assert( dc_array_get_id(outcomes, 3)==DC_IMPORT_CREATED );
+		dc_array_unref(outcomes);
+
+		uint32_t contact_id = dc_lookup_contact_id_by_addr(context, addr_upper);
+		assert( contact_id > DC_CONTACT_ID_LAST_SPECIAL );
+		assert( dc_lookup_contact_id_by_addr(context, addr_lower)==contact_id );
+
+		dc_contact_t* contact = dc_get_contact(context, contact_id);
+		char* str = dc_contact_get_name(contact);
+		assert( strcmp(str, "Import One")==0 ); /* the last non-empty name */
+		free(str);
+		str = dc_contact_get_addr(contact);
+		assert( strcmp(str, addr_lower)==0 ); /* the last address */
+		free(str);
+		dc_contact_unref(contact);
+
+		assert( dc_add_address_book(context, adr_book)==0 );
+
+		free(adr_book);
+		adr_book = dc_mprintf("Import Renamed\n%s", addr_upper);
+		assert( dc_add_address_book(context, adr_book)==1 );
+		assert( dc_lookup_contact_id_by_addr(context, addr_lower)==contact_id );
+
+		contact = dc_get_contact(context, contact_id);
+		str = dc_contact_get_name(contact);
+		assert( strcmp(str, "Import Renamed")==0 );
+		free(str);
+		dc_contact_unref(contact);
+
+		free(adr_book);
+		free(addr_lower);
+		free(addr_upper);
+	}
+
+	/* test dc_midfilter_t
+	 **************************************************************************/
+
+	if (dc_is_open(context))
+	{
+		#define MIDFILTER_TEST_CNT 2000
+		dc_midfilter_t* filter = dc_midfilter_new();
+		int             i = 0, false_positives = 0;
+
+		assert( dc_midfilter_may_contain(filter, "foo@bar.example") ); /* not built, no lookups answered */
+
+		dc_midfilter_build(filter, context->sql);
+		for (i = 0; i < MIDFILTER_TEST_CNT; i++) {
+			char* mid = dc_mprintf("Mr.midfilter%i.%i@stress.example", i, i*7919);
+			dc_midfilter_add(filter, mid);
+			free(mid);
+		}
+
+		for (i = 0; i < MIDFILTER_TEST_CNT; i++) {
+			char* mid = dc_mprintf("Mr.midfilter%i.%i@stress.example", i, i*7919);
+			assert( dc_midfilter_may_contain(filter, mid) ); /* no false negatives */
+			free(mid);
+
+			mid = dc_mprintf("Mr.unknown%i.%i@stress.example", i, i*7919);
+			false_positives += dc_midfilter_may_contain(filter, mid);
+			free(mid);
+		}
+		assert( false_positives < MIDFILTER_TEST_CNT/20 );
+
+		dc_midfilter_removed(filter, MIDFILTER_TEST_CNT/2); /* too few to rebuild, all entries are kept */
+		assert( dc_midfilter_may_contain(filter, "Mr.midfilter0.0@stress.example") );
+
+		dc_midfilter_reset(filter);
+		char* info = dc_midfilter_get_info(filter);
+		assert( strcmp(info, "0")==0 );
+		free(info);
+
+		dc_midfilter_unref(filter);
+	}
 }
@@ -976,6 +976,18 @@ free_BN(BIGNUM **pp)
 	*pp = NULL;
 }
 
+/* as free_BN(), but clears the number before, used for the secret parts of keys; EDIT BY MR */
+static void
+clear_free_BN(BIGNUM **pp)
+{
+	if (pp==NULL || *pp==NULL) {
+		return;
+	}
+
+	BN_clear_free(*pp);
+	*pp = NULL;
+}
+
 static void
 dup_BN(BIGNUM **dst, const BIGNUM *src)
 {
@@ -2490,14 +2502,14 @@ pgp_seckey_free(pgp_seckey_t *key)
 	case PGP_PKA_RSA:
 	case PGP_PKA_RSA_ENCRYPT_ONLY:
 	case PGP_PKA_RSA_SIGN_ONLY:
-		free_BN(&key->key.rsa.d);
-		free_BN(&key->key.rsa.p);
-		free_BN(&key->key.rsa.q);
-		free_BN(&key->key.rsa.u);
+		clear_free_BN(&key->key.rsa.d); // EDIT BY MR: clear secret numbers
+		clear_free_BN(&key->key.rsa.p); // EDIT BY MR: clear secret numbers
+		clear_free_BN(&key->key.rsa.q); // EDIT BY MR: clear secret numbers
+		clear_free_BN(&key->key.rsa.u); // EDIT BY MR: clear secret numbers
 		break;
 
 	case PGP_PKA_DSA:
-		free_BN(&key->key.dsa.x);
+		clear_free_BN(&key->key.dsa.x); // EDIT BY MR: clear secret numbers
 		break;
 
 	default:
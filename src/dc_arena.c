@@ -0,0 +1,204 @@
+#include <stdarg.h>
+#include "dc_context.h"
+#include "dc_arena.h"
+
+
+struct dc_arena_chunk_t
+{
+	dc_arena_chunk_t* next;
+	size_t            bytes;  // usable bytes following the header
+	size_t            used;
+};
+
+
+#define CHUNK_HEADER_BYTES (((sizeof(dc_arena_chunk_t)+DC_ARENA_ALIGN-1)/DC_ARENA_ALIGN)*DC_ARENA_ALIGN)
+#define CHUNK_DATA(c)      (((unsigned char*)(c))+CHUNK_HEADER_BYTES)
+
+
+static dc_arena_chunk_t* chunk_new(dc_arena_t* arena, size_t bytes)
+{
+	dc_arena_chunk_t* chunk = NULL;
+
+	if ((chunk=malloc(CHUNK_HEADER_BYTES+bytes))==NULL) {
+		exit(59);
+	}
+
+	chunk->next  = NULL;
+	chunk->bytes = bytes;
+	chunk->used  = 0;
+	arena->chunk_cnt++;
+	return chunk;
+}
+
+
+static void* alloc_uninitialized(dc_arena_t* arena, size_t bytes)
+{
+	dc_arena_chunk_t* chunk = NULL;
+
+	bytes = ((bytes+DC_ARENA_ALIGN-1)/DC_ARENA_ALIGN)*DC_ARENA_ALIGN;
+	if (bytes==0) {
+		bytes = DC_ARENA_ALIGN;
+	}
+
+	arena->alloc_cnt++;
+
+	if (arena->chunks && arena->chunks->bytes-arena->chunks->used >= bytes) {
+		chunk = arena->chunks;
+	}
+	else if (bytes > arena->chunk_bytes/4) {
+		/* large allocations get a chunk of their own, linked behind the current chunk so that its free space is not lost */
+		chunk = chunk_new(arena, bytes);
+		if (arena->chunks) {
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		}
+		else {
+			arena->chunks = chunk;
+		}
+	}
+	else {
+		chunk = chunk_new(arena, arena->chunk_bytes);
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	void* ret = CHUNK_DATA(chunk)+chunk->used;
+	chunk->used += bytes;
+	return ret;
+}
+
+
+/**
+ * Initialize an arena.
+ * The arena does not allocate any memory until the first allocation is done.
+ *
+ * @private @memberof dc_arena_t
+ * @param arena The arena to initialize, typically a member of another object.
+ * @param chunk_bytes Size of the chunks to take the allocations from, 0 for DC_ARENA_CHUNK_BYTES.
+ * @return None.
+ */
+void dc_arena_init(dc_arena_t* arena, size_t chunk_bytes)
+{
+	if (arena==NULL) {
+		return;
+	}
+
+	memset(arena, 0, sizeof(dc_arena_t));
+	arena->chunk_bytes = chunk_bytes? chunk_bytes : DC_ARENA_CHUNK_BYTES;
+}
+
+
+/**
+ * Free all allocations done from the arena.
+ * The first chunk is kept, so that an arena reused for the next message
+ * typically does not need to call malloc() at all.
+ *
+ * @private @memberof dc_arena_t
+ * @param arena The arena to reset.
+ * @return None.
+ */
+void dc_arena_reset(dc_arena_t* arena)
+{
+	dc_arena_chunk_t* keep = NULL;
+
+	if (arena==NULL) {
+		return;
+	}
+
+	dc_arena_chunk_t* chunk = arena->chunks;
+	while (chunk) {
+		dc_arena_chunk_t* next = chunk->next;
+		if (keep==NULL && chunk->bytes==arena->chunk_bytes) {
+			keep = chunk;
+			keep->next = NULL;
+			keep->used = 0;
+		}
+		else {
+			free(chunk);
+		}
+		chunk = next;
+	}
+
+	arena->chunks = keep;
+}
+
+
+/**
+ * Free all allocations and all memory held by the arena.
+ * The arena can be used again afterwards.
+ *
+ * @private @memberof dc_arena_t
+ * @param arena The arena to clear.
+ * @return None.
+ */
+void dc_arena_clear(dc_arena_t* arena)
+{
+	if (arena==NULL) {
+		return;
+	}
+
+	dc_arena_reset(arena);
+	free(arena->chunks);
+	arena->chunks = NULL;
+}
+
+
+/**
+ * Allocate zeroed memory from the arena.
+ * The memory must not be free()'d, it is freed by dc_arena_reset() or dc_arena_clear().
+ *
+ * @private @memberof dc_arena_t
+ * @param arena The arena to allocate memory from.
+ * @param bytes Number of bytes to allocate.
+ * @return Pointer to the memory, aligned to DC_ARENA_ALIGN bytes.
+ */
+void* dc_arena_alloc(dc_arena_t* arena, size_t bytes)
+{
+	void* ret = alloc_uninitialized(arena, bytes);
+	memset(ret, 0, bytes);
+	return ret;
+}
+
+
+char* dc_arena_strdup(dc_arena_t* arena, const char* s)
+{
+	return dc_arena_strndup(arena, s? s : "", s? strlen(s) : 0);
+}
+
+
+char* dc_arena_strndup(dc_arena_t* arena, const char* s, size_t bytes)
+{
+	bytes = s? strnlen(s, bytes) : 0; /* as strndup(), stop at the first null-byte */
+
+	char* ret = alloc_uninitialized(arena, bytes+1);
+	if (bytes) {
+		memcpy(ret, s, bytes);
+	}
+	ret[bytes] = 0;
+	return ret;
+}
+
+
+char* dc_arena_mprintf(dc_arena_t* arena, const char* format, ...)
+{
+	char  testbuf[1];
+	char* buf = NULL;
+	int   char_cnt_without_zero = 0;
+
+	va_list argp;
+	va_list argp_copy;
+	va_start(argp, format);
+	va_copy(argp_copy, argp);
+
+	char_cnt_without_zero = vsnprintf(testbuf, 0, format, argp);
+	va_end(argp);
+	if (char_cnt_without_zero < 0) {
+		va_end(argp_copy);
+		return dc_arena_strdup(arena, "ErrFmt");
+	}
+
+	buf = alloc_uninitialized(arena, char_cnt_without_zero+1);
+	vsnprintf(buf, char_cnt_without_zero+1, format, argp_copy);
+	va_end(argp_copy);
+	return buf;
+}
@@ -0,0 +1,48 @@
+/* Purpose: Bump allocator for data that is freed all at once,
+eg. the parts and texts created while parsing or rendering a single message.
+Memory is taken from larger chunks, single allocations cannot be free()'d. */
+
+
+#ifndef __DC_ARENA_H__
+#define __DC_ARENA_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define DC_ARENA_CHUNK_BYTES  8192 // allocations larger than a quarter of this get a chunk of their own
+#define DC_ARENA_ALIGN          16
+
+
+typedef struct dc_arena_chunk_t dc_arena_chunk_t;
+
+
+/**
+ * Library-internal.
+ * Embed the structure in the owning object and call dc_arena_init() before use.
+ */
+typedef struct dc_arena_t
+{
+	/** @privatesection */
+
+	dc_arena_chunk_t* chunks;       // the chunk allocations are taken from first
+	size_t            chunk_bytes;
+	size_t            alloc_cnt;    // allocations served since dc_arena_init(), each would be a malloc() without the arena; for statistics
+	size_t            chunk_cnt;    // malloc() calls done by the arena since dc_arena_init(), for statistics
+} dc_arena_t;
+
+
+void   dc_arena_init     (dc_arena_t*, size_t chunk_bytes); /* 0=use DC_ARENA_CHUNK_BYTES */
+void   dc_arena_reset    (dc_arena_t*); /* free all allocations, the first chunk is kept for reuse */
+void   dc_arena_clear    (dc_arena_t*); /* free all allocations and all chunks */
+
+void*  dc_arena_alloc    (dc_arena_t*, size_t bytes); /* the returned memory is zeroed */
+char*  dc_arena_strdup   (dc_arena_t*, const char*); /* NULL results in an empty string, as for dc_strdup() */
+char*  dc_arena_strndup  (dc_arena_t*, const char*, size_t bytes);
+char*  dc_arena_mprintf  (dc_arena_t*, const char* format, ...);
+
+
+#ifdef __cplusplus
+} /* /extern "C" */
+#endif
+#endif /* __DC_ARENA_H__ */
@@ -5,6 +5,8 @@
 #include "dc_imap.h"
 #include "dc_mimefactory.h"
 #include "dc_apeerstate.h"
+#include "dc_objcache.h"
+#include "dc_midfilter.h"
 
 
 #define DC_CHAT_MAGIC 0xc4a7c4a7
@@ -375,15 +377,21 @@ int dc_chat_update_param(dc_chat_t* chat)
 	int success = 0;
 	sqlite3_stmt* stmt = dc_sqlite3_prepare(chat->context->sql,
 		"UPDATE chats SET param=? WHERE id=?");
-	sqlite3_bind_text(stmt, 1, chat->param->packed, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 1, dc_param_get_packed(chat->param), -1, SQLITE_STATIC);
 	sqlite3_bind_int (stmt, 2, chat->id);
 	success = (sqlite3_step(stmt)==SQLITE_DONE)? 1 : 0;
 	sqlite3_finalize(stmt);
+	dc_objcache_remove(chat->context->chat_cache, chat->id);
 	return success;
 }
 
 
-static int set_from_stmt(dc_chat_t* chat, sqlite3_stmt* row)
+/**
+ * Set up a chat object from a row selected with DC_CHAT_FIELDS.
+ *
+ * @private @memberof dc_chat_t
+ */
+int dc_chat_set_from_stmt(dc_chat_t* chat, sqlite3_stmt* row)
 {
 	int         row_offset = 0;
 	const char* draft_text = NULL;
@@ -394,8 +402,7 @@ static int set_from_stmt(dc_chat_t* chat, sqlite3_stmt* row)
 
 	dc_chat_empty(chat);
 
-	#define CHAT_FIELDS " c.id,c.type,c.name, c.draft_timestamp,c.draft_txt,c.grpid,c.param,c.archived, c.blocked "
-	chat->id              =                    sqlite3_column_int  (row, row_offset++); /* the columns are defined in CHAT_FIELDS */
+	chat->id              =                    sqlite3_column_int  (row, row_offset++); /* the columns are defined in DC_CHAT_FIELDS */
 	chat->type            =                    sqlite3_column_int  (row, row_offset++);
 	chat->name            =   dc_strdup((char*)sqlite3_column_text (row, row_offset++));
 	chat->draft_timestamp =                    sqlite3_column_int64(row, row_offset++);
@@ -438,6 +445,32 @@ static int set_from_stmt(dc_chat_t* chat, sqlite3_stmt* row)
 }
 
 
+/**
+ * Copy all fields loaded from the database to another chat object.
+ * The context of the destination object is not changed.
+ *
+ * @private @memberof dc_chat_t
+ */
+void dc_chat_copy(dc_chat_t* dest, const dc_chat_t* src)
+{
+	if (dest==NULL || dest->magic!=DC_CHAT_MAGIC || src==NULL || src->magic!=DC_CHAT_MAGIC) {
+		return;
+	}
+
+	dc_chat_empty(dest);
+
+	dest->id              = src->id;
+	dest->type            = src->type;
+	dest->name            = dc_strdup_keep_null(src->name);
+	dest->draft_timestamp = src->draft_timestamp;
+	dest->draft_text      = dc_strdup_keep_null(src->draft_text);
+	dest->grpid           = dc_strdup_keep_null(src->grpid);
+	dest->archived        = src->archived;
+	dest->blocked         = src->blocked;
+	dc_param_set_param(dest->param, src->param);
+}
+
+
 /**
  * Load a chat from the database to the chat object.
  *
@@ -458,22 +491,22 @@ int dc_chat_load_from_db(dc_chat_t* chat, uint32_t chat_id)
 
 	dc_chat_empty(chat);
 
-	stmt = dc_sqlite3_prepare(chat->context->sql,
-		"SELECT " CHAT_FIELDS " FROM chats c WHERE c.id=?;");
+	stmt = dc_sqlite3_prepare_cached(chat->context->sql,
+		"SELECT " DC_CHAT_FIELDS " FROM chats c WHERE c.id=?;");
 	sqlite3_bind_int(stmt, 1, chat_id);
 
 	if (sqlite3_step(stmt)!=SQLITE_ROW) {
 		goto cleanup;
 	}
 
-	if (!set_from_stmt(chat, stmt)) {
+	if (!dc_chat_set_from_stmt(chat, stmt)) {
 		goto cleanup;
 	}
 
 	success = 1;
 
 cleanup:
-	sqlite3_finalize(stmt);
+	if (stmt) { dc_sqlite3_finalize_cached(chat->context->sql, stmt); }
 	return success;
 }
 
@@ -516,10 +549,58 @@ int dc_add_to_chat_contacts_table(dc_context_t* context, uint32_t chat_id, uint3
 	sqlite3_bind_int(stmt, 2, contact_id);
 	ret = (sqlite3_step(stmt)==SQLITE_DONE)? 1 : 0;
 	sqlite3_finalize(stmt);
+
+	if (ret) {
+		dc_recalc_chat_member_set(context->sql, chat_id);
+	}
 	return ret;
 }
 
 
+uint64_t dc_get_member_set_hash(const dc_array_t* sorted_contact_ids)
+{
+	/* FNV-1a over the sorted contact IDs; as SELF is not included, the hash does not change if the user leaves a group */
+	uint64_t hash = 14695981039346656037ULL;
+	size_t   i = 0, cnt = dc_array_get_cnt(sorted_contact_ids);
+	int      b = 0;
+
+	for (i = 0; i < cnt; i++) {
+		uint32_t contact_id = dc_array_get_id(sorted_contact_ids, i);
+		for (b = 0; b < 4; b++) {
+			hash ^= (contact_id>>(b*8)) & 0xFF;
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+
+void dc_recalc_chat_member_set(dc_sqlite3_t* sql, uint32_t chat_id)
+{
+	/* chats.member_set is the hash of the members of a chat, this allows finding ad-hoc groups by their members
+	with a single index lookup, see search_chat_ids_by_contact_ids(); as hashes may collide, the members of found chats must be checked */
+	dc_array_t*   contact_ids = dc_array_new(sql->context, 23);
+	sqlite3_stmt* stmt = NULL;
+
+	stmt = dc_sqlite3_prepare(sql,
+		"SELECT DISTINCT contact_id FROM chats_contacts WHERE chat_id=? AND contact_id!=" DC_STRINGIFY(DC_CONTACT_ID_SELF) " ORDER BY contact_id;");
+	sqlite3_bind_int(stmt, 1, chat_id);
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		dc_array_add_id(contact_ids, sqlite3_column_int(stmt, 0));
+	}
+	sqlite3_finalize(stmt);
+
+	stmt = dc_sqlite3_prepare(sql, "UPDATE chats SET member_set=? WHERE id=?;");
+	sqlite3_bind_int64(stmt, 1, (sqlite3_int64)dc_get_member_set_hash(contact_ids));
+	sqlite3_bind_int  (stmt, 2, chat_id);
+	sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+
+	dc_array_unref(contact_ids);
+}
+
+
 /**
  * Get chat object by a chat ID.
  *
@@ -534,15 +615,30 @@ dc_chat_t* dc_get_chat(dc_context_t* context, uint32_t chat_id)
 {
 	int        success = 0;
 	dc_chat_t* obj = dc_chat_new(context);
+	dc_chat_t* snapshot = NULL;
+	uint32_t   generation = 0;
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
 		goto cleanup;
 	}
 
+	/* the names of the special chats are stock strings, these chats are not cached */
+	if (chat_id>DC_CHAT_ID_LAST_SPECIAL
+	 && dc_objcache_get(context->chat_cache, chat_id, obj, &generation)) {
+		success = 1;
+		goto cleanup;
+	}
+
 	if (!dc_chat_load_from_db(obj, chat_id)) {
 		goto cleanup;
 	}
 
+	if (chat_id>DC_CHAT_ID_LAST_SPECIAL) {
+		snapshot = dc_chat_new(context);
+		dc_chat_copy(snapshot, obj);
+		dc_objcache_put(context->chat_cache, chat_id, snapshot, generation);
+	}
+
 	success = 1;
 
 cleanup:
@@ -960,6 +1056,34 @@ cleanup:
 }
 
 
+#define SECONDS_PER_DAY 86400
+
+
+static int get_local_day(time_t timestamp, long cnv_to_local)
+{
+	return (timestamp+cnv_to_local)/SECONDS_PER_DAY;
+}
+
+
+static void add_chat_msg_id(dc_array_t* ret, uint32_t curr_id, int curr_day, uint32_t flags, uint32_t marker1before, int* last_day)
+{
+	/* add user marker */
+	if (curr_id==marker1before) {
+		dc_array_add_id(ret, DC_MSG_ID_MARKER1);
+	}
+
+	/* add daymarker, if needed */
+	if (flags&DC_GCM_ADDDAYMARKER) {
+		if (curr_day!=*last_day) {
+			dc_array_add_id(ret, DC_MSG_ID_DAYMARKER);
+			*last_day = curr_day;
+		}
+	}
+
+	dc_array_add_id(ret, curr_id);
+}
+
+
 /**
  * Get all message IDs belonging to a chat.
  *
@@ -987,11 +1111,8 @@ dc_array_t* dc_get_chat_msgs(dc_context_t* context, uint32_t chat_id, uint32_t f
 	dc_array_t*   ret = dc_array_new(context, 512);
 	sqlite3_stmt* stmt = NULL;
 
-	uint32_t      curr_id;
-	time_t        curr_local_timestamp;
-	int           curr_day, last_day = 0;
+	int           last_day = 0;
 	long          cnv_to_local = dc_gm2local_offset();
-	#define       SECONDS_PER_DAY 86400
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || ret==NULL) {
 		goto cleanup;
@@ -999,7 +1120,7 @@ dc_array_t* dc_get_chat_msgs(dc_context_t* context, uint32_t chat_id, uint32_t f
 
 	if (chat_id==DC_CHAT_ID_DEADDROP)
 	{
-		stmt = dc_sqlite3_prepare(context->sql,
+		stmt = dc_sqlite3_prepare_read(context->sql,
 			"SELECT m.id, m.timestamp"
 				" FROM msgs m"
 				" LEFT JOIN chats ON m.chat_id=chats.id"
@@ -1012,7 +1133,7 @@ dc_array_t* dc_get_chat_msgs(dc_context_t* context, uint32_t chat_id, uint32_t f
 	}
 	else if (chat_id==DC_CHAT_ID_STARRED)
 	{
-		stmt = dc_sqlite3_prepare(context->sql,
+		stmt = dc_sqlite3_prepare_read(context->sql,
 			"SELECT m.id, m.timestamp"
 				" FROM msgs m"
 				" LEFT JOIN contacts ct ON m.from_id=ct.id"
@@ -1023,7 +1144,7 @@ dc_array_t* dc_get_chat_msgs(dc_context_t* context, uint32_t chat_id, uint32_t f
 	}
 	else
 	{
-		stmt = dc_sqlite3_prepare(context->sql,
+		stmt = dc_sqlite3_prepare_read(context->sql,
 			"SELECT m.id, m.timestamp"
 				" FROM msgs m"
 				//" LEFT JOIN contacts ct ON m.from_id=ct.id"
@@ -1036,30 +1157,15 @@ dc_array_t* dc_get_chat_msgs(dc_context_t* context, uint32_t chat_id, uint32_t f
 
 	while (sqlite3_step(stmt)==SQLITE_ROW)
 	{
-		curr_id = sqlite3_column_int(stmt, 0);
-
-		/* add user marker */
-		if (curr_id==marker1before) {
-			dc_array_add_id(ret, DC_MSG_ID_MARKER1);
-		}
-
-		/* add daymarker, if needed */
-		if (flags&DC_GCM_ADDDAYMARKER) {
-			curr_local_timestamp = (time_t)sqlite3_column_int64(stmt, 1) + cnv_to_local;
-			curr_day = curr_local_timestamp/SECONDS_PER_DAY;
-			if (curr_day!=last_day) {
-				dc_array_add_id(ret, DC_MSG_ID_DAYMARKER);
-				last_day = curr_day;
-			}
-		}
-
-		dc_array_add_id(ret, curr_id);
+		add_chat_msg_id(ret, sqlite3_column_int(stmt, 0),
+			get_local_day(sqlite3_column_int64(stmt, 1), cnv_to_local),
+			flags, marker1before, &last_day);
 	}
 
 	success = 1;
 
 cleanup:
-	sqlite3_finalize(stmt);
+	if (stmt) { dc_sqlite3_finalize_read(context->sql, stmt); }
 
 	//dc_log_info(context, 0, "Message list for chat #%i created in %.3f ms.", chat_id, (double)(clock()-start)*1000.0/CLOCKS_PER_SEC);
 
@@ -1075,6 +1181,190 @@ cleanup:
 }
 
 
+/**
+ * Get a page of the message IDs belonging to a chat.
+ *
+ * Other than dc_get_chat_msgs(), this function does not load the whole chat
+ * but only up to `cnt` messages before or after a given anchor message.
+ * This allows the UI to show long chats without loading all message IDs
+ * on every #DC_EVENT_MSGS_CHANGED.
+ *
+ * As for dc_get_chat_msgs(), the returned list starts with the oldest message.
+ * The markers are added as if the pages were parts of the list returned by
+ * dc_get_chat_msgs(), so a daymarker is added before the first message of a page
+ * only if the message before it is from another day
+ * (if you get a page with the newer messages, the anchor is the message before).
+ * The anchor itself is not part of the returned page.
+ *
+ * Example, to show the chat starting with the newest messages and to load
+ * the older ones on scrolling up:
+ *
+ * ~~~
+ * dc_array_t* page = dc_get_chat_msgs_page(context, chat_id, DC_GCM_ADDDAYMARKER, 0, 0, 30);
+ * // ... on scrolling up, get the first real message of the page as anchor ...
+ * dc_array_t* older = dc_get_chat_msgs_page(context, chat_id, DC_GCM_ADDDAYMARKER, 0, anchor_id, 30);
+ * ~~~
+ *
+ * Note that, when the older page is put in front of the current one, a daymarker
+ * that started the current page may not be needed any longer.
+ * So, if the last message of the older page is from the same day,
+ * the daymarker at the beginning of the current page should be removed.
+ *
+ * @memberof dc_context_t
+ * @param context The context object as returned from dc_context_new().
+ * @param chat_id The chat ID of which the messages IDs should be queried.
+ * @param flags DC_GCM_ADDDAYMARKER adds daymarkers as for dc_get_chat_msgs().
+ *     By default, the messages before the anchor are returned;
+ *     if DC_GCM_NEWER is set, the messages after the anchor are returned.
+ * @param marker1before An optional message ID, see dc_get_chat_msgs().
+ * @param anchor_msg_id The message ID the page should start before or after.
+ *     If set to 0, the page contains the newest messages of the chat or,
+ *     if DC_GCM_NEWER is set, the oldest messages of the chat.
+ * @param cnt The maximum number of messages to return, the markers are not counted.
+ * @return Array of message IDs, must be dc_array_unref()'d when no longer used.
+ *     NULL on errors, eg. if the anchor message does not exist.
+ */
+dc_array_t* dc_get_chat_msgs_page(dc_context_t* context, uint32_t chat_id, uint32_t flags, uint32_t marker1before, uint32_t anchor_msg_id, int cnt)
+{
+	int           success = 0;
+	int           newer = (flags&DC_GCM_NEWER)? 1 : 0;
+	dc_array_t*   ret = NULL;
+	dc_array_t*   rev_ids = NULL;
+	dc_array_t*   rev_days = NULL;
+	sqlite3_stmt* stmt = NULL;
+	char*         q_from = NULL;
+	char*         q_keyset = NULL;
+	char*         q3 = NULL;
+	time_t        anchor_timestamp = 0;
+	int           last_day = 0;
+	long          cnv_to_local = dc_gm2local_offset();
+	int           i = 0, row_cnt = 0;
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || cnt<0) {
+		goto cleanup;
+	}
+
+	ret = dc_array_new(context, cnt+16);
+
+	if (anchor_msg_id)
+	{
+		stmt = dc_sqlite3_prepare(context->sql, "SELECT timestamp FROM msgs WHERE id=?;");
+		sqlite3_bind_int(stmt, 1, anchor_msg_id);
+		if (sqlite3_step(stmt)!=SQLITE_ROW) {
+			goto cleanup;
+		}
+		anchor_timestamp = sqlite3_column_int64(stmt, 0);
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+
+		/* (timestamp, id) is compared as a whole; the first condition alone allows a range scan on msgs_index6.
+		the messages after the anchor may get a daymarker if the anchor is from another day */
+		q_keyset = sqlite3_mprintf(newer?
+			" AND m.timestamp>=%lli AND (m.timestamp>%lli OR m.id>%i)" :
+			" AND m.timestamp<=%lli AND (m.timestamp<%lli OR m.id<%i)",
+			(sqlite3_int64)anchor_timestamp, (sqlite3_int64)anchor_timestamp, (int)anchor_msg_id);
+		if (newer) {
+			last_day = get_local_day(anchor_timestamp, cnv_to_local);
+		}
+	}
+	else
+	{
+		q_keyset = sqlite3_mprintf("");
+	}
+
+	/* the same messages as in dc_get_chat_msgs() */
+	if (chat_id==DC_CHAT_ID_DEADDROP)
+	{
+		q_from = sqlite3_mprintf(
+			" FROM msgs m"
+			" LEFT JOIN chats ON m.chat_id=chats.id"
+			" LEFT JOIN contacts ON m.from_id=contacts.id"
+			" WHERE m.from_id!=" DC_STRINGIFY(DC_CONTACT_ID_SELF)
+			"   AND m.hidden=0 "
+			"   AND chats.blocked=" DC_STRINGIFY(DC_CHAT_DEADDROP_BLOCKED)
+			"   AND contacts.blocked=0");
+	}
+	else if (chat_id==DC_CHAT_ID_STARRED)
+	{
+		q_from = sqlite3_mprintf(
+			" FROM msgs m"
+			" LEFT JOIN contacts ct ON m.from_id=ct.id"
+			" WHERE m.starred=1 "
+			"   AND m.hidden=0 "
+			"   AND ct.blocked=0");
+	}
+	else
+	{
+		q_from = sqlite3_mprintf(
+			" FROM msgs m"
+			" WHERE m.chat_id=%i "
+			"   AND m.hidden=0 ", (int)chat_id);
+	}
+
+	if (newer)
+	{
+		q3 = sqlite3_mprintf("SELECT m.id, m.timestamp %s %s ORDER BY m.timestamp,m.id LIMIT %i;",
+			q_from, q_keyset, cnt);
+		stmt = dc_sqlite3_prepare_read(context->sql, q3);
+		while (sqlite3_step(stmt)==SQLITE_ROW)
+		{
+			add_chat_msg_id(ret, sqlite3_column_int(stmt, 0),
+				get_local_day(sqlite3_column_int64(stmt, 1), cnv_to_local),
+				flags, marker1before, &last_day);
+		}
+	}
+	else
+	{
+		/* read the page backwards; one more message is read to check if the oldest message
+		of the page starts a new day */
+		q3 = sqlite3_mprintf("SELECT m.id, m.timestamp %s %s ORDER BY m.timestamp DESC,m.id DESC LIMIT %i;",
+			q_from, q_keyset, cnt+1);
+		stmt = dc_sqlite3_prepare_read(context->sql, q3);
+		rev_ids = dc_array_new(context, cnt+1);
+		rev_days = dc_array_new(context, cnt+1);
+		while (sqlite3_step(stmt)==SQLITE_ROW)
+		{
+			dc_array_add_id(rev_ids, sqlite3_column_int(stmt, 0));
+			dc_array_add_uint(rev_days, get_local_day(sqlite3_column_int64(stmt, 1), cnv_to_local));
+		}
+
+		row_cnt = dc_array_get_cnt(rev_ids);
+		if (row_cnt > cnt) {
+			last_day = dc_array_get_uint(rev_days, cnt);
+			row_cnt = cnt;
+		}
+
+		for (i = row_cnt-1; i >= 0; i--)
+		{
+			add_chat_msg_id(ret, dc_array_get_id(rev_ids, i),
+				dc_array_get_uint(rev_days, i),
+				flags, marker1before, &last_day);
+		}
+	}
+
+	success = 1;
+
+cleanup:
+	if (stmt) {
+		if (q3) { dc_sqlite3_finalize_read(context->sql, stmt); }
+		else    { sqlite3_finalize(stmt); }
+	}
+	sqlite3_free(q_from);
+	sqlite3_free(q_keyset);
+	sqlite3_free(q3);
+	dc_array_unref(rev_ids);
+	dc_array_unref(rev_days);
+
+	if (success) {
+		return ret;
+	}
+	else {
+		dc_array_unref(ret);
+		return NULL;
+	}
+}
+
+
 /**
  * Save a draft for a chat in the database.
  * If the draft was modified, an #DC_EVENT_MSGS_CHANGED will be sent that you
@@ -1222,6 +1512,8 @@ void dc_create_or_lookup_nchat_by_contact_id(dc_context_t* context, uint32_t con
 		goto cleanup;
 	}
 
+	dc_recalc_chat_member_set(context->sql, chat_id);
+
 	sqlite3_free(q);
 	q = NULL;
 	sqlite3_finalize(stmt);
@@ -1297,21 +1589,19 @@ int dc_get_fresh_msg_cnt(dc_context_t* context, uint32_t chat_id)
 		goto cleanup;
 	}
 
-	stmt = dc_sqlite3_prepare(context->sql,
-		"SELECT COUNT(*) FROM msgs "
-		" WHERE state=" DC_STRINGIFY(DC_STATE_IN_FRESH)
-		"   AND hidden=0 "
-		"   AND chat_id=?;"); /* we have an index over the state-column, this should be sufficient as there are typically only few fresh messages */
+	/* the counter is updated by triggers on the msgs table, see migration 48 in dc_sqlite3_open() */
+	stmt = dc_sqlite3_prepare_cached(context->sql,
+		"SELECT fresh_msg_cnt FROM chats WHERE id=?;");
 	sqlite3_bind_int(stmt, 1, chat_id);
 
 	if (sqlite3_step(stmt)!=SQLITE_ROW) {
 		goto cleanup;
 	}
 
-	ret = sqlite3_column_int(stmt, 0);
+	ret = DC_MAX(0, sqlite3_column_int(stmt, 0));
 
 cleanup:
-	sqlite3_finalize(stmt);
+	if (stmt) { dc_sqlite3_finalize_cached(context->sql, stmt); }
 	return ret;
 }
 
@@ -1435,10 +1725,20 @@ void dc_delete_chat(dc_context_t* context, uint32_t chat_id)
 		sqlite3_free(q3);
 		q3 = NULL;
 
+		if (context->sql->fts_state!=DC_FTS_NONE) {
+			q3 = sqlite3_mprintf("DELETE FROM msgs_fts WHERE rowid IN (SELECT id FROM msgs WHERE chat_id=%i);", chat_id);
+			if (!dc_sqlite3_execute(context->sql, q3)) {
+				goto cleanup;
+			}
+			sqlite3_free(q3);
+			q3 = NULL;
+		}
+
 		q3 = sqlite3_mprintf("DELETE FROM msgs WHERE chat_id=%i;", chat_id);
 		if (!dc_sqlite3_execute(context->sql, q3)) {
 			goto cleanup;
 		}
+		dc_midfilter_removed(context->mid_filter, sqlite3_changes(context->sql->cobj));
 		sqlite3_free(q3);
 		q3 = NULL;
 
@@ -1944,6 +2244,8 @@ int dc_remove_contact_from_chat(dc_context_t* context, uint32_t chat_id, uint32_
 		goto cleanup;
 	}
 
+	dc_recalc_chat_member_set(context->sql, chat_id);
+
 	context->cb(context, DC_EVENT_CHAT_MODIFIED, chat_id, 0);
 
 	success = 1;
@@ -1957,6 +2259,38 @@ cleanup:
 }
 
 
+/*******************************************************************************
+ * Last message of a chat
+ ******************************************************************************/
+
+
+void dc_set_chat_last_msg_if_newer(dc_context_t* context, uint32_t chat_id, uint32_t msg_id, time_t timestamp)
+{
+	/* messages are ordered by timestamp and id, as in dc_get_chat_msgs() */
+	sqlite3_stmt* stmt = dc_sqlite3_prepare_cached(context->sql,
+		"UPDATE chats SET last_msg_id=?1, last_msg_timestamp=?2 "
+		" WHERE id=?3 AND (last_msg_timestamp<?2 OR (last_msg_timestamp=?2 AND last_msg_id<?1));");
+	sqlite3_bind_int  (stmt, 1, msg_id);
+	sqlite3_bind_int64(stmt, 2, timestamp);
+	sqlite3_bind_int  (stmt, 3, chat_id);
+	sqlite3_step(stmt);
+	dc_sqlite3_finalize_cached(context->sql, stmt);
+}
+
+
+void dc_recalc_chat_last_msg(dc_context_t* context, uint32_t chat_id)
+{
+	sqlite3_stmt* stmt = dc_sqlite3_prepare_cached(context->sql,
+		"UPDATE chats SET "
+		" last_msg_id=IFNULL((SELECT id FROM msgs WHERE chat_id=?1 AND hidden=0 ORDER BY timestamp DESC, id DESC LIMIT 1), 0),"
+		" last_msg_timestamp=IFNULL((SELECT MAX(timestamp) FROM msgs WHERE chat_id=?1 AND hidden=0), 0) "
+		" WHERE id=?1;");
+	sqlite3_bind_int(stmt, 1, chat_id);
+	sqlite3_step(stmt);
+	dc_sqlite3_finalize_cached(context->sql, stmt);
+}
+
+
 /*******************************************************************************
  * Sending messages
  ******************************************************************************/
@@ -2096,14 +2430,19 @@ static uint32_t send_msg_raw(dc_context_t* context, dc_chat_t* chat, const dc_ms
 	sqlite3_bind_int  (stmt,  6, msg->type);
 	sqlite3_bind_int  (stmt,  7, DC_STATE_OUT_PENDING);
 	sqlite3_bind_text (stmt,  8, msg->text? msg->text : "",  -1, SQLITE_STATIC);
-	sqlite3_bind_text (stmt,  9, msg->param->packed, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt,  9, dc_param_get_packed(msg->param), -1, SQLITE_STATIC);
 	sqlite3_bind_int  (stmt, 10, msg->hidden);
 	if (sqlite3_step(stmt)!=SQLITE_DONE) {
 		dc_log_error(context, 0, "Cannot send message, cannot insert to database.", chat->id);
 		goto cleanup;
 	}
+	dc_midfilter_add(context->mid_filter, rfc724_mid);
 
 	msg_id = dc_sqlite3_get_rowid(context->sql, "msgs", "rfc724_mid", rfc724_mid);
+	if (!msg->hidden) {
+		dc_set_chat_last_msg_if_newer(context, chat->id, msg_id, timestamp);
+	}
+	dc_update_msg_fts(context, msg_id, msg->text? msg->text : "");
 	dc_job_add(context, DC_JOB_SEND_MSG_TO_SMTP, msg_id, NULL, 0);
 
 cleanup:
@@ -2113,51 +2452,10 @@ cleanup:
 }
 
 
-/**
- * Send a message defined by a dc_msg_t object to a chat.
- *
- * Sends the event #DC_EVENT_MSGS_CHANGED on succcess.
- * However, this does not imply, the message really reached the recipient -
- * sending may be delayed eg. due to network problems. However, from your
- * view, you're done with the message. Sooner or later it will find its way.
- *
- * Example:
- * ~~~
- * dc_msg_t* msg = dc_msg_new(context, DC_MSG_IMAGE);
- * dc_msg_set_file(msg, "/file/to/send.jpg", NULL);
- * dc_send_msg(context, msg);
- * ~~~
- *
- * You can even call this function if the file to be sent is still in creation.
- * For this purpose, create a file with the additional extension `.increation`
- * beside the file to sent. Once you're done with creating the file, delete the
- * increation-file and the message will really be sent.
- * This is useful as the user can already send the next messages while
- * eg. the recoding of a video is not yet finished. Or the user can even forward
- * the message with the file being still in creation to other groups.
- *
- * Files being sent with the increation-method must be placed in the
- * blob directory, see dc_get_blobdir().
- * If the increation-method is not used - which is probably the normal case -
- * the file is copied to the blob directory if it is not yet there.
- *
- * @memberof dc_context_t
- * @param context The context object as returned from dc_context_new().
- * @param chat_id Chat ID to send the message to.
- * @param msg Message object to send to the chat defined by the chat ID.
- *     On succcess, msg_id of the object is set up,
- *     The function does not take ownership of the object,
- *     so you have to free it using dc_msg_unref() as usual.
- * @return The ID of the message that is about being sent.
- */
-uint32_t dc_send_msg(dc_context_t* context, uint32_t chat_id, dc_msg_t* msg)
+static int prepare_msg_for_sending(dc_context_t* context, dc_msg_t* msg)
 {
-	char*      pathNfilename = NULL;
-	dc_chat_t* chat = NULL;
-
-	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || msg==NULL || chat_id<=DC_CHAT_ID_LAST_SPECIAL) {
-		return 0;
-	}
+	int   success = 0;
+	char* pathNfilename = NULL;
 
 	msg->id      = 0;
 	msg->context = context;
@@ -2208,6 +2506,63 @@ uint32_t dc_send_msg(dc_context_t* context, uint32_t chat_id, dc_msg_t* msg)
 		goto cleanup;
 	}
 
+	success = 1;
+
+cleanup:
+	free(pathNfilename);
+	return success;
+}
+
+
+/**
+ * Send a message defined by a dc_msg_t object to a chat.
+ *
+ * Sends the event #DC_EVENT_MSGS_CHANGED on succcess.
+ * However, this does not imply, the message really reached the recipient -
+ * sending may be delayed eg. due to network problems. However, from your
+ * view, you're done with the message. Sooner or later it will find its way.
+ *
+ * Example:
+ * ~~~
+ * dc_msg_t* msg = dc_msg_new(context, DC_MSG_IMAGE);
+ * dc_msg_set_file(msg, "/file/to/send.jpg", NULL);
+ * dc_send_msg(context, msg);
+ * ~~~
+ *
+ * You can even call this function if the file to be sent is still in creation.
+ * For this purpose, create a file with the additional extension `.increation`
+ * beside the file to sent. Once you're done with creating the file, delete the
+ * increation-file and the message will really be sent.
+ * This is useful as the user can already send the next messages while
+ * eg. the recoding of a video is not yet finished. Or the user can even forward
+ * the message with the file being still in creation to other groups.
+ *
+ * Files being sent with the increation-method must be placed in the
+ * blob directory, see dc_get_blobdir().
+ * If the increation-method is not used - which is probably the normal case -
+ * the file is copied to the blob directory if it is not yet there.
+ *
+ * @memberof dc_context_t
+ * @param context The context object as returned from dc_context_new().
+ * @param chat_id Chat ID to send the message to.
+ * @param msg Message object to send to the chat defined by the chat ID.
+ *     On succcess, msg_id of the object is set up,
+ *     The function does not take ownership of the object,
+ *     so you have to free it using dc_msg_unref() as usual.
+ * @return The ID of the message that is about being sent.
+ */
+uint32_t dc_send_msg(dc_context_t* context, uint32_t chat_id, dc_msg_t* msg)
+{
+	dc_chat_t* chat = NULL;
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || msg==NULL || chat_id<=DC_CHAT_ID_LAST_SPECIAL) {
+		return 0;
+	}
+
+	if (!prepare_msg_for_sending(context, msg)) {
+		goto cleanup;
+	}
+
 	dc_unarchive_chat(context, chat_id);
 
 	context->smtp->log_connect_errors = 1;
@@ -2224,11 +2579,89 @@ uint32_t dc_send_msg(dc_context_t* context, uint32_t chat_id, dc_msg_t* msg)
 
 cleanup:
 	dc_chat_unref(chat);
-	free(pathNfilename);
 	return msg->id;
 }
 
 
+/**
+ * Send the same message to several chats.
+ *
+ * The message is prepared only once: an attachment is copied to the blob directory
+ * a single time and all messages created by this function refer to the same file.
+ * For each chat, a message is added and a sending job is created as with dc_send_msg();
+ * the sending jobs are independent, so a failure in one chat does not affect the others.
+ *
+ * When the messages are encrypted, the body is rendered and signed only once
+ * and then encrypted for each chat, as long as the protected headers are the same,
+ * which is typically true for one-to-one chats.
+ *
+ * Sends the event #DC_EVENT_MSGS_CHANGED for each chat the message was added to.
+ *
+ * @memberof dc_context_t
+ * @param context The context object as returned from dc_context_new().
+ * @param chat_ids Array of chat IDs to send the message to.
+ * @param chat_cnt Number of chat IDs in the array.
+ * @param msg Message object to send.
+ *     The function does not take ownership of the object,
+ *     so you have to free it using dc_msg_unref() as usual.
+ *     The msg_id of the object is not set up, use the returned array instead.
+ * @return Array of message IDs, one for each chat ID given, in the same order.
+ *     If the message could not be added to a chat, the message ID is 0 for this chat.
+ *     Returns NULL if the message cannot be sent at all, eg. on a missing attachment.
+ *     If not NULL, the returned array must be freed using dc_array_unref().
+ */
+dc_array_t* dc_send_msg_to_chats(dc_context_t* context, const uint32_t* chat_ids, int chat_cnt, dc_msg_t* msg)
+{
+	dc_array_t* ret = NULL;
+	dc_chat_t*  chat = NULL;
+	char*       shared_id = NULL;
+	int         i = 0;
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || chat_ids==NULL || chat_cnt<=0 || msg==NULL) {
+		goto cleanup;
+	}
+
+	if (!prepare_msg_for_sending(context, msg)) {
+		goto cleanup;
+	}
+
+	context->smtp->log_connect_errors = 1;
+
+	/* mark the messages as having the same body, see dc_e2ee_encrypt() */
+	shared_id = dc_create_id();
+	dc_param_set(msg->param, DC_PARAM_SHARED_ID, shared_id);
+
+	chat = dc_chat_new(context);
+
+	ret = dc_array_new(context, chat_cnt);
+	for (i = 0; i < chat_cnt; i++)
+	{
+		uint32_t msg_id = 0;
+		if (chat_ids[i] > DC_CHAT_ID_LAST_SPECIAL) {
+			dc_unarchive_chat(context, chat_ids[i]);
+			if (dc_chat_load_from_db(chat, chat_ids[i])) {
+				msg_id = send_msg_raw(context, chat, msg, dc_create_smeared_timestamp(context));
+			}
+		}
+		dc_array_add_id(ret, msg_id);
+	}
+
+	for (i = 0; i < chat_cnt; i++) {
+		if (dc_array_get_id(ret, i)) {
+			context->cb(context, DC_EVENT_MSGS_CHANGED, chat_ids[i], dc_array_get_id(ret, i));
+		}
+	}
+
+	msg->id = 0;
+	dc_param_set(msg->param, DC_PARAM_SHARED_ID, NULL);
+
+cleanup:
+	dc_chat_unref(chat);
+	free(shared_id);
+	return ret;
+}
+
+
 /**
  * Send a simple text message a given chat.
  *
@@ -2277,17 +2710,20 @@ void dc_add_device_msg(dc_context_t* context, uint32_t chat_id, const char* text
 	uint32_t      msg_id = 0;
 	sqlite3_stmt* stmt = NULL;
 	char*         rfc724_mid = dc_create_outgoing_rfc724_mid(NULL, "@device");
+	time_t        timestamp = 0;
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || text==NULL) {
 		goto cleanup;
 	}
 
+	timestamp = dc_create_smeared_timestamp(context);
+
 	stmt = dc_sqlite3_prepare(context->sql,
 		"INSERT INTO msgs (chat_id,from_id,to_id, timestamp,type,state, txt,rfc724_mid) VALUES (?,?,?, ?,?,?, ?,?);");
 	sqlite3_bind_int  (stmt,  1, chat_id);
 	sqlite3_bind_int  (stmt,  2, DC_CONTACT_ID_DEVICE);
 	sqlite3_bind_int  (stmt,  3, DC_CONTACT_ID_DEVICE);
-	sqlite3_bind_int64(stmt,  4, dc_create_smeared_timestamp(context));
+	sqlite3_bind_int64(stmt,  4, timestamp);
 	sqlite3_bind_int  (stmt,  5, DC_MSG_TEXT);
 	sqlite3_bind_int  (stmt,  6, DC_STATE_IN_NOTICED);
 	sqlite3_bind_text (stmt,  7, text,  -1, SQLITE_STATIC);
@@ -2295,7 +2731,10 @@ void dc_add_device_msg(dc_context_t* context, uint32_t chat_id, const char* text
 	if (sqlite3_step(stmt)!=SQLITE_DONE) {
 		goto cleanup;
 	}
+	dc_midfilter_add(context->mid_filter, rfc724_mid);
 	msg_id = dc_sqlite3_get_rowid(context->sql, "msgs", "rfc724_mid", rfc724_mid);
+	dc_set_chat_last_msg_if_newer(context, chat_id, msg_id, timestamp);
+	dc_update_msg_fts(context, msg_id, text);
 	context->cb(context, DC_EVENT_MSGS_CHANGED, chat_id, msg_id);
 
 cleanup:
@@ -2355,6 +2794,7 @@ void dc_forward_msgs(dc_context_t* context, const uint32_t* msg_ids, int msg_cnt
 
 			dc_param_set_int(msg->param, DC_PARAM_FORWARDED, 1);
 			dc_param_set    (msg->param, DC_PARAM_GUARANTEE_E2EE, NULL);
+			dc_param_set    (msg->param, DC_PARAM_SHARED_ID, NULL);
 			dc_param_set    (msg->param, DC_PARAM_FORCE_PLAINTEXT, NULL);
 
 			uint32_t new_msg_id = send_msg_raw(context, chat, msg, curr_timestamp++);
@@ -29,6 +29,9 @@ struct _dc_chat
 };
 
 int             dc_chat_load_from_db               (dc_chat_t*, uint32_t id);
+#define         DC_CHAT_FIELDS " c.id,c.type,c.name, c.draft_timestamp,c.draft_txt,c.grpid,c.param,c.archived, c.blocked "
+int             dc_chat_set_from_stmt              (dc_chat_t*, sqlite3_stmt* row); /* field order must be DC_CHAT_FIELDS */
+void            dc_chat_copy                       (dc_chat_t* dest, const dc_chat_t* src); /* copies all database fields, used for the cache */
 int             dc_chat_update_param               (dc_chat_t*);
 
 #define         DC_CHAT_TYPE_IS_MULTI(a)   ((a)==DC_CHAT_TYPE_GROUP || (a)==DC_CHAT_TYPE_VERIFIED_GROUP)
@@ -40,6 +43,8 @@ int             dc_chat_update_param               (dc_chat_t*);
 
 // Context functions to work with chats
 int             dc_add_to_chat_contacts_table              (dc_context_t*, uint32_t chat_id, uint32_t contact_id);
+uint64_t        dc_get_member_set_hash                     (const dc_array_t* sorted_contact_ids); /* the IDs must be sorted, without duplicates and without SELF */
+void            dc_recalc_chat_member_set                  (dc_sqlite3_t*, uint32_t chat_id); /* call after chats_contacts is modified */
 int             dc_is_contact_in_chat                      (dc_context_t*, uint32_t chat_id, uint32_t contact_id);
 size_t          dc_get_chat_cnt                            (dc_context_t*);
 uint32_t        dc_get_chat_id_by_grpid                    (dc_context_t*, const char* grpid, int* ret_blocked, int* ret_verified);
@@ -49,6 +54,8 @@ void            dc_unarchive_chat                          (dc_context_t*, uint3
 void            dc_block_chat                              (dc_context_t*, uint32_t chat_id, int new_blocking);
 void            dc_unblock_chat                            (dc_context_t*, uint32_t chat_id);
 void            dc_add_device_msg                          (dc_context_t*, uint32_t chat_id, const char* text);
+void            dc_set_chat_last_msg_if_newer              (dc_context_t*, uint32_t chat_id, uint32_t msg_id, time_t timestamp); /* call after a visible message is added */
+void            dc_recalc_chat_last_msg                    (dc_context_t*, uint32_t chat_id); /* call after messages are removed from a chat */
 int             dc_get_chat_contact_cnt                    (dc_context_t*, uint32_t chat_id);
 int             dc_is_group_explicitly_left                (dc_context_t*, const char* grpid);
 void            dc_set_group_explicitly_left               (dc_context_t*, const char* grpid);
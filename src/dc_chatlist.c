@@ -63,6 +63,14 @@ void dc_chatlist_empty(dc_chatlist_t* chatlist)
 		return;
 	}
 
+	if (chatlist->summaries) {
+		for (size_t i = 0; i < chatlist->cnt; i++) {
+			dc_lot_unref(chatlist->summaries[i]);
+		}
+		free(chatlist->summaries);
+		chatlist->summaries = NULL;
+	}
+
 	chatlist->cnt = 0;
 	dc_array_empty(chatlist->chatNlastmsg_ids);
 }
@@ -127,6 +135,227 @@ uint32_t dc_chatlist_get_msg_id(const dc_chatlist_t* chatlist, size_t index)
 }
 
 
+static dc_lot_t* create_summary(dc_context_t* context, const dc_chat_t* chat, const dc_msg_t* lastmsg /*may be NULL*/, const dc_contact_t* lastcontact /*may be NULL*/)
+{
+	/* The summary is created by the chat, not by the last message.
+	This is because we may want to display drafts here or stuff as
+	"is typing".
+	Also, sth. as "No messages" would not work if the summary comes from a
+	message. */
+
+	dc_lot_t* ret = dc_lot_new();
+
+	if (chat->id==DC_CHAT_ID_ARCHIVED_LINK)
+	{
+		ret->text2 = dc_strdup(NULL);
+	}
+	else if (chat->draft_timestamp
+	      && chat->draft_text
+	      && (lastmsg==NULL || chat->draft_timestamp>lastmsg->timestamp))
+	{
+		/* show the draft as the last message */
+		ret->text1 = dc_stock_str(context, DC_STR_DRAFT);
+		ret->text1_meaning = DC_TEXT1_DRAFT;
+
+		ret->text2 = dc_strdup(chat->draft_text);
+		dc_truncate_n_unwrap_str(ret->text2, DC_SUMMARY_CHARACTERS, 1/*unwrap*/);
+
+		ret->timestamp = chat->draft_timestamp;
+	}
+	else if (lastmsg==NULL || lastmsg->from_id==0)
+	{
+		/* no messages */
+		ret->text2 = dc_stock_str(context, DC_STR_NOMESSAGES);
+	}
+	else
+	{
+		/* show the last message */
+		dc_lot_fill(ret, lastmsg, chat, lastcontact, context);
+	}
+
+	return ret;
+}
+
+
+static void load_summaries(dc_chatlist_t* chatlist, size_t index, size_t cnt, dc_chat_t* chat_at_index /*may be NULL*/)
+{
+	dc_context_t* context = NULL;
+	dc_array_t*   chat_ids = NULL;
+	dc_array_t*   msg_ids = NULL;
+	dc_array_t*   contact_ids = NULL;
+	dc_hash_t     chats;
+	dc_hash_t     msgs;
+	dc_hash_t     contacts;
+	dc_hashelem_t* e = NULL;
+	char*         ids_str = NULL;
+	char*         q3 = NULL;
+	sqlite3_stmt* stmt = NULL;
+	size_t        end = 0, i = 0, missing_cnt = 0;
+
+	dc_hash_init(&chats, DC_HASH_INT, 0);
+	dc_hash_init(&msgs, DC_HASH_INT, 0);
+	dc_hash_init(&contacts, DC_HASH_INT, 0);
+
+	if (chatlist==NULL || chatlist->magic!=DC_CHATLIST_MAGIC || index>=chatlist->cnt) {
+		goto cleanup;
+	}
+
+	context = chatlist->context;
+	end = DC_MIN(index+cnt, chatlist->cnt);
+
+	if (chatlist->summaries==NULL) {
+		if ((chatlist->summaries=calloc(chatlist->cnt, sizeof(dc_lot_t*)))==NULL) {
+			exit(33);
+		}
+	}
+
+	/* collect the IDs of the summaries not yet loaded */
+	chat_ids = dc_array_new(context, end-index);
+	msg_ids = dc_array_new(context, end-index);
+	for (i = index; i < end; i++) {
+		if (chatlist->summaries[i]==NULL) {
+			missing_cnt++;
+			if (i==index && chat_at_index) {
+				dc_hash_insert(&chats, NULL, dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT), chat_at_index); /* owned by the caller */
+			}
+			else {
+				dc_array_add_id(chat_ids, dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT));
+			}
+			uint32_t msg_id = dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT+1);
+			if (msg_id) {
+				dc_array_add_id(msg_ids, msg_id);
+			}
+		}
+	}
+
+	if (missing_cnt==0) {
+		goto cleanup;
+	}
+
+	/* load all chats ... */
+	if (dc_array_get_cnt(chat_ids))
+	{
+		ids_str = dc_array_get_string(chat_ids, ",");
+		q3 = sqlite3_mprintf("SELECT " DC_CHAT_FIELDS " FROM chats c WHERE c.id IN(%s);", ids_str);
+		stmt = dc_sqlite3_prepare(context->sql, q3);
+		while (sqlite3_step(stmt)==SQLITE_ROW) {
+			dc_chat_t* chat = dc_chat_new(context);
+			dc_chat_set_from_stmt(chat, stmt);
+			dc_hash_insert(&chats, NULL, chat->id, chat);
+		}
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+		sqlite3_free(q3);
+		q3 = NULL;
+		free(ids_str);
+		ids_str = NULL;
+	}
+
+	/* ... the last messages ... */
+	contact_ids = dc_array_new(context, dc_array_get_cnt(msg_ids)+1);
+	if (dc_array_get_cnt(msg_ids))
+	{
+		ids_str = dc_array_get_string(msg_ids, ",");
+		q3 = sqlite3_mprintf("SELECT " DC_MSG_FIELDS " FROM msgs m LEFT JOIN chats c ON c.id=m.chat_id WHERE m.id IN(%s);", ids_str);
+		stmt = dc_sqlite3_prepare(context->sql, q3);
+		while (sqlite3_step(stmt)==SQLITE_ROW) {
+			dc_msg_t* msg = dc_msg_new_untyped(context);
+			dc_msg_set_from_stmt(msg, stmt, 0);
+			dc_hash_insert(&msgs, NULL, msg->id, msg);
+		}
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+		sqlite3_free(q3);
+		q3 = NULL;
+		free(ids_str);
+		ids_str = NULL;
+
+		/* the sender is shown for groups; use the chat of the row, not the one of the message,
+		as they differ for the deaddrop */
+		for (i = index; i < end; i++) {
+			if (chatlist->summaries[i]==NULL) {
+				dc_chat_t* chat = dc_hash_find(&chats, NULL, dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT));
+				uint32_t   msg_id = dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT+1);
+				dc_msg_t*  msg = msg_id? dc_hash_find(&msgs, NULL, msg_id) : NULL;
+				if (chat && msg && msg->from_id!=DC_CONTACT_ID_SELF && DC_CHAT_TYPE_IS_MULTI(chat->type)
+				 && !dc_array_search_id(contact_ids, msg->from_id, NULL)) {
+					dc_array_add_id(contact_ids, msg->from_id);
+				}
+			}
+		}
+	}
+
+	/* ... and the senders of the last messages in groups */
+	if (dc_array_get_cnt(contact_ids))
+	{
+		ids_str = dc_array_get_string(contact_ids, ",");
+		q3 = sqlite3_mprintf("SELECT " DC_CONTACT_FIELDS " FROM contacts c WHERE c.id IN(%s);", ids_str);
+		stmt = dc_sqlite3_prepare(context->sql, q3);
+		while (sqlite3_step(stmt)==SQLITE_ROW) {
+			dc_contact_t* contact = dc_contact_new(context);
+			dc_contact_set_from_stmt(contact, stmt);
+			dc_hash_insert(&contacts, NULL, contact->id, contact);
+		}
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+	}
+
+	/* create the summaries */
+	for (i = index; i < end; i++) {
+		if (chatlist->summaries[i]==NULL) {
+			dc_chat_t* chat = dc_hash_find(&chats, NULL, dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT));
+			if (chat) { /* if the chat cannot be loaded, dc_chatlist_get_summary() returns an error for the index */
+				uint32_t      msg_id = dc_array_get_id(chatlist->chatNlastmsg_ids, i*DC_CHATLIST_IDS_PER_RESULT+1);
+				dc_msg_t*     lastmsg = msg_id? dc_hash_find(&msgs, NULL, msg_id) : NULL;
+				dc_contact_t* lastcontact = lastmsg? dc_hash_find(&contacts, NULL, lastmsg->from_id) : NULL;
+				chatlist->summaries[i] = create_summary(context, chat, lastmsg, DC_CHAT_TYPE_IS_MULTI(chat->type)? lastcontact : NULL);
+			}
+		}
+	}
+
+cleanup:
+	for (e = dc_hash_first(&chats); e; e = dc_hash_next(e)) { if (dc_hash_data(e)!=chat_at_index) { dc_chat_unref((dc_chat_t*)dc_hash_data(e)); } }
+	for (e = dc_hash_first(&msgs); e; e = dc_hash_next(e)) { dc_msg_unref((dc_msg_t*)dc_hash_data(e)); }
+	for (e = dc_hash_first(&contacts); e; e = dc_hash_next(e)) { dc_contact_unref((dc_contact_t*)dc_hash_data(e)); }
+	dc_hash_clear(&chats);
+	dc_hash_clear(&msgs);
+	dc_hash_clear(&contacts);
+	dc_array_unref(chat_ids);
+	dc_array_unref(msg_ids);
+	dc_array_unref(contact_ids);
+	sqlite3_finalize(stmt);
+	sqlite3_free(q3);
+	free(ids_str);
+}
+
+
+/**
+ * Load the summaries for a range of chatlist indices.
+ *
+ * The chats, the last messages and their senders are loaded for all
+ * indices in the range at once, which is much faster than loading the
+ * summaries one by one. Afterwards, dc_chatlist_get_summary() returns
+ * the summaries for the range without accessing the database.
+ *
+ * dc_chatlist_get_summary() calls this function as needed,
+ * so calling it is only useful if the UI knows the rows to show in advance,
+ * eg. on scrolling.
+ *
+ * The summaries are not updated when the chats change;
+ * as for the chatlist itself, get a new chatlist on #DC_EVENT_MSGS_CHANGED.
+ *
+ * @memberof dc_chatlist_t
+ * @param chatlist The chatlist object as created eg. by dc_get_chatlist().
+ * @param index The first index to load the summary for.
+ * @param cnt The number of summaries to load, the range is truncated at the end of the chatlist.
+ * @return None.
+ */
+void dc_chatlist_load_summaries(dc_chatlist_t* chatlist, size_t index, size_t cnt)
+{
+	load_summaries(chatlist, index, cnt, NULL);
+}
+
+
 /**
  * Get a summary for a chatlist index.
  *
@@ -155,78 +384,33 @@ uint32_t dc_chatlist_get_msg_id(const dc_chatlist_t* chatlist, size_t index)
  */
 dc_lot_t* dc_chatlist_get_summary(const dc_chatlist_t* chatlist, size_t index, dc_chat_t* chat /*may be NULL*/)
 {
-	/* The summary is created by the chat, not by the last message.
-	This is because we may want to display drafts here or stuff as
-	"is typing".
-	Also, sth. as "No messages" would not work if the summary comes from a
-	message. */
-
-	dc_lot_t*      ret = dc_lot_new(); /* the function never returns NULL */
-	uint32_t       lastmsg_id = 0;
-	dc_msg_t*      lastmsg = NULL;
-	dc_contact_t*  lastcontact = NULL;
-	dc_chat_t*     chat_to_delete = NULL;
+	dc_lot_t* ret = dc_lot_new(); /* the function never returns NULL */
+	dc_lot_t* cached = NULL;
 
 	if (chatlist==NULL || chatlist->magic!=DC_CHATLIST_MAGIC || index>=chatlist->cnt) {
 		ret->text2 = dc_strdup("ErrBadChatlistIndex");
 		goto cleanup;
 	}
 
-	lastmsg_id = dc_array_get_id(chatlist->chatNlastmsg_ids, index*DC_CHATLIST_IDS_PER_RESULT+1);
-
-	if (chat==NULL) {
-		chat = dc_chat_new(chatlist->context);
-		chat_to_delete = chat;
-		if (!dc_chat_load_from_db(chat, dc_array_get_id(chatlist->chatNlastmsg_ids, index*DC_CHATLIST_IDS_PER_RESULT))) {
-			ret->text2 = dc_strdup("ErrCannotReadChat");
-			goto cleanup;
-		}
+	/* summaries are typically requested for the rows in view, one after another,
+	so we load the following ones together with the requested one.
+	the cache does not change what the chatlist object represents, so we allow this for const objects. */
+	if (chatlist->summaries==NULL || chatlist->summaries[index]==NULL) {
+		load_summaries((dc_chatlist_t*)chatlist, index, DC_SUMMARY_PREFETCH_CNT, chat);
 	}
 
-	if (lastmsg_id)
-	{
-		lastmsg = dc_msg_new_untyped(chatlist->context);
-		dc_msg_load_from_db(lastmsg, chatlist->context, lastmsg_id);
-
-		if (lastmsg->from_id!=DC_CONTACT_ID_SELF  &&  DC_CHAT_TYPE_IS_MULTI(chat->type))
-		{
-			lastcontact = dc_contact_new(chatlist->context);
-			dc_contact_load_from_db(lastcontact, chatlist->context->sql, lastmsg->from_id);
-		}
+	if (chatlist->summaries==NULL || (cached=chatlist->summaries[index])==NULL) {
+		ret->text2 = dc_strdup("ErrCannotReadChat");
+		goto cleanup;
 	}
 
-	if (chat->id==DC_CHAT_ID_ARCHIVED_LINK)
-	{
-		ret->text2 = dc_strdup(NULL);
-	}
-	else if (chat->draft_timestamp
-	      && chat->draft_text
-	      && (lastmsg==NULL || chat->draft_timestamp>lastmsg->timestamp))
-	{
-		/* show the draft as the last message */
-		ret->text1 = dc_stock_str(chatlist->context, DC_STR_DRAFT);
-		ret->text1_meaning = DC_TEXT1_DRAFT;
-
-		ret->text2 = dc_strdup(chat->draft_text);
-		dc_truncate_n_unwrap_str(ret->text2, DC_SUMMARY_CHARACTERS, 1/*unwrap*/);
-
-		ret->timestamp = chat->draft_timestamp;
-	}
-	else if (lastmsg==NULL || lastmsg->from_id==0)
-	{
-		/* no messages */
-		ret->text2 = dc_stock_str(chatlist->context, DC_STR_NOMESSAGES);
-	}
-	else
-	{
-		/* show the last message */
-		dc_lot_fill(ret, lastmsg, chat, lastcontact, chatlist->context);
-	}
+	ret->text1_meaning = cached->text1_meaning;
+	ret->text1         = dc_strdup_keep_null(cached->text1);
+	ret->text2         = dc_strdup_keep_null(cached->text2);
+	ret->timestamp     = cached->timestamp;
+	ret->state         = cached->state;
 
 cleanup:
-	dc_msg_unref(lastmsg);
-	dc_contact_unref(lastcontact);
-	dc_chat_unref(chat_to_delete);
 	return ret;
 }
 
@@ -294,12 +478,13 @@ static int dc_chatlist_load_from_db(dc_chatlist_t* chatlist, int listflags, cons
 
 	dc_chatlist_empty(chatlist);
 
-	/* select example with left join and minimum: http://stackoverflow.com/questions/7588142/mysql-left-join-min */
-	#define QUR1 "SELECT c.id, m.id FROM chats c " \
-	                " LEFT JOIN msgs m ON (c.id=m.chat_id AND m.hidden=0 AND m.timestamp=(SELECT MAX(timestamp) FROM msgs WHERE chat_id=c.id AND hidden=0)) " /* not: `m.hidden` which would refer the outer select and takes lot of time*/ \
+	/* the last message of each chat is stored in the chats table, see dc_set_chat_last_msg_if_newer(),
+	so the query does not need to touch the msgs table. the ORDER BY cannot use an index and sorts the selected chats;
+	as all chats are read anyway, an expression index on the sort key was not faster for some thousand chats
+	and would cost an additional index update for each incoming message */
+	#define QUR1 "SELECT c.id, c.last_msg_id FROM chats c " \
 	                " WHERE c.id>" DC_STRINGIFY(DC_CHAT_ID_LAST_SPECIAL) " AND c.blocked=0"
-	#define QUR2    " GROUP BY c.id " /* GROUP BY is needed as there may be several messages with the same timestamp */ \
-	                " ORDER BY MAX(c.draft_timestamp, IFNULL(m.timestamp,0)) DESC,m.id DESC;" /* the list starts with the newest chats */
+	#define QUR2    " ORDER BY MAX(c.draft_timestamp, c.last_msg_timestamp) DESC, c.last_msg_id DESC;" /* the list starts with the newest chats */
 
 	// nb: the query currently shows messages from blocked contacts in groups.
 	// however, for normal-groups, this is okay as the message is also returned by dc_get_chat_msgs()
@@ -310,14 +495,14 @@ static int dc_chatlist_load_from_db(dc_chatlist_t* chatlist, int listflags, cons
 	if (query_contact_id)
 	{
 		// show chats shared with a given contact
-		stmt = dc_sqlite3_prepare(chatlist->context->sql,
+		stmt = dc_sqlite3_prepare_read(chatlist->context->sql,
 			QUR1 " AND c.id IN(SELECT chat_id FROM chats_contacts WHERE contact_id=?) " QUR2);
 		sqlite3_bind_int(stmt, 1, query_contact_id);
 	}
 	else if (listflags & DC_GCL_ARCHIVED_ONLY)
 	{
 		/* show archived chats */
-		stmt = dc_sqlite3_prepare(chatlist->context->sql,
+		stmt = dc_sqlite3_prepare_read(chatlist->context->sql,
 			QUR1 " AND c.archived=1 " QUR2);
 	}
 	else if (query__==NULL)
@@ -332,7 +517,7 @@ static int dc_chatlist_load_from_db(dc_chatlist_t* chatlist, int listflags, cons
 			add_archived_link_item = 1;
 		}
 
-		stmt = dc_sqlite3_prepare(chatlist->context->sql,
+		stmt = dc_sqlite3_prepare_read(chatlist->context->sql,
 			QUR1 " AND c.archived=0 " QUR2);
 	}
 	else
@@ -345,7 +530,7 @@ static int dc_chatlist_load_from_db(dc_chatlist_t* chatlist, int listflags, cons
 			goto cleanup;
 		}
 		strLikeCmd = dc_mprintf("%%%s%%", query);
-		stmt = dc_sqlite3_prepare(chatlist->context->sql,
+		stmt = dc_sqlite3_prepare_read(chatlist->context->sql,
 			QUR1 " AND c.name LIKE ? " QUR2);
 		sqlite3_bind_text(stmt, 1, strLikeCmd, -1, SQLITE_STATIC);
 	}
@@ -371,7 +556,7 @@ static int dc_chatlist_load_from_db(dc_chatlist_t* chatlist, int listflags, cons
 
 cleanup:
 	//dc_log_info(chatlist->context, 0, "Chatlist for search \"%s\" created in %.3f ms.", query__?query__:"", (double)(clock()-start)*1000.0/CLOCKS_PER_SEC);
-	sqlite3_finalize(stmt);
+	if (stmt) { dc_sqlite3_finalize_read(chatlist->context->sql, stmt); }
 	free(query);
 	free(strLikeCmd);
 	return success;
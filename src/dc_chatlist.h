@@ -14,9 +14,13 @@ struct _dc_chatlist
 	#define         DC_CHATLIST_IDS_PER_RESULT 2
 	size_t          cnt;
 	dc_array_t*     chatNlastmsg_ids;
+	dc_lot_t**      summaries;  /**< cnt summaries loaded by dc_chatlist_load_summaries(), NULL for summaries not yet loaded; NULL if nothing is loaded */
 };
 
 
+#define         DC_SUMMARY_PREFETCH_CNT 20 // number of summaries loaded at once by dc_chatlist_get_summary()
+
+
 // Context functions to work with chatlist
 int             dc_get_archived_cnt        (dc_context_t*);
 
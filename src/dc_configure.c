@@ -417,6 +417,7 @@ void dc_job_do_DC_JOB_CONFIGURE_IMAP(dc_context_t* context, dc_job_t* job)
 
 	dc_imap_disconnect(context->imap);
 	dc_smtp_disconnect(context->smtp);
+	dc_job_close_smtp_pool(context, 0);
 
 	//dc_sqlite3_set_config_int(context->sql, "configured", 0); -- NO: we do _not_ reset this flag if it was set once; otherwise the user won't get back to his chats (as an alternative, we could change the UI).  Moreover, and not changeable in the UI, we use this flag to check if we shall search for backups.
 	context->smtp->log_connect_errors = 1;
@@ -3,6 +3,7 @@
 #include "dc_apeerstate.h"
 #include "dc_loginparam.h"
 #include "dc_pgp.h"
+#include "dc_objcache.h"
 
 
 #define DC_CONTACT_MAGIC 0x0c047ac7
@@ -283,6 +284,48 @@ int dc_contact_is_verified(dc_contact_t* contact)
 }
 
 
+/**
+ * Set up a contact object from a row selected with DC_CONTACT_FIELDS.
+ * Other than dc_contact_load_from_db(), this does not handle DC_CONTACT_ID_SELF.
+ *
+ * @private @memberof dc_contact_t
+ */
+void dc_contact_set_from_stmt(dc_contact_t* contact, sqlite3_stmt* row)
+{
+	dc_contact_empty(contact);
+
+	contact->id               =                  sqlite3_column_int  (row, 0);
+	contact->name             = dc_strdup((char*)sqlite3_column_text (row, 1));
+	contact->addr             = dc_strdup((char*)sqlite3_column_text (row, 2));
+	contact->origin           =                  sqlite3_column_int  (row, 3);
+	contact->blocked          =                  sqlite3_column_int  (row, 4);
+	contact->authname         = dc_strdup((char*)sqlite3_column_text (row, 5));
+}
+
+
+/**
+ * Copy all fields loaded from the database to another contact object.
+ * The context of the destination object is not changed.
+ *
+ * @private @memberof dc_contact_t
+ */
+void dc_contact_copy(dc_contact_t* dest, const dc_contact_t* src)
+{
+	if (dest==NULL || dest->magic!=DC_CONTACT_MAGIC || src==NULL || src->magic!=DC_CONTACT_MAGIC) {
+		return;
+	}
+
+	dc_contact_empty(dest);
+
+	dest->id       = src->id;
+	dest->name     = dc_strdup_keep_null(src->name);
+	dest->addr     = dc_strdup_keep_null(src->addr);
+	dest->origin   = src->origin;
+	dest->blocked  = src->blocked;
+	dest->authname = dc_strdup_keep_null(src->authname);
+}
+
+
 /**
  * Load a contact from the database to the contact object.
  *
@@ -307,8 +350,8 @@ int dc_contact_load_from_db(dc_contact_t* contact, dc_sqlite3_t* sql, uint32_t c
 	}
 	else
 	{
-		stmt = dc_sqlite3_prepare(sql,
-			"SELECT c.name, c.addr, c.origin, c.blocked, c.authname "
+		stmt = dc_sqlite3_prepare_cached(sql,
+			"SELECT " DC_CONTACT_FIELDS
 			" FROM contacts c "
 			" WHERE c.id=?;");
 		sqlite3_bind_int(stmt, 1, contact_id);
@@ -316,18 +359,13 @@ int dc_contact_load_from_db(dc_contact_t* contact, dc_sqlite3_t* sql, uint32_t c
 			goto cleanup;
 		}
 
-		contact->id               = contact_id;
-		contact->name             = dc_strdup((char*)sqlite3_column_text (stmt, 0));
-		contact->addr             = dc_strdup((char*)sqlite3_column_text (stmt, 1));
-		contact->origin           =                  sqlite3_column_int  (stmt, 2);
-		contact->blocked          =                  sqlite3_column_int  (stmt, 3);
-		contact->authname         = dc_strdup((char*)sqlite3_column_text (stmt, 4));
+		dc_contact_set_from_stmt(contact, stmt);
 	}
 
 	success = 1;
 
 cleanup:
-	sqlite3_finalize(stmt);
+	dc_sqlite3_finalize_cached(sql, stmt);
 	return success;
 }
 
@@ -654,6 +692,8 @@ uint32_t dc_add_or_lookup_contact( dc_context_t* context,
 			sqlite3_finalize (stmt);
 			stmt = NULL;
 
+			dc_objcache_remove(context->contact_cache, row_id);
+
 			if (update_name)
 			{
 				/* Update the contact name also if it is used as a group name.
@@ -664,6 +704,8 @@ uint32_t dc_add_or_lookup_contact( dc_context_t* context,
 				sqlite3_bind_int (stmt, 2, DC_CHAT_TYPE_SINGLE);
 				sqlite3_bind_int (stmt, 3, row_id);
 				sqlite3_step     (stmt);
+
+				dc_objcache_clear(context->chat_cache);
 			}
 
 			*sth_modified = CONTACT_MODIFIED;
@@ -713,6 +755,8 @@ void dc_scaleup_contact_origin(dc_context_t* context, uint32_t contact_id, int o
 	sqlite3_bind_int(stmt, 3, origin);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+
+	dc_objcache_remove(context->contact_cache, contact_id);
 }
 
 
@@ -816,6 +860,7 @@ cleanup:
  *
  * To add a single contact entered by the user, you should prefer dc_create_contact(),
  * however, for adding a bunch of addresses, this function is _much_ faster.
+ * To get the outcome for each address, use dc_import_address_book().
  *
  * @memberof dc_context_t
  * @param context the context object as created by dc_context_new().
@@ -827,11 +872,68 @@ cleanup:
  */
 int dc_add_address_book(dc_context_t* context, const char* adr_book)
 {
-	carray* lines = NULL;
-	size_t  i = 0;
-	size_t  iCnt = 0;
-	int     sth_modified = 0;
-	int     modify_cnt = 0;
+	dc_array_t* outcomes = NULL;
+	size_t      i = 0;
+	int         modify_cnt = 0;
+
+	if ((outcomes=dc_import_address_book(context, adr_book))==NULL) {
+		goto cleanup;
+	}
+
+	for (i = 0; i < dc_array_get_cnt(outcomes); i++) {
+		int outcome = dc_array_get_id(outcomes, i);
+		if (outcome==DC_IMPORT_MODIFIED || outcome==DC_IMPORT_CREATED) {
+			modify_cnt++;
+		}
+	}
+
+cleanup:
+	dc_array_unref(outcomes);
+	return modify_cnt;
+}
+
+
+/**
+ * Add a number of contacts and get the outcome for each of them.
+ *
+ * Works as dc_add_address_book(), however, the addresses are checked and normalized
+ * in a single pass and the contacts are then added or updated by a few statements
+ * for all addresses at once, so this is also fast for address books with many thousand entries.
+ *
+ * If an address is given several times, the last address and the last non-empty name are used;
+ * all these entries get the same outcome.
+ *
+ * The event #DC_EVENT_CONTACTS_CHANGED is sent once if any contact was added or modified.
+ *
+ * @memberof dc_context_t
+ * @param context the context object as created by dc_context_new().
+ * @param adr_book A multi-line string in the format
+ *     `Name one\nAddress one\nName two\nAddress two`, see dc_add_address_book().
+ * @return Array with one outcome for each name/address pair, in the same order;
+ *     each outcome is one of DC_IMPORT_INVALID (bad address, nothing imported),
+ *     DC_IMPORT_UNCHANGED, DC_IMPORT_MODIFIED or DC_IMPORT_CREATED.
+ *     Use dc_lookup_contact_id_by_addr() to get the contact IDs.
+ *     Returns NULL on errors, otherwise the returned array must be freed using dc_array_unref().
+ */
+dc_array_t* dc_import_address_book(dc_context_t* context, const char* adr_book)
+{
+	carray*       lines = NULL;
+	size_t        i = 0;
+	size_t        iCnt = 0;
+	char*         addr = NULL;
+	dc_hash_t     rows_by_addr;
+	dc_array_t*   pair_rows = NULL;  /* for each name/address pair, the row in import_contacts or 0 for invalid addresses */
+	dc_array_t*   row_outcomes = NULL;
+	dc_array_t*   outcomes = NULL;
+	uint32_t      row_cnt = 0;
+	int           invalid_cnt = 0;
+	int           modified_cnt = 0;
+	sqlite3_stmt* stmt = NULL;
+	sqlite3_stmt* insert_stmt = NULL; /* prepared once for all rows */
+	sqlite3_stmt* update_stmt = NULL;
+	int           in_transaction = 0;
+
+	dc_hash_init(&rows_by_addr, DC_HASH_STRING, 1/*copy key*/); /* the string-hash is case-insensitive as the addr-column */
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || adr_book==NULL) {
 		goto cleanup;
@@ -841,29 +943,156 @@ int dc_add_address_book(dc_context_t* context, const char* adr_book)
 		goto cleanup;
 	}
 
+	pair_rows = dc_array_new(context, 128);
+	row_outcomes = dc_array_new(context, 128);
+
 	dc_sqlite3_begin_transaction(context->sql);
+	in_transaction = 1;
 
-		iCnt = carray_count(lines);
-		for (i = 0; i+1 < iCnt; i += 2) {
-			char* name = (char*)carray_get(lines, i);
-			char* addr = (char*)carray_get(lines, i+1);
-			dc_normalize_name(name);
-			dc_add_or_lookup_contact(context, name, addr, DC_ORIGIN_ADRESS_BOOK, &sth_modified);
-			if (sth_modified) {
-				modify_cnt++;
-			}
+	/* normalize all names and addresses in one pass and load them into a temporary table;
+	an address given several times uses a single row */
+	dc_sqlite3_execute(context->sql, "DROP TABLE IF EXISTS temp.import_contacts;");
+	if (!dc_sqlite3_execute(context->sql, "CREATE TEMP TABLE import_contacts (id INTEGER PRIMARY KEY, name TEXT, addr TEXT,"
+	                                      " contact_id INTEGER DEFAULT 0, update_name INTEGER DEFAULT 0, outcome INTEGER DEFAULT 0);")) {
+		goto cleanup;
+	}
+
+	insert_stmt = dc_sqlite3_prepare(context->sql, "INSERT INTO temp.import_contacts (id, name, addr) VALUES (?, ?, ?);");
+	update_stmt = dc_sqlite3_prepare(context->sql, "UPDATE temp.import_contacts SET name=CASE WHEN ?2!='' THEN ?2 ELSE name END, addr=?3 WHERE id=?1;");
+
+	iCnt = carray_count(lines);
+	for (i = 0; i+1 < iCnt; i += 2)
+	{
+		char* name = (char*)carray_get(lines, i);
+		dc_normalize_name(name);
+
+		free(addr);
+		addr = dc_addr_normalize((char*)carray_get(lines, i+1));
+		if (!dc_may_be_valid_addr(addr)) {
+			dc_array_add_id(pair_rows, 0);
+			invalid_cnt++;
+			continue;
+		}
+
+		sqlite3_stmt* row_stmt = update_stmt;
+		uint32_t      row = (uint32_t)(uintptr_t)dc_hash_find_str(&rows_by_addr, addr);
+		if (row==0) {
+			row = ++row_cnt;
+			dc_hash_insert(&rows_by_addr, addr, strlen(addr), (void*)(uintptr_t)row);
+			row_stmt = insert_stmt;
+		}
+		sqlite3_reset(row_stmt);
+		sqlite3_bind_int (row_stmt, 1, row);
+		sqlite3_bind_text(row_stmt, 2, name? name : "", -1, SQLITE_STATIC);
+		sqlite3_bind_text(row_stmt, 3, addr, -1, SQLITE_STATIC);
+		sqlite3_step(row_stmt);
+
+		dc_array_add_id(pair_rows, row);
+	}
+
+	sqlite3_finalize(insert_stmt);
+	insert_stmt = NULL;
+	sqlite3_finalize(update_stmt);
+	update_stmt = NULL;
+
+	if (invalid_cnt) {
+		dc_log_warning(context, 0, "%i bad addresses in address book.", invalid_cnt);
+	}
+
+	/* find the existing contacts and check what has to be updated, the rules are the same as in dc_add_or_lookup_contact() */
+	dc_sqlite3_execute(context->sql,
+		"UPDATE temp.import_contacts SET contact_id=IFNULL((SELECT c.id FROM contacts c WHERE c.addr=import_contacts.addr), 0);");
+
+	stmt = dc_sqlite3_prepare(context->sql,
+		"UPDATE temp.import_contacts SET"
+		" update_name=(SELECT import_contacts.name!='' AND (c.name='' OR (?1>=c.origin AND c.name!=import_contacts.name))"
+		"  FROM contacts c WHERE c.id=import_contacts.contact_id),"
+		" outcome=(SELECT CASE WHEN (import_contacts.name!='' AND (c.name='' OR (?1>=c.origin AND c.name!=import_contacts.name)))"
+		"                        OR (?1>=c.origin AND c.addr!=import_contacts.addr COLLATE BINARY)" /* really compare case-sensitive here */
+		"                        OR ?1>c.origin"
+		"   THEN " DC_STRINGIFY(DC_IMPORT_MODIFIED) " ELSE " DC_STRINGIFY(DC_IMPORT_UNCHANGED) " END"
+		"  FROM contacts c WHERE c.id=import_contacts.contact_id)"
+		" WHERE contact_id!=0;");
+	sqlite3_bind_int(stmt, 1, DC_ORIGIN_ADRESS_BOOK);
+	sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+
+	stmt = dc_sqlite3_prepare(context->sql,
+		"UPDATE contacts SET"
+		" name=IFNULL((SELECT i.name FROM temp.import_contacts i WHERE i.contact_id=contacts.id AND i.update_name), name),"
+		" addr=CASE WHEN origin<=?1 THEN (SELECT i.addr FROM temp.import_contacts i WHERE i.contact_id=contacts.id) ELSE addr END,"
+		" origin=MAX(origin, ?1)"
+		" WHERE id IN(SELECT contact_id FROM temp.import_contacts WHERE outcome=" DC_STRINGIFY(DC_IMPORT_MODIFIED) ");");
+	sqlite3_bind_int(stmt, 1, DC_ORIGIN_ADRESS_BOOK);
+	sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+
+	/* update the contact names also if they are used as chat names, see dc_add_or_lookup_contact() */
+	dc_sqlite3_execute(context->sql,
+		"UPDATE chats SET name=(SELECT i.name FROM temp.import_contacts i INNER JOIN chats_contacts cc ON cc.contact_id=i.contact_id WHERE cc.chat_id=chats.id AND i.update_name)"
+		" WHERE type=" DC_STRINGIFY(DC_CHAT_TYPE_SINGLE)
+		"   AND id IN(SELECT cc.chat_id FROM chats_contacts cc INNER JOIN temp.import_contacts i ON i.contact_id=cc.contact_id WHERE i.update_name);");
+
+	/* add the new contacts */
+	stmt = dc_sqlite3_prepare(context->sql,
+		"INSERT INTO contacts (name, addr, origin) SELECT name, addr, ? FROM temp.import_contacts WHERE contact_id=0 ORDER BY id;");
+	sqlite3_bind_int(stmt, 1, DC_ORIGIN_ADRESS_BOOK);
+	if (sqlite3_step(stmt)!=SQLITE_DONE) {
+		dc_log_error(context, 0, "Cannot add contacts."); /* should not happen */
+		goto cleanup;
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	dc_sqlite3_execute(context->sql,
+		"UPDATE temp.import_contacts SET outcome=" DC_STRINGIFY(DC_IMPORT_CREATED) " WHERE contact_id=0;");
+
+	/* collect the outcomes, the rows are numbered from 1 */
+	dc_array_add_id(row_outcomes, DC_IMPORT_INVALID);
+	stmt = dc_sqlite3_prepare(context->sql, "SELECT outcome FROM temp.import_contacts ORDER BY id;");
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		int outcome = sqlite3_column_int(stmt, 0);
+		dc_array_add_id(row_outcomes, outcome);
+		if (outcome==DC_IMPORT_MODIFIED || outcome==DC_IMPORT_CREATED) {
+			modified_cnt++;
 		}
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	if (dc_array_get_cnt(row_outcomes)!=row_cnt+1) {
+		goto cleanup;
+	}
+
+	dc_sqlite3_execute(context->sql, "DROP TABLE temp.import_contacts;");
 
 	dc_sqlite3_commit(context->sql);
+	in_transaction = 0;
+
+	outcomes = dc_array_new(context, dc_array_get_cnt(pair_rows));
+	for (i = 0; i < dc_array_get_cnt(pair_rows); i++) {
+		dc_array_add_id(outcomes, dc_array_get_id(row_outcomes, dc_array_get_id(pair_rows, i)));
+	}
 
-	if (modify_cnt) {
+	if (modified_cnt) {
+		dc_objcache_clear(context->contact_cache);
+		dc_objcache_clear(context->chat_cache);
 		context->cb(context, DC_EVENT_CONTACTS_CHANGED, 0, 0);
 	}
 
 cleanup:
+	sqlite3_finalize(stmt);
+	sqlite3_finalize(insert_stmt);
+	sqlite3_finalize(update_stmt);
+	if (in_transaction) {
+		dc_sqlite3_rollback(context->sql);
+	}
+	dc_hash_clear(&rows_by_addr);
 	dc_free_splitted_lines(lines);
-
-	return modify_cnt;
+	dc_array_unref(pair_rows);
+	dc_array_unref(row_outcomes);
+	free(addr);
+	return outcomes;
 }
 
 
@@ -1088,12 +1317,34 @@ cleanup:
 dc_contact_t* dc_get_contact(dc_context_t* context, uint32_t contact_id)
 {
 	dc_contact_t* ret = dc_contact_new(context);
+	dc_contact_t* snapshot = NULL;
+	uint32_t      generation = 0;
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
+		dc_contact_unref(ret);
+		ret = NULL;
+		goto cleanup;
+	}
+
+	/* DC_CONTACT_ID_SELF is created from the configuration, the special contacts are not cached */
+	if (contact_id>DC_CONTACT_ID_LAST_SPECIAL
+	 && dc_objcache_get(context->contact_cache, contact_id, ret, &generation)) {
+		goto cleanup;
+	}
 
 	if (!dc_contact_load_from_db(ret, context->sql, contact_id)) {
 		dc_contact_unref(ret);
 		ret = NULL;
+		goto cleanup;
 	}
 
+	if (contact_id>DC_CONTACT_ID_LAST_SPECIAL) {
+		snapshot = dc_contact_new(context);
+		dc_contact_copy(snapshot, ret);
+		dc_objcache_put(context->contact_cache, contact_id, snapshot, generation);
+	}
+
+cleanup:
 	return ret; /* may be NULL */
 }
 
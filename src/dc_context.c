@@ -10,9 +10,13 @@
 #include "dc_mimefactory.h"
 #include "dc_tools.h"
 #include "dc_job.h"
+#include "dc_jobqueue.h"
 #include "dc_key.h"
 #include "dc_pgp.h"
 #include "dc_apeerstate.h"
+#include "dc_objcache.h"
+#include "dc_rcvpipe.h"
+#include "dc_midfilter.h"
 
 
 static const char* config_keys[] = {
@@ -32,6 +36,13 @@ static const char* config_keys[] = {
 	"e2ee_enabled",
 	"mdns_enabled",
 	"save_mime_headers",
+	"imap_fetch_batch_msgs",
+	"imap_fetch_batch_bytes",
+	"job_retry_network",
+	"job_retry_auth",
+	"job_retry_quota",
+	"smtp_pool_size",
+	"wal_mode",
 	"configured_addr",
 	"configured_mail_pw",
 	"configured",
@@ -60,7 +71,40 @@ static uintptr_t cb_dummy(dc_context_t* context, int event, uintptr_t data1, uin
 
 
 /**
- * The following three callback are given to dc_imap_new() to read/write configuration
+ * All events are passed to this callback first, so that the object caches
+ * can be invalidated before the UI reloads the objects.
+ *
+ * Events about changed objects sent inside a transaction
+ * are sent when the transaction is committed, see dc_sqlite3_commit().
+ *
+ * @private @memberof dc_context_t
+ */
+static uintptr_t cb_invalidate_caches(dc_context_t* context, int event, uintptr_t data1, uintptr_t data2)
+{
+	if (event==DC_EVENT_MSGS_CHANGED || event==DC_EVENT_INCOMING_MSG
+	 || event==DC_EVENT_MSG_DELIVERED || event==DC_EVENT_MSG_FAILED || event==DC_EVENT_MSG_READ
+	 || event==DC_EVENT_CHAT_MODIFIED || event==DC_EVENT_CONTACTS_CHANGED) {
+		if (dc_sqlite3_in_transaction(context->sql)) {
+			dc_sqlite3_defer_event(context->sql, event, data1, data2);
+			return 0;
+		}
+	}
+
+	dc_objcache_handle_event(context, event, data1, data2);
+	return context->user_cb(context, event, data1, data2);
+}
+
+
+static void copy_msg(void* dest, const void* src)         { dc_msg_copy((dc_msg_t*)dest, (const dc_msg_t*)src); }
+static void free_msg(void* obj)                           { dc_msg_unref((dc_msg_t*)obj); }
+static void copy_chat(void* dest, const void* src)        { dc_chat_copy((dc_chat_t*)dest, (const dc_chat_t*)src); }
+static void free_chat(void* obj)                          { dc_chat_unref((dc_chat_t*)obj); }
+static void copy_contact(void* dest, const void* src)     { dc_contact_copy((dc_contact_t*)dest, (const dc_contact_t*)src); }
+static void free_contact(void* obj)                       { dc_contact_unref((dc_contact_t*)obj); }
+
+
+/**
+ * The following callbacks are given to dc_imap_new() to read/write configuration
  * and to handle received messages. As the imap-functions are typically used in
  * a separate user-thread, also these functions may be called from a different thread.
  *
@@ -83,7 +127,17 @@ static void cb_set_config(dc_imap_t* imap, const char* key, const char* value)
 static void cb_receive_imf(dc_imap_t* imap, const char* imf_raw_not_terminated, size_t imf_raw_bytes, const char* server_folder, uint32_t server_uid, uint32_t flags)
 {
 	dc_context_t* context = (dc_context_t*)imap->userData;
-	dc_receive_imf(context, imf_raw_not_terminated, imf_raw_bytes, server_folder, server_uid, flags);
+	dc_rcvpipe_add(context->rcvpipe, imf_raw_not_terminated, imf_raw_bytes, server_folder, server_uid, flags);
+}
+
+
+static void cb_receive_flush(dc_imap_t* imap)
+{
+	/* each message is received in a transaction of its own, see dc_receive_imf();
+	a transaction spanning the batch would contain the statements of other threads
+	and a rollback would discard them */
+	dc_context_t* context = (dc_context_t*)imap->userData;
+	dc_rcvpipe_flush(context->rcvpipe); // the raw messages are no longer valid after the batch
 }
 
 
@@ -121,13 +175,16 @@ dc_context_t* dc_context_new(dc_callback_t cb, void* userdata, const char* os_na
 
 	pthread_mutex_init(&context->smear_critical, NULL);
 	pthread_mutex_init(&context->bobs_qr_critical, NULL);
+	pthread_mutex_init(&context->self_keys_critical, NULL);
+	pthread_mutex_init(&context->shared_signed_critical, NULL);
 	pthread_mutex_init(&context->imapidle_condmutex, NULL);
 	pthread_mutex_init(&context->smtpidle_condmutex, NULL);
 	pthread_cond_init(&context->smtpidle_cond, NULL);
 
 	context->magic    = DC_CONTEXT_MAGIC;
 	context->userdata = userdata;
-	context->cb       = cb? cb : cb_dummy;
+	context->user_cb  = cb? cb : cb_dummy;
+	context->cb       = cb_invalidate_caches;
 	context->os_name  = dc_strdup_keep_null(os_name);
 	context->shall_stop_ongoing = 1; /* the value 1 avoids dc_stop_ongoing_process() from stopping already stopped threads */
 
@@ -135,7 +192,13 @@ dc_context_t* dc_context_new(dc_callback_t cb, void* userdata, const char* os_na
 
 	dc_pgp_init();
 	context->sql      = dc_sqlite3_new(context);
-	context->imap     = dc_imap_new(cb_get_config, cb_set_config, cb_receive_imf, (void*)context, context);
+	context->jobqueue = dc_jobqueue_new(context);
+	context->msg_cache     = dc_objcache_new(DC_MSG_CACHE_SIZE, copy_msg, free_msg);
+	context->chat_cache    = dc_objcache_new(DC_CHAT_CACHE_SIZE, copy_chat, free_chat);
+	context->contact_cache = dc_objcache_new(DC_CONTACT_CACHE_SIZE, copy_contact, free_contact);
+	context->rcvpipe  = dc_rcvpipe_new(context);
+	context->mid_filter = dc_midfilter_new();
+	context->imap     = dc_imap_new(cb_get_config, cb_set_config, cb_receive_imf, cb_receive_flush, (void*)context, context);
 	context->smtp     = dc_smtp_new(context);
 
 	/* Random-seed.  An additional seed with more random data is done just before key generation
@@ -172,6 +235,8 @@ void dc_context_unref(dc_context_t* context)
 		return;
 	}
 
+	dc_key_forget_self_keys(context);
+	dc_e2ee_forget_shared(context);
 	dc_pgp_exit();
 
 	if (dc_is_open(context)) {
@@ -179,13 +244,22 @@ void dc_context_unref(dc_context_t* context)
 	}
 
 	dc_imap_unref(context->imap);
+	dc_job_close_smtp_pool(context, 1);
 	dc_smtp_unref(context->smtp);
+	dc_rcvpipe_unref(context->rcvpipe);
 	dc_sqlite3_unref(context->sql);
+	dc_jobqueue_unref(context->jobqueue);
+	dc_objcache_unref(context->msg_cache);
+	dc_objcache_unref(context->chat_cache);
+	dc_objcache_unref(context->contact_cache);
+	dc_midfilter_unref(context->mid_filter);
 
 	dc_openssl_exit();
 
 	pthread_mutex_destroy(&context->smear_critical);
 	pthread_mutex_destroy(&context->bobs_qr_critical);
+	pthread_mutex_destroy(&context->self_keys_critical);
+	pthread_mutex_destroy(&context->shared_signed_critical);
 	pthread_mutex_destroy(&context->imapidle_condmutex);
 	pthread_cond_destroy(&context->smtpidle_cond);
 	pthread_mutex_destroy(&context->smtpidle_condmutex);
@@ -288,6 +362,7 @@ void dc_close(dc_context_t* context)
 
 	dc_imap_disconnect(context->imap);
 	dc_smtp_disconnect(context->smtp);
+	dc_job_close_smtp_pool(context, 0);
 
 	if (dc_sqlite3_is_open(context->sql)) {
 		dc_sqlite3_close(context->sql);
@@ -425,6 +500,20 @@ static char* get_sys_config_str(const char* key)
  *                    1=send and request read receipts (default)
  * - `save_mime_headers` = 1=save mime headers and make dc_get_mime_headers() work for subsequent calls,
  *                    0=do not save mime headers (default)
+ * - `imap_fetch_batch_msgs` = max. number of messages downloaded by a single IMAP-FETCH command,
+ *                    defaults to 50, set to 1 to download the messages one by one
+ * - `imap_fetch_batch_bytes` = max. number of bytes downloaded by a single IMAP-FETCH command,
+ *                    a message larger than this is downloaded on its own, defaults to 4 MB
+ * - `job_retry_network`, `job_retry_auth`, `job_retry_quota` = retry policy for jobs failed
+ *                    because of network-, login- or temporary server-problems (eg. an overloaded server),
+ *                    given as `<first delay in seconds>,<max. delay in seconds>,<max. tries>`, eg. `5,600,3`;
+ *                    the delay is doubled on each retry and randomized by up to 50%.
+ *                    If unset, defaults depending on the job are used.
+ * - `smtp_pool_size` = number of SMTP connections used to send messages of different chats in parallel,
+ *                    messages of the same chat are always sent in order; defaults to 1, max. 8.
+ * - `wal_mode` = 1=use SQLite's write-ahead log; reading functions as dc_get_chatlist() or dc_get_chat_msgs()
+ *                    are then not blocked by messages being received. 0=use a rollback journal (default).
+ *                    Takes effect the next time the database is opened.
  *
  * If you want to retrieve a value, use dc_get_config().
  *
@@ -554,6 +643,11 @@ char* dc_get_info(dc_context_t* context)
 	char*            l_readable_str = NULL;
 	char*            l2_readable_str = NULL;
 	char*            fingerprint_str = NULL;
+	char*            msg_cache_str = NULL;
+	char*            chat_cache_str = NULL;
+	char*            contact_cache_str = NULL;
+	char*            key_cache_str = NULL;
+	char*            mid_filter_str = NULL;
 	dc_loginparam_t* l = NULL;
 	dc_loginparam_t* l2 = NULL;
 	int              contacts = 0;
@@ -614,6 +708,12 @@ char* dc_get_info(dc_context_t* context)
 	l_readable_str = dc_loginparam_get_readable(l);
 	l2_readable_str = dc_loginparam_get_readable(l2);
 
+	msg_cache_str     = dc_objcache_get_info(context->msg_cache);
+	chat_cache_str    = dc_objcache_get_info(context->chat_cache);
+	contact_cache_str = dc_objcache_get_info(context->contact_cache);
+	key_cache_str     = dc_pgp_get_key_cache_info();
+	mid_filter_str    = dc_midfilter_get_info(context->mid_filter);
+
 	temp = dc_mprintf(
 		"deltachat_core_version=v%s\n"
 		"sqlite_version=%s\n"
@@ -639,6 +739,11 @@ char* dc_get_info(dc_context_t* context)
 		"private_key_count=%i\n"
 		"public_key_count=%i\n"
 		"fingerprint=%s\n"
+		"msg_cache=%s\n"
+		"chat_cache=%s\n"
+		"contact_cache=%s\n"
+		"pgp_key_cache=%s\n"
+		"message_id_filter=%s\n"
 
 		, DC_VERSION_STR
 		, SQLITE_VERSION
@@ -663,6 +768,11 @@ char* dc_get_info(dc_context_t* context)
 		, prv_key_cnt
 		, pub_key_cnt
 		, fingerprint_str
+		, msg_cache_str
+		, chat_cache_str
+		, contact_cache_str
+		, key_cache_str
+		, mid_filter_str
 		);
 	dc_strbuilder_cat(&ret, temp);
 	free(temp);
@@ -674,6 +784,11 @@ char* dc_get_info(dc_context_t* context)
 	free(l_readable_str);
 	free(l2_readable_str);
 	free(fingerprint_str);
+	free(msg_cache_str);
+	free(chat_cache_str);
+	free(contact_cache_str);
+	free(key_cache_str);
+	free(mid_filter_str);
 	dc_key_unref(self_public);
 	return ret.buf; /* must be freed by the caller */
 }
@@ -835,3 +950,153 @@ cleanup:
 		return NULL;
 	}
 }
+
+
+static void cat_fts_phrase(dc_strbuilder_t* expr, const char* phrase)
+{
+	/* quotes in a phrase are escaped by doubling them */
+	char* escaped = dc_strdup(phrase);
+	dc_str_replace(&escaped, "\"", "\"\"");
+	dc_strbuilder_catf(expr, "%s\"%s\"", expr->buf[0]? " " : "", escaped);
+	free(escaped);
+}
+
+
+static char* get_fts_match_expr(const char* query, int trigram)
+{
+	/* returns NULL if the full-text index cannot be used for the query */
+	dc_strbuilder_t expr;
+	dc_strbuilder_init(&expr, 0);
+
+	if (trigram)
+	{
+		/* the whole query as one phrase, matching any substring as LIKE does;
+		trigrams cannot match less than 3 characters */
+		int chars = 0;
+		for (const char* p = query; *p; p++) {
+			if ((*p & 0xC0)!=0x80) {
+				chars++;
+			}
+		}
+		if (chars < 3) {
+			free(expr.buf);
+			return NULL;
+		}
+		cat_fts_phrase(&expr, query);
+	}
+	else
+	{
+		/* each word as a prefix, all words must match */
+		char* words = dc_strdup(query);
+		char* saveptr = NULL;
+		for (char* word = strtok_r(words, " \t\r\n", &saveptr); word; word = strtok_r(NULL, " \t\r\n", &saveptr)) {
+			cat_fts_phrase(&expr, word);
+			dc_strbuilder_cat(&expr, "*");
+		}
+		free(words);
+	}
+
+	return expr.buf;
+}
+
+
+/**
+ * Search messages containing the given query string,
+ * the best matches first.
+ *
+ * Other than dc_search_msgs(), the function uses a full-text index
+ * and returns only a page of the results;
+ * to get the next page, call the function again with the offset increased by the limit.
+ * The function matches the message texts only, not the names of the senders.
+ *
+ * If SQLite is compiled without support for full-text indices
+ * or the index is not yet filled for older messages,
+ * the function falls back to a slower search and the newest matches are returned first.
+ *
+ * @memberof dc_context_t
+ * @param context The context object as returned from dc_context_new().
+ * @param chat_id ID of the chat to search messages in.
+ *     Set this to 0 for a global search.
+ * @param query The query to search for.
+ * @param offset Number of results to skip, 0 for the first page.
+ * @param limit Max. number of results to return.
+ * @return An array of message IDs. Must be freed using dc_array_unref() when no longer needed.
+ *     If nothing can be found, the function returns NULL.
+ */
+dc_array_t* dc_search_msgs_ranked(dc_context_t* context, uint32_t chat_id, const char* query, int offset, int limit)
+{
+	int           success = 0;
+	dc_array_t*   ret = dc_array_new(context, 100);
+	char*         real_query = NULL;
+	char*         match_expr = NULL;
+	char*         str_like = NULL;
+	sqlite3_stmt* stmt = NULL;
+	int           show_deaddrop = 0; // as in dc_search_msgs()
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || ret==NULL || query==NULL || offset<0 || limit<=0) {
+		goto cleanup;
+	}
+
+	real_query = dc_strdup(query);
+	dc_trim(real_query);
+	if (real_query[0]==0) {
+		success = 1; /*empty result*/
+		goto cleanup;
+	}
+
+	#define SEARCH_CHAT_COND \
+		" AND m.hidden=0 AND ct.blocked=0" \
+		" AND (m.chat_id=?1 OR (?1=0 AND m.chat_id>" DC_STRINGIFY(DC_CHAT_ID_LAST_SPECIAL) " AND (c.blocked=0 OR c.blocked=?2)))"
+
+	if (context->sql->fts_state==DC_FTS_READY
+	 && (match_expr=get_fts_match_expr(real_query, context->sql->fts_trigram))!=NULL)
+	{
+		stmt = dc_sqlite3_prepare_read(context->sql,
+			"SELECT m.id FROM msgs_fts f"
+			" INNER JOIN msgs m ON m.id=f.rowid"
+			" LEFT JOIN contacts ct ON m.from_id=ct.id"
+			" LEFT JOIN chats c ON m.chat_id=c.id"
+			" WHERE msgs_fts MATCH ?3" SEARCH_CHAT_COND
+			" ORDER BY bm25(msgs_fts), m.timestamp DESC, m.id DESC"
+			" LIMIT ?4 OFFSET ?5;");
+		sqlite3_bind_text(stmt, 3, match_expr, -1, SQLITE_STATIC);
+	}
+	else
+	{
+		str_like = dc_mprintf("%%%s%%", real_query);
+		stmt = dc_sqlite3_prepare_read(context->sql,
+			"SELECT m.id FROM msgs m"
+			" LEFT JOIN contacts ct ON m.from_id=ct.id"
+			" LEFT JOIN chats c ON m.chat_id=c.id"
+			" WHERE m.txt LIKE ?3" SEARCH_CHAT_COND
+			" ORDER BY m.timestamp DESC, m.id DESC"
+			" LIMIT ?4 OFFSET ?5;");
+		sqlite3_bind_text(stmt, 3, str_like, -1, SQLITE_STATIC);
+	}
+	sqlite3_bind_int(stmt, 1, chat_id);
+	sqlite3_bind_int(stmt, 2, show_deaddrop? DC_CHAT_DEADDROP_BLOCKED : 0);
+	sqlite3_bind_int(stmt, 4, limit);
+	sqlite3_bind_int(stmt, 5, offset);
+
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		dc_array_add_id(ret, sqlite3_column_int(stmt, 0));
+	}
+
+	success = 1;
+
+cleanup:
+	if (stmt) { dc_sqlite3_finalize_read(context->sql, stmt); }
+	free(real_query);
+	free(match_expr);
+	free(str_like);
+
+	if (success) {
+		return ret;
+	}
+	else {
+		if (ret) {
+			dc_array_unref(ret);
+		}
+		return NULL;
+	}
+}
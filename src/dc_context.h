@@ -29,8 +29,16 @@ typedef struct dc_imap_t       dc_imap_t;
 typedef struct dc_smtp_t       dc_smtp_t;
 typedef struct dc_sqlite3_t    dc_sqlite3_t;
 typedef struct dc_job_t        dc_job_t;
+typedef struct dc_jobqueue_t   dc_jobqueue_t;
 typedef struct dc_mimeparser_t dc_mimeparser_t;
 typedef struct dc_hash_t       dc_hash_t;
+typedef struct dc_objcache_t   dc_objcache_t;
+typedef struct dc_rcvpipe_t    dc_rcvpipe_t;
+typedef struct dc_midfilter_t  dc_midfilter_t;
+typedef struct dc_key_t        dc_key_t;
+typedef struct dc_keyring_t    dc_keyring_t;
+typedef struct dc_e2ee_prepared_t dc_e2ee_prepared_t;
+typedef struct dc_shared_signed_t dc_shared_signed_t;
 
 
 /** Structure behind dc_context_t */
@@ -46,22 +54,47 @@ struct _dc_context
 	char*            blobdir;               /**< Full path of the blob directory. This is the directory given to dc_context_new() or a directory in the same directory as dc_context_t::dbfile. */
 
 	dc_sqlite3_t*    sql;                   /**< Internal SQL object, never NULL */
+	dc_jobqueue_t*   jobqueue;              /**< Internal queue of pending jobs, never NULL */
 
 	dc_imap_t*       imap;                  /**< Internal IMAP object, never NULL */
 	pthread_mutex_t  imapidle_condmutex;
 	int              perform_imap_jobs_needed;
 
 	dc_smtp_t*       smtp;                  /**< Internal SMTP object, never NULL */
+	#define          DC_SMTP_POOL_MAX         8
+	dc_smtp_t*       smtp_pool[DC_SMTP_POOL_MAX]; /**< Additional SMTP objects used if `smtp_pool_size` is larger than 1, created on demand; [0] is unused, this is `smtp` */
 	pthread_cond_t   smtpidle_cond;
 	pthread_mutex_t  smtpidle_condmutex;
 	int              smtpidle_condflag;
 	int              smtp_suspended;
 	int              smtp_doing_jobs;
 	#define          DC_JOBS_NEEDED_AT_ONCE   1
-	#define          DC_JOBS_NEEDED_AVOID_DOS 2
 	int              perform_smtp_jobs_needed;
 
-	dc_callback_t    cb;                    /**< Internal */
+	dc_callback_t    cb;                    /**< Internal, invalidates the caches and calls user_cb */
+	dc_callback_t    user_cb;               /**< Internal, the callback given to dc_context_new() */
+
+	dc_objcache_t*   msg_cache;             /**< Internal, snapshots of dc_msg_t objects returned by dc_get_msg(), never NULL */
+	dc_objcache_t*   chat_cache;            /**< Internal, snapshots of dc_chat_t objects returned by dc_get_chat(), never NULL */
+	dc_objcache_t*   contact_cache;         /**< Internal, snapshots of dc_contact_t objects returned by dc_get_contact(), never NULL */
+
+	dc_rcvpipe_t*    rcvpipe;               /**< Internal, parses and decrypts the messages fetched by the IMAP thread, never NULL */
+	dc_midfilter_t*  mid_filter;            /**< Internal, Bloom filter of the Message-IDs in the database, never NULL */
+
+	// our own secret keys, needed for every encryption and decryption; see dc_key_forget_self_keys()
+	pthread_mutex_t  self_keys_critical;
+	uint32_t         self_keys_generation;  /**< Internal, incremented whenever the keys are forgotten */
+	char*            self_keys_addr;        /**< Internal, the address the keys below are loaded for, NULL if nothing is cached */
+	dc_key_t*        self_private_key;      /**< Internal, cached result of dc_key_load_self_private(), may be NULL */
+	dc_keyring_t*    self_private_keyring;  /**< Internal, cached result of dc_keyring_load_self_private_for_decrypting(), may be NULL */
+
+	// the signed bodies of the messages sent to several chats using dc_send_msg_to_chats(); see dc_e2ee_encrypt()
+	#define          DC_SHARED_SIGNED_CACHE_SIZE  8                // the jobs of several calls may be interleaved
+	#define          DC_SHARED_SIGNED_CACHE_BYTES (20*1024*1024)   // bodies are evicted before this is exceeded, however, a single larger body is kept
+	pthread_mutex_t  shared_signed_critical;
+	dc_shared_signed_t* shared_signed[DC_SHARED_SIGNED_CACHE_SIZE]; /**< Internal, the least recently used first */
+	int              shared_signed_cnt;
+	size_t           shared_signed_bytes;   /**< Internal, the sum of the cached bodies */
 
 	char*            os_name;               /**< Internal, may be NULL */
 
@@ -92,6 +125,7 @@ void            dc_log_warning       (dc_context_t*, int code, const char* msg,
 void            dc_log_info          (dc_context_t*, int code, const char* msg, ...);
 void            dc_log_event         (dc_context_t* context, int event_code, int code, const char* msg, ...);
 void            dc_receive_imf       (dc_context_t*, const char* imf_raw_not_terminated, size_t imf_raw_bytes, const char* server_folder, uint32_t server_uid, uint32_t flags);
+void            dc_receive_imf_prepared (dc_context_t*, const char* imf_raw_not_terminated, size_t imf_raw_bytes, const char* server_folder, uint32_t server_uid, uint32_t flags, dc_e2ee_prepared_t*);
 
 #define         DC_BAK_PREFIX                "delta-chat"
 #define         DC_BAK_SUFFIX                "bak"
@@ -121,9 +155,25 @@ typedef struct dc_e2ee_helper_t {
 
 } dc_e2ee_helper_t;
 
-void            dc_e2ee_encrypt      (dc_context_t*, const clist* recipients_addr, int force_plaintext, int e2ee_guaranteed, int min_verified, struct mailmime* in_out_message, dc_e2ee_helper_t*);
+void            dc_e2ee_encrypt      (dc_context_t*, const clist* recipients_addr, int force_plaintext, int e2ee_guaranteed, int min_verified, const char* shared_id, struct mailmime* in_out_message, dc_e2ee_helper_t*);
+void            dc_e2ee_forget_shared(dc_context_t*); /* frees the signed bodies cached for the messages sent by dc_send_msg_to_chats() */
+void*           dc_e2ee_get_shared_signed (dc_context_t*, const char* shared_id, const char* protected_headers, const dc_key_t* sign_key, size_t* ret_bytes); /* returns a copy that must be free()'d, NULL if nothing is cached */
+void            dc_e2ee_set_shared_signed (dc_context_t*, const char* shared_id, const char* protected_headers, const dc_key_t* sign_key, const void* signed_packet, size_t signed_bytes);
 void            dc_e2ee_decrypt      (dc_context_t*, struct mailmime* in_out_message, dc_e2ee_helper_t*); /* returns 1 if sth. was decrypted, 0 in other cases */
 void            dc_e2ee_thanks       (dc_e2ee_helper_t*); /* frees data referenced by "mailmime" but not freed by mailmime_free(). After calling this function, in_out_message cannot be used any longer! */
+
+struct dc_e2ee_prepared_t {
+	struct mailmime*       mimeroot;        // the parsed message, decrypted as far as possible
+	int                    decrypt_tried;   // 0 if there were no keys for decryption
+	int                    contains_report; // checked before decryption
+	dc_hash_t*             validate_keys;   // fingerprints of all keys offered for validation
+	dc_e2ee_helper_t       helper;          // encrypted-flag and signatures
+	struct mailimf_fields* gossip_headers;
+};
+
+void            dc_e2ee_prepare_decrypt  (dc_context_t*, const char* imf_raw, size_t imf_raw_bytes, dc_e2ee_prepared_t*); /* does not modify the database, may be called from any thread */
+void            dc_e2ee_decrypt_prepared (dc_context_t*, dc_e2ee_prepared_t*, const char* imf_raw, size_t imf_raw_bytes, struct mailmime** ret_message, dc_e2ee_helper_t*);
+void            dc_e2ee_prepared_empty   (dc_e2ee_prepared_t*);
 int             dc_ensure_secret_key_exists (dc_context_t*); /* makes sure, the private key exists, needed only for exporting keys and the case no message was sent before */
 char*           dc_create_setup_code (dc_context_t*);
 char*           dc_normalize_setup_code(dc_context_t*, const char* passphrase);
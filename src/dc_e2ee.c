@@ -167,12 +167,15 @@ static int contains_report(struct mailmime* mime)
  ******************************************************************************/
 
 
+static pthread_mutex_t s_key_creation_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int             s_in_key_creation = 0; /* avoid double creation (we unlock the database during creation), guarded by s_key_creation_mutex */
+
+
 static int load_or_generate_self_public_key(dc_context_t* context, dc_key_t* public_key, const char* self_addr,
                                               struct mailmime* random_data_mime /*for an extra-seed of the random generator. For speed reasons, only give _available_ pointers here, do not create any data - in very most cases, the key is not generated!*/)
 {
-	static int s_in_key_creation = 0; /* avoid double creation (we unlock the database during creation) */
-	int        key_created = 0;
-	int        success = 0, key_creation_here = 0;
+	int key_created = 0;
+	int success = 0, key_creation_here = 0;
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || public_key==NULL) {
 		goto cleanup;
@@ -181,9 +184,21 @@ static int load_or_generate_self_public_key(dc_context_t* context, dc_key_t* pub
 	if (!dc_key_load_self_public(public_key, self_addr, context->sql))
 	{
 		/* create the keypair - this may take a moment, however, as this is in a thread, this is no big deal */
-		if (s_in_key_creation) { goto cleanup; }
-		key_creation_here = 1;
-		s_in_key_creation = 1;
+		/* the keys may be needed by several threads at the same time, eg. by the SMTP connection pool;
+		only one of them creates the keys, the mutex is not held during creation as this may take a while */
+		pthread_mutex_lock(&s_key_creation_mutex);
+			if (!s_in_key_creation) {
+				s_in_key_creation = 1;
+				key_creation_here = 1;
+			}
+		pthread_mutex_unlock(&s_key_creation_mutex);
+
+		if (!key_creation_here) { goto cleanup; }
+
+		if (dc_key_load_self_public(public_key, self_addr, context->sql)) {
+			success = 1; /* created by another thread in between */
+			goto cleanup;
+		}
 
 		/* seed the random generator */
 		{
@@ -246,7 +261,11 @@ static int load_or_generate_self_public_key(dc_context_t* context, dc_key_t* pub
 	success = 1;
 
 cleanup:
-	if (key_creation_here) { s_in_key_creation = 0; }
+	if (key_creation_here) {
+		pthread_mutex_lock(&s_key_creation_mutex);
+			s_in_key_creation = 0;
+		pthread_mutex_unlock(&s_key_creation_mutex);
+	}
 	return success;
 }
 
@@ -286,10 +305,156 @@ cleanup:
  ******************************************************************************/
 
 
+struct dc_shared_signed_t
+{
+	char*     shared_id;         /**< DC_PARAM_SHARED_ID of the messages the body is shared by */
+	char*     protected_headers; /**< the protected headers the body was signed with */
+	dc_key_t* sign_key;          /**< the key the body was signed with */
+	void*     signed_packet;     /**< the signed packet as returned by dc_pgp_sign() */
+	size_t    signed_bytes;
+};
+
+
+static void shared_signed_unref(dc_shared_signed_t* entry)
+{
+	if (entry==NULL) {
+		return;
+	}
+	free(entry->shared_id);
+	free(entry->protected_headers);
+	dc_key_unref(entry->sign_key);
+	free(entry->signed_packet);
+	free(entry);
+}
+
+
+static int shared_signed_find(dc_context_t* context, const char* shared_id, const char* protected_headers, const dc_key_t* sign_key)
+{
+	/* the caller must hold shared_signed_critical; returns the index or -1 */
+	for (int i = context->shared_signed_cnt-1; i >= 0; i--) {
+		dc_shared_signed_t* entry = context->shared_signed[i];
+		if (strcmp(entry->shared_id, shared_id)==0
+		 && strcmp(entry->protected_headers, protected_headers)==0
+		 && dc_key_equals(entry->sign_key, sign_key)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+static void shared_signed_remove(dc_context_t* context, int i)
+{
+	/* the caller must hold shared_signed_critical */
+	context->shared_signed_bytes -= context->shared_signed[i]->signed_bytes;
+	shared_signed_unref(context->shared_signed[i]);
+	memmove(&context->shared_signed[i], &context->shared_signed[i+1], (context->shared_signed_cnt-i-1)*sizeof(dc_shared_signed_t*));
+	context->shared_signed_cnt--;
+}
+
+
+/**
+ * Free the signed bodies cached for the messages sent by dc_send_msg_to_chats().
+ * The bodies are otherwise kept until newer ones push them out of the cache.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_e2ee_forget_shared(dc_context_t* context)
+{
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
+		return;
+	}
+
+	pthread_mutex_lock(&context->shared_signed_critical);
+		while (context->shared_signed_cnt > 0) {
+			shared_signed_remove(context, 0);
+		}
+	pthread_mutex_unlock(&context->shared_signed_critical);
+}
+
+
+/**
+ * Get a copy of the body signed for a message sent by dc_send_msg_to_chats().
+ * The body is found only if it was signed with the same protected headers and key.
+ *
+ * @private @memberof dc_context_t
+ * @return The signed packet, must be free()'d. NULL if no such body is cached.
+ */
+void* dc_e2ee_get_shared_signed(dc_context_t* context, const char* shared_id, const char* protected_headers, const dc_key_t* sign_key, size_t* ret_bytes)
+{
+	void* ret = NULL;
+	int   i = 0;
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || shared_id==NULL || protected_headers==NULL || sign_key==NULL || ret_bytes==NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&context->shared_signed_critical);
+		if ((i=shared_signed_find(context, shared_id, protected_headers, sign_key)) >= 0) {
+			dc_shared_signed_t* entry = context->shared_signed[i];
+			if ((ret=malloc(entry->signed_bytes))==NULL) {
+				exit(63);
+			}
+			memcpy(ret, entry->signed_packet, entry->signed_bytes);
+			*ret_bytes = entry->signed_bytes;
+
+			/* move to the end, the most recently used */
+			memmove(&context->shared_signed[i], &context->shared_signed[i+1], (context->shared_signed_cnt-i-1)*sizeof(dc_shared_signed_t*));
+			context->shared_signed[context->shared_signed_cnt-1] = entry;
+		}
+	pthread_mutex_unlock(&context->shared_signed_critical);
+
+	return ret;
+}
+
+
+/**
+ * Cache the body signed for a message sent by dc_send_msg_to_chats(),
+ * the following messages with the same ID only encrypt it.
+ * If the cache is full, the least recently used body is dropped.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_e2ee_set_shared_signed(dc_context_t* context, const char* shared_id, const char* protected_headers, const dc_key_t* sign_key, const void* signed_packet, size_t signed_bytes)
+{
+	dc_shared_signed_t* entry = NULL;
+	int                 i = 0;
+
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || shared_id==NULL || protected_headers==NULL || sign_key==NULL || signed_packet==NULL || signed_bytes==0) {
+		return;
+	}
+
+	if ((entry=calloc(1, sizeof(dc_shared_signed_t)))==NULL
+	 || (entry->signed_packet=malloc(signed_bytes))==NULL) {
+		exit(63);
+	}
+	memcpy(entry->signed_packet, signed_packet, signed_bytes);
+	entry->signed_bytes      = signed_bytes;
+	entry->shared_id         = dc_strdup(shared_id);
+	entry->protected_headers = dc_strdup(protected_headers);
+	entry->sign_key          = dc_key_ref((dc_key_t*)sign_key);
+
+	pthread_mutex_lock(&context->shared_signed_critical);
+		if ((i=shared_signed_find(context, shared_id, protected_headers, sign_key)) >= 0) {
+			shared_signed_remove(context, i); /* another thread signed the same body meanwhile */
+		}
+
+		while (context->shared_signed_cnt >= DC_SHARED_SIGNED_CACHE_SIZE
+		   || (context->shared_signed_cnt > 0 && context->shared_signed_bytes+signed_bytes > DC_SHARED_SIGNED_CACHE_BYTES)) {
+			shared_signed_remove(context, 0);
+		}
+
+		context->shared_signed[context->shared_signed_cnt++] = entry;
+		context->shared_signed_bytes += signed_bytes;
+	pthread_mutex_unlock(&context->shared_signed_critical);
+}
+
+
 void dc_e2ee_encrypt(dc_context_t* context, const clist* recipients_addr,
                     int force_unencrypted,
                     int e2ee_guaranteed, /*set if e2ee was possible on sending time; we should not degrade to transport*/
                     int min_verified,
+                    const char* shared_id, /*set for messages sent by dc_send_msg_to_chats(), the signed body may be reused for all messages with this ID*/
                     struct mailmime* in_out_message, dc_e2ee_helper_t* helper)
 {
 	int                     col = 0;
@@ -299,6 +464,9 @@ void dc_e2ee_encrypt(dc_context_t* context, const clist* recipients_addr,
 	dc_keyring_t*           keyring = dc_keyring_new();
 	dc_key_t*               sign_key = dc_key_new();
 	MMAPString*             plain = mmap_string_new("");
+	MMAPString*             protected_headers = NULL;
+	void*                   signed_packet = NULL;
+	size_t                  signed_bytes = 0;
 	char*                   ctext = NULL;
 	size_t                  ctext_bytes = 0;
 	dc_array_t*             peerstates = dc_array_new(NULL, 10);
@@ -430,15 +598,51 @@ void dc_e2ee_encrypt(dc_context_t* context, const clist* recipients_addr,
 
 		clist_append(part_to_encrypt->mm_content_type->ct_parameters, mailmime_param_new_with_data("protected-headers", "v1"));
 
-		/* convert part to encrypt to plain text */
-		mailmime_write_mem(plain, &col, message_to_encrypt);
-		if (plain->str==NULL || plain->len<=0) {
-			goto cleanup;
+		if (shared_id)
+		{
+			/* the messages created by dc_send_msg_to_chats() have the same body. If the protected headers are also the same,
+			which is typically true for one-to-one chats, the body is rendered and signed only for the first message
+			and just encrypted for the others. The Message-ID, Date and recipients are in the unprotected headers. */
+			protected_headers = mmap_string_new("");
+			mailimf_fields_write_mem(protected_headers, &col, imffields_encrypted);
+
+			/* the lock is held only to look up or store the signed body, signing and encrypting are done outside */
+			signed_packet = dc_e2ee_get_shared_signed(context, shared_id, protected_headers->str, sign_key, &signed_bytes);
+			if (signed_packet==NULL)
+			{
+				col = 0;
+				mailmime_write_mem(plain, &col, message_to_encrypt);
+				if (plain->str==NULL || plain->len<=0) {
+					goto cleanup;
+				}
+
+				if (!dc_pgp_sign(context, plain->str, plain->len, sign_key, &signed_packet, &signed_bytes)) {
+					goto cleanup;
+				}
+
+				dc_e2ee_set_shared_signed(context, shared_id, protected_headers->str, sign_key, signed_packet, signed_bytes);
+			}
+			else
+			{
+				dc_log_info(context, 0, "Using the body signed for message %s.", shared_id);
+			}
+
+			if (!dc_pgp_pk_encrypt_signed(context, signed_packet, signed_bytes, keyring, 1/*use_armor*/, (void**)&ctext, &ctext_bytes)) {
+				goto cleanup;
+			}
 		}
-		//char* t1=dc_null_terminate(plain->str,plain->len);printf("PLAIN:\n%s\n",t1);free(t1); // DEBUG OUTPUT
+		else
+		{
+			/* convert part to encrypt to plain text */
+			mailmime_write_mem(plain, &col, message_to_encrypt);
+			if (plain->str==NULL || plain->len<=0) {
+				goto cleanup;
+			}
+			//char* t1=dc_null_terminate(plain->str,plain->len);printf("PLAIN:\n%s\n",t1);free(t1); // DEBUG OUTPUT
 
-		if (!dc_pgp_pk_encrypt(context, plain->str, plain->len, keyring, sign_key, 1/*use_armor*/, (void**)&ctext, &ctext_bytes)) {
-			goto cleanup;
+			if (!dc_pgp_pk_encrypt(context, plain->str, plain->len, keyring, sign_key, 1/*use_armor*/, (void**)&ctext, &ctext_bytes)) {
+				goto cleanup;
+			}
 		}
 		helper->cdata_to_free = ctext;
 		//char* t2=dc_null_terminate(ctext,ctext_bytes);printf("ENCRYPTED:\n%s\n",t2);free(t2); // DEBUG OUTPUT
@@ -476,6 +680,8 @@ cleanup:
 	dc_keyring_unref(keyring);
 	dc_key_unref(sign_key);
 	if (plain) { mmap_string_free(plain); }
+	if (protected_headers) { mmap_string_free(protected_headers); }
+	free(signed_packet);
 
 	for (int i=dc_array_get_cnt(peerstates)-1; i>=0; i--) { dc_apeerstate_unref((dc_apeerstate_t*)dc_array_get_ptr(peerstates, i)); }
 	dc_array_unref(peerstates);
@@ -771,24 +977,150 @@ static dc_hash_t* update_gossip_peerstates(dc_context_t* context, time_t message
 }
 
 
-void dc_e2ee_decrypt(dc_context_t* context, struct mailmime* in_out_message,
-                           dc_e2ee_helper_t* helper)
+static void get_from_and_time(struct mailimf_fields* imffields, char** ret_from, time_t* ret_message_time)
 {
-	/* return values: 0=nothing to decrypt/cannot decrypt, 1=sth. decrypted
-	(to detect parts that could not be decrypted, simply look for left "multipart/encrypted" MIME types */
-	struct mailimf_fields* imffields = mailmime_find_mailimf_fields(in_out_message); /*just a pointer into mailmime structure, must not be freed*/
+	struct mailimf_field* field = mailimf_find_field(imffields, MAILIMF_FIELD_FROM);
+	if (field && field->fld_data.fld_from) {
+		*ret_from = mailimf_find_first_addr(field->fld_data.fld_from->frm_mb_list);
+	}
+
+	field = mailimf_find_field(imffields, MAILIMF_FIELD_ORIG_DATE);
+	if (field && field->fld_data.fld_orig_date) {
+		struct mailimf_orig_date* orig_date = field->fld_data.fld_orig_date;
+		if (orig_date) {
+			*ret_message_time = dc_timestamp_from_date(orig_date->dt_date_time); /* is not yet checked against bad times! */
+			if (*ret_message_time!=DC_INVALID_TIMESTAMP && *ret_message_time > time(NULL)) {
+				*ret_message_time = time(NULL);
+			}
+		}
+	}
+}
+
+
+static dc_aheader_t* get_valid_aheader(dc_context_t* context, const char* from, struct mailimf_fields* imffields)
+{
+	dc_aheader_t* autocryptheader = dc_aheader_new_from_imffields(from, imffields);
+	if (autocryptheader) {
+		if (!dc_pgp_is_valid_key(context, autocryptheader->public_key)) {
+			dc_aheader_unref(autocryptheader);
+			autocryptheader = NULL;
+		}
+	}
+	return autocryptheader;
+}
+
+
+static int load_private_keyring(dc_context_t* context, dc_keyring_t* private_keyring)
+{
+	int   success = 0;
+	char* self_addr = NULL;
+
+	if ((self_addr=dc_sqlite3_get_config(context->sql, "configured_addr", NULL))==NULL) {
+		goto cleanup;
+	}
+
+	if (!dc_keyring_load_self_private_for_decrypting(private_keyring, self_addr, context->sql)) {
+		goto cleanup;
+	}
+
+	success = 1;
+
+cleanup:
+	free(self_addr);
+	return success;
+}
+
+
+static void decrypt_all(dc_context_t* context, struct mailmime* in_out_message,
+                        const dc_keyring_t* private_keyring, const dc_keyring_t* public_keyring_for_validate,
+                        dc_e2ee_helper_t* helper, struct mailimf_fields** ret_gossip_headers)
+{
+	/* finally, decrypt.  If sth. was decrypted, decrypt_recursive() returns "true" and we start over to decrypt maybe just added parts. */
+	helper->signatures = malloc(sizeof(dc_hash_t));
+	dc_hash_init(helper->signatures, DC_HASH_STRING, 1/*copy key*/);
+
+	int iterations = 0;
+	while (iterations < 10) {
+		int has_unencrypted_parts = 0;
+		if (!decrypt_recursive(context, in_out_message, private_keyring,
+		        public_keyring_for_validate,
+		        helper->signatures, ret_gossip_headers, &has_unencrypted_parts)) {
+			break;
+		}
+
+		// if we're here, sth. was encrypted. if we're on top-level, and there are no
+		// additional unencrypted parts in the message the encryption was fine
+		// (signature is handled separately and returned as `signatures`)
+		if (iterations==0
+		 && !has_unencrypted_parts) {
+			helper->encrypted = 1;
+		}
+
+		iterations++;
+	}
+}
+
+
+static int can_use_prepared(const dc_e2ee_prepared_t* prepared, const dc_keyring_t* public_keyring_for_validate)
+{
+	/* the prepared decryption was done with the keys known at that time; it gives the same result
+	if all keys we would use now were offered (additional keys may only result in additional signatures)
+	and if all signatures found belong to the keys we would use now. */
+	int        ok = 0;
+	int        i = 0;
+	dc_hash_t  fingerprints;
+	dc_hashelem_t* cur = NULL;
+
+	dc_hash_init(&fingerprints, DC_HASH_STRING, 1/*copy key*/);
+
+	for (i = 0; i < public_keyring_for_validate->count; i++) {
+		char* fingerprint = dc_key_get_fingerprint(public_keyring_for_validate->keys[i]);
+		if (fingerprint==NULL
+		 || prepared->validate_keys==NULL
+		 || dc_hash_find_str(prepared->validate_keys, fingerprint)==NULL) {
+			free(fingerprint);
+			goto cleanup;
+		}
+		dc_hash_insert(&fingerprints, fingerprint, strlen(fingerprint), (void*)1);
+		free(fingerprint);
+	}
+
+	if (prepared->helper.signatures) {
+		for (cur=dc_hash_first(prepared->helper.signatures); cur!=NULL; cur=dc_hash_next(cur)) {
+			if (dc_hash_find(&fingerprints, dc_hash_key(cur), dc_hash_keysize(cur))==NULL) {
+				goto cleanup;
+			}
+		}
+	}
+
+	ok = 1;
+
+cleanup:
+	dc_hash_clear(&fingerprints);
+	return ok;
+}
+
+
+static void decrypt_message(dc_context_t* context, struct mailmime** io_message,
+                            dc_e2ee_prepared_t* prepared, const char* imf_raw, size_t imf_raw_bytes,
+                            dc_e2ee_helper_t* helper)
+{
+	/* decrypt *io_message or, if given, use the prepared decryption.
+	if the prepared decryption cannot be used, *io_message is parsed again from imf_raw.
+	peerstates are always updated here as this must be done in the order the messages are received. */
+	struct mailimf_fields* imffields = mailmime_find_mailimf_fields(*io_message); /*just a pointer into mailmime structure, must not be freed*/
 	dc_aheader_t*          autocryptheader = NULL;
 	time_t                 message_time = 0;
 	dc_apeerstate_t*       peerstate = dc_apeerstate_new(context);
 	char*                  from = NULL;
-	char*                  self_addr = NULL;
+	int                    keys_loaded = 0;
 	dc_keyring_t*          private_keyring = dc_keyring_new();
 	dc_keyring_t*          public_keyring_for_validate = dc_keyring_new();
 	struct mailimf_fields* gossip_headers = NULL;
 
 	if (helper) { memset(helper, 0, sizeof(dc_e2ee_helper_t)); }
 
-	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || in_out_message==NULL
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC || *io_message==NULL
 	 || helper==NULL || imffields==NULL) {
 		goto cleanup;
 	}
@@ -797,32 +1129,9 @@ void dc_e2ee_decrypt(dc_context_t* context, struct mailmime* in_out_message,
 	- Set message_time and from (both may be unset)
 	- Get the autocrypt header, if any.
 	- Do not abort on errors - we should try at last the decyption below */
-	if (imffields)
-	{
-		struct mailimf_field* field = mailimf_find_field(imffields, MAILIMF_FIELD_FROM);
-		if (field && field->fld_data.fld_from) {
-			from = mailimf_find_first_addr(field->fld_data.fld_from->frm_mb_list);
-		}
-
-		field = mailimf_find_field(imffields, MAILIMF_FIELD_ORIG_DATE);
-		if (field && field->fld_data.fld_orig_date) {
-			struct mailimf_orig_date* orig_date = field->fld_data.fld_orig_date;
-			if (orig_date) {
-				message_time = dc_timestamp_from_date(orig_date->dt_date_time); /* is not yet checked against bad times! */
-				if (message_time!=DC_INVALID_TIMESTAMP && message_time > time(NULL)) {
-					message_time = time(NULL);
-				}
-			}
-		}
-	}
+	get_from_and_time(imffields, &from, &message_time);
 
-	autocryptheader = dc_aheader_new_from_imffields(from, imffields);
-	if (autocryptheader) {
-		if (!dc_pgp_is_valid_key(context, autocryptheader->public_key)) {
-			dc_aheader_unref(autocryptheader);
-			autocryptheader = NULL;
-		}
-	}
+	autocryptheader = get_valid_aheader(context, from, imffields);
 
 	/* modify the peerstate (eg. if there is a peer but not autocrypt header, stop encryption) */
 
@@ -837,7 +1146,7 @@ void dc_e2ee_decrypt(dc_context_t* context, struct mailmime* in_out_message,
 			}
 			else {
 				if (message_time > peerstate->last_seen_autocrypt
-				 && !contains_report(in_out_message) /*reports are ususally not encrpyted; do not degrade decryption then*/){
+				 && !(prepared? prepared->contains_report : contains_report(*io_message)) /*reports are ususally not encrpyted; do not degrade decryption then*/){
 					dc_apeerstate_degrade_encryption(peerstate, message_time);
 					dc_apeerstate_save_to_db(peerstate, context->sql, 0/*no not create*/);
 				}
@@ -850,58 +1159,64 @@ void dc_e2ee_decrypt(dc_context_t* context, struct mailmime* in_out_message,
 	}
 
 	/* load private key for decryption */
-	if ((self_addr=dc_sqlite3_get_config(context->sql, "configured_addr", NULL))==NULL) {
-		goto cleanup;
-	}
+	keys_loaded = load_private_keyring(context, private_keyring);
 
-	if (!dc_keyring_load_self_private_for_decrypting(private_keyring, self_addr, context->sql)) {
-		goto cleanup;
-	}
+	if (keys_loaded)
+	{
+		/* if not yet done, load peer with public key for verification (should be last as the peer may be modified above) */
+		if (peerstate->last_seen==0) {
+			dc_apeerstate_load_by_addr(peerstate, context->sql, from);
+		}
 
-	/* if not yet done, load peer with public key for verification (should be last as the peer may be modified above) */
-	if (peerstate->last_seen==0) {
-		dc_apeerstate_load_by_addr(peerstate, context->sql, from);
-	}
+		if (peerstate->degrade_event) {
+			dc_handle_degrade_event(context, peerstate);
+		}
 
-	if (peerstate->degrade_event) {
-		dc_handle_degrade_event(context, peerstate);
+		// offer both, gossip and public, for signature validation.
+		// the caller may check the signature fingerprints as needed later.
+		dc_keyring_add(public_keyring_for_validate, peerstate->gossip_key);
+		dc_keyring_add(public_keyring_for_validate, peerstate->public_key);
 	}
 
-	// offer both, gossip and public, for signature validation.
-	// the caller may check the signature fingerprints as needed later.
-	dc_keyring_add(public_keyring_for_validate, peerstate->gossip_key);
-	dc_keyring_add(public_keyring_for_validate, peerstate->public_key);
-
-	/* finally, decrypt.  If sth. was decrypted, decrypt_recursive() returns "true" and we start over to decrypt maybe just added parts. */
-	helper->signatures = malloc(sizeof(dc_hash_t));
-	dc_hash_init(helper->signatures, DC_HASH_STRING, 1/*copy key*/);
+	if (prepared)
+	{
+		if (keys_loaded==prepared->decrypt_tried
+		 && (!keys_loaded || can_use_prepared(prepared, public_keyring_for_validate))) {
+			helper->encrypted  = prepared->helper.encrypted;
+			helper->signatures = prepared->helper.signatures;
+			prepared->helper.signatures = NULL;
+			gossip_headers = prepared->gossip_headers;
+			prepared->gossip_headers = NULL;
+			goto gossip;
+		}
 
-	int iterations = 0;
-	while (iterations < 10) {
-		int has_unencrypted_parts = 0;
-		if (!decrypt_recursive(context, in_out_message, private_keyring,
-		        public_keyring_for_validate,
-		        helper->signatures, &gossip_headers, &has_unencrypted_parts)) {
-			break;
+		/* the keys have changed since the decryption was prepared, start over with the raw message */
+		size_t index = 0;
+		mailmime_free(*io_message);
+		*io_message = NULL;
+		imffields = NULL; /* pointed into the freed message */
+		if (mailmime_parse(imf_raw, imf_raw_bytes, &index, io_message)!=MAILIMF_NO_ERROR || *io_message==NULL) {
+			goto cleanup;
 		}
 
-		// if we're here, sth. was encrypted. if we're on top-level, and there are no
-		// additional unencrypted parts in the message the encryption was fine
-		// (signature is handled separately and returned as `signatures`)
-		if (iterations==0
-		 && !has_unencrypted_parts) {
-			helper->encrypted = 1;
+		if ((imffields=mailmime_find_mailimf_fields(*io_message))==NULL) {
+			goto cleanup;
 		}
+	}
 
-		iterations++;
+	if (!keys_loaded) {
+		goto cleanup;
 	}
 
+	decrypt_all(context, *io_message, private_keyring, public_keyring_for_validate, helper, &gossip_headers);
+
+gossip:
 	/* check for Autocrypt-Gossip */
 	if (gossip_headers) {
 		helper->gossipped_addr = update_gossip_peerstates(context, message_time, imffields, gossip_headers);
 	}
 
-	//mailmime_print(in_out_message);
+	//mailmime_print(*io_message);
 
 cleanup:
 	if (gossip_headers) { mailimf_fields_free(gossip_headers); }
@@ -910,6 +1225,125 @@ cleanup:
 	dc_keyring_unref(private_keyring);
 	dc_keyring_unref(public_keyring_for_validate);
 	free(from);
-	free(self_addr);
 }
 
+
+void dc_e2ee_decrypt(dc_context_t* context, struct mailmime* in_out_message,
+                           dc_e2ee_helper_t* helper)
+{
+	/* return values: 0=nothing to decrypt/cannot decrypt, 1=sth. decrypted
+	(to detect parts that could not be decrypted, simply look for left "multipart/encrypted" MIME types */
+	decrypt_message(context, &in_out_message, NULL, NULL, 0, helper);
+}
+
+
+/**
+ * Parse and decrypt a message without modifying the database.
+ * The function may be called from any thread, the result is used by dc_e2ee_decrypt_prepared()
+ * which is called in the order the messages are received and which updates the peerstates.
+ * As the peerstates may be changed by messages received before,
+ * all keys that may be used for validation are offered - the ones from the database and the one from the Autocrypt:-header.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_e2ee_prepare_decrypt(dc_context_t* context, const char* imf_raw, size_t imf_raw_bytes, dc_e2ee_prepared_t* prepared)
+{
+	size_t                 index = 0;
+	struct mailimf_fields* imffields = NULL;
+	char*                  from = NULL;
+	time_t                 message_time = 0;
+	dc_aheader_t*          autocryptheader = NULL;
+	dc_apeerstate_t*       peerstate = dc_apeerstate_new(context);
+	dc_keyring_t*          private_keyring = dc_keyring_new();
+	dc_keyring_t*          public_keyring_for_validate = dc_keyring_new();
+	int                    i = 0;
+
+	memset(prepared, 0, sizeof(dc_e2ee_prepared_t));
+
+	if (mailmime_parse(imf_raw, imf_raw_bytes, &index, &prepared->mimeroot)!=MAILIMF_NO_ERROR || prepared->mimeroot==NULL) {
+		goto cleanup;
+	}
+
+	if ((imffields=mailmime_find_mailimf_fields(prepared->mimeroot))==NULL) {
+		goto cleanup;
+	}
+
+	prepared->contains_report = contains_report(prepared->mimeroot);
+
+	if (!load_private_keyring(context, private_keyring)) {
+		goto cleanup;
+	}
+	prepared->decrypt_tried = 1;
+
+	get_from_and_time(imffields, &from, &message_time);
+
+	if (from && dc_apeerstate_load_by_addr(peerstate, context->sql, from)) {
+		dc_keyring_add(public_keyring_for_validate, peerstate->gossip_key);
+		dc_keyring_add(public_keyring_for_validate, peerstate->public_key);
+	}
+
+	if ((autocryptheader=get_valid_aheader(context, from, imffields))!=NULL) {
+		dc_keyring_add(public_keyring_for_validate, autocryptheader->public_key);
+	}
+
+	prepared->validate_keys = malloc(sizeof(dc_hash_t));
+	dc_hash_init(prepared->validate_keys, DC_HASH_STRING, 1/*copy key*/);
+	for (i = 0; i < public_keyring_for_validate->count; i++) {
+		char* fingerprint = dc_key_get_fingerprint(public_keyring_for_validate->keys[i]);
+		if (fingerprint) {
+			dc_hash_insert(prepared->validate_keys, fingerprint, strlen(fingerprint), (void*)1);
+		}
+		free(fingerprint);
+	}
+
+	decrypt_all(context, prepared->mimeroot, private_keyring, public_keyring_for_validate, &prepared->helper, &prepared->gossip_headers);
+
+cleanup:
+	dc_aheader_unref(autocryptheader);
+	dc_apeerstate_unref(peerstate);
+	dc_keyring_unref(private_keyring);
+	dc_keyring_unref(public_keyring_for_validate);
+	free(from);
+}
+
+
+/**
+ * Update the peerstates for a message prepared by dc_e2ee_prepare_decrypt() and take over the decrypted message.
+ * If the keys used for validation have changed in between, the message is decrypted again.
+ *
+ * @private @memberof dc_context_t
+ * @param ret_message Receives the decrypted message, may be NULL on errors. Must be freed using mailmime_free().
+ */
+void dc_e2ee_decrypt_prepared(dc_context_t* context, dc_e2ee_prepared_t* prepared, const char* imf_raw, size_t imf_raw_bytes,
+                              struct mailmime** ret_message, dc_e2ee_helper_t* helper)
+{
+	*ret_message = prepared->mimeroot;
+	prepared->mimeroot = NULL;
+	decrypt_message(context, ret_message, prepared, imf_raw, imf_raw_bytes, helper);
+}
+
+
+void dc_e2ee_prepared_empty(dc_e2ee_prepared_t* prepared)
+{
+	if (prepared==NULL) {
+		return;
+	}
+
+	if (prepared->mimeroot) {
+		mailmime_free(prepared->mimeroot);
+		prepared->mimeroot = NULL;
+	}
+
+	if (prepared->validate_keys) {
+		dc_hash_clear(prepared->validate_keys);
+		free(prepared->validate_keys);
+		prepared->validate_keys = NULL;
+	}
+
+	if (prepared->gossip_headers) {
+		mailimf_fields_free(prepared->gossip_headers);
+		prepared->gossip_headers = NULL;
+	}
+
+	dc_e2ee_thanks(&prepared->helper);
+}
@@ -69,6 +69,15 @@ static char* get_error_msg(dc_imap_t* imap, const char* what_failed, int code)
 }
 
 
+static int get_config_int(dc_imap_t* imap, const char* key, int def)
+{
+	char* str = imap->get_config(imap, key, NULL);
+	int   ret = str? atoi(str) : def;
+	free(str);
+	return ret;
+}
+
+
 static void get_config_lastseenuid(dc_imap_t* imap, const char* folder, uint32_t* uidvalidity, uint32_t* lastseenuid)
 {
 	*uidvalidity = 0;
@@ -643,59 +652,105 @@ static void peek_body(struct mailimap_msg_att* msg_att, char** p_msg, size_t* p_
 }
 
 
-static int fetch_single_msg(dc_imap_t* imap, const char* folder, uint32_t server_uid)
+static uint32_t peek_rfc822_size(struct mailimap_msg_att* msg_att)
 {
-	/* the function returns:
-	    0  the caller should try over again later
-	or  1  if the messages should be treated as received, the caller should not try to read the message again (even if no database entries are returned) */
-	char*       msg_content = NULL;
-	size_t      msg_bytes = 0;
-	int         r = 0;
-	int         retry_later = 0;
-	int         deleted = 0;
-	uint32_t    flags = 0;
-	clist*      fetch_result = NULL;
-	clistiter*  cur;
-
-	if (imap==NULL) {
-		goto cleanup;
+	/* search the RFC822.SIZE in a list of attributes returned by a FETCH command */
+	clistiter* iter1;
+	for (iter1=clist_begin(msg_att->att_list); iter1!=NULL; iter1=clist_next(iter1))
+	{
+		struct mailimap_msg_att_item* item = (struct mailimap_msg_att_item*)clist_content(iter1);
+		if (item)
+		{
+			if (item->att_type==MAILIMAP_MSG_ATT_ITEM_STATIC)
+			{
+				if (item->att_data.att_static->att_type==MAILIMAP_MSG_ATT_RFC822_SIZE)
+				{
+					return item->att_data.att_static->att_data.att_rfc822_size;
+				}
+			}
+		}
 	}
 
-	if (imap->etpan==NULL) {
+	return 0;
+}
+
+
+static int fetch_msgs(dc_imap_t* imap, const char* folder, const dc_array_t* server_uids, uint32_t* ret_max_uid)
+{
+	/* fetch the bodies of all given UIDs using a single `UID FETCH <uid>,<uid>,... (FLAGS BODY.PEEK[])`
+	and pass them one by one to receive_imf() in the order returned by the server.
+	receive_flush() is called after the last receive_imf(), the raw messages are freed afterwards.
+	the function returns:
+	    0  the caller should try over again later
+	or  1  if the messages should be treated as received, the caller should not try to read the messages again (even if no database entries are returned);
+	       ret_max_uid is set to the largest UID passed to receive_imf() or that does no longer exist on the server */
+	int                  r = 0;
+	int                  retry_later = 0;
+	size_t               i = 0;
+	size_t               cnt = dc_array_get_cnt(server_uids);
+	clist*               fetch_result = NULL;
+	clistiter*           cur = NULL;
+	struct mailimap_set* set = NULL;
+
+	if (imap==NULL || imap->etpan==NULL || cnt==0) {
 		goto cleanup;
 	}
 
-
-	{
-		struct mailimap_set* set = mailimap_set_new_single(server_uid);
-			r = mailimap_uid_fetch(imap->etpan, set, imap->fetch_type_body, &fetch_result);
-		mailimap_set_free(set);
+	set = mailimap_set_new_empty();
+	for (i = 0; i < cnt; i++) {
+		mailimap_set_add_single(set, dc_array_get_id(server_uids, i));
 	}
 
+	r = mailimap_uid_fetch(imap->etpan, set, imap->fetch_type_body, &fetch_result);
 	if (is_error(imap, r) || fetch_result==NULL) {
 		fetch_result = NULL;
-		dc_log_warning(imap->context, 0, "Error #%i on fetching message #%i from folder \"%s\"; retry=%i.", (int)r, (int)server_uid, folder, (int)imap->should_reconnect);
+		dc_log_warning(imap->context, 0, "Error #%i on fetching %i messages from folder \"%s\"; retry=%i.", (int)r, (int)cnt, folder, (int)imap->should_reconnect);
 		if (imap->should_reconnect) {
 			retry_later = 1; /* maybe we should also retry on other errors, however, we should check this carefully, as this may result in a dead lock! */
 		}
-		goto cleanup; /* this is an error that should be recovered; the caller should try over later to fetch the message again (if there is no such message, we simply get an empty result) */
+		goto cleanup; /* this is an error that should be recovered; the caller should try over later to fetch the messages again (if there are no such messages, we simply get an empty result) */
 	}
 
-	if ((cur=clist_begin(fetch_result))==NULL) {
-		dc_log_warning(imap->context, 0, "Message #%i does not exist in folder \"%s\".", (int)server_uid, folder);
-		goto cleanup; /* server response is fine, however, there is no such message, do not try to fetch the message again */
+	if (clist_count(fetch_result) < cnt) {
+		dc_log_warning(imap->context, 0, "%i of %i messages do not exist in folder \"%s\".", (int)(cnt-clist_count(fetch_result)), (int)cnt, folder);
+		/* server response is fine, however, some messages are missing, do not try to fetch them again */
 	}
 
-	struct mailimap_msg_att* msg_att = (struct mailimap_msg_att*)clist_content(cur);
-	peek_body(msg_att, &msg_content, &msg_bytes, &flags, &deleted);
-	if (msg_content==NULL  || msg_bytes <= 0 || deleted) {
-		/* dc_log_warning(imap->context, 0, "Message #%i in folder \"%s\" is empty or deleted.", (int)server_uid, folder); -- this is a quite usual situation, do not print a warning */
-		goto cleanup;
+	for (cur=clist_begin(fetch_result); cur!=NULL; cur=clist_next(cur))
+	{
+		struct mailimap_msg_att* msg_att = (struct mailimap_msg_att*)clist_content(cur);
+		uint32_t server_uid  = peek_uid(msg_att);
+		char*    msg_content = NULL;
+		size_t   msg_bytes = 0;
+		uint32_t flags = 0;
+		int      deleted = 0;
+
+		if (server_uid==0 || !dc_array_search_id(server_uids, server_uid, NULL)) {
+			continue; /* unsolicited FETCH responses may come in between, eg. on flag changes */
+		}
+
+		peek_body(msg_att, &msg_content, &msg_bytes, &flags, &deleted);
+		if (msg_content==NULL  || msg_bytes <= 0 || deleted) {
+			/* dc_log_warning(imap->context, 0, "Message #%i in folder \"%s\" is empty or deleted.", (int)server_uid, folder); -- this is a quite usual situation, do not print a warning */
+			continue;
+		}
+
+		imap->receive_imf(imap, msg_content, msg_bytes, folder, server_uid, flags);
 	}
 
-	imap->receive_imf(imap, msg_content, msg_bytes, folder, server_uid, flags);
+	imap->receive_flush(imap);
+
+	/* all requested UIDs are handled now - either received or missing on the server */
+	for (i = 0; i < cnt; i++) {
+		if (dc_array_get_id(server_uids, i) > *ret_max_uid) {
+			*ret_max_uid = dc_array_get_id(server_uids, i);
+		}
+	}
 
 cleanup:
+	if (set) {
+		mailimap_set_free(set);
+	}
 
 	if (fetch_result) {
 		mailimap_fetch_list_free(fetch_result);
@@ -704,6 +759,21 @@ cleanup:
 }
 
 
+static void fetch_batch(dc_imap_t* imap, const char* folder, uint32_t uidvalidity, dc_array_t* batch_uids, uint32_t* new_lastseenuid, size_t* read_errors)
+{
+	if (fetch_msgs(imap, folder, batch_uids, new_lastseenuid)==0/* 0=try again later*/) {
+		*read_errors += dc_array_get_cnt(batch_uids);
+	}
+	dc_array_empty(batch_uids);
+
+	/* the messages of the batch are in the database now, skip them on the next fetch;
+	after an error, all following messages are fetched again */
+	if (*read_errors==0 && *new_lastseenuid > 0) {
+		set_config_lastseenuid(imap, folder, uidvalidity, *new_lastseenuid);
+	}
+}
+
+
 static int fetch_from_single_folder(dc_imap_t* imap, const char* folder)
 {
 	int                  r;
@@ -715,6 +785,8 @@ static int fetch_from_single_folder(dc_imap_t* imap, const char* folder)
 	size_t               read_errors = 0;
 	clistiter*           cur;
 	struct mailimap_set* set;
+	dc_array_t*          batch_uids = NULL;
+	size_t               batch_bytes = 0;
 
 	if (imap==NULL) {
 		goto cleanup;
@@ -781,9 +853,9 @@ static int fetch_from_single_folder(dc_imap_t* imap, const char* folder)
 		set_config_lastseenuid(imap, folder, uidvalidity, lastseenuid);
 	}
 
-	/* fetch messages with larger UID than the last one seen (`UID FETCH lastseenuid+1:*)`, see RFC 4549 */
+	/* fetch UIDs and sizes of messages with larger UID than the last one seen (`UID FETCH lastseenuid+1:* (UID RFC822.SIZE)`, see RFC 4549) */
 	set = mailimap_set_new_interval(lastseenuid+1, 0);
-		r = mailimap_uid_fetch(imap->etpan, set, imap->fetch_type_uid, &fetch_result);
+		r = mailimap_uid_fetch(imap->etpan, set, imap->fetch_type_uid_size, &fetch_result);
 	mailimap_set_free(set);
 
 	if (is_error(imap, r) || fetch_result==NULL)
@@ -797,7 +869,10 @@ static int fetch_from_single_folder(dc_imap_t* imap, const char* folder)
 		goto cleanup;
 	}
 
-	/* go through all mails in folder (this is typically _fast_ as we already have the whole list) */
+	/* go through all mails in folder and fetch the bodies in batches (this is typically _fast_ as we already have the whole list);
+	a batch is closed as soon as it reaches the configured number of messages or bytes;
+	a message that does not fit into the current batch starts a new one, so a single large message is fetched on its own */
+	batch_uids = dc_array_new(imap->context, imap->fetch_batch_max_msgs);
 	for (cur = clist_begin(fetch_result); cur!=NULL ; cur = clist_next(cur))
 	{
 		struct mailimap_msg_att* msg_att = (struct mailimap_msg_att*)clist_content(cur); /* mailimap_msg_att is a list of attributes: list is a list of message attributes */
@@ -805,19 +880,27 @@ static int fetch_from_single_folder(dc_imap_t* imap, const char* folder)
 		if (cur_uid > 0
 		 && cur_uid!=lastseenuid /* `UID FETCH <lastseenuid+1>:*` may include lastseenuid if "*"==lastseenuid */)
 		{
-			read_cnt++;
-			if (fetch_single_msg(imap, folder, cur_uid)==0/* 0=try again later*/) {
-				read_errors++;
-			}
-			else if (cur_uid > new_lastseenuid) {
-				new_lastseenuid = cur_uid;
+			uint32_t cur_bytes = peek_rfc822_size(msg_att);
+			if (dc_array_get_cnt(batch_uids) > 0
+			 && batch_bytes+cur_bytes > (size_t)imap->fetch_batch_max_bytes)
+			{
+				fetch_batch(imap, folder, uidvalidity, batch_uids, &new_lastseenuid, &read_errors);
+				batch_bytes = 0;
 			}
 
+			read_cnt++;
+			dc_array_add_id(batch_uids, cur_uid);
+			batch_bytes += cur_bytes;
 		}
-	}
 
-	if (!read_errors && new_lastseenuid > 0) {
-		set_config_lastseenuid(imap, folder, uidvalidity, new_lastseenuid);
+		if (dc_array_get_cnt(batch_uids) > 0
+		 && (dc_array_get_cnt(batch_uids) >= (size_t)imap->fetch_batch_max_msgs
+		  || batch_bytes >= (size_t)imap->fetch_batch_max_bytes
+		  || clist_next(cur)==NULL))
+		{
+			fetch_batch(imap, folder, uidvalidity, batch_uids, &new_lastseenuid, &read_errors);
+			batch_bytes = 0;
+		}
 	}
 
 	/* done */
@@ -834,6 +917,7 @@ cleanup:
 		mailimap_fetch_list_free(fetch_result);
 	}
 
+	dc_array_unref(batch_uids);
 	return read_cnt;
 }
 
@@ -904,63 +988,70 @@ int dc_imap_fetch(dc_imap_t* imap)
 }
 
 
-static void fake_idle(dc_imap_t* imap)
+static void fake_idle(dc_imap_t* imap, time_t wakeup_at)
 {
 	/* Idle using timeouts. This is also needed if we're not yet configured -
-	in this case, we're waiting for a configure job */
-
-	time_t fake_idle_start_time = time(NULL);
-	time_t seconds_to_wait = 0;
+	in this case, we're waiting for a configure job.
+	we wait until the next job is due or until we're interrupted, eg. by a new job or by the ui on network changes;
+	only if we're connected to a server without IDLE, new messages are checked from time to time. */
 
 	dc_log_info(imap->context, 0, "IMAP-fake-IDLEing...");
 
 	int do_fake_idle = 1;
 	while (do_fake_idle)
 	{
-		// wait a moment: every 5 seconds in the first 3 minutes after a new message, after that every 60 seconds
-		seconds_to_wait = (time(NULL)-fake_idle_start_time < 3*60)? 5 : 60;
+		time_t wait_until = wakeup_at;
+		if (dc_imap_is_connected(imap)) {
+			time_t fetch_at = time(NULL)+DC_FAKE_IDLE_FETCH_SECONDS;
+			if (wait_until==0 || fetch_at<wait_until) {
+				wait_until = fetch_at;
+			}
+		}
+
 		pthread_mutex_lock(&imap->watch_condmutex);
 
 			int r = 0;
-			struct timespec wakeup_at;
-			memset(&wakeup_at, 0, sizeof(wakeup_at));
-			wakeup_at.tv_sec  = time(NULL)+seconds_to_wait;
-			while (imap->watch_condflag==0 && r==0) {
-				r = pthread_cond_timedwait(&imap->watch_cond, &imap->watch_condmutex, &wakeup_at); /* unlock mutex -> wait -> lock mutex */
-				if (imap->watch_condflag) {
-					do_fake_idle = 0;
+			if (wait_until==0) {
+				while (imap->watch_condflag==0 && r==0) {
+					r = pthread_cond_wait(&imap->watch_cond, &imap->watch_condmutex); /* unlock mutex -> wait -> lock mutex */
 				}
 			}
+			else {
+				struct timespec wakeup_ts;
+				memset(&wakeup_ts, 0, sizeof(wakeup_ts));
+				wakeup_ts.tv_sec  = wait_until;
+				while (imap->watch_condflag==0 && r==0) {
+					r = pthread_cond_timedwait(&imap->watch_cond, &imap->watch_condmutex, &wakeup_ts); /* unlock mutex -> wait -> lock mutex */
+				}
+			}
+			if (imap->watch_condflag) {
+				do_fake_idle = 0;
+			}
 			imap->watch_condflag = 0;
 
 		pthread_mutex_unlock(&imap->watch_condmutex);
 
-		if (do_fake_idle==0) {
+		if (do_fake_idle==0 || (wakeup_at!=0 && time(NULL)>=wakeup_at)) {
 			return;
 		}
 
 		// check for new messages. fetch_from_single_folder() has the side-effect that messages
 		// are also downloaded, however, typically this would take place in the FETCH command
 		// following IDLE otherwise, so this seems okay here.
-		if (setup_handle_if_needed(imap)) { // the handle may not be set up if configure is not yet done
+		if (setup_handle_if_needed(imap)) {
 			if (fetch_from_single_folder(imap, "INBOX")) {
 				do_fake_idle = 0;
 			}
 		}
-		else {
-			// if we cannot connect, set the starting time to a small value which will
-			// result in larger timeouts (60 instead of 5 seconds) for re-checking the availablility of network.
-			// to get the _exact_ moment of re-available network, the ui should call interrupt_idle()
-			fake_idle_start_time = 0;
-		}
 	}
 }
 
 
-void dc_imap_idle(dc_imap_t* imap)
+void dc_imap_idle(dc_imap_t* imap, time_t wakeup_at)
 {
 	int r = 0;
 	int r2 = 0;
+	int idle_seconds = 0;
 
 	if (imap->can_idle)
 	{
@@ -970,7 +1061,7 @@ void dc_imap_idle(dc_imap_t* imap)
 			r = mailstream_setup_idle(imap->etpan->imap_stream);
 			if (is_error(imap, r)) {
 				dc_log_warning(imap->context, 0, "IMAP-IDLE: Cannot setup.");
-				fake_idle(imap);
+				fake_idle(imap, wakeup_at);
 				return;
 			}
 			imap->idle_set_up = 1;
@@ -978,23 +1069,27 @@ void dc_imap_idle(dc_imap_t* imap)
 
 		if (!imap->idle_set_up || !select_folder(imap, "INBOX")) {
 			dc_log_warning(imap->context, 0, "IMAP-IDLE not setup.");
-			fake_idle(imap);
+			fake_idle(imap, wakeup_at);
 			return;
 		}
 
 		r = mailimap_idle(imap->etpan);
 		if (is_error(imap, r)) {
 			dc_log_warning(imap->context, 0, "IMAP-IDLE: Cannot start.");
-			fake_idle(imap);
+			fake_idle(imap, wakeup_at);
 			return;
 		}
 
 		// most servers do not allow more than ~28 minutes; stay clearly below that.
-		// a good value is 23 minutes.  however, as we do all imap in the same thread,
-		// we use a shorter delay to let failed jobs run again from time to time.
-		#define IDLE_DELAY_SECONDS (1*60)
+		// if a job is due before, we stop idling for it.
+		#define IDLE_DELAY_SECONDS (23*60)
 
-		r = mailstream_wait_idle(imap->etpan->imap_stream, IDLE_DELAY_SECONDS);
+		idle_seconds = IDLE_DELAY_SECONDS;
+		if (wakeup_at!=0 && wakeup_at-time(NULL) < idle_seconds) {
+			idle_seconds = DC_MAX(wakeup_at-time(NULL), 1);
+		}
+
+		r = mailstream_wait_idle(imap->etpan->imap_stream, idle_seconds);
 		r2 = mailimap_idle_done(imap->etpan);
 
 		if (r==MAILSTREAM_IDLE_ERROR /*0*/ || r==MAILSTREAM_IDLE_CANCELLED /*4*/) {
@@ -1016,7 +1111,7 @@ void dc_imap_idle(dc_imap_t* imap)
 	}
 	else
 	{
-		fake_idle(imap);
+		fake_idle(imap, wakeup_at);
 	}
 }
 
@@ -1225,6 +1320,9 @@ int dc_imap_connect(dc_imap_t* imap, const dc_loginparam_t* lp)
 	imap->imap_pw      = dc_strdup(lp->mail_pw);
 	imap->server_flags = lp->server_flags;
 
+	imap->fetch_batch_max_msgs  = DC_MAX(1, get_config_int(imap, "imap_fetch_batch_msgs", DC_FETCH_BATCH_MAX_MSGS));
+	imap->fetch_batch_max_bytes = DC_MAX(1, get_config_int(imap, "imap_fetch_batch_bytes", DC_FETCH_BATCH_MAX_BYTES));
+
 	if (!setup_handle_if_needed(imap)) {
 		goto cleanup;
 	}
@@ -1298,7 +1396,7 @@ int dc_imap_is_connected(const dc_imap_t* imap)
  ******************************************************************************/
 
 
-dc_imap_t* dc_imap_new(dc_get_config_t get_config, dc_set_config_t set_config, dc_receive_imf_t receive_imf, void* userData, dc_context_t* context)
+dc_imap_t* dc_imap_new(dc_get_config_t get_config, dc_set_config_t set_config, dc_receive_imf_t receive_imf, dc_receive_flush_t receive_flush, void* userData, dc_context_t* context)
 {
 	dc_imap_t* imap = NULL;
 
@@ -1308,10 +1406,14 @@ dc_imap_t* dc_imap_new(dc_get_config_t get_config, dc_set_config_t set_config, d
 
 	imap->log_connect_errors = 1;
 
+	imap->fetch_batch_max_msgs  = DC_FETCH_BATCH_MAX_MSGS;
+	imap->fetch_batch_max_bytes = DC_FETCH_BATCH_MAX_BYTES;
+
 	imap->context        = context;
 	imap->get_config     = get_config;
 	imap->set_config     = set_config;
 	imap->receive_imf    = receive_imf;
+	imap->receive_flush  = receive_flush;
 	imap->userData       = userData;
 
 	pthread_mutex_init(&imap->watch_condmutex, NULL);
@@ -1327,6 +1429,10 @@ dc_imap_t* dc_imap_new(dc_get_config_t get_config, dc_set_config_t set_config, d
 	imap->fetch_type_uid = mailimap_fetch_type_new_fetch_att_list_empty(); /* object to fetch the ID */
 	mailimap_fetch_type_new_fetch_att_list_add(imap->fetch_type_uid, mailimap_fetch_att_new_uid());
 
+	imap->fetch_type_uid_size = mailimap_fetch_type_new_fetch_att_list_empty(); /* object to fetch the ID and the size, used to plan the fetch batches */
+	mailimap_fetch_type_new_fetch_att_list_add(imap->fetch_type_uid_size, mailimap_fetch_att_new_uid());
+	mailimap_fetch_type_new_fetch_att_list_add(imap->fetch_type_uid_size, mailimap_fetch_att_new_rfc822_size());
+
 	imap->fetch_type_message_id = mailimap_fetch_type_new_fetch_att_list_empty();
 	mailimap_fetch_type_new_fetch_att_list_add(imap->fetch_type_message_id, mailimap_fetch_att_new_envelope());
 
@@ -1353,6 +1459,7 @@ void dc_imap_unref(dc_imap_t* imap)
 	pthread_mutex_destroy(&imap->watch_condmutex);
 	free(imap->selected_folder);
 	if (imap->fetch_type_uid)        { mailimap_fetch_type_free(imap->fetch_type_uid); }
+	if (imap->fetch_type_uid_size)   { mailimap_fetch_type_free(imap->fetch_type_uid_size); }
 	if (imap->fetch_type_message_id) { mailimap_fetch_type_free(imap->fetch_type_message_id); }
 	if (imap->fetch_type_body)       { mailimap_fetch_type_free(imap->fetch_type_body); }
 	if (imap->fetch_type_flags)      { mailimap_fetch_type_free(imap->fetch_type_flags); }
@@ -1426,12 +1533,11 @@ cleanup:
 }
 
 
-static int add_flag(dc_imap_t* imap, uint32_t server_uid, struct mailimap_flag* flag)
+static int add_flag_to_set(dc_imap_t* imap, struct mailimap_set* set, struct mailimap_flag* flag)
 {
 	int                              r = 0;
 	struct mailimap_flag_list*       flag_list = NULL;
 	struct mailimap_store_att_flags* store_att_flags = NULL;
-	struct mailimap_set*             set = mailimap_set_new_single(server_uid);
 
 	if (imap==NULL || imap->etpan==NULL) {
 		goto cleanup;
@@ -1451,13 +1557,43 @@ cleanup:
 	if (store_att_flags) {
 		mailimap_store_att_flags_free(store_att_flags);
 	}
-	if (set) {
-		mailimap_set_free(set);
-	}
 	return imap->should_reconnect? 0 : 1; /* all non-connection states are treated as success - the mail may already be deleted or moved away on the server */
 }
 
 
+static int add_flag(dc_imap_t* imap, uint32_t server_uid, struct mailimap_flag* flag)
+{
+	struct mailimap_set* set = mailimap_set_new_single(server_uid);
+	int                  ret = add_flag_to_set(imap, set, flag);
+	mailimap_set_free(set);
+	return ret;
+}
+
+
+static int can_create_mdnsent_flag(dc_imap_t* imap)
+{
+	/* Check if the selected folder can handle the `$MDNSent` flag (see RFC 3503).
+	If the folder cannot handle the `$MDNSent` flag, we risk duplicated MDNs; it's up to the receiving MUA to handle this then (eg. Delta Chat has no problem with this). */
+	clistiter* iter;
+	for (iter=clist_begin(imap->etpan->imap_selection_info->sel_perm_flags); iter!=NULL; iter=clist_next(iter))
+	{
+		struct mailimap_flag_perm* fp = (struct mailimap_flag_perm*)clist_content(iter);
+		if (fp) {
+			if (fp->fl_type==MAILIMAP_FLAG_PERM_ALL) {
+				return 1;
+			}
+			else if (fp->fl_type==MAILIMAP_FLAG_PERM_FLAG && fp->fl_flag) {
+				struct mailimap_flag* fl = (struct mailimap_flag*)fp->fl_flag;
+				if (fl->fl_type==MAILIMAP_FLAG_KEYWORD && fl->fl_data.fl_keyword && strcmp(fl->fl_data.fl_keyword, "$MDNSent")==0) {
+					return 1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+
 int dc_imap_markseen_msg(dc_imap_t* imap, const char* folder, uint32_t server_uid, int ms_flags,
                         char** ret_server_folder, uint32_t* ret_server_uid, int* ret_ms_flags)
 {
@@ -1496,27 +1632,7 @@ int dc_imap_markseen_msg(dc_imap_t* imap, const char* folder, uint32_t server_ui
 	if ((ms_flags&DC_MS_SET_MDNSent_FLAG)
 	 && imap->etpan->imap_selection_info!=NULL && imap->etpan->imap_selection_info->sel_perm_flags!=NULL)
 	{
-		/* Check if the folder can handle the `$MDNSent` flag (see RFC 3503).  If so, and not set: set the flags and return this information.
-		If the folder cannot handle the `$MDNSent` flag, we risk duplicated MDNs; it's up to the receiving MUA to handle this then (eg. Delta Chat has no problem with this). */
-		int can_create_flag = 0;
-		clistiter* iter;
-		for (iter=clist_begin(imap->etpan->imap_selection_info->sel_perm_flags); iter!=NULL; iter=clist_next(iter))
-		{
-			struct mailimap_flag_perm* fp = (struct mailimap_flag_perm*)clist_content(iter);
-			if (fp) {
-				if (fp->fl_type==MAILIMAP_FLAG_PERM_ALL) {
-					can_create_flag = 1;
-					break;
-				}
-				else if (fp->fl_type==MAILIMAP_FLAG_PERM_FLAG && fp->fl_flag) {
-					struct mailimap_flag* fl = (struct mailimap_flag*)fp->fl_flag;
-					if (fl->fl_type==MAILIMAP_FLAG_KEYWORD && fl->fl_data.fl_keyword && strcmp(fl->fl_data.fl_keyword, "$MDNSent")==0) {
-						can_create_flag = 1;
-						break;
-					}
-				}
-			}
-		}
+		int can_create_flag = can_create_mdnsent_flag(imap);
 
 		if (can_create_flag)
 		{
@@ -1526,8 +1642,10 @@ int dc_imap_markseen_msg(dc_imap_t* imap, const char* folder, uint32_t server_ui
 				clistiter* cur=clist_begin(fetch_result);
 				if (cur) {
 					if (!peek_flag_keyword((struct mailimap_msg_att*)clist_content(cur), "$MDNSent")) {
-						add_flag(imap, server_uid, mailimap_flag_new_flag_keyword(dc_strdup("$MDNSent")));
-						*ret_ms_flags |= DC_MS_MDNSent_JUST_SET;
+						/* if storing fails because of the connection, the flag is checked again on the next try */
+						if (add_flag(imap, server_uid, mailimap_flag_new_flag_keyword(dc_strdup("$MDNSent")))) {
+							*ret_ms_flags |= DC_MS_MDNSent_JUST_SET;
+						}
 					}
 				}
 				mailimap_fetch_list_free(fetch_result);
@@ -1685,3 +1803,364 @@ cleanup:
 
 }
 
+
+
+/*******************************************************************************
+ * Pipelined commands
+ ******************************************************************************/
+
+
+static dc_imap_msgref_t* find_msgref(dc_imap_msgref_t* refs, int ref_cnt, uint32_t server_uid)
+{
+	int i;
+	for (i = 0; i < ref_cnt; i++) {
+		if (refs[i].server_uid==server_uid) {
+			return &refs[i];
+		}
+	}
+	return NULL;
+}
+
+
+static void expand_set(const struct mailimap_set* set, dc_array_t* ret_uids)
+{
+	/* expand a set as returned eg. by COPYUID to single UIDs, the order is kept */
+	clistiter* cur;
+	for (cur=clist_begin(set->set_list); cur!=NULL; cur=clist_next(cur)) {
+		struct mailimap_set_item* item = (struct mailimap_set_item*)clist_content(cur);
+		uint32_t uid;
+		if (item->set_first==0 || item->set_last < item->set_first) {
+			continue; /* `*` is not expected in UIDPLUS responses */
+		}
+		for (uid = item->set_first; ; uid++) {
+			dc_array_add_id(ret_uids, uid);
+			if (uid==item->set_last) {
+				break;
+			}
+		}
+	}
+}
+
+
+/**
+ * Mark several messages of the same folder as seen using one `UID STORE`
+ * and, if needed, move them to the moveto-folder using one `UID MOVE` (or `UID COPY`).
+ * The $MDNSent flags are checked and set with one command each.
+ *
+ * On return, `handled` is set for all messages if the commands succeeded;
+ * if not, the caller should use dc_imap_markseen_msg() for the messages
+ * which will also do the error handling.
+ *
+ * DC_MS_MDNSent_JUST_SET is returned for all messages the $MDNSent flag was stored for,
+ * also if a later command fails, and the caller must send the MDN for them:
+ * dc_imap_markseen_msg() will find the flag and will not request the MDN again.
+ *
+ * @private @memberof dc_imap_t
+ * @param imap The IMAP object.
+ * @param folder The folder containing all messages given in refs.
+ * @param refs The messages to mark as seen.
+ * @param ref_cnt The number of messages in refs.
+ * @param ret_moveto_folder If any message is moved, the name of the folder is returned here
+ *     and must be free()'d; the new UIDs are returned in dc_imap_msgref_t::new_server_uid then.
+ * @return None.
+ */
+void dc_imap_markseen_msgs(dc_imap_t* imap, const char* folder, dc_imap_msgref_t* refs, int ref_cnt, char** ret_moveto_folder)
+{
+	int                  i = 0;
+	int                  r = 0;
+	int                  done = 0;
+	struct mailimap_set* seen_set = NULL;
+	struct mailimap_set* mdn_set = NULL;
+	int                  mdn_cnt = 0;
+	int                  mdn_without_flag = 0;
+	struct mailimap_set* move_set = NULL;
+	int                  move_cnt = 0;
+	clist*               fetch_result = NULL;
+	uint32_t             res_uid = 0;
+	struct mailimap_set* res_setsrc = NULL;
+	struct mailimap_set* res_setdest = NULL;
+	dc_array_t*          src_uids = NULL;
+	dc_array_t*          dest_uids = NULL;
+
+	if (imap==NULL || folder==NULL || refs==NULL || ret_moveto_folder==NULL || *ret_moveto_folder!=NULL) {
+		return;
+	}
+
+	for (i = 0; i < ref_cnt; i++) {
+		refs[i].new_server_uid = 0;
+		refs[i].handled = 0;
+	}
+
+	if (imap->etpan==NULL || ref_cnt<=0) {
+		goto cleanup;
+	}
+
+	dc_log_info(imap->context, 0, "Marking %i messages in %s as seen...", ref_cnt, folder);
+
+	if (select_folder(imap, folder)==0) {
+		dc_log_warning(imap->context, 0, "Cannot select folder.");
+		goto cleanup;
+	}
+
+	seen_set = mailimap_set_new_empty();
+	mdn_set = mailimap_set_new_empty();
+	move_set = mailimap_set_new_empty();
+	for (i = 0; i < ref_cnt; i++) {
+		mailimap_set_add_single(seen_set, refs[i].server_uid);
+		if (refs[i].ms_flags&DC_MS_SET_MDNSent_FLAG) {
+			mailimap_set_add_single(mdn_set, refs[i].server_uid);
+			mdn_cnt++;
+		}
+		if (refs[i].ms_flags&DC_MS_ALSO_MOVE) {
+			mailimap_set_add_single(move_set, refs[i].server_uid);
+			move_cnt++;
+		}
+	}
+
+	if (add_flag_to_set(imap, seen_set, mailimap_flag_new_seen())==0) {
+		dc_log_warning(imap->context, 0, "Cannot mark messages as seen.");
+		goto cleanup;
+	}
+
+	dc_log_info(imap->context, 0, "Messages marked as seen.");
+
+	if (mdn_cnt > 0
+	 && imap->etpan->imap_selection_info!=NULL && imap->etpan->imap_selection_info->sel_perm_flags!=NULL)
+	{
+		if (can_create_mdnsent_flag(imap))
+		{
+			/* request the flags of all messages at once and set $MDNSent only for messages that do not have the flag yet */
+			struct mailimap_set* flag_set = mailimap_set_new_empty();
+			int                  flag_cnt = 0;
+
+			r = mailimap_uid_fetch(imap->etpan, mdn_set, imap->fetch_type_flags, &fetch_result);
+			if (!is_error(imap, r) && fetch_result) {
+				clistiter* cur;
+				for (cur=clist_begin(fetch_result); cur!=NULL; cur=clist_next(cur)) {
+					struct mailimap_msg_att* msg_att = (struct mailimap_msg_att*)clist_content(cur);
+					dc_imap_msgref_t*        ref = find_msgref(refs, ref_cnt, peek_uid(msg_att));
+					if (ref && (ref->ms_flags&DC_MS_SET_MDNSent_FLAG) && (ref->ms_flags&DC_MS_MDNSent_JUST_SET)==0
+					 && !peek_flag_keyword(msg_att, "$MDNSent")) {
+						mailimap_set_add_single(flag_set, ref->server_uid);
+						ref->ms_flags |= DC_MS_MDNSent_JUST_SET;
+						flag_cnt++;
+					}
+				}
+				mailimap_fetch_list_free(fetch_result);
+				fetch_result = NULL;
+			}
+
+			if (flag_cnt > 0
+			 && add_flag_to_set(imap, flag_set, mailimap_flag_new_flag_keyword(dc_strdup("$MDNSent")))==0) {
+				/* the flags are not stored, leave the MDNs to dc_imap_markseen_msg() */
+				for (i = 0; i < ref_cnt; i++) {
+					refs[i].ms_flags &= ~DC_MS_MDNSent_JUST_SET;
+				}
+				flag_cnt = 0;
+			}
+			mailimap_set_free(flag_set);
+
+			dc_log_info(imap->context, 0, "$MDNSent just set for %i of %i messages.", flag_cnt, mdn_cnt);
+		}
+		else
+		{
+			mdn_without_flag = 1; /* the MDNs are requested below if all commands succeed, otherwise dc_imap_markseen_msg() requests them */
+			dc_log_info(imap->context, 0, "Cannot store $MDNSent flags, risk sending duplicate MDN.");
+		}
+	}
+
+	if (move_cnt > 0 && (imap->server_flags&DC_NO_MOVE_TO_CHATS)==0)
+	{
+		init_chat_folders(imap);
+		if (imap->moveto_folder && strcmp(folder, imap->moveto_folder)==0)
+		{
+			dc_log_info(imap->context, 0, "%i messages are already in %s...", move_cnt, imap->moveto_folder);
+			/* see the comment in dc_imap_markseen_msg() */
+		}
+		else if (imap->moveto_folder)
+		{
+			dc_log_info(imap->context, 0, "Moving %i messages from %s to %s...", move_cnt, folder, imap->moveto_folder);
+
+			r = mailimap_uidplus_uid_move(imap->etpan, move_set, imap->moveto_folder, &res_uid, &res_setsrc, &res_setdest);
+			if (is_error(imap, r)) {
+				dc_log_info(imap->context, 0, "Cannot move messages, fallback to COPY/DELETE %s to %s...", folder, imap->moveto_folder);
+				r = mailimap_uidplus_uid_copy(imap->etpan, move_set, imap->moveto_folder, &res_uid, &res_setsrc, &res_setdest);
+				if (is_error(imap, r)) {
+					dc_log_info(imap->context, 0, "Cannot copy messages. Leaving in %s.", folder);
+					goto cleanup;
+				}
+				else {
+					if (add_flag_to_set(imap, move_set, mailimap_flag_new_deleted())==0) {
+						dc_log_warning(imap->context, 0, "Cannot mark messages as \"Deleted\".");
+					}
+
+					/* force an EXPUNGE resp. CLOSE for the selected folder */
+					imap->selected_folder_needs_expunge = 1;
+				}
+			}
+
+			/* COPYUID returns the source and the destination UIDs in the same order,
+			map them back to the messages */
+			*ret_moveto_folder = dc_strdup(imap->moveto_folder);
+			if (res_setsrc && res_setdest) {
+				src_uids = dc_array_new(imap->context, move_cnt);
+				dest_uids = dc_array_new(imap->context, move_cnt);
+				expand_set(res_setsrc, src_uids);
+				expand_set(res_setdest, dest_uids);
+				if (dc_array_get_cnt(src_uids)==dc_array_get_cnt(dest_uids)) {
+					size_t j, cnt = dc_array_get_cnt(src_uids);
+					for (j = 0; j < cnt; j++) {
+						dc_imap_msgref_t* ref = find_msgref(refs, ref_cnt, dc_array_get_id(src_uids, j));
+						if (ref) {
+							ref->new_server_uid = dc_array_get_id(dest_uids, j);
+						}
+					}
+				}
+			}
+
+			dc_log_info(imap->context, 0, "Messages moved.");
+		}
+	}
+
+	done = 1;
+
+cleanup:
+	if (done && !imap->should_reconnect) {
+		for (i = 0; i < ref_cnt; i++) {
+			refs[i].handled = 1;
+			if (mdn_without_flag && (refs[i].ms_flags&DC_MS_SET_MDNSent_FLAG)) {
+				refs[i].ms_flags |= DC_MS_MDNSent_JUST_SET;
+			}
+		}
+	}
+
+	if (fetch_result) { mailimap_fetch_list_free(fetch_result); }
+	if (seen_set) { mailimap_set_free(seen_set); }
+	if (mdn_set) { mailimap_set_free(mdn_set); }
+	if (move_set) { mailimap_set_free(move_set); }
+	if (res_setsrc) { mailimap_set_free(res_setsrc); }
+	if (res_setdest) { mailimap_set_free(res_setdest); }
+	dc_array_unref(src_uids);
+	dc_array_unref(dest_uids);
+}
+
+
+/**
+ * Delete several messages of the same folder using one `UID FETCH` to check
+ * the Message-IDs and one `UID STORE` to set the `\Deleted` flags.
+ * If the server supports UIDPLUS, the messages are expunged using `UID EXPUNGE`
+ * then, otherwise the folder is expunged on the next folder change.
+ *
+ * Only messages where the UID matches the Message-ID are marked as handled;
+ * for the other messages, the caller should use dc_imap_delete_msg() which
+ * searches the message in all folders.
+ *
+ * @private @memberof dc_imap_t
+ * @param imap The IMAP object.
+ * @param folder The folder containing all messages given in refs.
+ * @param refs The messages to delete, dc_imap_msgref_t::rfc724_mid must be set.
+ * @param ref_cnt The number of messages in refs.
+ * @return None.
+ */
+void dc_imap_delete_msgs(dc_imap_t* imap, const char* folder, dc_imap_msgref_t* refs, int ref_cnt)
+{
+	int                  i = 0;
+	int                  r = 0;
+	struct mailimap_set* fetch_set = NULL;
+	int                  fetch_cnt = 0;
+	struct mailimap_set* delete_set = NULL;
+	dc_array_t*          delete_uids = NULL;
+	clist*               fetch_result = NULL;
+	clistiter*           cur = NULL;
+
+	if (imap==NULL || folder==NULL || folder[0]==0 || refs==NULL) {
+		return;
+	}
+
+	for (i = 0; i < ref_cnt; i++) {
+		refs[i].handled = 0;
+	}
+
+	if (imap->etpan==NULL || ref_cnt<=0) {
+		goto cleanup;
+	}
+
+	dc_log_info(imap->context, 0, "Marking %i messages in %s for deletion...", ref_cnt, folder);
+
+	if (select_folder(imap, folder)==0) {
+		dc_log_warning(imap->context, 0, "Cannot select folder \"%s\".", folder);
+		goto cleanup;
+	}
+
+	fetch_set = mailimap_set_new_empty();
+	for (i = 0; i < ref_cnt; i++) {
+		if (refs[i].server_uid && refs[i].rfc724_mid) {
+			mailimap_set_add_single(fetch_set, refs[i].server_uid);
+			fetch_cnt++;
+		}
+	}
+
+	if (fetch_cnt==0) {
+		goto cleanup;
+	}
+
+	/* check if Folder+UID matches the Message-ID, see dc_imap_delete_msg() */
+	r = mailimap_uid_fetch(imap->etpan, fetch_set, imap->fetch_type_message_id, &fetch_result);
+	if (is_error(imap, r) || fetch_result==NULL) {
+		goto cleanup;
+	}
+
+	delete_set = mailimap_set_new_empty();
+	delete_uids = dc_array_new(imap->context, fetch_cnt);
+	for (cur=clist_begin(fetch_result); cur!=NULL; cur=clist_next(cur)) {
+		struct mailimap_msg_att* msg_att = (struct mailimap_msg_att*)clist_content(cur);
+		dc_imap_msgref_t*        ref = find_msgref(refs, ref_cnt, peek_uid(msg_att));
+		const char*              is_quoted_rfc724_mid = peek_rfc724_mid(msg_att);
+		if (ref && ref->rfc724_mid && is_quoted_rfc724_mid
+		 && !dc_array_search_id(delete_uids, ref->server_uid, NULL)) {
+			char* is_rfc724_mid = unquote_rfc724_mid(is_quoted_rfc724_mid);
+			if (is_rfc724_mid && strcmp(is_rfc724_mid, ref->rfc724_mid)==0) {
+				mailimap_set_add_single(delete_set, ref->server_uid);
+				dc_array_add_id(delete_uids, ref->server_uid);
+			}
+			free(is_rfc724_mid);
+		}
+	}
+
+	if (dc_array_get_cnt(delete_uids)==0) {
+		dc_log_warning(imap->context, 0, "UIDs not found in the given folder or do not match Message-IDs.");
+		goto cleanup;
+	}
+
+	if (add_flag_to_set(imap, delete_set, mailimap_flag_new_deleted())==0) {
+		dc_log_warning(imap->context, 0, "Cannot mark messages as \"Deleted\".");
+		goto cleanup;
+	}
+
+	if (mailimap_has_extension(imap->etpan, "UIDPLUS")) {
+		/* expunge only the messages deleted by us */
+		r = mailimap_uid_expunge(imap->etpan, delete_set);
+		if (is_error(imap, r)) {
+			imap->selected_folder_needs_expunge = 1;
+		}
+	}
+	else {
+		/* force an EXPUNGE resp. CLOSE for the selected folder */
+		imap->selected_folder_needs_expunge = 1;
+	}
+
+	if (!imap->should_reconnect) {
+		for (i = 0; i < ref_cnt; i++) {
+			if (dc_array_search_id(delete_uids, refs[i].server_uid, NULL)) {
+				refs[i].handled = 1;
+			}
+		}
+		dc_log_info(imap->context, 0, "%i messages marked for deletion.", (int)dc_array_get_cnt(delete_uids));
+	}
+
+cleanup:
+	if (fetch_result) { mailimap_fetch_list_free(fetch_result); }
+	if (fetch_set) { mailimap_set_free(fetch_set); }
+	if (delete_set) { mailimap_set_free(delete_set); }
+	dc_array_unref(delete_uids);
+}
@@ -19,6 +19,7 @@ typedef void     (*dc_set_config_t)    (dc_imap_t*, const char*, const char*);
 
 #define DC_IMAP_SEEN 0x0001L
 typedef void     (*dc_receive_imf_t)   (dc_imap_t*, const char* imf_raw_not_terminated, size_t imf_raw_bytes, const char* server_folder, uint32_t server_uid, uint32_t flags);
+typedef void     (*dc_receive_flush_t) (dc_imap_t*); /* called after the receive_imf() calls of a fetch batch; the data given to receive_imf() is valid until then */
 
 
 /**
@@ -55,6 +56,7 @@ typedef struct dc_imap_t
 	int                   watch_condflag;
 
 	struct mailimap_fetch_type* fetch_type_uid;
+	struct mailimap_fetch_type* fetch_type_uid_size;
 	struct mailimap_fetch_type* fetch_type_message_id;
 	struct mailimap_fetch_type* fetch_type_body;
 	struct mailimap_fetch_type* fetch_type_flags;
@@ -62,16 +64,29 @@ typedef struct dc_imap_t
 	dc_get_config_t       get_config;
 	dc_set_config_t       set_config;
 	dc_receive_imf_t      receive_imf;
+	dc_receive_flush_t    receive_flush;
 	void*                 userData;
 	dc_context_t*         context;
 
 	int                   log_connect_errors;
 	int                   skip_log_capabilities;
 
+	int                   fetch_batch_max_msgs;  // max. number of message bodies requested by a single `UID FETCH`
+	int                   fetch_batch_max_bytes; // max. sum of RFC822.SIZE requested by a single `UID FETCH`; larger messages are fetched alone
+
 } dc_imap_t;
 
 
-dc_imap_t* dc_imap_new               (dc_get_config_t, dc_set_config_t, dc_receive_imf_t, void* userData, dc_context_t*);
+// defaults for the fetch batches, may be overwritten by the config-keys
+// `imap_fetch_batch_msgs` and `imap_fetch_batch_bytes`
+#define    DC_FETCH_BATCH_MAX_MSGS   50
+#define    DC_FETCH_BATCH_MAX_BYTES  (4*1024*1024)
+
+// if the server does not support IDLE, new messages are checked this often
+#define    DC_FAKE_IDLE_FETCH_SECONDS 60
+
+
+dc_imap_t* dc_imap_new               (dc_get_config_t, dc_set_config_t, dc_receive_imf_t, dc_receive_flush_t, void* userData, dc_context_t*);
 void       dc_imap_unref             (dc_imap_t*);
 
 int        dc_imap_connect           (dc_imap_t*, const dc_loginparam_t*);
@@ -79,7 +94,7 @@ void       dc_imap_disconnect        (dc_imap_t*);
 int        dc_imap_is_connected      (const dc_imap_t*);
 int        dc_imap_fetch             (dc_imap_t*);
 
-void       dc_imap_idle              (dc_imap_t*);
+void       dc_imap_idle              (dc_imap_t*, time_t wakeup_at); /* wakeup_at: the time the next job is due, 0=no jobs */
 void       dc_imap_interrupt_idle    (dc_imap_t*);
 
 int        dc_imap_append_msg        (dc_imap_t*, time_t timestamp, const char* data_not_terminated, size_t data_bytes, char** ret_server_folder, uint32_t* ret_server_uid);
@@ -92,6 +107,26 @@ int        dc_imap_markseen_msg      (dc_imap_t*, const char* folder, uint32_t s
 int        dc_imap_delete_msg        (dc_imap_t*, const char* rfc724_mid, const char* folder, uint32_t server_uid); /* only returns 0 on connection problems; we should try later again in this case */
 
 
+/**
+ * Library-internal.
+ * One message of a pipelined command, see dc_imap_markseen_msgs() and dc_imap_delete_msgs().
+ */
+typedef struct dc_imap_msgref_t
+{
+	/** @privatesection */
+
+	uint32_t    job_id;          // not used by dc_imap_t, may be used by the caller to map the results back
+	char*       rfc724_mid;      // in: Message-ID, needed by dc_imap_delete_msgs(), owned by the caller
+	uint32_t    server_uid;      // in: UID in the folder given to the function
+	int         ms_flags;        // in: DC_MS_ALSO_MOVE, DC_MS_SET_MDNSent_FLAG; out: DC_MS_MDNSent_JUST_SET may be added, also if not handled; the MDN must be sent then
+	uint32_t    new_server_uid;  // out: new UID in the returned moveto-folder, 0 if the message was not moved
+	int         handled;         // out: 1=done for this message, 0=not done, use dc_imap_markseen_msg() or dc_imap_delete_msg() for this message
+} dc_imap_msgref_t;
+
+void       dc_imap_markseen_msgs     (dc_imap_t*, const char* folder, dc_imap_msgref_t* refs, int ref_cnt, char** ret_moveto_folder);
+void       dc_imap_delete_msgs       (dc_imap_t*, const char* folder, dc_imap_msgref_t* refs, int ref_cnt);
+
+
 #ifdef __cplusplus
 } /* /extern "C" */
 #endif
@@ -827,24 +827,62 @@ The macro avoids weird values of 0% or 100% while still working. */
 	context->cb(context, DC_EVENT_IMEX_PROGRESS, permille, 0);
 
 
+#define DC_BACKUP_STEP_PAGES    256   /* pages copied at once by the online backup, other threads may write to the database between the steps */
+#define DC_BACKUP_CHUNK_BYTES 65536   /* files are copied to the backup in chunks of this size */
+
+
+static void bytes_progress(dc_context_t* context, uint64_t processed_bytes, uint64_t total_bytes, int* last_permille)
+{
+	/* like FILE_PROGRESS, but for the bytes processed; the callback is called only if the permille value changes */
+	int permille = total_bytes? (int)((processed_bytes*1000)/total_bytes) : 0;
+	if (permille <  10) { permille =  10; }
+	if (permille > 990) { permille = 990; }
+	if (permille!=*last_permille) {
+		*last_permille = permille;
+		context->cb(context, DC_EVENT_IMEX_PROGRESS, permille, 0);
+	}
+}
+
+
+static int is_blob_to_backup(const char* name)
+{
+	/* name without path; may also be `.` or `..` or an older backup */
+	int name_len = strlen(name);
+	int prefix_len = strlen(DC_BAK_PREFIX);
+	int suffix_len = strlen(DC_BAK_SUFFIX);
+	if ((name_len==1 && name[0]=='.')
+	 || (name_len==2 && name[0]=='.' && name[1]=='.')
+	 || (name_len > prefix_len && strncmp(name, DC_BAK_PREFIX, prefix_len)==0 && name_len > suffix_len && strncmp(&name[name_len-suffix_len-1], "." DC_BAK_SUFFIX, suffix_len)==0)) {
+		return 0;
+	}
+	return 1;
+}
+
+
 static int export_backup(dc_context_t* context, const char* dir)
 {
-	int            success = 0;
-	int            closed = 0;
-	char*          dest_pathNfilename = NULL;
-	dc_sqlite3_t*  dest_sql = NULL;
-	time_t         now = time(NULL);
-	DIR*           dir_handle = NULL;
-	struct dirent* dir_entry = NULL;
-	int            prefix_len = strlen(DC_BAK_PREFIX);
-	int            suffix_len = strlen(DC_BAK_SUFFIX);
-	char*          curr_pathNfilename = NULL;
-	void*          buf = NULL;
-	size_t         buf_bytes = 0;
-	sqlite3_stmt*  stmt = NULL;
-	int            total_files_cnt = 0;
-	int            processed_files_cnt = 0;
-	int            delete_dest_file = 0;
+	int             success = 0;
+	char*           dest_pathNfilename = NULL;
+	int             dest_created = 0;
+	sqlite3*        dest_cobj = NULL;
+	sqlite3_backup* backup = NULL;
+	dc_sqlite3_t*   dest_sql = NULL;
+	int             dest_in_transaction = 0;
+	time_t          now = time(NULL);
+	DIR*            dir_handle = NULL;
+	struct dirent*  dir_entry = NULL;
+	char*           curr_pathNfilename = NULL;
+	FILE*           curr_file = NULL;
+	sqlite3_blob*   blob = NULL;
+	unsigned char*  buf = NULL;
+	sqlite3_stmt*   stmt = NULL;
+	int             rc = 0;
+	uint64_t        page_size = 0;
+	uint64_t        db_bytes = 0;
+	uint64_t        blobs_bytes = 0;
+	uint64_t        processed_bytes = 0;
+	uint64_t        copied_blobs_bytes = 0;
+	int             last_permille = 0;
 
 	/* get a fine backup file name (the name includes the date so that multiple backup instances are possible)
 	FIXME: we should write to a temporary file first and rename it on success. this would guarantee the backup is complete. however, currently it is not clear it the import exists in the long run (may be replaced by a restore-from-imap)*/
@@ -859,19 +897,77 @@ static int export_backup(dc_context_t* context, const char* dir)
 		}
 	}
 
-	/* temporary lock and close the source (we just make a copy of the whole file, this is the fastest and easiest approach) */
-	dc_sqlite3_close(context->sql);
-	closed = 1;
+	/* scan directory, pass 1: collect the number of bytes to copy, used for the progress */
+	if ((dir_handle=opendir(context->blobdir))==NULL) {
+		dc_log_error(context, 0, "Backup: Cannot get info for blob-directory \"%s\".", context->blobdir);
+		goto cleanup;
+	}
 
-		dc_log_info(context, 0, "Backup \"%s\" to \"%s\".", context->dbfile, dest_pathNfilename);
-		if (!dc_copy_file(context, context->dbfile, dest_pathNfilename)) {
-			goto cleanup; /* error already logged */
+	while ((dir_entry=readdir(dir_handle))!=NULL) {
+		if (is_blob_to_backup(dir_entry->d_name)) {
+			free(curr_pathNfilename);
+			curr_pathNfilename = dc_mprintf("%s/%s", context->blobdir, dir_entry->d_name);
+			blobs_bytes += dc_get_filebytes(context, curr_pathNfilename);
 		}
+	}
+
+	closedir(dir_handle);
+	dir_handle = NULL;
 
-	dc_sqlite3_open(context->sql, context->dbfile, 0);
-	closed = 0;
+	/* copy the database using the online backup; the database stays open and usable by other threads.
+	the steps are done without a transaction of the source, a write transaction would make every step fail with SQLITE_BUSY.
+	while another thread sharing the connection is inside a transaction, the step returns SQLITE_BUSY or SQLITE_LOCKED
+	and is retried a little later. the backup is restarted automatically if the database is modified by other connections;
+	modifications done by the source connection between the steps are copied to the backup. */
+	dc_log_info(context, 0, "Backup \"%s\" to \"%s\".", context->dbfile, dest_pathNfilename);
+
+	stmt = dc_sqlite3_prepare(context->sql, "PRAGMA page_size;");
+	if (sqlite3_step(stmt)==SQLITE_ROW) {
+		page_size = sqlite3_column_int64(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	dest_created = 1;
+	if (sqlite3_open_v2(dest_pathNfilename, &dest_cobj, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, NULL)!=SQLITE_OK) {
+		dc_log_error(context, 0, "Cannot create backup \"%s\".", dest_pathNfilename);
+		goto cleanup;
+	}
+
+	if ((backup=sqlite3_backup_init(dest_cobj, "main", context->sql->cobj, "main"))==NULL) {
+		dc_log_error(context, 0, "Cannot start backup: %s", sqlite3_errmsg(dest_cobj));
+		goto cleanup;
+	}
 
-	/* add all files as blobs to the database copy (this does not require the source to be locked, neigher the destination as it is used only here) */
+	do {
+		if (context->shall_stop_ongoing) {
+			goto cleanup;
+		}
+
+		rc = sqlite3_backup_step(backup, DC_BACKUP_STEP_PAGES);
+
+		db_bytes        = (uint64_t)sqlite3_backup_pagecount(backup) * page_size;
+		processed_bytes = (uint64_t)(sqlite3_backup_pagecount(backup)-sqlite3_backup_remaining(backup)) * page_size;
+		bytes_progress(context, processed_bytes, db_bytes+blobs_bytes, &last_permille);
+
+		if (rc==SQLITE_BUSY || rc==SQLITE_LOCKED) {
+			sqlite3_sleep(100);
+		}
+	}
+	while (rc==SQLITE_OK || rc==SQLITE_BUSY || rc==SQLITE_LOCKED);
+
+	if (rc!=SQLITE_DONE) {
+		dc_log_error(context, 0, "Disk full? Cannot copy database to backup: %s", sqlite3_errstr(rc));
+		goto cleanup;
+	}
+
+	sqlite3_backup_finish(backup);
+	backup = NULL;
+	sqlite3_close(dest_cobj);
+	dest_cobj = NULL;
+
+	/* add all files as blobs to the database copy (the destination is used only here);
+	in WAL mode, the backup is switched to a rollback journal when opened so that it consists of a single file. */
 	if ((dest_sql=dc_sqlite3_new(context/*for logging only*/))==NULL
 	 || !dc_sqlite3_open(dest_sql, dest_pathNfilename, 0)) {
 		goto cleanup; /* error already logged */
@@ -883,83 +979,93 @@ static int export_backup(dc_context_t* context, const char* dir)
 		}
 	}
 
-	/* scan directory, pass 1: collect file info */
-	total_files_cnt = 0;
+	/* scan directory, pass 2: copy files; the files are streamed to the blobs so that they need not to fit into memory */
 	if ((dir_handle=opendir(context->blobdir))==NULL) {
-		dc_log_error(context, 0, "Backup: Cannot get info for blob-directory \"%s\".", context->blobdir);
+		dc_log_error(context, 0, "Backup: Cannot copy from blob-directory \"%s\".", context->blobdir);
 		goto cleanup;
 	}
 
-	while ((dir_entry=readdir(dir_handle))!=NULL) {
-		total_files_cnt++;
+	if ((buf=malloc(DC_BACKUP_CHUNK_BYTES))==NULL) {
+		goto cleanup;
 	}
 
-	closedir(dir_handle);
-	dir_handle = NULL;
+	dc_sqlite3_begin_transaction(dest_sql);
+	dest_in_transaction = 1;
 
-	if (total_files_cnt>0)
+	stmt = dc_sqlite3_prepare(dest_sql, "INSERT INTO backup_blobs (file_name, file_content) VALUES (?, ?);");
+	while ((dir_entry=readdir(dir_handle))!=NULL)
 	{
-		/* scan directory, pass 2: copy files */
-		if ((dir_handle=opendir(context->blobdir))==NULL) {
-			dc_log_error(context, 0, "Backup: Cannot copy from blob-directory \"%s\".", context->blobdir);
+		if (context->shall_stop_ongoing) {
 			goto cleanup;
 		}
 
-		stmt = dc_sqlite3_prepare(dest_sql, "INSERT INTO backup_blobs (file_name, file_content) VALUES (?, ?);");
-		while ((dir_entry=readdir(dir_handle))!=NULL)
-		{
-			if (context->shall_stop_ongoing) {
-				delete_dest_file = 1;
-				goto cleanup;
-			}
-
-			FILE_PROGRESS
+		if (!is_blob_to_backup(dir_entry->d_name)) {
+			continue;
+		}
 
-			char* name = dir_entry->d_name; /* name without path; may also be `.` or `..` */
-			int name_len = strlen(name);
-			if ((name_len==1 && name[0]=='.')
-			 || (name_len==2 && name[0]=='.' && name[1]=='.')
-			 || (name_len > prefix_len && strncmp(name, DC_BAK_PREFIX, prefix_len)==0 && name_len > suffix_len && strncmp(&name[name_len-suffix_len-1], "." DC_BAK_SUFFIX, suffix_len)==0)) {
-				//dc_log_info(context, 0, "Backup: Skipping \"%s\".", name);
-				continue;
-			}
+		free(curr_pathNfilename);
+		curr_pathNfilename = dc_mprintf("%s/%s", context->blobdir, dir_entry->d_name);
+		uint64_t file_bytes = dc_get_filebytes(context, curr_pathNfilename);
+		if (file_bytes==0 || file_bytes>0x7FFFFFFF/*the maximum size of sqlite blobs is less*/
+		 || (curr_file=fopen(curr_pathNfilename, "rb"))==NULL) {
+			continue;
+		}
 
-			//dc_log_info(context, 0, "Backup \"%s\".", name);
-			free(curr_pathNfilename);
-			curr_pathNfilename = dc_mprintf("%s/%s", context->blobdir, name);
-			free(buf);
-			if (!dc_read_file(context, curr_pathNfilename, &buf, &buf_bytes) || buf==NULL || buf_bytes<=0) {
-				continue;
+		/* reserve space for the file and write the content in chunks */
+		sqlite3_bind_text(stmt, 1, dir_entry->d_name, -1, SQLITE_STATIC);
+		sqlite3_bind_zeroblob(stmt, 2, (int)file_bytes);
+		if (sqlite3_step(stmt)!=SQLITE_DONE
+		 || sqlite3_blob_open(dest_sql->cobj, "main", "backup_blobs", "file_content", sqlite3_last_insert_rowid(dest_sql->cobj), 1, &blob)!=SQLITE_OK) {
+			dc_log_error(context, 0, "Disk full? Cannot add file \"%s\" to backup.", curr_pathNfilename);
+			goto cleanup; /* this is not recoverable! writing to the sqlite database should work! */
+		}
+		sqlite3_reset(stmt);
+
+		uint64_t copied_bytes = 0;
+		while (copied_bytes < file_bytes) {
+			size_t chunk_bytes = (file_bytes-copied_bytes) < DC_BACKUP_CHUNK_BYTES? (size_t)(file_bytes-copied_bytes) : DC_BACKUP_CHUNK_BYTES;
+			if (fread(buf, 1, chunk_bytes, curr_file)!=chunk_bytes) {
+				dc_log_error(context, 0, "Cannot read \"%s\".", curr_pathNfilename);
+				goto cleanup; /* the file was modified while being copied */
 			}
 
-			sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
-			sqlite3_bind_blob(stmt, 2, buf, buf_bytes, SQLITE_STATIC);
-			if (sqlite3_step(stmt)!=SQLITE_DONE) {
+			if (sqlite3_blob_write(blob, buf, chunk_bytes, copied_bytes)!=SQLITE_OK) {
 				dc_log_error(context, 0, "Disk full? Cannot add file \"%s\" to backup.", curr_pathNfilename);
-				goto cleanup; /* this is not recoverable! writing to the sqlite database should work! */
+				goto cleanup;
 			}
-			sqlite3_reset(stmt);
+
+			copied_bytes += chunk_bytes;
+			bytes_progress(context, db_bytes+copied_blobs_bytes+copied_bytes, db_bytes+blobs_bytes, &last_permille);
 		}
-	}
-	else
-	{
-		dc_log_info(context, 0, "Backup: No files to copy.", context->blobdir);
+		copied_blobs_bytes += file_bytes;
+
+		sqlite3_blob_close(blob);
+		blob = NULL;
+		fclose(curr_file);
+		curr_file = NULL;
 	}
 
 	/* done - set some special config values (do this last to avoid importing crashed backups) */
 	dc_sqlite3_set_config_int(dest_sql, "backup_time", now);
 
+	dc_sqlite3_commit(dest_sql);
+	dest_in_transaction = 0;
+
 	context->cb(context, DC_EVENT_IMEX_FILE_WRITTEN, (uintptr_t)dest_pathNfilename, 0);
 	success = 1;
 
 cleanup:
 	if (dir_handle) { closedir(dir_handle); }
-	if (closed) { dc_sqlite3_open(context->sql, context->dbfile, 0); }
-
+	if (curr_file) { fclose(curr_file); }
+	sqlite3_blob_close(blob);
 	sqlite3_finalize(stmt);
+	sqlite3_backup_finish(backup);
+	sqlite3_close(dest_cobj);
+
+	if (dest_in_transaction) { dc_sqlite3_rollback(dest_sql); }
 	dc_sqlite3_close(dest_sql);
 	dc_sqlite3_unref(dest_sql);
-	if (delete_dest_file) { dc_delete_file(context, dest_pathNfilename); }
+	if (dest_created && !success) { dc_delete_file(context, dest_pathNfilename); }
 	free(dest_pathNfilename);
 
 	free(curr_pathNfilename);
@@ -1121,7 +1227,7 @@ void dc_imex(dc_context_t* context, int what, const char* param1, const char* pa
 	dc_param_set    (param, DC_PARAM_CMD_ARG2, param2);
 
 	dc_job_kill_actions(context, DC_JOB_IMEX_IMAP, 0);
-	dc_job_add(context, DC_JOB_IMEX_IMAP, 0, param->packed, 0); // results in a call to dc_job_do_DC_JOB_IMEX_IMAP()
+	dc_job_add(context, DC_JOB_IMEX_IMAP, 0, dc_param_get_packed(param), 0); // results in a call to dc_job_do_DC_JOB_IMEX_IMAP()
 
 	dc_param_unref(param);
 }
@@ -1,11 +1,15 @@
 #include <stdarg.h>
 #include <unistd.h>
+#include <openssl/rand.h>
 #include "dc_context.h"
 #include "dc_loginparam.h"
 #include "dc_job.h"
+#include "dc_jobqueue.h"
 #include "dc_imap.h"
 #include "dc_smtp.h"
 #include "dc_mimefactory.h"
+#include "dc_objcache.h"
+#include "dc_midfilter.h"
 
 
 /*******************************************************************************
@@ -91,40 +95,10 @@ cleanup:
 }
 
 
-static void dc_job_do_DC_JOB_DELETE_MSG_ON_IMAP(dc_context_t* context, dc_job_t* job)
+static void delete_msg_locally(dc_context_t* context, const dc_msg_t* msg)
 {
-	int           delete_from_server = 1;
-	dc_msg_t*     msg = dc_msg_new_untyped(context);
 	sqlite3_stmt* stmt = NULL;
 
-	if (!dc_msg_load_from_db(msg, context, job->foreign_id)
-	 || msg->rfc724_mid==NULL || msg->rfc724_mid[0]==0 /* eg. device messages have no Message-ID */) {
-		goto cleanup;
-	}
-
-	if (dc_rfc724_mid_cnt(context, msg->rfc724_mid)!=1) {
-		dc_log_info(context, 0, "The message is deleted from the server when all parts are deleted.");
-		delete_from_server = 0;
-	}
-
-	/* if this is the last existing part of the message, we delete the message from the server */
-	if (delete_from_server)
-	{
-		if (!dc_imap_is_connected(context->imap)) {
-			connect_to_imap(context, NULL);
-			if (!dc_imap_is_connected(context->imap)) {
-				dc_job_try_again_later(job, DC_STANDARD_DELAY, NULL);
-				goto cleanup;
-			}
-		}
-
-		if (!dc_imap_delete_msg(context->imap, msg->rfc724_mid, msg->server_folder, msg->server_uid))
-		{
-			dc_job_try_again_later(job, DC_AT_ONCE, NULL);
-			goto cleanup;
-		}
-	}
-
 	/* we delete the database entry ...
 	- if the message is successfully removed from the server
 	- or if there are other parts of the message in the database (in this case we have not deleted if from the server)
@@ -135,6 +109,11 @@ static void dc_job_do_DC_JOB_DELETE_MSG_ON_IMAP(dc_context_t* context, dc_job_t*
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
 	stmt = NULL;
+	dc_midfilter_removed(context->mid_filter, 1);
+
+	dc_recalc_chat_last_msg(context, msg->chat_id);
+	dc_update_msg_fts(context, msg->id, NULL);
+	dc_objcache_remove(context->msg_cache, msg->id);
 
 	stmt = dc_sqlite3_prepare(context->sql,
 		"DELETE FROM msgs_mdns WHERE msg_id=?;");
@@ -181,13 +160,67 @@ static void dc_job_do_DC_JOB_DELETE_MSG_ON_IMAP(dc_context_t* context, dc_job_t*
 		}
 		free(pathNfilename);
 	}
+}
+
+
+static void dc_job_do_DC_JOB_DELETE_MSG_ON_IMAP(dc_context_t* context, dc_job_t* job)
+{
+	int           delete_from_server = 1;
+	dc_msg_t*     msg = dc_msg_new_untyped(context);
+
+	if (!dc_msg_load_from_db(msg, context, job->foreign_id)
+	 || msg->rfc724_mid==NULL || msg->rfc724_mid[0]==0 /* eg. device messages have no Message-ID */) {
+		goto cleanup;
+	}
+
+	if (dc_rfc724_mid_cnt(context, msg->rfc724_mid)!=1) {
+		dc_log_info(context, 0, "The message is deleted from the server when all parts are deleted.");
+		delete_from_server = 0;
+	}
+
+	/* if this is the last existing part of the message, we delete the message from the server */
+	if (delete_from_server)
+	{
+		if (!dc_imap_is_connected(context->imap)) {
+			connect_to_imap(context, NULL);
+			if (!dc_imap_is_connected(context->imap)) {
+				dc_job_try_again_later(job, DC_STANDARD_DELAY, NULL);
+				goto cleanup;
+			}
+		}
+
+		if (!dc_imap_delete_msg(context->imap, msg->rfc724_mid, msg->server_folder, msg->server_uid))
+		{
+			dc_job_try_again_later(job, DC_AT_ONCE, NULL);
+			goto cleanup;
+		}
+	}
+
+	delete_msg_locally(context, msg);
 
 cleanup:
-	sqlite3_finalize(stmt);
 	dc_msg_unref(msg);
 }
 
 
+static int get_markseen_flags(dc_context_t* context, const dc_msg_t* msg)
+{
+	int ms_flags = 0;
+
+	/* add an additional job for sending the MDN (here in a thread for fast ui resonses) (an extra job as the MDN has a lower priority) */
+	if (dc_param_get_int(msg->param, DC_PARAM_WANTS_MDN, 0) /* DC_PARAM_WANTS_MDN is set only for one part of a multipart-message */
+	 && dc_sqlite3_get_config_int(context->sql, "mdns_enabled", DC_MDNS_DEFAULT_ENABLED)) {
+		ms_flags |= DC_MS_SET_MDNSent_FLAG;
+	}
+
+	if (msg->is_msgrmsg) {
+		ms_flags |= DC_MS_ALSO_MOVE;
+	}
+
+	return ms_flags;
+}
+
+
 static void dc_job_do_DC_JOB_MARKSEEN_MSG_ON_IMAP(dc_context_t* context, dc_job_t* job)
 {
 	dc_msg_t* msg = dc_msg_new_untyped(context);
@@ -208,30 +241,22 @@ static void dc_job_do_DC_JOB_MARKSEEN_MSG_ON_IMAP(dc_context_t* context, dc_job_
 		goto cleanup;
 	}
 
-	/* add an additional job for sending the MDN (here in a thread for fast ui resonses) (an extra job as the MDN has a lower priority) */
-	if (dc_param_get_int(msg->param, DC_PARAM_WANTS_MDN, 0) /* DC_PARAM_WANTS_MDN is set only for one part of a multipart-message */
-	 && dc_sqlite3_get_config_int(context->sql, "mdns_enabled", DC_MDNS_DEFAULT_ENABLED)) {
-		in_ms_flags |= DC_MS_SET_MDNSent_FLAG;
-	}
+	in_ms_flags = get_markseen_flags(context, msg);
 
-	if (msg->is_msgrmsg) {
-		in_ms_flags |= DC_MS_ALSO_MOVE;
+	int ok = dc_imap_markseen_msg(context->imap, msg->server_folder, msg->server_uid,
+		in_ms_flags, &new_server_folder, &new_server_uid, &out_ms_flags);
+
+	/* once $MDNSent is set, the MDN must be sent even if moving fails; the next try would find the flag */
+	if (out_ms_flags&DC_MS_MDNSent_JUST_SET)
+	{
+		dc_job_add(context, DC_JOB_SEND_MDN, msg->id, NULL, 0);
 	}
 
-	if (dc_imap_markseen_msg(context->imap, msg->server_folder, msg->server_uid,
-		   in_ms_flags, &new_server_folder, &new_server_uid, &out_ms_flags)!=0)
+	if (ok)
 	{
-		if ((new_server_folder && new_server_uid) || out_ms_flags&DC_MS_MDNSent_JUST_SET)
+		if (new_server_folder && new_server_uid)
 		{
-			if (new_server_folder && new_server_uid)
-			{
-				dc_update_server_uid(context, msg->rfc724_mid, new_server_folder, new_server_uid);
-			}
-
-			if (out_ms_flags&DC_MS_MDNSent_JUST_SET)
-			{
-				dc_job_add(context, DC_JOB_SEND_MDN, msg->id, NULL, 0);
-			}
+			dc_update_server_uid(context, msg->rfc724_mid, new_server_folder, new_server_uid);
 		}
 	}
 	else
@@ -271,25 +296,63 @@ cleanup:
 }
 
 
+static void dc_job_do_DC_JOB_FTS_BACKFILL(dc_context_t* context, dc_job_t* job)
+{
+	/* one chunk per call, so fetching and the other jobs are not blocked until all messages are indexed */
+	if (dc_sqlite3_fts_backfill(context->sql)) {
+		dc_job_try_again_later(job, DC_CONTINUE_NEXT_CALL, NULL);
+	}
+}
+
+
 /*******************************************************************************
  * SMTP-jobs
  ******************************************************************************/
 
 
-static void dc_job_do_DC_JOB_SEND_MSG_TO_SMTP(dc_context_t* context, dc_job_t* job)
+static int get_smtp_error_class(int error_etpan)
+{
+	switch (error_etpan) {
+		case MAILSMTP_ERROR_EXCEED_STORAGE_ALLOCATION:
+			return DC_JOB_ERR_PERMANENT;
+
+		case MAILSMTP_ERROR_SERVICE_NOT_AVAILABLE:
+		case MAILSMTP_ERROR_ACTION_NOT_TAKEN:
+		case MAILSMTP_ERROR_IN_PROCESSING:
+		case MAILSMTP_ERROR_INSUFFICIENT_SYSTEM_STORAGE:
+			return DC_JOB_ERR_QUOTA; /* 4xx codes, the server is busy or out of resources */
+
+		case MAILSMTP_ERROR_AUTH_NOT_SUPPORTED:
+		case MAILSMTP_ERROR_AUTH_LOGIN:
+		case MAILSMTP_ERROR_AUTH_REQUIRED:
+		case MAILSMTP_ERROR_AUTH_TOO_WEAK:
+		case MAILSMTP_ERROR_AUTH_TRANSITION_NEEDED:
+		case MAILSMTP_ERROR_AUTH_TEMPORARY_FAILTURE:
+		case MAILSMTP_ERROR_AUTH_ENCRYPTION_REQUIRED:
+		case MAILSMTP_ERROR_AUTH_AUTHENTICATION_FAILED:
+			return DC_JOB_ERR_AUTH;
+
+		default:
+			return DC_JOB_ERR_NETWORK;
+	}
+}
+
+
+static void dc_job_do_DC_JOB_SEND_MSG_TO_SMTP(dc_context_t* context, dc_smtp_t* smtp, dc_job_t* job)
 {
 	char*            pathNfilename = NULL;
 	dc_mimefactory_t mimefactory;
 	dc_mimefactory_init(&mimefactory, context);
 
-	/* connect to SMTP server, if not yet done */
-	if (!dc_smtp_is_connected(context->smtp)) {
+	/* connect to SMTP server, if not yet done; the connection may be one of the SMTP-pool */
+	if (!dc_smtp_is_connected(smtp)) {
 		dc_loginparam_t* loginparam = dc_loginparam_new();
 			dc_loginparam_read(loginparam, context->sql, "configured_");
-			int connected = dc_smtp_connect(context->smtp, loginparam);
+			int connected = dc_smtp_connect(smtp, loginparam);
 		dc_loginparam_unref(loginparam);
 		if (!connected) {
 			dc_job_try_again_later(job, DC_STANDARD_DELAY, NULL);
+			dc_job_set_error_class(job, get_smtp_error_class(smtp->error_etpan));
 			goto cleanup;
 		}
 	}
@@ -344,14 +407,15 @@ static void dc_job_do_DC_JOB_SEND_MSG_TO_SMTP(dc_context_t* context, dc_job_t* j
 			goto cleanup; /* unrecoverable */
 		}
 
-		if (!dc_smtp_send_msg(context->smtp, mimefactory.recipients_addr, mimefactory.out->str, mimefactory.out->len)) {
-			if (MAILSMTP_ERROR_EXCEED_STORAGE_ALLOCATION==context->smtp->error_etpan
-			 || MAILSMTP_ERROR_INSUFFICIENT_SYSTEM_STORAGE==context->smtp->error_etpan) {
-				dc_set_msg_failed(context, job->foreign_id, context->smtp->error);
+		if (!dc_smtp_send_msg(smtp, mimefactory.recipients_addr, mimefactory.out->str, mimefactory.out->len)) {
+			int error_class = get_smtp_error_class(smtp->error_etpan);
+			if (error_class==DC_JOB_ERR_PERMANENT) {
+				dc_set_msg_failed(context, job->foreign_id, smtp->error);
 			}
 			else {
-				dc_smtp_disconnect(context->smtp);
-				dc_job_try_again_later(job, DC_AT_ONCE, context->smtp->error);
+				dc_smtp_disconnect(smtp);
+				dc_job_try_again_later(job, error_class==DC_JOB_ERR_NETWORK? DC_AT_ONCE : DC_STANDARD_DELAY, smtp->error);
+				dc_job_set_error_class(job, error_class);
 			}
 			goto cleanup;
 		}
@@ -403,6 +467,7 @@ static void dc_job_do_DC_JOB_SEND_MDN(dc_context_t* context, dc_job_t* job)
 		dc_loginparam_unref(loginparam);
 		if (!connected) {
 			dc_job_try_again_later(job, DC_STANDARD_DELAY, NULL);
+			dc_job_set_error_class(job, get_smtp_error_class(context->smtp->error_etpan));
 			goto cleanup;
 		}
 	}
@@ -415,8 +480,10 @@ static void dc_job_do_DC_JOB_SEND_MDN(dc_context_t* context, dc_job_t* job)
 	//char* t1=dc_null_terminate(mimefactory.out->str,mimefactory.out->len);printf("~~~~~MDN~~~~~\n%s\n~~~~~/MDN~~~~~",t1);free(t1); // DEBUG OUTPUT
 
 	if (!dc_smtp_send_msg(context->smtp, mimefactory.recipients_addr, mimefactory.out->str, mimefactory.out->len)) {
+		int error_class = get_smtp_error_class(context->smtp->error_etpan);
 		dc_smtp_disconnect(context->smtp);
-		dc_job_try_again_later(job, DC_AT_ONCE, NULL);
+		dc_job_try_again_later(job, error_class==DC_JOB_ERR_NETWORK? DC_AT_ONCE : DC_STANDARD_DELAY, NULL);
+		dc_job_set_error_class(job, error_class);
 		goto cleanup;
 	}
 
@@ -429,6 +496,11 @@ static void dc_suspend_smtp_thread(dc_context_t* context, int suspend)
 {
 	pthread_mutex_lock(&context->smtpidle_condmutex);
 		context->smtp_suspended = suspend;
+		if (!suspend) {
+			// the smtp-thread may wait for an interrupt, let it check for due jobs
+			context->smtpidle_condflag = 1;
+			pthread_cond_signal(&context->smtpidle_cond);
+		}
 	pthread_mutex_unlock(&context->smtpidle_condmutex);
 
 	// if the smtp-thread is currently in dc_perform_smtp_jobs(),
@@ -455,11 +527,44 @@ static void dc_suspend_smtp_thread(dc_context_t* context, int suspend)
  ******************************************************************************/
 
 
+static void interrupt_imap_idle(dc_context_t* context)
+{
+	/* wake up the IMAP-thread, unlike dc_interrupt_imap_idle(), jobs waiting for a retry keep their time */
+	dc_log_info(context, 0, "Interrupting IMAP-IDLE...");
+
+	pthread_mutex_lock(&context->imapidle_condmutex);
+		// when this function is called, it might be that the idle-thread is in
+		// perform_idle_jobs() instead of idle(). if so, added jobs will be performed after the _next_ idle-jobs loop.
+		// setting the flag perform_imap_jobs_needed makes sure, idle() returns immediately in this case.
+		context->perform_imap_jobs_needed = 1;
+	pthread_mutex_unlock(&context->imapidle_condmutex);
+
+	dc_imap_interrupt_idle(context->imap);
+}
+
+
+static void interrupt_smtp_idle(dc_context_t* context)
+{
+	/* wake up the SMTP-thread, unlike dc_interrupt_smtp_idle(), jobs waiting for a retry keep their time */
+	dc_log_info(context, 0, "Interrupting SMTP-idle...");
+
+	pthread_mutex_lock(&context->smtpidle_condmutex);
+
+		// when this function is called, it might be that the smtp-thread is in
+		// perform_smtp_jobs(). if so, added jobs will be performed after the _next_ idle-jobs loop.
+		// setting the flag perform_smtp_jobs_needed makes sure, idle() returns immediately in this case.
+		context->perform_smtp_jobs_needed = DC_JOBS_NEEDED_AT_ONCE;
+
+		context->smtpidle_condflag = 1;
+		pthread_cond_signal(&context->smtpidle_cond);
+
+	pthread_mutex_unlock(&context->smtpidle_condmutex);
+}
+
+
 void dc_job_add(dc_context_t* context, int action, int foreign_id, const char* param, int delay_seconds)
 {
-	time_t        timestamp = time(NULL);
-	sqlite3_stmt* stmt = NULL;
-	int           thread = 0;
+	int thread = 0;
 
 	if (action >= DC_IMAP_THREAD && action < DC_IMAP_THREAD+1000) {
 		thread = DC_IMAP_THREAD;
@@ -471,32 +576,24 @@ void dc_job_add(dc_context_t* context, int action, int foreign_id, const char* p
 		return;
 	}
 
-	stmt = dc_sqlite3_prepare(context->sql,
-		"INSERT INTO jobs (added_timestamp, thread, action, foreign_id, param, desired_timestamp) VALUES (?,?,?,?,?,?);");
-	sqlite3_bind_int64(stmt, 1, timestamp);
-	sqlite3_bind_int  (stmt, 2, thread);
-	sqlite3_bind_int  (stmt, 3, action);
-	sqlite3_bind_int  (stmt, 4, foreign_id);
-	sqlite3_bind_text (stmt, 5, param? param : "",  -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 6, delay_seconds>0? (timestamp+delay_seconds) : 0);
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	dc_jobqueue_add(context->jobqueue, thread, action, foreign_id, param, delay_seconds>0? (time(NULL)+delay_seconds) : 0);
 
 	if (thread==DC_IMAP_THREAD) {
-		dc_interrupt_imap_idle(context);
+		interrupt_imap_idle(context);
 	}
 	else {
-		dc_interrupt_smtp_idle(context);
+		interrupt_smtp_idle(context);
 	}
 }
 
 
-static void dc_job_update(dc_context_t* context, const dc_job_t* job)
+static void dc_job_update(dc_context_t* context, const dc_job_t* job, time_t desired_timestamp)
 {
 	sqlite3_stmt* update_stmt = dc_sqlite3_prepare(context->sql,
-		"UPDATE jobs SET desired_timestamp=0, param=? WHERE id=?;");
-	sqlite3_bind_text (update_stmt, 1, job->param->packed, -1, SQLITE_STATIC);
-	sqlite3_bind_int  (update_stmt, 2, job->job_id);
+		"UPDATE jobs SET desired_timestamp=?, param=? WHERE id=?;");
+	sqlite3_bind_int64(update_stmt, 1, desired_timestamp);
+	sqlite3_bind_text (update_stmt, 2, dc_param_get_packed(job->param), -1, SQLITE_STATIC);
+	sqlite3_bind_int  (update_stmt, 3, job->job_id);
 	sqlite3_step(update_stmt);
 	sqlite3_finalize(update_stmt);
 }
@@ -525,6 +622,16 @@ void dc_job_try_again_later(dc_job_t* job, int try_again, const char* pending_er
 }
 
 
+void dc_job_set_error_class(dc_job_t* job, int error_class)
+{
+	if (job==NULL) {
+		return;
+	}
+
+	job->error_class = error_class;
+}
+
+
 void dc_job_kill_actions(dc_context_t* context, int action1, int action2)
 {
 	if (context==NULL) {
@@ -537,33 +644,592 @@ void dc_job_kill_actions(dc_context_t* context, int action1, int action2)
 	sqlite3_bind_int(stmt, 2, action2);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+
+	dc_jobqueue_remove_actions(context->jobqueue, action1, action2);
 }
 
 
+/* Retry policies: a failed job is tried again after base_sec, each further retry doubles the delay up to max_sec.
+The delay is randomized by up to 50% so that clients hitting an overloaded server do not come back in lockstep.
+The first matching row is used, action 0 matches all actions; the config-keys job_retry_* overwrite the rows of their error class. */
+typedef struct dc_retry_policy_t
+{
+	int action;
+	int error_class;
+	int base_sec;
+	int max_sec;
+	int max_tries;
+} dc_retry_policy_t;
+
+
+static const dc_retry_policy_t retry_policies[] = {
+	{ DC_JOB_SEND_MSG_TO_SMTP, DC_JOB_ERR_NETWORK,  2,  5*60, 3 }, /* the user waits for the message to be sent */
+	{ 0,                       DC_JOB_ERR_NETWORK,  5, 10*60, 3 },
+	{ 0,                       DC_JOB_ERR_AUTH,    60, 60*60, 3 },
+	{ 0,                       DC_JOB_ERR_QUOTA,   30, 60*60, 5 },
+	{ 0,                       DC_JOB_ERR_PERMANENT, 0,    0, 0 }
+};
+
+
+static void get_retry_policy(dc_context_t* context, int action, int error_class, dc_retry_policy_t* ret_policy)
+{
+	static const char* policy_keys[] = { "job_retry_network", "job_retry_auth", "job_retry_quota" };
+	int                i = 0;
+	char*              value = NULL;
+	int                base_sec = 0, max_sec = 0, max_tries = 0;
+
+	memset(ret_policy, 0, sizeof(dc_retry_policy_t));
+	ret_policy->error_class = DC_JOB_ERR_PERMANENT;
+
+	for (i = 0; i < (int)(sizeof(retry_policies)/sizeof(retry_policies[0])); i++) {
+		if ((retry_policies[i].action==action || retry_policies[i].action==0)
+		 && retry_policies[i].error_class==error_class) {
+			*ret_policy = retry_policies[i];
+			break;
+		}
+	}
+
+	if (error_class>=0 && error_class < (int)(sizeof(policy_keys)/sizeof(policy_keys[0]))
+	 && (value=dc_sqlite3_get_config(context->sql, policy_keys[error_class], NULL))!=NULL) {
+		if (sscanf(value, "%i,%i,%i", &base_sec, &max_sec, &max_tries)==3 && base_sec>=0 && max_sec>=base_sec && max_tries>=0) {
+			ret_policy->base_sec  = base_sec;
+			ret_policy->max_sec   = max_sec;
+			ret_policy->max_tries = max_tries;
+		}
+		else {
+			dc_log_warning(context, 0, "Bad value \"%s\" for %s, using defaults.", value, policy_keys[error_class]);
+		}
+		free(value);
+	}
+}
+
+
+static time_t get_retry_delay(const dc_retry_policy_t* policy, int tries)
+{
+	/* exponential backoff with "equal jitter": between the half and the full delay */
+	time_t   delay = policy->base_sec;
+	uint32_t random_val = 0;
+
+	for (int i = 1; i < tries && delay < policy->max_sec; i++) {
+		delay *= 2;
+	}
+	delay = DC_MIN(delay, policy->max_sec);
+
+	if (delay >= 2) {
+		RAND_bytes((unsigned char*)&random_val, sizeof(random_val));
+		delay = delay/2 + (time_t)(random_val % (uint32_t)(delay/2 + 1));
+	}
+
+	return delay;
+}
+
+
+/* Get the randomized delay before the next try of a job that failed `tries` times,
+-1 is returned if the retry policy of the action and the error class does not allow more tries. */
+time_t dc_job_get_retry_delay(dc_context_t* context, int action, int error_class, int tries)
+{
+	dc_retry_policy_t policy;
+	get_retry_policy(context, action, error_class, &policy);
+
+	if (tries >= policy.max_tries) {
+		return -1;
+	}
+
+	return get_retry_delay(&policy, DC_MAX(tries, 1));
+}
+
+
+/* Pipeline all due DC_JOB_MARKSEEN_MSG_ON_IMAP resp. DC_JOB_DELETE_MSG_ON_IMAP jobs:
+the messages are grouped by folder and each group is handled by a few commands
+using UID sets instead of some commands per message.
+Jobs handled this way are deleted; all other jobs are put back to the queue
+and are done by the normal per-job functions which also do the error handling. */
+static void perform_imap_batch(dc_context_t* context, int action)
+{
+	#define              IMAP_BATCH_MAX 500
+	dc_jobqueue_entry_t* entries = NULL;
+	int                  entry_cnt = 0;
+	dc_msg_t**           msgs = NULL;
+	int*                 msg_entry = NULL;
+	dc_imap_msgref_t*    refs = NULL;
+	int*                 folder_done = NULL;
+	dc_imap_msgref_t*    group = NULL;
+	int*                 group_idx = NULL;
+	int                  cnt = 0;
+	int                  handled_cnt = 0;
+	int                  i = 0, j = 0;
+	dc_job_t             done_job;
+
+	memset(&done_job, 0, sizeof(dc_job_t));
+
+	if (!dc_imap_is_connected(context->imap)) {
+		connect_to_imap(context, NULL);
+		if (!dc_imap_is_connected(context->imap)) {
+			goto cleanup;
+		}
+	}
+
+	entries   = calloc(IMAP_BATCH_MAX, sizeof(dc_jobqueue_entry_t));
+	msgs      = calloc(IMAP_BATCH_MAX, sizeof(dc_msg_t*));
+	msg_entry = calloc(IMAP_BATCH_MAX, sizeof(int));
+	refs      = calloc(IMAP_BATCH_MAX, sizeof(dc_imap_msgref_t));
+	if (entries==NULL || msgs==NULL || msg_entry==NULL || refs==NULL) {
+		goto cleanup;
+	}
+
+	entry_cnt = dc_jobqueue_pop_due_action(context->jobqueue, DC_IMAP_THREAD, action, time(NULL), entries, IMAP_BATCH_MAX);
+	for (i = 0; i < entry_cnt; i++)
+	{
+		dc_msg_t* msg = dc_msg_new_untyped(context);
+		if (!dc_msg_load_from_db(msg, context, entries[i].foreign_id)
+		 || msg->server_folder==NULL || msg->server_folder[0]==0 || msg->server_uid==0
+		 || (action==DC_JOB_DELETE_MSG_ON_IMAP && (msg->rfc724_mid==NULL || msg->rfc724_mid[0]==0
+		                                       || dc_rfc724_mid_cnt(context, msg->rfc724_mid)!=1))) {
+			dc_msg_unref(msg); /* special cases are left to the per-job functions */
+			continue;
+		}
+
+		msgs[cnt] = msg;
+		msg_entry[cnt] = i;
+		refs[cnt].job_id     = entries[i].job_id;
+		refs[cnt].rfc724_mid = msg->rfc724_mid;
+		refs[cnt].server_uid = msg->server_uid;
+		refs[cnt].ms_flags   = action==DC_JOB_MARKSEEN_MSG_ON_IMAP? get_markseen_flags(context, msg) : 0;
+		cnt++;
+	}
+
+	if (cnt < 2) {
+		goto cleanup; /* nothing to pipeline */
+	}
+
+	folder_done = calloc(cnt, sizeof(int));
+	group       = calloc(cnt, sizeof(dc_imap_msgref_t));
+	group_idx   = calloc(cnt, sizeof(int));
+	if (folder_done==NULL || group==NULL || group_idx==NULL) {
+		goto cleanup;
+	}
+
+	for (i = 0; i < cnt; i++)
+	{
+		const char* folder = msgs[i]->server_folder;
+		char*       moveto_folder = NULL;
+		int         group_cnt = 0;
+
+		if (folder_done[i]) {
+			continue;
+		}
+
+		for (j = i; j < cnt; j++) {
+			if (!folder_done[j] && strcmp(msgs[j]->server_folder, folder)==0) {
+				folder_done[j] = 1;
+				group[group_cnt] = refs[j];
+				group_idx[group_cnt] = j;
+				group_cnt++;
+			}
+		}
+
+		if (action==DC_JOB_MARKSEEN_MSG_ON_IMAP) {
+			dc_imap_markseen_msgs(context->imap, folder, group, group_cnt, &moveto_folder);
+		}
+		else {
+			dc_imap_delete_msgs(context->imap, folder, group, group_cnt);
+		}
+
+		for (j = 0; j < group_cnt; j++)
+		{
+			dc_msg_t*            msg = msgs[group_idx[j]];
+			dc_jobqueue_entry_t* entry = &entries[msg_entry[group_idx[j]]];
+
+			/* $MDNSent may be set even if a later command failed and the job is left to the per-job function;
+			that would find the flag and would not request the MDN again */
+			if (action==DC_JOB_MARKSEEN_MSG_ON_IMAP && (group[j].ms_flags&DC_MS_MDNSent_JUST_SET)) {
+				dc_job_add(context, DC_JOB_SEND_MDN, msg->id, NULL, 0);
+			}
+
+			if (!group[j].handled) {
+				continue;
+			}
+
+			if (action==DC_JOB_MARKSEEN_MSG_ON_IMAP) {
+				if (moveto_folder && group[j].new_server_uid) {
+					dc_update_server_uid(context, msg->rfc724_mid, moveto_folder, group[j].new_server_uid);
+				}
+			}
+			else {
+				delete_msg_locally(context, msg);
+			}
+
+			done_job.job_id = entry->job_id;
+			dc_job_delete(context, &done_job);
+			entry->job_id = 0; /* mark as done */
+			handled_cnt++;
+		}
+
+		free(moveto_folder);
+	}
+
+	dc_log_info(context, 0, "%i of %i IMAP-jobs, action %i, pipelined.", handled_cnt, entry_cnt, action);
+
+cleanup:
+	for (i = 0; i < entry_cnt; i++) {
+		if (entries[i].job_id) {
+			dc_jobqueue_push(context->jobqueue, DC_IMAP_THREAD, &entries[i]);
+		}
+		free(entries[i].param);
+	}
+	for (i = 0; i < cnt; i++) {
+		dc_msg_unref(msgs[i]);
+	}
+	free(entries);
+	free(msgs);
+	free(msg_entry);
+	free(refs);
+	free(folder_done);
+	free(group);
+	free(group_idx);
+}
+
+
+#define THREAD_STR (thread==DC_IMAP_THREAD? "IMAP" : "SMTP")
+
+
+static void run_job(dc_context_t* context, dc_smtp_t* smtp, dc_job_t* job)
+{
+	for (int tries = 0; tries <= 1; tries++)
+	{
+		job->try_again = DC_DONT_TRY_AGAIN; // this can be modified by a job using dc_job_try_again_later()
+		job->error_class = DC_JOB_ERR_NETWORK; // this can be modified by a job using dc_job_set_error_class()
+
+		switch (job->action) {
+			case DC_JOB_SEND_MSG_TO_SMTP:     dc_job_do_DC_JOB_SEND_MSG_TO_SMTP     (context, smtp, job); break;
+			case DC_JOB_SEND_MSG_TO_IMAP:     dc_job_do_DC_JOB_SEND_MSG_TO_IMAP     (context, job); break;
+			case DC_JOB_DELETE_MSG_ON_IMAP:   dc_job_do_DC_JOB_DELETE_MSG_ON_IMAP   (context, job); break;
+			case DC_JOB_MARKSEEN_MSG_ON_IMAP: dc_job_do_DC_JOB_MARKSEEN_MSG_ON_IMAP (context, job); break;
+			case DC_JOB_MARKSEEN_MDN_ON_IMAP: dc_job_do_DC_JOB_MARKSEEN_MDN_ON_IMAP (context, job); break;
+			case DC_JOB_SEND_MDN:             dc_job_do_DC_JOB_SEND_MDN             (context, job); break;
+			case DC_JOB_CONFIGURE_IMAP:       dc_job_do_DC_JOB_CONFIGURE_IMAP       (context, job); break;
+			case DC_JOB_IMEX_IMAP:            dc_job_do_DC_JOB_IMEX_IMAP            (context, job); break;
+			case DC_JOB_FTS_BACKFILL:         dc_job_do_DC_JOB_FTS_BACKFILL         (context, job); break;
+		}
+
+		if (job->try_again!=DC_AT_ONCE) {
+			break;
+		}
+	}
+}
+
+
+/* Delete the job or schedule it for a retry after run_job().
+Returns 1 if the entry was updated and must be put back to the queue, 0 if the job is deleted. */
+static int finish_job(dc_context_t* context, int thread, dc_job_t* job, dc_jobqueue_entry_t* entry)
+{
+	if (job->try_again==DC_CONTINUE_NEXT_CALL)
+	{
+		// put back to the queue as being due, the job is done again after the other thread functions had their turn
+		entry->desired_timestamp = time(NULL);
+		return 1;
+	}
+	else if (job->try_again==DC_INCREATION_POLL)
+	{
+		// just try over next loop unconditionally, the ui typically interrupts idle when the file (video) is ready
+		dc_log_info(context, 0, "%s-job #%i not yet ready and will be delayed.", THREAD_STR, (int)job->job_id);
+		entry->desired_timestamp = time(NULL) + (thread==DC_IMAP_THREAD? DC_IMAP_RETRY_SEC : DC_SMTP_RETRY_SEC);
+		entry->is_retry = 1;
+		return 1;
+	}
+	else if (job->try_again==DC_AT_ONCE || job->try_again==DC_STANDARD_DELAY)
+	{
+		// Each retry may result in 2 tries (for fast network-failure-recover).
+		// Network errors while offline do not count as failed tries.
+		int    counts = (job->error_class!=DC_JOB_ERR_NETWORK || dc_is_online(context))? 1 : 0;
+		int    tries = dc_param_get_int(job->param, DC_PARAM_TIMES, 0) + counts;
+		time_t delay = dc_job_get_retry_delay(context, job->action, job->error_class, tries);
+
+		if (delay >= 0) {
+			dc_param_set_int(job->param, DC_PARAM_TIMES, tries);
+			free(entry->param);
+			entry->param             = dc_strdup(dc_param_get_packed(job->param));
+			entry->desired_timestamp = time(NULL) + delay;
+			entry->is_retry          = 1;
+			dc_job_update(context, job, entry->desired_timestamp);
+			dc_log_info(context, 0, "%s-job #%i not succeeded on try #%i, error class %i, retry in %i seconds.", THREAD_STR, (int)job->job_id, tries, job->error_class, (int)delay);
+			return 1;
+		}
+		else {
+			if (job->action==DC_JOB_SEND_MSG_TO_SMTP) { // in all other cases, the messages is already sent
+				dc_set_msg_failed(context, job->foreign_id, job->pending_error);
+			}
+			dc_job_delete(context, job);
+		}
+	}
+	else
+	{
+		dc_job_delete(context, job);
+	}
+
+	return 0;
+}
+
+
+/*******************************************************************************
+ * SMTP-pool
+ ******************************************************************************/
+
+
+/* If the config-key `smtp_pool_size` is larger than 1, due DC_JOB_SEND_MSG_TO_SMTP jobs are sent
+over several SMTP connections in parallel. The jobs are grouped to one lane per chat,
+a lane is always sent by one connection in the order the jobs were added, so the order in a chat is kept.
+The threads live only while the jobs are sent, the connections are kept open for the next call. */
+typedef struct dc_smtp_lane_t
+{
+	uint32_t             chat_id;
+	dc_jobqueue_entry_t  entry;
+	int                  requeue;
+} dc_smtp_lane_t;
+
+
+typedef struct dc_smtp_pool_t
+{
+	dc_context_t*        context;
+	dc_smtp_lane_t*      items;      // sorted by chat_id and job_id
+	int                  item_cnt;
+	int                  next_item;  // the first item of the next lane not yet taken by a worker
+	pthread_mutex_t      mutex;
+} dc_smtp_pool_t;
+
+
+typedef struct dc_smtp_worker_t
+{
+	dc_smtp_pool_t*      pool;
+	dc_smtp_t*           smtp;
+} dc_smtp_worker_t;
+
+
+static int cmp_smtp_lane_items(const void* p1, const void* p2)
+{
+	const dc_smtp_lane_t* i1 = (const dc_smtp_lane_t*)p1;
+	const dc_smtp_lane_t* i2 = (const dc_smtp_lane_t*)p2;
+	if (i1->chat_id!=i2->chat_id) {
+		return i1->chat_id < i2->chat_id? -1 : 1;
+	}
+	return i1->entry.job_id < i2->entry.job_id? -1 : (i1->entry.job_id > i2->entry.job_id? 1 : 0);
+}
+
+
+static void* smtp_pool_worker(void* arg)
+{
+	dc_smtp_worker_t* worker = (dc_smtp_worker_t*)arg;
+	dc_smtp_pool_t*   pool = worker->pool;
+	dc_context_t*     context = pool->context;
+	int               thread = DC_SMTP_THREAD;
+	dc_job_t          job;
+
+	memset(&job, 0, sizeof(dc_job_t));
+	job.param = dc_param_new();
+
+	while (1)
+	{
+		int first = 0, last = 0;
+
+		pthread_mutex_lock(&pool->mutex);
+			first = pool->next_item;
+			last = first;
+			while (last < pool->item_cnt && pool->items[last].chat_id==pool->items[first].chat_id) {
+				last++;
+			}
+			pool->next_item = last;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (first >= pool->item_cnt) {
+			break;
+		}
+
+		for (int i = first; i < last; i++)
+		{
+			dc_smtp_lane_t* item = &pool->items[i];
+
+			job.job_id     = item->entry.job_id;
+			job.action     = item->entry.action;
+			job.foreign_id = item->entry.foreign_id;
+			dc_param_set_packed(job.param, item->entry.param);
+
+			dc_log_info(context, 0, "%s-job #%i, action %i started on pooled connection...", THREAD_STR, (int)job.job_id, (int)job.action);
+
+			run_job(context, worker->smtp, &job);
+			item->requeue = finish_job(context, thread, &job, &item->entry);
+		}
+	}
+
+	dc_param_unref(job.param);
+	free(job.pending_error);
+	return NULL;
+}
+
+
+static void perform_smtp_pool(dc_context_t* context, int pool_size)
+{
+	#define             SMTP_POOL_MAX_JOBS 1000
+	dc_smtp_pool_t      pool;
+	dc_jobqueue_entry_t* entries = NULL;
+	int                 entry_cnt = 0;
+	int                 lane_cnt = 0;
+	int                 worker_cnt = 0;
+	dc_smtp_worker_t    workers[DC_SMTP_POOL_MAX];
+	pthread_t           threads[DC_SMTP_POOL_MAX];
+	int                 started[DC_SMTP_POOL_MAX];
+	sqlite3_stmt*       stmt = NULL;
+	int                 i = 0;
+
+	memset(&pool, 0, sizeof(dc_smtp_pool_t));
+	memset(started, 0, sizeof(started));
+	pool.context = context;
+	pthread_mutex_init(&pool.mutex, NULL);
+
+	if ((entries=calloc(SMTP_POOL_MAX_JOBS, sizeof(dc_jobqueue_entry_t)))==NULL) {
+		goto cleanup;
+	}
+
+	entry_cnt = dc_jobqueue_pop_due_action(context->jobqueue, DC_SMTP_THREAD, DC_JOB_SEND_MSG_TO_SMTP, time(NULL), entries, SMTP_POOL_MAX_JOBS);
+	if (entry_cnt==0 || (pool.items=calloc(entry_cnt, sizeof(dc_smtp_lane_t)))==NULL) {
+		goto cleanup;
+	}
+
+	stmt = dc_sqlite3_prepare(context->sql, "SELECT chat_id FROM msgs WHERE id=?;");
+	for (i = 0; i < entry_cnt; i++) {
+		sqlite3_reset(stmt);
+		sqlite3_bind_int(stmt, 1, entries[i].foreign_id);
+		pool.items[i].chat_id = sqlite3_step(stmt)==SQLITE_ROW? sqlite3_column_int(stmt, 0) : 0;
+		pool.items[i].entry   = entries[i];
+		pool.items[i].requeue = 1; // if not done by a worker for any reason
+		entries[i].param      = NULL; // now owned by pool.items
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+	pool.item_cnt = entry_cnt;
+
+	qsort(pool.items, pool.item_cnt, sizeof(dc_smtp_lane_t), cmp_smtp_lane_items);
+	for (i = 0; i < pool.item_cnt; i++) {
+		if (i==0 || pool.items[i].chat_id!=pool.items[i-1].chat_id) {
+			lane_cnt++;
+		}
+	}
+
+	worker_cnt = DC_MIN(pool_size, lane_cnt);
+	dc_log_info(context, 0, "Sending %i messages in %i chats over %i SMTP connections...", pool.item_cnt, lane_cnt, worker_cnt);
+
+	for (i = 0; i < worker_cnt; i++) {
+		if (i > 0 && context->smtp_pool[i]==NULL) {
+			context->smtp_pool[i] = dc_smtp_new(context);
+		}
+		workers[i].pool = &pool;
+		workers[i].smtp = i==0? context->smtp : context->smtp_pool[i];
+	}
+
+	// worker #0 runs in the calling thread using the normal SMTP connection
+	for (i = 1; i < worker_cnt; i++) {
+		if (pthread_create(&threads[i], NULL, smtp_pool_worker, &workers[i])==0) {
+			started[i] = 1;
+		}
+	}
+	if (worker_cnt > 0) {
+		smtp_pool_worker(&workers[0]);
+	}
+	for (i = 1; i < worker_cnt; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+
+cleanup:
+	sqlite3_finalize(stmt);
+	for (i = 0; i < entry_cnt; i++) {
+		free(entries[i].param);
+	}
+	if (pool.items) {
+		for (i = 0; i < pool.item_cnt; i++) {
+			if (pool.items[i].requeue) {
+				dc_jobqueue_push(context->jobqueue, DC_SMTP_THREAD, &pool.items[i].entry);
+			}
+			free(pool.items[i].entry.param);
+		}
+		free(pool.items);
+	}
+	free(entries);
+	pthread_mutex_destroy(&pool.mutex);
+}
+
+
+/**
+ * Disconnect the additional SMTP connections used if `smtp_pool_size` is larger than 1.
+ * The normal connection, dc_context_t::smtp, is not affected.
+ *
+ * @private @memberof dc_context_t
+ * @param context The context object.
+ * @param unref 1=also free the connection objects, 0=only disconnect.
+ * @return None.
+ */
+void dc_job_close_smtp_pool(dc_context_t* context, int unref)
+{
+	for (int i = 1; i < DC_SMTP_POOL_MAX; i++) {
+		if (context->smtp_pool[i]) {
+			dc_smtp_disconnect(context->smtp_pool[i]);
+			if (unref) {
+				dc_smtp_unref(context->smtp_pool[i]);
+				context->smtp_pool[i] = NULL;
+			}
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Perform jobs
+ ******************************************************************************/
+
+
 static void dc_job_perform(dc_context_t* context, int thread)
 {
-	sqlite3_stmt* select_stmt = NULL;
-	dc_job_t      job;
-	#define       THREAD_STR (thread==DC_IMAP_THREAD? "IMAP" : "SMTP")
-	#define       IS_EXCLUSIVE_JOB (DC_JOB_CONFIGURE_IMAP==job.action || DC_JOB_IMEX_IMAP==job.action)
+	dc_job_t             job;
+	dc_jobqueue_entry_t  entry;
+	dc_jobqueue_entry_t* delayed = NULL; // jobs to try again are put back to the queue after the loop, so they're done at most once per call
+	int                  delayed_cnt = 0;
+	int                  markseen_pipelined = 0;
+	int                  delete_pipelined = 0;
+	#define              IS_EXCLUSIVE_JOB (DC_JOB_CONFIGURE_IMAP==job.action || DC_JOB_IMEX_IMAP==job.action)
 
 	memset(&job, 0, sizeof(dc_job_t));
 	job.param = dc_param_new();
+	memset(&entry, 0, sizeof(dc_jobqueue_entry_t));
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
 		goto cleanup;
 	}
 
-	select_stmt = dc_sqlite3_prepare(context->sql,
-		"SELECT id, action, foreign_id, param FROM jobs WHERE thread=? AND desired_timestamp<=? ORDER BY action DESC, added_timestamp;");
-	sqlite3_bind_int64(select_stmt, 1, thread);
-	sqlite3_bind_int64(select_stmt, 2, time(NULL));
-	while (sqlite3_step(select_stmt)==SQLITE_ROW)
+	if (thread==DC_SMTP_THREAD) {
+		int pool_size = dc_sqlite3_get_config_int(context->sql, "smtp_pool_size", 1);
+		if (pool_size > 1) {
+			perform_smtp_pool(context, DC_MIN(pool_size, DC_SMTP_POOL_MAX));
+		}
+	}
+
+	while (dc_jobqueue_pop_due(context->jobqueue, thread, time(NULL), &entry))
 	{
-		job.job_id                          = sqlite3_column_int (select_stmt, 0);
-		job.action                          = sqlite3_column_int (select_stmt, 1);
-		job.foreign_id                      = sqlite3_column_int (select_stmt, 2);
-		dc_param_set_packed(job.param, (char*)sqlite3_column_text(select_stmt, 3));
+		job.job_id                          = entry.job_id;
+		job.action                          = entry.action;
+		job.foreign_id                      = entry.foreign_id;
+		dc_param_set_packed(job.param, entry.param);
+
+		// flag updates, moves and deletes on IMAP are sent as one command stream for all due jobs of the action;
+		// the jobs that could not be done this way are put back to the queue and are executed one by one.
+		if (thread==DC_IMAP_THREAD
+		 && ((job.action==DC_JOB_MARKSEEN_MSG_ON_IMAP && !markseen_pipelined) || (job.action==DC_JOB_DELETE_MSG_ON_IMAP && !delete_pipelined))) {
+			if (job.action==DC_JOB_MARKSEEN_MSG_ON_IMAP) { markseen_pipelined = 1; } else { delete_pipelined = 1; }
+			dc_jobqueue_push(context->jobqueue, thread, &entry);
+			free(entry.param);
+			entry.param = NULL;
+			perform_imap_batch(context, job.action);
+			continue;
+		}
 
 		dc_log_info(context, 0, "%s-job #%i, action %i started...", THREAD_STR, (int)job.job_id, (int)job.action);
 
@@ -573,78 +1239,33 @@ static void dc_job_perform(dc_context_t* context, int thread)
 		// - they can be re-executed one time AT_ONCE, but they are not save in the database for later execution
 		if (IS_EXCLUSIVE_JOB) {
 			dc_job_kill_actions(context, job.action, 0);
-			sqlite3_finalize(select_stmt);
-			select_stmt = NULL;
 			dc_suspend_smtp_thread(context, 1);
+			run_job(context, context->smtp, &job);
+			dc_suspend_smtp_thread(context, 0);
+			goto cleanup;
 		}
 
-		for (int tries = 0; tries <= 1; tries++)
-		{
-			job.try_again = DC_DONT_TRY_AGAIN; // this can be modified by a job using dc_job_try_again_later()
-
-			switch (job.action) {
-				case DC_JOB_SEND_MSG_TO_SMTP:     dc_job_do_DC_JOB_SEND_MSG_TO_SMTP     (context, &job); break;
-				case DC_JOB_SEND_MSG_TO_IMAP:     dc_job_do_DC_JOB_SEND_MSG_TO_IMAP     (context, &job); break;
-				case DC_JOB_DELETE_MSG_ON_IMAP:   dc_job_do_DC_JOB_DELETE_MSG_ON_IMAP   (context, &job); break;
-				case DC_JOB_MARKSEEN_MSG_ON_IMAP: dc_job_do_DC_JOB_MARKSEEN_MSG_ON_IMAP (context, &job); break;
-				case DC_JOB_MARKSEEN_MDN_ON_IMAP: dc_job_do_DC_JOB_MARKSEEN_MDN_ON_IMAP (context, &job); break;
-				case DC_JOB_SEND_MDN:             dc_job_do_DC_JOB_SEND_MDN             (context, &job); break;
-				case DC_JOB_CONFIGURE_IMAP:       dc_job_do_DC_JOB_CONFIGURE_IMAP       (context, &job); break;
-				case DC_JOB_IMEX_IMAP:            dc_job_do_DC_JOB_IMEX_IMAP            (context, &job); break;
-			}
+		run_job(context, context->smtp, &job);
 
-			if (job.try_again!=DC_AT_ONCE) {
-				break;
-			}
+		if (finish_job(context, thread, &job, &entry)) {
+			delayed = realloc(delayed, (delayed_cnt+1)*sizeof(dc_jobqueue_entry_t));
+			delayed[delayed_cnt++] = entry;
+			entry.param = NULL;
 		}
 
-		if (IS_EXCLUSIVE_JOB) {
-			dc_suspend_smtp_thread(context, 0);
-			goto cleanup;
-		}
-		else if (job.try_again==DC_INCREATION_POLL)
-		{
-			// just try over next loop unconditionally, the ui typically interrupts idle when the file (video) is ready
-			dc_log_info(context, 0, "%s-job #%i not yet ready and will be delayed.", THREAD_STR, (int)job.job_id);
-		}
-		else if (job.try_again==DC_AT_ONCE || job.try_again==DC_STANDARD_DELAY)
-		{
-			// Define the number of job-retries, each retry may result in 2 tries (for fast network-failure-recover).
-			// The first job-retries are done asap, the last retry is delayed about a minute.
-			// Network errors do not count as failed tries.
-			#define JOB_RETRIES 3
-
-			int is_online = dc_is_online(context)? 1 : 0;
-			int tries_while_online = dc_param_get_int(job.param, DC_PARAM_TIMES, 0) + is_online;
-
-			if( tries_while_online < JOB_RETRIES ) {
-				dc_param_set_int(job.param, DC_PARAM_TIMES, tries_while_online);
-				dc_job_update(context, &job);
-				dc_log_info(context, 0, "%s-job #%i not succeeded on try #%i.", THREAD_STR, (int)job.job_id, tries_while_online);
-
-				if (thread==DC_SMTP_THREAD && is_online && tries_while_online<(JOB_RETRIES-1)) {
-					pthread_mutex_lock(&context->smtpidle_condmutex);
-						context->perform_smtp_jobs_needed = DC_JOBS_NEEDED_AVOID_DOS;
-					pthread_mutex_unlock(&context->smtpidle_condmutex);
-				}
-			}
-			else {
-				if (job.action==DC_JOB_SEND_MSG_TO_SMTP) { // in all other cases, the messages is already sent
-					dc_set_msg_failed(context, job.foreign_id, job.pending_error);
-				}
-				dc_job_delete(context, &job);
-			}
-		}
-		else
-		{
-			dc_job_delete(context, &job);
-		}
+		free(entry.param);
+		entry.param = NULL;
 	}
 
 cleanup:
+	for (int i = 0; i < delayed_cnt; i++) {
+		dc_jobqueue_push(context->jobqueue, thread, &delayed[i]);
+		free(delayed[i].param);
+	}
+	free(delayed);
+	free(entry.param);
 	dc_param_unref(job.param);
 	free(job.pending_error);
-	sqlite3_finalize(select_stmt);
 }
 
 
@@ -737,9 +1358,15 @@ void dc_perform_imap_idle(dc_context_t* context)
 		}
 	pthread_mutex_unlock(&context->imapidle_condmutex);
 
+	time_t next_timestamp = dc_jobqueue_get_next_timestamp(context->jobqueue, DC_IMAP_THREAD);
+	if (next_timestamp!=0 && next_timestamp<=time(NULL)) {
+		dc_log_info(context, 0, "IMAP-IDLE will not be started because of due jobs.");
+		return;
+	}
+
 	dc_log_info(context, 0, "IMAP-IDLE started...");
 
-	dc_imap_idle(context->imap);
+	dc_imap_idle(context->imap, next_timestamp);
 
 	dc_log_info(context, 0, "IMAP-IDLE ended.");
 }
@@ -754,8 +1381,8 @@ void dc_perform_imap_idle(dc_context_t* context)
  * If the imap-thread is inside one of these functions when dc_interrupt_imap_idle() is called, however,
  * the next call of the imap-thread to dc_perform_imap_idle() is interrupted immediately.
  *
- * Internally, this function is called whenever a imap-jobs should be processed (delete message, markseen etc.),
- * for the UI view it may make sense to call the function eg. on network changes to fetch messages immediately.
+ * For the UI view it may make sense to call the function eg. on network changes to fetch messages immediately;
+ * failed jobs waiting for a retry are then tried again at once.
  *
  * Example:
  *
@@ -790,16 +1417,10 @@ void dc_interrupt_imap_idle(dc_context_t* context)
 		return;
 	}
 
-	dc_log_info(context, 0, "Interrupting IMAP-IDLE...");
+	// the app calls this function eg. on network changes, so failed jobs are tried again at once
+	dc_jobqueue_make_retries_due(context->jobqueue, DC_IMAP_THREAD);
 
-	pthread_mutex_lock(&context->imapidle_condmutex);
-		// when this function is called, it might be that the idle-thread is in
-		// perform_idle_jobs() instead of idle(). if so, added jobs will be performed after the _next_ idle-jobs loop.
-		// setting the flag perform_imap_jobs_needed makes sure, idle() returns immediately in this case.
-		context->perform_imap_jobs_needed = 1;
-	pthread_mutex_unlock(&context->imapidle_condmutex);
-
-	dc_imap_interrupt_idle(context->imap);
+	interrupt_imap_idle(context);
 }
 
 
@@ -869,12 +1490,26 @@ void dc_perform_smtp_idle(dc_context_t* context)
 		}
 		else
 		{
+			// sleep until the next job is due; jobs added in between interrupt the idle.
+			// if the thread is suspended, the due jobs are not done and we must not wake up at once again.
 			int r = 0;
-			struct timespec wakeup_at;
-			memset(&wakeup_at, 0, sizeof(wakeup_at));
-			wakeup_at.tv_sec  = time(NULL) + ((context->perform_smtp_jobs_needed==DC_JOBS_NEEDED_AVOID_DOS)? 2 : DC_SMTP_IDLE_SEC);
-			while (context->smtpidle_condflag==0 && r==0) {
-				r = pthread_cond_timedwait(&context->smtpidle_cond, &context->smtpidle_condmutex, &wakeup_at); // unlock mutex -> wait -> lock mutex
+			time_t next_timestamp = dc_jobqueue_get_next_timestamp(context->jobqueue, DC_SMTP_THREAD);
+			if (context->smtp_suspended) {
+				next_timestamp = time(NULL) + DC_SMTP_RETRY_SEC;
+			}
+
+			if (next_timestamp==0) {
+				while (context->smtpidle_condflag==0 && r==0) {
+					r = pthread_cond_wait(&context->smtpidle_cond, &context->smtpidle_condmutex); // unlock mutex -> wait -> lock mutex
+				}
+			}
+			else if (next_timestamp > time(NULL)) {
+				struct timespec wakeup_at;
+				memset(&wakeup_at, 0, sizeof(wakeup_at));
+				wakeup_at.tv_sec  = next_timestamp;
+				while (context->smtpidle_condflag==0 && r==0) {
+					r = pthread_cond_timedwait(&context->smtpidle_cond, &context->smtpidle_condmutex, &wakeup_at); // unlock mutex -> wait -> lock mutex
+				}
 			}
 			context->smtpidle_condflag = 0;
 		}
@@ -894,8 +1529,8 @@ void dc_perform_smtp_idle(dc_context_t* context)
  * If the smtp-thread is inside this function when dc_interrupt_smtp_idle() is called, however,
  * the next call of the smtp-thread to dc_perform_smtp_idle() is interrupted immediately.
  *
- * Internally, this function is called whenever a message is to be send,
- * for the UI view it may make sense to call the function eg. on network changes.
+ * For the UI view it may make sense to call the function eg. on network changes;
+ * failed jobs waiting for a retry are then tried again at once.
  *
  * Example:
  *
@@ -928,17 +1563,8 @@ void dc_interrupt_smtp_idle(dc_context_t* context)
 		return;
 	}
 
-	dc_log_info(context, 0, "Interrupting SMTP-idle...");
-
-	pthread_mutex_lock(&context->smtpidle_condmutex);
-
-		// when this function is called, it might be that the smtp-thread is in
-		// perform_smtp_jobs(). if so, added jobs will be performed after the _next_ idle-jobs loop.
-		// setting the flag perform_smtp_jobs_needed makes sure, idle() returns immediately in this case.
-		context->perform_smtp_jobs_needed = DC_JOBS_NEEDED_AT_ONCE;
-
-		context->smtpidle_condflag = 1;
-		pthread_cond_signal(&context->smtpidle_cond);
+	// the app calls this function eg. on network changes, so failed jobs are tried again at once
+	dc_jobqueue_make_retries_due(context->jobqueue, DC_SMTP_THREAD);
 
-	pthread_mutex_unlock(&context->smtpidle_condmutex);
+	interrupt_smtp_idle(context);
 }
@@ -11,7 +11,8 @@ extern "C" {
 
 
 // jobs in the IMAP-thread
-#define DC_JOB_DELETE_MSG_ON_IMAP     110    // low priority ...
+#define DC_JOB_FTS_BACKFILL           105    // low priority ...
+#define DC_JOB_DELETE_MSG_ON_IMAP     110
 #define DC_JOB_MARKSEEN_MDN_ON_IMAP   120
 #define DC_JOB_MARKSEEN_MSG_ON_IMAP   130
 #define DC_JOB_SEND_MSG_TO_IMAP       700
@@ -31,10 +32,11 @@ extern "C" {
 #define DC_SMTP_TIMEOUT_SEC       10
 
 
-// this is the timeout after which dc_perform_smtp_idle() returns at latest.
-// this timeout should not be too large as this might be the only option to perform
-// jobs that failed on the first execution.
-#define DC_SMTP_IDLE_SEC          60
+// delays until jobs waiting for a file in creation are tried again, for failed jobs, see the retry policies in dc_job.c.
+// dc_perform_imap_idle() and dc_perform_smtp_idle() wake up when the next job is due;
+// dc_interrupt_imap_idle() and dc_interrupt_smtp_idle() make failed jobs due at once.
+#define DC_IMAP_RETRY_SEC             60
+#define DC_SMTP_RETRY_SEC             60
 
 
 /**
@@ -50,6 +52,7 @@ typedef struct dc_job_t
 	dc_param_t* param;
 
 	int         try_again;
+	int         error_class;   // one of DC_JOB_ERR_*, selects the retry policy
 	char*       pending_error; // discarded if the retry succeeds
 } dc_job_t;
 
@@ -61,13 +64,23 @@ void     dc_job_kill_actions          (dc_context_t*, int action1, int action2);
 #define  DC_AT_ONCE                 -1
 #define  DC_INCREATION_POLL          2 // this value does not increase the number of tries
 #define  DC_STANDARD_DELAY           3
+#define  DC_CONTINUE_NEXT_CALL       4 // the job is not finished yet and continues on the next call of dc_perform_imap_jobs() resp. dc_perform_smtp_jobs(), not counted as a try
 void     dc_job_try_again_later       (dc_job_t*, int try_again, const char* error);
 
+#define  DC_JOB_ERR_NETWORK          0 // connection problems, the default
+#define  DC_JOB_ERR_AUTH             1 // login failed
+#define  DC_JOB_ERR_QUOTA            2 // the server is temporarily overloaded or out of resources
+#define  DC_JOB_ERR_PERMANENT        3 // the job will fail again, do not retry
+void     dc_job_set_error_class       (dc_job_t*, int error_class);
+time_t   dc_job_get_retry_delay       (dc_context_t*, int action, int error_class, int tries); /* -1 if the job is not tried again after `tries` failed tries */
+
 
 // the other dc_job_do_DC_JOB_*() functions are declared static in the c-file
 void     dc_job_do_DC_JOB_CONFIGURE_IMAP (dc_context_t*, dc_job_t*);
 void     dc_job_do_DC_JOB_IMEX_IMAP      (dc_context_t*, dc_job_t*);
 
+void     dc_job_close_smtp_pool       (dc_context_t*, int unref);
+
 
 #ifdef __cplusplus
 } /* /extern "C" */
@@ -0,0 +1,531 @@
+#include "dc_context.h"
+#include "dc_job.h"
+#include "dc_jobqueue.h"
+
+
+/*******************************************************************************
+ * The heap
+ ******************************************************************************/
+
+
+static int entry_before(const dc_jobqueue_entry_t* a, const dc_jobqueue_entry_t* b)
+{
+	/* the job to perform first: the smallest desired_timestamp, then the highest action,
+	then the oldest job; this is the order formerly used by the SELECT in dc_job_perform() */
+	if (a->desired_timestamp!=b->desired_timestamp) {
+		return a->desired_timestamp < b->desired_timestamp;
+	}
+	if (a->action!=b->action) {
+		return a->action > b->action;
+	}
+	if (a->added_timestamp!=b->added_timestamp) {
+		return a->added_timestamp < b->added_timestamp;
+	}
+	return a->job_id < b->job_id;
+}
+
+
+static void heap_swap(dc_jobheap_t* heap, int i, int j)
+{
+	dc_jobqueue_entry_t tmp = heap->entries[i];
+	heap->entries[i] = heap->entries[j];
+	heap->entries[j] = tmp;
+}
+
+
+static void heap_sift_up(dc_jobheap_t* heap, int i)
+{
+	while (i > 0) {
+		int parent = (i-1)/2;
+		if (!entry_before(&heap->entries[i], &heap->entries[parent])) {
+			break;
+		}
+		heap_swap(heap, i, parent);
+		i = parent;
+	}
+}
+
+
+static void heap_sift_down(dc_jobheap_t* heap, int i)
+{
+	while (1) {
+		int smallest = i;
+		int left = 2*i+1, right = 2*i+2;
+		if (left < heap->cnt && entry_before(&heap->entries[left], &heap->entries[smallest])) {
+			smallest = left;
+		}
+		if (right < heap->cnt && entry_before(&heap->entries[right], &heap->entries[smallest])) {
+			smallest = right;
+		}
+		if (smallest==i) {
+			break;
+		}
+		heap_swap(heap, i, smallest);
+		i = smallest;
+	}
+}
+
+
+static void heap_rebuild(dc_jobheap_t* heap)
+{
+	for (int i = heap->cnt/2-1; i >= 0; i--) {
+		heap_sift_down(heap, i);
+	}
+}
+
+
+static void heap_push(dc_jobheap_t* heap, const dc_jobqueue_entry_t* entry)
+{
+	if (heap->cnt >= heap->allocated) {
+		heap->allocated = heap->allocated<16? 16 : heap->allocated*2;
+		heap->entries = realloc(heap->entries, heap->allocated * sizeof(dc_jobqueue_entry_t));
+		if (heap->entries==NULL) {
+			exit(51);
+		}
+	}
+
+	heap->entries[heap->cnt] = *entry;
+	heap->entries[heap->cnt].param = dc_strdup(entry->param);
+	heap->cnt++;
+	heap_sift_up(heap, heap->cnt-1);
+}
+
+
+static void heap_remove_at(dc_jobheap_t* heap, int i)
+{
+	/* the param of the removed entry is not freed, it's up to the caller */
+	heap->cnt--;
+	if (i < heap->cnt) {
+		heap->entries[i] = heap->entries[heap->cnt];
+		heap_sift_down(heap, i);
+		heap_sift_up(heap, i);
+	}
+}
+
+
+static void heap_empty(dc_jobheap_t* heap)
+{
+	for (int i = 0; i < heap->cnt; i++) {
+		free(heap->entries[i].param);
+	}
+	heap->cnt = 0;
+}
+
+
+/*******************************************************************************
+ * The queue
+ ******************************************************************************/
+
+
+static dc_jobheap_t* get_heap(dc_jobqueue_t* jobqueue, int thread)
+{
+	return thread==DC_IMAP_THREAD? &jobqueue->imap_heap : &jobqueue->smtp_heap;
+}
+
+
+static dc_jobheap_t* get_deferred(dc_jobqueue_t* jobqueue, int thread)
+{
+	return thread==DC_IMAP_THREAD? &jobqueue->imap_deferred : &jobqueue->smtp_deferred;
+}
+
+
+static void heap_free(dc_jobheap_t* heap)
+{
+	heap_empty(heap);
+	free(heap->entries);
+	memset(heap, 0, sizeof(dc_jobheap_t));
+}
+
+
+static int heap_contains(const dc_jobheap_t* heap, uint32_t job_id)
+{
+	for (int i = 0; i < heap->cnt; i++) {
+		if (heap->entries[i].job_id==job_id) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+static int load_if_needed(dc_jobqueue_t* jobqueue)
+{
+	/* must be called with the mutex unlocked: the jobs are read without holding the mutex
+	and are only installed if the queue was not reset and no job was added in between, otherwise they're read again.
+	returns 1 if the queue is loaded, 0 if the database is closed. */
+	sqlite3_stmt*       stmt = NULL;
+	dc_jobqueue_entry_t entry;
+	dc_param_t*         param = dc_param_new();
+	dc_jobheap_t        imap_heap, smtp_heap;
+	uint32_t            max_job_id = 0;
+	int                 generation = 0;
+	int                 imap_cnt = 0, smtp_cnt = 0;
+	int                 installed = 0; // the jobs read by this call are used
+	int                 loaded = 0;
+
+	memset(&imap_heap, 0, sizeof(dc_jobheap_t));
+	memset(&smtp_heap, 0, sizeof(dc_jobheap_t));
+
+	while (1)
+	{
+		pthread_mutex_lock(&jobqueue->mutex);
+			loaded = jobqueue->loaded;
+			generation = jobqueue->generation;
+		pthread_mutex_unlock(&jobqueue->mutex);
+
+		if (loaded || !dc_sqlite3_is_open(jobqueue->context->sql)) {
+			goto cleanup;
+		}
+
+		heap_empty(&imap_heap);
+		heap_empty(&smtp_heap);
+		max_job_id = 0;
+
+		stmt = dc_sqlite3_prepare(jobqueue->context->sql,
+			"SELECT id, thread, action, foreign_id, param, added_timestamp, desired_timestamp FROM jobs;");
+		while (sqlite3_step(stmt)==SQLITE_ROW)
+		{
+			memset(&entry, 0, sizeof(dc_jobqueue_entry_t));
+			entry.job_id            = sqlite3_column_int  (stmt, 0);
+			entry.action            = sqlite3_column_int  (stmt, 2);
+			entry.foreign_id        = sqlite3_column_int  (stmt, 3);
+			entry.param             = (char*)sqlite3_column_text(stmt, 4);
+			entry.added_timestamp   = sqlite3_column_int64(stmt, 5);
+			entry.desired_timestamp = sqlite3_column_int64(stmt, 6);
+
+			dc_param_set_packed(param, entry.param);
+			entry.is_retry = dc_param_exists(param, DC_PARAM_TIMES);
+
+			if (entry.job_id > max_job_id) {
+				max_job_id = entry.job_id;
+			}
+
+			int thread = sqlite3_column_int(stmt, 1);
+			if (thread==DC_IMAP_THREAD) {
+				heap_push(&imap_heap, &entry);
+			}
+			else if (thread==DC_SMTP_THREAD) {
+				heap_push(&smtp_heap, &entry);
+			}
+		}
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+
+		pthread_mutex_lock(&jobqueue->mutex);
+			if (!jobqueue->loaded && jobqueue->generation==generation) {
+				heap_free(&jobqueue->imap_heap);
+				heap_free(&jobqueue->smtp_heap);
+				jobqueue->imap_heap = imap_heap;
+				jobqueue->smtp_heap = smtp_heap;
+				imap_cnt = imap_heap.cnt;
+				smtp_cnt = smtp_heap.cnt;
+				memset(&imap_heap, 0, sizeof(dc_jobheap_t));
+				memset(&smtp_heap, 0, sizeof(dc_jobheap_t));
+				// IDs are never given out twice, even if the queue is reset while jobs are added
+				jobqueue->last_job_id = DC_MAX(jobqueue->last_job_id, max_job_id);
+				jobqueue->loaded = 1;
+				installed = 1;
+			}
+			loaded = jobqueue->loaded;
+		pthread_mutex_unlock(&jobqueue->mutex);
+
+		if (loaded) {
+			break;
+		}
+	}
+
+	if (installed) {
+		dc_log_info(jobqueue->context, 0, "%i IMAP-jobs and %i SMTP-jobs loaded.", imap_cnt, smtp_cnt);
+	}
+
+cleanup:
+	sqlite3_finalize(stmt);
+	heap_free(&imap_heap);
+	heap_free(&smtp_heap);
+	dc_param_unref(param);
+	return loaded;
+}
+
+
+dc_jobqueue_t* dc_jobqueue_new(dc_context_t* context)
+{
+	dc_jobqueue_t* jobqueue = NULL;
+
+	if ((jobqueue=calloc(1, sizeof(dc_jobqueue_t)))==NULL) {
+		exit(50);
+	}
+
+	jobqueue->context = context;
+	pthread_mutex_init(&jobqueue->mutex, NULL);
+
+	return jobqueue;
+}
+
+
+void dc_jobqueue_unref(dc_jobqueue_t* jobqueue)
+{
+	if (jobqueue==NULL) {
+		return;
+	}
+
+	heap_free(&jobqueue->imap_heap);
+	heap_free(&jobqueue->smtp_heap);
+	heap_free(&jobqueue->imap_deferred);
+	heap_free(&jobqueue->smtp_deferred);
+	pthread_mutex_destroy(&jobqueue->mutex);
+	free(jobqueue);
+}
+
+
+void dc_jobqueue_reset(dc_jobqueue_t* jobqueue)
+{
+	if (jobqueue==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&jobqueue->mutex);
+		heap_empty(&jobqueue->imap_heap);
+		heap_empty(&jobqueue->smtp_heap);
+		jobqueue->loaded = 0;
+		jobqueue->generation++; // a load running concurrently is discarded
+	pthread_mutex_unlock(&jobqueue->mutex);
+}
+
+
+uint32_t dc_jobqueue_add(dc_jobqueue_t* jobqueue, int thread, int action, uint32_t foreign_id, const char* param, time_t desired_timestamp)
+{
+	/* the INSERT is done without holding the mutex, only the ID is reserved before and the heap is changed afterwards */
+	uint32_t            job_id = 0;
+	int                 generation = 0;
+	sqlite3_stmt*       stmt = NULL;
+	dc_jobqueue_entry_t entry;
+
+	if (jobqueue==NULL) {
+		return 0;
+	}
+
+	memset(&entry, 0, sizeof(dc_jobqueue_entry_t));
+	entry.action            = action;
+	entry.foreign_id        = foreign_id;
+	entry.param             = (char*)(param? param : "");
+	entry.added_timestamp   = time(NULL);
+	entry.desired_timestamp = desired_timestamp;
+
+	// the last ID is known only after the jobs are loaded
+	while (entry.job_id==0) {
+		if (!load_if_needed(jobqueue)) {
+			goto cleanup;
+		}
+		pthread_mutex_lock(&jobqueue->mutex);
+			if (jobqueue->loaded) {
+				entry.job_id = ++jobqueue->last_job_id;
+				generation = jobqueue->generation;
+			}
+		pthread_mutex_unlock(&jobqueue->mutex);
+	}
+
+	stmt = dc_sqlite3_prepare(jobqueue->context->sql,
+		"INSERT INTO jobs (id, added_timestamp, thread, action, foreign_id, param, desired_timestamp) VALUES (?,?,?,?,?,?,?);");
+	sqlite3_bind_int  (stmt, 1, entry.job_id);
+	sqlite3_bind_int64(stmt, 2, entry.added_timestamp);
+	sqlite3_bind_int  (stmt, 3, thread);
+	sqlite3_bind_int  (stmt, 4, action);
+	sqlite3_bind_int  (stmt, 5, foreign_id);
+	sqlite3_bind_text (stmt, 6, entry.param, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 7, desired_timestamp);
+	if (sqlite3_step(stmt)!=SQLITE_DONE) {
+		goto cleanup;
+	}
+
+	job_id = entry.job_id;
+
+	pthread_mutex_lock(&jobqueue->mutex);
+		if (dc_sqlite3_in_transaction(jobqueue->context->sql)) {
+			// the row may still be rolled back, the job is added to the heap on commit, see dc_jobqueue_end_transaction()
+			heap_push(get_deferred(jobqueue, thread), &entry);
+		}
+		else if (!jobqueue->loaded) {
+			// the job is read from the database by the next load; a load already running may have missed the row, let it read again
+			jobqueue->generation++;
+		}
+		else if (jobqueue->generation==generation
+		      || !heap_contains(get_heap(jobqueue, thread), entry.job_id)) {
+			// if the queue was reloaded in between, the load may or may not have seen the row
+			heap_push(get_heap(jobqueue, thread), &entry);
+		}
+	pthread_mutex_unlock(&jobqueue->mutex);
+
+cleanup:
+	sqlite3_finalize(stmt);
+	return job_id;
+}
+
+
+void dc_jobqueue_push(dc_jobqueue_t* jobqueue, int thread, const dc_jobqueue_entry_t* entry)
+{
+	if (jobqueue==NULL || entry==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&jobqueue->mutex);
+		if (jobqueue->loaded) { // if the queue was reset in between, the job is loaded from the database
+			heap_push(get_heap(jobqueue, thread), entry);
+		}
+	pthread_mutex_unlock(&jobqueue->mutex);
+}
+
+
+int dc_jobqueue_pop_due(dc_jobqueue_t* jobqueue, int thread, time_t now, dc_jobqueue_entry_t* ret_entry)
+{
+	int           success = 0;
+	dc_jobheap_t* heap = NULL;
+
+	if (jobqueue==NULL || ret_entry==NULL) {
+		return 0;
+	}
+
+	load_if_needed(jobqueue);
+
+	pthread_mutex_lock(&jobqueue->mutex);
+
+		heap = get_heap(jobqueue, thread);
+		if (heap->cnt > 0 && heap->entries[0].desired_timestamp <= now) {
+			*ret_entry = heap->entries[0];
+			heap_remove_at(heap, 0);
+			success = 1;
+		}
+
+	pthread_mutex_unlock(&jobqueue->mutex);
+
+	return success;
+}
+
+
+int dc_jobqueue_pop_due_action(dc_jobqueue_t* jobqueue, int thread, int action, time_t now, dc_jobqueue_entry_t* ret_entries, int max_entries)
+{
+	int           cnt = 0;
+	dc_jobheap_t* heap = NULL;
+
+	if (jobqueue==NULL || ret_entries==NULL) {
+		return 0;
+	}
+
+	load_if_needed(jobqueue);
+
+	pthread_mutex_lock(&jobqueue->mutex);
+
+		heap = get_heap(jobqueue, thread);
+		for (int i = 0; i < heap->cnt && cnt < max_entries; ) {
+			if (heap->entries[i].action==action && heap->entries[i].desired_timestamp <= now) {
+				ret_entries[cnt++] = heap->entries[i];
+				heap->entries[i] = heap->entries[--heap->cnt];
+			}
+			else {
+				i++;
+			}
+		}
+
+		if (cnt > 0) {
+			heap_rebuild(heap);
+		}
+
+	pthread_mutex_unlock(&jobqueue->mutex);
+
+	return cnt;
+}
+
+
+void dc_jobqueue_remove_actions(dc_jobqueue_t* jobqueue, int action1, int action2)
+{
+	if (jobqueue==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&jobqueue->mutex);
+		for (int t = 0; t <= 1; t++) {
+			dc_jobheap_t* heap = get_heap(jobqueue, t==0? DC_IMAP_THREAD : DC_SMTP_THREAD);
+			for (int i = 0; i < heap->cnt; ) {
+				if (heap->entries[i].action==action1 || heap->entries[i].action==action2) {
+					free(heap->entries[i].param);
+					heap->entries[i] = heap->entries[--heap->cnt];
+				}
+				else {
+					i++;
+				}
+			}
+			heap_rebuild(heap);
+		}
+	pthread_mutex_unlock(&jobqueue->mutex);
+}
+
+
+time_t dc_jobqueue_get_next_timestamp(dc_jobqueue_t* jobqueue, int thread)
+{
+	time_t        ret = 0;
+	dc_jobheap_t* heap = NULL;
+
+	if (jobqueue==NULL) {
+		return 0;
+	}
+
+	load_if_needed(jobqueue);
+
+	pthread_mutex_lock(&jobqueue->mutex);
+
+		heap = get_heap(jobqueue, thread);
+		if (heap->cnt > 0) {
+			ret = DC_MAX(heap->entries[0].desired_timestamp, 1); // 0 is returned only if there are no jobs
+		}
+
+	pthread_mutex_unlock(&jobqueue->mutex);
+
+	return ret;
+}
+
+
+void dc_jobqueue_make_retries_due(dc_jobqueue_t* jobqueue, int thread)
+{
+	/* on interrupts, eg. as the network is available again, failed jobs are tried again at once;
+	jobs added with a delay keep their timestamp */
+	int           changed = 0;
+	dc_jobheap_t* heap = NULL;
+
+	if (jobqueue==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&jobqueue->mutex);
+		heap = get_heap(jobqueue, thread);
+		for (int i = 0; i < heap->cnt; i++) {
+			if (heap->entries[i].is_retry && heap->entries[i].desired_timestamp!=0) {
+				heap->entries[i].desired_timestamp = 0;
+				changed = 1;
+			}
+		}
+		if (changed) {
+			heap_rebuild(heap);
+		}
+	pthread_mutex_unlock(&jobqueue->mutex);
+}
+
+
+void dc_jobqueue_end_transaction(dc_jobqueue_t* jobqueue, int commit)
+{
+	/* only the thread owning the transaction adds deferred jobs, so all deferred jobs belong to the ended transaction */
+	if (jobqueue==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&jobqueue->mutex);
+		for (int t = 0; t <= 1; t++) {
+			int           thread = t==0? DC_IMAP_THREAD : DC_SMTP_THREAD;
+			dc_jobheap_t* deferred = get_deferred(jobqueue, thread);
+			if (commit && jobqueue->loaded) { // if the queue was reset in between, the jobs are loaded from the database
+				for (int i = 0; i < deferred->cnt; i++) {
+					heap_push(get_heap(jobqueue, thread), &deferred->entries[i]);
+				}
+			}
+			heap_empty(deferred);
+		}
+	pthread_mutex_unlock(&jobqueue->mutex);
+}
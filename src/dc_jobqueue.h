@@ -0,0 +1,81 @@
+/* Purpose: Keep the pending jobs of the IMAP- and the SMTP-thread in memory.
+The jobs table is only written on changes and read once after the database is opened.
+The mutex only guards the memory, the jobs table is never accessed while holding it. */
+
+
+#ifndef __DC_JOBQUEUE_H__
+#define __DC_JOBQUEUE_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Library-internal.
+ * One pending job, a copy of the row in the jobs table.
+ */
+typedef struct dc_jobqueue_entry_t
+{
+	/** @privatesection */
+
+	uint32_t    job_id;
+	int         action;
+	uint32_t    foreign_id;
+	char*       param;             // packed dc_param_t, owned by the entry
+	time_t      added_timestamp;
+	time_t      desired_timestamp; // 0=as soon as possible
+	int         is_retry;          // the desired_timestamp was set by a retry; dc_jobqueue_make_retries_due() may reset it
+} dc_jobqueue_entry_t;
+
+
+/**
+ * Library-internal.
+ * A binary min-heap, the top is the job to perform next.
+ */
+typedef struct dc_jobheap_t
+{
+	/** @privatesection */
+
+	dc_jobqueue_entry_t* entries;
+	int                  cnt;
+	int                  allocated;
+} dc_jobheap_t;
+
+
+/**
+ * Library-internal.
+ */
+typedef struct dc_jobqueue_t
+{
+	/** @privatesection */
+
+	dc_context_t*    context;
+	pthread_mutex_t  mutex;
+	int              loaded;       // 0=the heaps are (re-)loaded from the jobs table on the next access
+	int              generation;   // changed on resets and on jobs added while not loaded; a load started before is read again
+	uint32_t         last_job_id;  // job IDs are assigned by us to get them without a race condition; kept on resets
+	dc_jobheap_t     imap_heap;
+	dc_jobheap_t     smtp_heap;
+	dc_jobheap_t     imap_deferred; // jobs added inside a transaction, moved to the heaps when the transaction is committed
+	dc_jobheap_t     smtp_deferred;
+} dc_jobqueue_t;
+
+
+dc_jobqueue_t* dc_jobqueue_new                (dc_context_t*);
+void           dc_jobqueue_unref              (dc_jobqueue_t*);
+void           dc_jobqueue_reset              (dc_jobqueue_t*); /* forget all jobs, they're reloaded from the database on the next access */
+
+uint32_t       dc_jobqueue_add                (dc_jobqueue_t*, int thread, int action, uint32_t foreign_id, const char* param, time_t desired_timestamp); /* also writes the job to the database */
+void           dc_jobqueue_push               (dc_jobqueue_t*, int thread, const dc_jobqueue_entry_t*); /* memory only, the entry is copied */
+int            dc_jobqueue_pop_due            (dc_jobqueue_t*, int thread, time_t now, dc_jobqueue_entry_t* ret_entry); /* memory only, the param must be free()'d */
+int            dc_jobqueue_pop_due_action     (dc_jobqueue_t*, int thread, int action, time_t now, dc_jobqueue_entry_t* ret_entries, int max_entries);
+void           dc_jobqueue_remove_actions     (dc_jobqueue_t*, int action1, int action2); /* memory only */
+time_t         dc_jobqueue_get_next_timestamp (dc_jobqueue_t*, int thread); /* 0 if there are no jobs */
+void           dc_jobqueue_make_retries_due   (dc_jobqueue_t*, int thread);
+void           dc_jobqueue_end_transaction    (dc_jobqueue_t*, int commit); /* called by the outermost dc_sqlite3_commit() or dc_sqlite3_rollback() */
+
+
+#ifdef __cplusplus
+} /* /extern "C" */
+#endif
+#endif /* __DC_JOBQUEUE_H__ */
@@ -2,6 +2,7 @@
 #include <memory.h>
 #include "dc_context.h"
 #include "dc_key.h"
+#include "dc_keyring.h"
 #include "dc_pgp.h"
 #include "dc_tools.h"
 
@@ -230,6 +231,7 @@ int dc_key_save_self_keypair(const dc_key_t* public_key, const dc_key_t* private
 
 cleanup:
 	sqlite3_finalize(stmt);
+	dc_key_forget_self_keys(dc_key_self_keys_context(sql)); /* also the default key may have changed */
 	return success;
 }
 
@@ -263,12 +265,28 @@ int dc_key_load_self_private(dc_key_t* key, const char* self_addr, dc_sqlite3_t*
 {
 	int           success = 0;
 	sqlite3_stmt* stmt = NULL;
+	dc_context_t* context = dc_key_self_keys_context(sql);
+	uint32_t      generation = 0;
 
 	if (key==NULL || self_addr==NULL || sql==NULL) {
 		goto cleanup;
 	}
 
 	dc_key_empty(key);
+
+	if (context) {
+		pthread_mutex_lock(&context->self_keys_critical);
+			if (context->self_private_key && context->self_keys_addr && strcmp(context->self_keys_addr, self_addr)==0) {
+				dc_key_set_from_key(key, context->self_private_key);
+				success = 1;
+			}
+			generation = context->self_keys_generation;
+		pthread_mutex_unlock(&context->self_keys_critical);
+		if (success) {
+			goto cleanup;
+		}
+	}
+
 	stmt = dc_sqlite3_prepare(sql,
 		"SELECT private_key FROM keypairs WHERE addr=? AND is_default=1;");
 	sqlite3_bind_text (stmt, 1, self_addr, -1, SQLITE_STATIC);
@@ -278,12 +296,91 @@ int dc_key_load_self_private(dc_key_t* key, const char* self_addr, dc_sqlite3_t*
 	dc_key_set_from_stmt(key, stmt, 0, DC_KEY_PRIVATE);
 	success = 1;
 
+	if (context) {
+		pthread_mutex_lock(&context->self_keys_critical);
+			if (dc_key_use_self_keys_addr(context, self_addr, generation) && context->self_private_key==NULL) {
+				context->self_private_key = dc_key_new();
+				dc_key_set_from_key(context->self_private_key, key);
+			}
+		pthread_mutex_unlock(&context->self_keys_critical);
+	}
+
 cleanup:
 	sqlite3_finalize(stmt);
 	return success;
 }
 
 
+/**
+ * Get the context whose own keys are cached for the given database.
+ * Keys are only cached for the database of the context, not eg. for a backup being imported.
+ *
+ * @private @memberof dc_context_t
+ */
+dc_context_t* dc_key_self_keys_context(dc_sqlite3_t* sql)
+{
+	if (sql==NULL || sql->context==NULL || sql->context->sql!=sql) {
+		return NULL;
+	}
+	return sql->context;
+}
+
+
+/**
+ * Prepare caching own keys loaded for the given address.
+ * The caller must hold self_keys_critical. Nothing should be cached if the keys
+ * were forgotten since the given generation, the loaded keys may be outdated then.
+ *
+ * @private @memberof dc_context_t
+ * @return 1=the keys can be cached, 0=do not cache the keys
+ */
+int dc_key_use_self_keys_addr(dc_context_t* context, const char* self_addr, uint32_t generation)
+{
+	if (generation!=context->self_keys_generation) {
+		return 0;
+	}
+
+	if (context->self_keys_addr==NULL || strcmp(context->self_keys_addr, self_addr)!=0) {
+		dc_key_unref(context->self_private_key);
+		context->self_private_key = NULL;
+		dc_keyring_unref(context->self_private_keyring);
+		context->self_private_keyring = NULL;
+		free(context->self_keys_addr);
+		context->self_keys_addr = dc_strdup(self_addr);
+	}
+
+	return 1;
+}
+
+
+/**
+ * Forget the cached own keys.
+ * Must be called whenever the table `keypairs` is modified.
+ * The private keys are wiped from memory,
+ * this also includes the keys parsed by the encryption engine.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_key_forget_self_keys(dc_context_t* context)
+{
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
+		return;
+	}
+
+	pthread_mutex_lock(&context->self_keys_critical);
+		dc_key_unref(context->self_private_key);
+		context->self_private_key = NULL;
+		dc_keyring_unref(context->self_private_keyring);
+		context->self_private_keyring = NULL;
+		free(context->self_keys_addr);
+		context->self_keys_addr = NULL;
+		context->self_keys_generation++;
+	pthread_mutex_unlock(&context->self_keys_critical);
+
+	dc_pgp_clear_key_cache();
+}
+
+
 /*******************************************************************************
  * Render keys
  ******************************************************************************/
@@ -42,6 +42,10 @@ int       dc_key_save_self_keypair        (const dc_key_t* public_key, const dc_
 int       dc_key_load_self_public         (dc_key_t*, const char* self_addr, dc_sqlite3_t* sql);
 int       dc_key_load_self_private        (dc_key_t*, const char* self_addr, dc_sqlite3_t* sql);
 
+dc_context_t* dc_key_self_keys_context    (dc_sqlite3_t*); /* the context, if the own keys of the database are cached, else NULL */
+int       dc_key_use_self_keys_addr       (dc_context_t*, const char* self_addr, uint32_t generation);
+void      dc_key_forget_self_keys         (dc_context_t*); /* call after modifying the table `keypairs` */
+
 char*     dc_render_base64                (const void* buf, size_t buf_bytes, int break_every, const char* break_chars, int add_checksum); /* the result must be freed */
 char*     dc_key_render_base64            (const dc_key_t*, int break_every, const char* break_chars, int add_checksum); /* the result must be freed */
 char*     dc_key_render_asc               (const dc_key_t*, const char* add_header_lines); /* each header line must be terminated by \r\n, the result must be freed */
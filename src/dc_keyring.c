@@ -50,24 +50,68 @@ void dc_keyring_add(dc_keyring_t* keyring, dc_key_t* to_add)
 }
 
 
+static void add_key_copies(dc_keyring_t* keyring, const dc_keyring_t* src)
+{
+	/* the keys are copied, the reference counters of the keys are not thread-safe */
+	for (int i = 0; i < src->count; i++) {
+		dc_key_t* key = dc_key_new();
+			dc_key_set_from_key(key, src->keys[i]);
+			dc_keyring_add(keyring, key);
+		dc_key_unref(key);
+	}
+}
+
+
 int dc_keyring_load_self_private_for_decrypting(dc_keyring_t* keyring, const char* self_addr, dc_sqlite3_t* sql)
 {
+	dc_context_t* context = dc_key_self_keys_context(sql);
+	dc_keyring_t* loaded = NULL;
+	uint32_t      generation = 0;
+	int           cached = 0;
+
 	if (keyring==NULL || self_addr==NULL || sql==NULL) {
 		return 0;
 	}
 
+	if (context) {
+		pthread_mutex_lock(&context->self_keys_critical);
+			if (context->self_private_keyring && context->self_keys_addr && strcmp(context->self_keys_addr, self_addr)==0) {
+				add_key_copies(keyring, context->self_private_keyring);
+				cached = 1;
+			}
+			generation = context->self_keys_generation;
+		pthread_mutex_unlock(&context->self_keys_critical);
+		if (cached) {
+			return 1;
+		}
+	}
+
+	loaded = dc_keyring_new();
+
 	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql,
 		"SELECT private_key FROM keypairs ORDER BY addr=? DESC, is_default DESC;");
 	sqlite3_bind_text (stmt, 1, self_addr, -1, SQLITE_STATIC);
 	while (sqlite3_step(stmt) == SQLITE_ROW) {
 		dc_key_t* key = dc_key_new();
 			if (dc_key_set_from_stmt(key, stmt, 0, DC_KEY_PRIVATE)) {
-				dc_keyring_add(keyring, key);
+				dc_keyring_add(loaded, key);
 			}
 		dc_key_unref(key); /* unref in any case, dc_keyring_add() adds its own reference */
 	}
 	sqlite3_finalize(stmt);
 
+	add_key_copies(keyring, loaded);
+
+	if (context) {
+		pthread_mutex_lock(&context->self_keys_critical);
+			if (dc_key_use_self_keys_addr(context, self_addr, generation) && context->self_private_keyring==NULL) {
+				context->self_private_keyring = loaded;
+				loaded = NULL;
+			}
+		pthread_mutex_unlock(&context->self_keys_critical);
+	}
+
+	dc_keyring_unref(loaded);
 	return 1;
 }
 
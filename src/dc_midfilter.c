@@ -0,0 +1,236 @@
+#include "dc_context.h"
+#include "dc_midfilter.h"
+
+
+static void get_hashes(const char* rfc724_mid, uint32_t* h1, uint32_t* h2)
+{
+	/* FNV-1a; the k hash functions are derived by double hashing from the two halves */
+	uint64_t             hash = 14695981039346656037ULL;
+	const unsigned char* p = (const unsigned char*)rfc724_mid;
+
+	for ( ; *p; p++) {
+		hash ^= *p;
+		hash *= 1099511628211ULL;
+	}
+
+	*h1 = (uint32_t)hash;
+	*h2 = (uint32_t)(hash>>32) | 1;
+}
+
+
+static void add_entry(dc_midfilter_t* filter, const char* rfc724_mid)
+{
+	uint32_t h1 = 0, h2 = 0;
+	int      i = 0;
+
+	get_hashes(rfc724_mid, &h1, &h2);
+	for (i = 0; i < DC_MIDFILTER_HASH_CNT; i++) {
+		size_t  bit = (h1 + (uint64_t)i*h2) % filter->bits_cnt;
+		uint8_t mask = 1<<(bit&7);
+		if (!(filter->bits[bit>>3]&mask)) {
+			filter->bits[bit>>3] |= mask;
+			filter->set_bits_cnt++;
+		}
+	}
+	filter->entry_cnt++;
+}
+
+
+static void build_locked(dc_midfilter_t* filter, dc_sqlite3_t* sql)
+{
+	/* the caller must hold the mutex; adding messages while building would get lost otherwise */
+	sqlite3_stmt* stmt = NULL;
+	size_t        msg_cnt = 0;
+
+	free(filter->bits);
+	filter->bits = NULL;
+	filter->sql = NULL;
+
+	stmt = dc_sqlite3_prepare(sql, "SELECT COUNT(*) FROM msgs;");
+	if (sqlite3_step(stmt)!=SQLITE_ROW) {
+		goto cleanup;
+	}
+	msg_cnt = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	filter->capacity     = DC_MIDFILTER_MIN_CAPACITY;
+	while (filter->capacity < msg_cnt*2) {
+		filter->capacity *= 2;
+	}
+	filter->bits_cnt     = filter->capacity*DC_MIDFILTER_BITS_PER_ENTRY;
+	filter->set_bits_cnt = 0;
+	filter->entry_cnt    = 0;
+	filter->removed_cnt  = 0;
+	if ((filter->bits=calloc(1, filter->bits_cnt/8+1))==NULL) {
+		goto cleanup;
+	}
+
+	/* one pass over the Message-IDs, the rows are not held in memory */
+	stmt = dc_sqlite3_prepare(sql, "SELECT rfc724_mid FROM msgs WHERE rfc724_mid!='';");
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		const char* rfc724_mid = (const char*)sqlite3_column_text(stmt, 0);
+		if (rfc724_mid) {
+			add_entry(filter, rfc724_mid);
+		}
+	}
+
+	filter->sql = sql;
+
+cleanup:
+	sqlite3_finalize(stmt);
+}
+
+
+dc_midfilter_t* dc_midfilter_new()
+{
+	dc_midfilter_t* filter = NULL;
+
+	if ((filter=calloc(1, sizeof(dc_midfilter_t)))==NULL) {
+		exit(58);
+	}
+
+	pthread_mutex_init(&filter->mutex, NULL);
+
+	return filter;
+}
+
+
+void dc_midfilter_unref(dc_midfilter_t* filter)
+{
+	if (filter==NULL) {
+		return;
+	}
+
+	free(filter->bits);
+	pthread_mutex_destroy(&filter->mutex);
+	free(filter);
+}
+
+
+void dc_midfilter_build(dc_midfilter_t* filter, dc_sqlite3_t* sql)
+{
+	if (filter==NULL || sql==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&filter->mutex);
+		build_locked(filter, sql);
+	pthread_mutex_unlock(&filter->mutex);
+}
+
+
+void dc_midfilter_reset(dc_midfilter_t* filter)
+{
+	if (filter==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&filter->mutex);
+		free(filter->bits);
+		filter->bits = NULL;
+		filter->sql = NULL;
+	pthread_mutex_unlock(&filter->mutex);
+}
+
+
+void dc_midfilter_add(dc_midfilter_t* filter, const char* rfc724_mid)
+{
+	if (filter==NULL || rfc724_mid==NULL || rfc724_mid[0]==0) {
+		return;
+	}
+
+	pthread_mutex_lock(&filter->mutex);
+
+		if (filter->sql) {
+			add_entry(filter, rfc724_mid);
+
+			/* the new entry is already in the database, so it is also added when rebuilding */
+			if (filter->entry_cnt > filter->capacity) {
+				build_locked(filter, filter->sql);
+			}
+		}
+
+	pthread_mutex_unlock(&filter->mutex);
+}
+
+
+void dc_midfilter_removed(dc_midfilter_t* filter, int cnt)
+{
+	if (filter==NULL || cnt<=0) {
+		return;
+	}
+
+	pthread_mutex_lock(&filter->mutex);
+
+		if (filter->sql) {
+			filter->removed_cnt += cnt;
+			if (filter->removed_cnt > filter->entry_cnt/2 && filter->removed_cnt > DC_MIDFILTER_MIN_CAPACITY) {
+				build_locked(filter, filter->sql);
+			}
+		}
+
+	pthread_mutex_unlock(&filter->mutex);
+}
+
+
+int dc_midfilter_may_contain(dc_midfilter_t* filter, const char* rfc724_mid)
+{
+	int      may_contain = 1;
+	uint32_t h1 = 0, h2 = 0;
+	int      i = 0;
+
+	if (filter==NULL || rfc724_mid==NULL) {
+		return 1;
+	}
+
+	get_hashes(rfc724_mid, &h1, &h2);
+
+	pthread_mutex_lock(&filter->mutex);
+
+		if (filter->sql) {
+			filter->lookups++;
+			for (i = 0; i < DC_MIDFILTER_HASH_CNT; i++) {
+				size_t bit = (h1 + (uint64_t)i*h2) % filter->bits_cnt;
+				if (!(filter->bits[bit>>3]&(1<<(bit&7)))) {
+					may_contain = 0;
+					filter->negatives++;
+					break;
+				}
+			}
+		}
+
+	pthread_mutex_unlock(&filter->mutex);
+
+	return may_contain;
+}
+
+
+char* dc_midfilter_get_info(dc_midfilter_t* filter)
+{
+	char* ret = NULL;
+
+	if (filter==NULL) {
+		return dc_strdup("0");
+	}
+
+	pthread_mutex_lock(&filter->mutex);
+
+		if (filter->sql==NULL) {
+			ret = dc_strdup("0");
+		}
+		else {
+			/* the probability that all bits checked for an unknown Message-ID are set */
+			double fill_ratio = (double)filter->set_bits_cnt/filter->bits_cnt, false_positives = 1.0;
+			for (int i = 0; i < DC_MIDFILTER_HASH_CNT; i++) {
+				false_positives *= fill_ratio;
+			}
+			ret = dc_mprintf("%i/%i entries, %i removed, %i KB, %.2f%% false positives, %i of %i lookups answered",
+				(int)filter->entry_cnt, (int)filter->capacity, (int)filter->removed_cnt, (int)(filter->bits_cnt/8/1024),
+				false_positives*100.0, filter->negatives, filter->lookups);
+		}
+
+	pthread_mutex_unlock(&filter->mutex);
+
+	return ret;
+}
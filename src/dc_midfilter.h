@@ -0,0 +1,54 @@
+/* Purpose: Bloom filter of the Message-IDs (rfc724_mid) in the database.
+Most Message-IDs looked up on receiving are unknown, eg. on rescanning folders,
+the filter answers these lookups without accessing the database.
+Deleted messages cannot be removed from a Bloom filter, they only increase the false positives
+until the filter is rebuilt. */
+
+
+#ifndef __DC_MIDFILTER_H__
+#define __DC_MIDFILTER_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define DC_MIDFILTER_BITS_PER_ENTRY   10 // with 7 hash functions, this results in about 1% false positives
+#define DC_MIDFILTER_HASH_CNT          7
+#define DC_MIDFILTER_MIN_CAPACITY   4096
+
+
+/**
+ * Library-internal.
+ */
+typedef struct dc_midfilter_t
+{
+	/** @privatesection */
+
+	pthread_mutex_t mutex;
+	dc_sqlite3_t*   sql;          // the database the filter is built for, NULL if not built; lookups are not answered then
+	uint8_t*        bits;
+	size_t          bits_cnt;
+	size_t          set_bits_cnt; // used to estimate the false positive rate
+	size_t          capacity;     // the filter is rebuilt with a larger size if more entries are added
+	size_t          entry_cnt;
+	size_t          removed_cnt;  // the filter is rebuilt if many entries are removed
+	int             lookups;
+	int             negatives;    // lookups answered without accessing the database
+} dc_midfilter_t;
+
+
+dc_midfilter_t* dc_midfilter_new          ();
+void            dc_midfilter_unref        (dc_midfilter_t*);
+
+void            dc_midfilter_build        (dc_midfilter_t*, dc_sqlite3_t*); /* load all Message-IDs from the database */
+void            dc_midfilter_reset        (dc_midfilter_t*); /* call when the database is closed */
+void            dc_midfilter_add          (dc_midfilter_t*, const char* rfc724_mid); /* call after a message is inserted */
+void            dc_midfilter_removed      (dc_midfilter_t*, int cnt); /* call after messages are deleted */
+int             dc_midfilter_may_contain  (dc_midfilter_t*, const char* rfc724_mid); /* 0=the Message-ID is surely not in the database */
+char*           dc_midfilter_get_info     (dc_midfilter_t*); /* the returned string must be free()'d */
+
+
+#ifdef __cplusplus
+} /* /extern "C" */
+#endif
+#endif /* __DC_MIDFILTER_H__ */
@@ -19,6 +19,7 @@ void dc_mimefactory_init(dc_mimefactory_t* factory, dc_context_t* context)
 
 	memset(factory, 0, sizeof(dc_mimefactory_t));
 	factory->context = context;
+	dc_arena_init(&factory->arena, 0);
 }
 
 
@@ -37,17 +38,15 @@ void dc_mimefactory_empty(dc_mimefactory_t* factory)
 	free(factory->selfstatus);
 	factory->selfstatus = NULL;
 
-	free(factory->rfc724_mid);
 	factory->rfc724_mid = NULL;
 
+	/* the list contents are allocated from the arena */
 	if (factory->recipients_names) {
-		clist_free_content(factory->recipients_names);
 		clist_free(factory->recipients_names);
 		factory->recipients_names = NULL;
 	}
 
 	if (factory->recipients_addr) {
-		clist_free_content(factory->recipients_addr);
 		clist_free(factory->recipients_addr);
 		factory->recipients_addr = NULL;
 	}
@@ -58,7 +57,6 @@ void dc_mimefactory_empty(dc_mimefactory_t* factory)
 	dc_chat_unref(factory->chat);
 	factory->chat = NULL;
 
-	free(factory->predecessor);
 	factory->predecessor = NULL;
 
 	free(factory->references);
@@ -75,6 +73,8 @@ void dc_mimefactory_empty(dc_mimefactory_t* factory)
 	factory->error = NULL;
 
 	factory->timestamp = 0;
+
+	dc_arena_clear(&factory->arena);
 }
 
 
@@ -128,8 +128,8 @@ int dc_mimefactory_load_msg(dc_mimefactory_t* factory, uint32_t msg_id)
 
 			if (dc_chat_is_self_talk(factory->chat))
 			{
-				clist_append(factory->recipients_names, (void*)dc_strdup_keep_null(factory->from_displayname));
-				clist_append(factory->recipients_addr,  (void*)dc_strdup(factory->from_addr));
+				clist_append(factory->recipients_names, (void*)(factory->from_displayname? dc_arena_strdup(&factory->arena, factory->from_displayname) : NULL));
+				clist_append(factory->recipients_addr,  (void*)dc_arena_strdup(&factory->arena, factory->from_addr));
 			}
 			else
 			{
@@ -145,8 +145,8 @@ int dc_mimefactory_load_msg(dc_mimefactory_t* factory, uint32_t msg_id)
 					const char* addr                = (const char*)sqlite3_column_text(stmt, 1);
 					if (clist_search_string_nocase(factory->recipients_addr, addr)==0)
 					{
-						clist_append(factory->recipients_names, (void*)((authname&&authname[0])? dc_strdup(authname) : NULL));
-						clist_append(factory->recipients_addr,  (void*)dc_strdup(addr));
+						clist_append(factory->recipients_names, (void*)((authname&&authname[0])? dc_arena_strdup(&factory->arena, authname) : NULL));
+						clist_append(factory->recipients_addr,  (void*)dc_arena_strdup(&factory->arena, addr));
 					}
 				}
 				sqlite3_finalize(stmt);
@@ -161,9 +161,10 @@ int dc_mimefactory_load_msg(dc_mimefactory_t* factory, uint32_t msg_id)
 						if (clist_search_string_nocase(factory->recipients_addr, email_to_remove)==0)
 						{
 							clist_append(factory->recipients_names, NULL);
-							clist_append(factory->recipients_addr,  (void*)email_to_remove);
+							clist_append(factory->recipients_addr,  (void*)dc_arena_strdup(&factory->arena, email_to_remove));
 						}
 					}
+					free(email_to_remove);
 					free(self_addr);
 				}
 
@@ -185,16 +186,21 @@ int dc_mimefactory_load_msg(dc_mimefactory_t* factory, uint32_t msg_id)
 			disturb other mailers.
 
 			Finally, maybe the Predecessor/In-Reply-To header is not needed for all answers but only to the first ones -
-			or after the sender has changes its email address. */
-			stmt = dc_sqlite3_prepare(context->sql,
-				"SELECT rfc724_mid FROM msgs WHERE timestamp=(SELECT max(timestamp) FROM msgs WHERE chat_id=? AND from_id!=?);");
-			sqlite3_bind_int  (stmt, 1, factory->msg->chat_id);
-			sqlite3_bind_int  (stmt, 2, DC_CONTACT_ID_SELF);
-			if (sqlite3_step(stmt)==SQLITE_ROW) {
-				factory->predecessor = dc_strdup_keep_null((const char*)sqlite3_column_text(stmt, 0));
+			or after the sender has changes its email address.
+
+			Messages sent using dc_send_msg_to_chats() do not get a predecessor: the header differs from chat to chat
+			and, as being protected, would prevent sharing the signed body. */
+			if (!dc_param_exists(factory->msg->param, DC_PARAM_SHARED_ID)) {
+				stmt = dc_sqlite3_prepare(context->sql,
+					"SELECT rfc724_mid FROM msgs WHERE timestamp=(SELECT max(timestamp) FROM msgs WHERE chat_id=? AND from_id!=?);");
+				sqlite3_bind_int  (stmt, 1, factory->msg->chat_id);
+				sqlite3_bind_int  (stmt, 2, DC_CONTACT_ID_SELF);
+				if (sqlite3_step(stmt)==SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+					factory->predecessor = dc_arena_strdup(&factory->arena, (const char*)sqlite3_column_text(stmt, 0));
+				}
+				sqlite3_finalize(stmt);
+				stmt = NULL;
 			}
-			sqlite3_finalize(stmt);
-			stmt = NULL;
 
 			/* get a References:-header: either the same as the last one or a random one.
 			To avoid endless nested threads, we do not use In-Reply-To: here but link subsequent mails to the same reference.
@@ -228,7 +234,7 @@ int dc_mimefactory_load_msg(dc_mimefactory_t* factory, uint32_t msg_id)
 			success = 1;
 			factory->loaded = DC_MF_MSG_LOADED;
 			factory->timestamp = factory->msg->timestamp;
-			factory->rfc724_mid = dc_strdup(factory->msg->rfc724_mid);
+			factory->rfc724_mid = dc_arena_strdup(&factory->arena, factory->msg->rfc724_mid);
 		}
 
 		if (success) {
@@ -273,13 +279,15 @@ int dc_mimefactory_load_mdn(dc_mimefactory_t* factory, uint32_t msg_id)
 		goto cleanup;
 	}
 
-	clist_append(factory->recipients_names, (void*)((contact->authname&&contact->authname[0])? dc_strdup(contact->authname) : NULL));
-	clist_append(factory->recipients_addr,  (void*)dc_strdup(contact->addr));
+	clist_append(factory->recipients_names, (void*)((contact->authname&&contact->authname[0])? dc_arena_strdup(&factory->arena, contact->authname) : NULL));
+	clist_append(factory->recipients_addr,  (void*)dc_arena_strdup(&factory->arena, contact->addr));
 
 	load_from(factory);
 
 	factory->timestamp = dc_create_smeared_timestamp(factory->context);
-	factory->rfc724_mid = dc_create_outgoing_rfc724_mid(NULL, factory->from_addr);
+	char* rfc724_mid = dc_create_outgoing_rfc724_mid(NULL, factory->from_addr);
+	factory->rfc724_mid = dc_arena_strdup(&factory->arena, rfc724_mid);
+	free(rfc724_mid);
 
 	success = 1;
 	factory->loaded = DC_MF_MDN_LOADED;
@@ -469,8 +477,8 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 {
 	struct mailimf_fields* imf_fields = NULL;
 	struct mailmime*       message = NULL;
-	char*                  message_text = NULL;
-	char*                  message_text2 = NULL;
+	char*                  message_text = NULL;  // allocated from the arena, mailmime_set_body_text() does not take ownership
+	char*                  message_text2 = NULL; //   - " --
 	char*                  subject_str = NULL;
 	int                    afwd_email = 0;
 	int                    col = 0;
@@ -480,6 +488,7 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 	int                    min_verified = DC_NOT_VERIFIED;
 	int                    force_plaintext = 0; // 1=add Autocrypt-header (needed eg. for handshaking), 2=no Autocrypte-header (used for MDN)
 	char*                  grpimage = NULL;
+	char*                  shared_id = NULL;
 	dc_e2ee_helper_t       e2ee_helper;
 	memset(&e2ee_helper, 0, sizeof(dc_e2ee_helper_t));
 
@@ -668,9 +677,9 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 		- we can add "forward hints" this way
 		- it looks better */
 		afwd_email = dc_param_exists(msg->param, DC_PARAM_FORWARDED);
-		char* fwdhint = NULL;
+		const char* fwdhint = NULL;
 		if (afwd_email) {
-			fwdhint = dc_strdup("---------- Forwarded message ----------" LINEEND "From: Delta Chat" LINEEND LINEEND); /* do not chage this! expected this way in the simplifier to detect forwarding! */
+			fwdhint = "---------- Forwarded message ----------" LINEEND "From: Delta Chat" LINEEND LINEEND; /* do not chage this! expected this way in the simplifier to detect forwarding! */
 		}
 
 		const char* final_text = NULL;
@@ -682,7 +691,7 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 		}
 
 		char* footer = factory->selfstatus;
-		message_text = dc_mprintf("%s%s%s%s%s",
+		message_text = dc_arena_mprintf(&factory->arena, "%s%s%s%s%s",
 			fwdhint? fwdhint : "",
 			final_text? final_text : "",
 			(final_text&&footer&&footer[0])? (LINEEND LINEEND) : "",
@@ -692,7 +701,6 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 		mailmime_smart_add_part(message, text_part);
 		parts++;
 
-		free(fwdhint);
 		free(placeholdertext);
 
 		/* add attachment part */
@@ -740,7 +748,7 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 			p1 = dc_msg_get_summarytext(factory->msg, DC_APPROX_SUBJECT_CHARS);
 		}
 		p2 = dc_stock_str_repl_string(factory->context, DC_STR_READRCPT_MAILBODY, p1);
-		message_text = dc_mprintf("%s" LINEEND, p2);
+		message_text = dc_arena_mprintf(&factory->arena, "%s" LINEEND, p2);
 		free(p2);
 		free(p1);
 
@@ -749,7 +757,7 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 
 
 		/* second body part: machine-readable, always REQUIRED by RFC 6522 */
-		message_text2 = dc_mprintf(
+		message_text2 = dc_arena_mprintf(&factory->arena,
 			"Reporting-UA: Delta Chat %s" LINEEND
 			"Original-Recipient: rfc822;%s" LINEEND
 			"Final-Recipient: rfc822;%s" LINEEND
@@ -798,7 +806,10 @@ int dc_mimefactory_render(dc_mimefactory_t* factory)
 	mailimf_fields_add(imf_fields, mailimf_field_new(MAILIMF_FIELD_SUBJECT, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, subject, NULL, NULL, NULL));
 
 	if (force_plaintext!=DC_FP_NO_AUTOCRYPT_HEADER) {
-		dc_e2ee_encrypt(factory->context, factory->recipients_addr, force_plaintext, e2ee_guaranteed, min_verified, message, &e2ee_helper);
+		if (factory->loaded==DC_MF_MSG_LOADED) {
+			shared_id = dc_param_get(factory->msg->param, DC_PARAM_SHARED_ID, NULL);
+		}
+		dc_e2ee_encrypt(factory->context, factory->recipients_addr, force_plaintext, e2ee_guaranteed, min_verified, shared_id, message, &e2ee_helper);
 	}
 
 	if (e2ee_helper.encryption_successfull) {
@@ -818,10 +829,9 @@ cleanup:
 		mailmime_free(message);
 	}
 	dc_e2ee_thanks(&e2ee_helper); // frees data referenced by "mailmime" but not freed by mailmime_free()
-	free(message_text);           // mailmime_set_body_text() does not take ownership of "text"
-	free(message_text2);          //   - " --
 	free(subject_str);
 	free(grpimage);
+	free(shared_id);
 	return success;
 }
 
@@ -5,6 +5,8 @@ extern "C" {
 #endif
 
 
+#include "dc_arena.h"
+
 
 #define DC_CMD_GROUPNAME_CHANGED           2
 #define DC_CMD_GROUPIMAGE_CHANGED          3
@@ -54,6 +56,7 @@ typedef struct dc_mimefactory_t {
 
 	/* private */
 	dc_context_t* context;
+	dc_arena_t    arena;      /* recipients, rfc724_mid, predecessor and the texts used while rendering, cleared by dc_mimefactory_empty() */
 
 } dc_mimefactory_t;
 
@@ -485,6 +485,21 @@ struct mailmime_parameter* mailmime_find_ct_parameter(struct mailmime* mime, con
 }
 
 
+static int mailmime_get_transfer_encoding(struct mailmime* mime)
+{
+	if (mime->mm_mime_fields!=NULL) {
+		clistiter* cur;
+		for (cur = clist_begin(mime->mm_mime_fields->fld_list); cur!=NULL; cur = clist_next(cur)) {
+			struct mailmime_field* field = (struct mailmime_field*)clist_content(cur);
+			if (field && field->fld_type==MAILMIME_FIELD_TRANSFER_ENCODING && field->fld_data.fld_encoding) {
+				return field->fld_data.fld_encoding->enc_type;
+			}
+		}
+	}
+	return MAILMIME_MECHANISM_BINARY;
+}
+
+
 int mailmime_transfer_decode(struct mailmime* mime, const char** ret_decoded_data, size_t* ret_decoded_data_bytes, char** ret_to_mmap_string_unref)
 {
 	int                   mime_transfer_encoding = MAILMIME_MECHANISM_BINARY;
@@ -499,17 +514,7 @@ int mailmime_transfer_decode(struct mailmime* mime, const char** ret_decoded_dat
 	}
 
 	mime_data = mime->mm_data.mm_single;
-
-	if (mime->mm_mime_fields!=NULL) {
-		clistiter* cur;
-		for (cur = clist_begin(mime->mm_mime_fields->fld_list); cur!=NULL; cur = clist_next(cur)) {
-			struct mailmime_field* field = (struct mailmime_field*)clist_content(cur);
-			if (field && field->fld_type==MAILMIME_FIELD_TRANSFER_ENCODING && field->fld_data.fld_encoding) {
-				mime_transfer_encoding = field->fld_data.fld_encoding->enc_type;
-				break;
-			}
-		}
-	}
+	mime_transfer_encoding = mailmime_get_transfer_encoding(mime);
 
 	/* regard `Content-Transfer-Encoding:` */
 	if (mime_transfer_encoding==MAILMIME_MECHANISM_7BIT
@@ -768,13 +773,10 @@ static int mailmime_get_mime_type(struct mailmime* mime, int* msg_type)
  ******************************************************************************/
 
 
-static dc_mimepart_t* dc_mimepart_new(void)
+static dc_mimepart_t* dc_mimepart_new(dc_mimeparser_t* mimeparser)
 {
-	dc_mimepart_t* mimepart = NULL;
-
-	if ((mimepart=calloc(1, sizeof(dc_mimepart_t)))==NULL) {
-		exit(33);
-	}
+	/* the part and its texts are allocated from the arena and freed by dc_mimeparser_empty() */
+	dc_mimepart_t* mimepart = dc_arena_alloc(&mimeparser->arena, sizeof(dc_mimepart_t));
 
 	mimepart->type    = 0;
 	mimepart->param   = dc_param_new();
@@ -789,14 +791,11 @@ static void dc_mimepart_unref(dc_mimepart_t* mimepart)
 		return;
 	}
 
-	free(mimepart->msg);
 	mimepart->msg = NULL;
-
-	free(mimepart->msg_raw);
 	mimepart->msg_raw = NULL;
 
 	dc_param_unref(mimepart->param);
-	free(mimepart);
+	mimepart->param = NULL;
 }
 
 
@@ -828,6 +827,7 @@ dc_mimeparser_t* dc_mimeparser_new(const char* blobdir, dc_context_t* context)
 	mimeparser->e2ee_helper = calloc(1, sizeof(dc_e2ee_helper_t));
 
 	dc_hash_init(&mimeparser->header, DC_HASH_STRING, 0/* do not copy key */);
+	dc_arena_init(&mimeparser->arena, 0);
 
 	return mimeparser;
 }
@@ -858,6 +858,7 @@ void dc_mimeparser_unref(dc_mimeparser_t* mimeparser)
 		carray_free(mimeparser->reports);
 	}
 
+	dc_arena_clear(&mimeparser->arena);
 	free(mimeparser->e2ee_helper);
 	free(mimeparser);
 }
@@ -891,6 +892,8 @@ void dc_mimeparser_empty(dc_mimeparser_t* mimeparser)
 		carray_set_size(mimeparser->parts, 0);
 	}
 
+	dc_arena_reset(&mimeparser->arena); /* the parts were allocated from the arena */
+
 	mimeparser->header_root  = NULL; /* a pointer somewhere to the MIME data, must NOT be freed */
 	dc_hash_clear(&mimeparser->header);
 
@@ -936,24 +939,262 @@ static void do_add_single_part(dc_mimeparser_t* parser, dc_mimepart_t* part)
 }
 
 
+#define DC_DECODE_CHUNK_BYTES  65536  /* decoded data are written to the file in chunks of this size */
+#define DC_FILEMETA_HEAD_BYTES 131072 /* decoded bytes kept for dc_get_filemeta(), JPEG dimensions may follow larger EXIF data */
+
+
+typedef struct dc_decode_writer_t
+{
+	FILE*          f;
+	unsigned char  buf[DC_DECODE_CHUNK_BYTES];
+	size_t         buf_bytes;
+	size_t         total_bytes;
+	unsigned char* head;       /* NULL if not needed, otherwise DC_FILEMETA_HEAD_BYTES big */
+	size_t         head_bytes;
+	int            write_error;
+} dc_decode_writer_t;
+
+
+static void decode_writer_write(dc_decode_writer_t* w, const unsigned char* data, size_t bytes)
+{
+	if (w->head && w->head_bytes < DC_FILEMETA_HEAD_BYTES) {
+		size_t head_add = DC_FILEMETA_HEAD_BYTES-w->head_bytes;
+		if (head_add > bytes) { head_add = bytes; }
+		memcpy(w->head+w->head_bytes, data, head_add);
+		w->head_bytes += head_add;
+	}
+
+	if (!w->write_error && fwrite(data, 1, bytes, w->f)!=bytes) {
+		w->write_error = 1;
+	}
+
+	w->total_bytes += bytes;
+}
+
+
+static void decode_writer_flush(dc_decode_writer_t* w)
+{
+	if (w->buf_bytes) {
+		decode_writer_write(w, w->buf, w->buf_bytes);
+		w->buf_bytes = 0;
+	}
+}
+
+
+#define DECODE_WRITER_PUT(w, c) { \
+	if ((w)->buf_bytes==DC_DECODE_CHUNK_BYTES) { decode_writer_flush((w)); } \
+	(w)->buf[(w)->buf_bytes++] = (unsigned char)(c); }
+
+
+/* the value of each base64 character, -1 for characters not in the alphabet */
+static const signed char s_base64_values[256] = {
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
+	52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
+	-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
+	15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
+	-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+	41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+};
+
+
+static void decode_base64(dc_decode_writer_t* w, const unsigned char* src, size_t bytes)
+{
+	uint32_t quantum = 0;
+	int      quantum_chars = 0;
+	size_t   i = 0;
+
+	for (i = 0; i < bytes; i++) {
+		if (src[i]=='=') {
+			break;
+		}
+
+		int value = s_base64_values[src[i]];
+		if (value < 0) {
+			continue; /* line breaks and other characters not in the alphabet are ignored */
+		}
+
+		quantum = (quantum<<6) | value;
+		if (++quantum_chars==4) {
+			DECODE_WRITER_PUT(w, quantum>>16);
+			DECODE_WRITER_PUT(w, quantum>>8);
+			DECODE_WRITER_PUT(w, quantum);
+			quantum = 0;
+			quantum_chars = 0;
+		}
+	}
+
+	if (quantum_chars==2) {
+		DECODE_WRITER_PUT(w, quantum>>4);
+	}
+	else if (quantum_chars==3) {
+		DECODE_WRITER_PUT(w, quantum>>10);
+		DECODE_WRITER_PUT(w, quantum>>2);
+	}
+}
+
+
+static int hex_value(unsigned char c)
+{
+	if (c>='0' && c<='9') { return c-'0'; }
+	if (c>='A' && c<='F') { return c-'A'+10; }
+	if (c>='a' && c<='f') { return c-'a'+10; }
+	return -1;
+}
+
+
+static void decode_quoted_printable(dc_decode_writer_t* w, const unsigned char* src, size_t bytes)
+{
+	size_t i = 0, j = 0;
+
+	for (i = 0; i < bytes; i++) {
+		if (src[i]!='=') {
+			DECODE_WRITER_PUT(w, src[i]);
+			continue;
+		}
+
+		if (i+2 < bytes && hex_value(src[i+1])>=0 && hex_value(src[i+2])>=0) {
+			DECODE_WRITER_PUT(w, (hex_value(src[i+1])<<4) | hex_value(src[i+2]));
+			i += 2;
+			continue;
+		}
+
+		/* soft line break, possibly with trailing whitespace */
+		for (j = i+1; j < bytes && (src[j]==' ' || src[j]=='\t'); j++) {
+			;
+		}
+		if (j < bytes && src[j]=='\r') { j++; }
+		if (j==bytes || src[j]=='\n') {
+			i = j;
+			continue;
+		}
+
+		DECODE_WRITER_PUT(w, '='); /* not encoded correctly, take the character as is */
+	}
+}
+
+
+/**
+ * Decode the body of a mime part regarding the `Content-Transfer-Encoding:` and write it to a file.
+ *
+ * Other than mailmime_transfer_decode(), the decoded data are never held in memory completely:
+ * the body is read from the buffer given to dc_mimeparser_parse() and the decoded data are written in chunks.
+ * If ret_head is given, the first DC_FILEMETA_HEAD_BYTES decoded bytes are returned there,
+ * the returned buffer must be free()'d.
+ *
+ * @private @memberof dc_mimeparser_t
+ * @return 1=success, 0=error or no data; on errors, the file may be written partly.
+ */
+static int transfer_decode_to_file(dc_mimeparser_t* parser, struct mailmime* mime, const char* pathNfilename,
+                                   size_t* ret_bytes, unsigned char** ret_head, size_t* ret_head_bytes)
+{
+	int                   success = 0;
+	struct mailmime_data* mime_data = mime->mm_data.mm_single;
+	const unsigned char*  src = (const unsigned char*)mime_data->dt_data.dt_text.dt_data;
+	size_t                src_bytes = mime_data->dt_data.dt_text.dt_length;
+	char*                 pathNfilename_abs = NULL;
+	dc_decode_writer_t*   w = NULL;
+
+	if ((pathNfilename_abs=dc_get_abs_path(parser->context, pathNfilename))==NULL) {
+		goto cleanup;
+	}
+
+	if ((w=calloc(1, sizeof(dc_decode_writer_t)))==NULL) {
+		goto cleanup;
+	}
+
+	if (ret_head) {
+		if ((w->head=malloc(DC_FILEMETA_HEAD_BYTES))==NULL) {
+			goto cleanup;
+		}
+	}
+
+	if ((w->f=fopen(pathNfilename_abs, "wb"))==NULL) {
+		dc_log_warning(parser->context, 0, "Cannot open \"%s\" for writing.", pathNfilename);
+		goto cleanup;
+	}
+
+	switch (mailmime_get_transfer_encoding(mime))
+	{
+		case MAILMIME_MECHANISM_BASE64:
+			decode_base64(w, src, src_bytes);
+			break;
+
+		case MAILMIME_MECHANISM_QUOTED_PRINTABLE:
+			decode_quoted_printable(w, src, src_bytes);
+			break;
+
+		default:
+			decode_writer_write(w, src, src_bytes); /* 7bit, 8bit or binary: no need to copy the data */
+			break;
+	}
+
+	decode_writer_flush(w);
+
+	if (fclose(w->f)!=0) {
+		w->write_error = 1;
+	}
+	w->f = NULL;
+
+	if (w->write_error) {
+		dc_log_warning(parser->context, 0, "Cannot write %lu bytes to \"%s\".", (unsigned long)w->total_bytes, pathNfilename);
+		goto cleanup;
+	}
+
+	if (w->total_bytes==0) {
+		goto cleanup; /* no error - but no data */
+	}
+
+	*ret_bytes = w->total_bytes;
+	if (ret_head) {
+		*ret_head = w->head;
+		*ret_head_bytes = w->head_bytes;
+		w->head = NULL;
+	}
+	success = 1;
+
+cleanup:
+	if (w) {
+		if (w->f) { fclose(w->f); }
+		free(w->head);
+		free(w);
+	}
+	free(pathNfilename_abs);
+	return success;
+}
+
+
 static void do_add_single_file_part(dc_mimeparser_t* parser, int msg_type, int mime_type,
-                                    const char* decoded_data, size_t decoded_data_bytes,
-                                    const char* desired_filename)
+                                    struct mailmime* mime, const char* desired_filename)
 {
 	dc_mimepart_t* part = NULL;
 	char*          pathNfilename = NULL;
+	size_t         decoded_data_bytes = 0;
+	unsigned char* head = NULL;
+	size_t         head_bytes = 0;
 
 	/* create a free file name to use */
 	if ((pathNfilename=dc_get_fine_pathNfilename(parser->context, "$BLOBDIR", desired_filename))==NULL) {
 		goto cleanup;
 	}
 
-	/* copy data to file */
-	if (dc_write_file(parser->context, pathNfilename, decoded_data, decoded_data_bytes)==0) {
+	/* decode data to file */
+	if (!transfer_decode_to_file(parser, mime, pathNfilename, &decoded_data_bytes,
+	                             mime_type==DC_MIMETYPE_IMAGE? &head : NULL, &head_bytes)) {
+		dc_delete_file(parser->context, pathNfilename);
 		goto cleanup;
 	}
 
-	part = dc_mimepart_new();
+	part = dc_mimepart_new(parser);
 	part->type  = msg_type;
 	part->int_mimetype = mime_type;
 	part->bytes = decoded_data_bytes;
@@ -961,7 +1202,7 @@ static void do_add_single_file_part(dc_mimeparser_t* parser, int msg_type, int m
 
 	if (mime_type==DC_MIMETYPE_IMAGE) {
 		uint32_t w = 0, h = 0;
-		if (dc_get_filemeta(decoded_data, decoded_data_bytes, &w, &h)) {
+		if (dc_get_filemeta(head, head_bytes, &w, &h)) {
 			dc_param_set_int(part->param, DC_PARAM_WIDTH, w);
 			dc_param_set_int(part->param, DC_PARAM_HEIGHT, h);
 		}
@@ -971,6 +1212,7 @@ static void do_add_single_file_part(dc_mimeparser_t* parser, int msg_type, int m
 	part = NULL;
 
 cleanup:
+	free(head);
 	free(pathNfilename);
 	dc_mimepart_unref(part);
 }
@@ -1008,17 +1250,16 @@ static int dc_mimeparser_add_single_part_if_known(dc_mimeparser_t* mimeparser, s
 		goto cleanup;
 	}
 
-
-	/* regard `Content-Transfer-Encoding:` */
-	if (!mailmime_transfer_decode(mime, &decoded_data, &decoded_data_bytes, &transfer_decoding_buffer)) {
-		goto cleanup; /* no always error - but no data */
-	}
-
 	switch (mime_type)
 	{
 		case DC_MIMETYPE_TEXT_PLAIN:
 		case DC_MIMETYPE_TEXT_HTML:
 			{
+				/* regard `Content-Transfer-Encoding:`; attachments are decoded directly to the file, see do_add_single_file_part() */
+				if (!mailmime_transfer_decode(mime, &decoded_data, &decoded_data_bytes, &transfer_decoding_buffer)) {
+					goto cleanup; /* no always error - but no data */
+				}
+
 				if (simplifier==NULL) {
 					simplifier = dc_simplify_new();
 					if (simplifier==NULL) {
@@ -1046,18 +1287,16 @@ static int dc_mimeparser_add_single_part_if_known(dc_mimeparser_t* mimeparser, s
 				char* simplified_txt = dc_simplify_simplify(simplifier, decoded_data, decoded_data_bytes, mime_type==DC_MIMETYPE_TEXT_HTML? 1 : 0);
 				if (simplified_txt && simplified_txt[0])
 				{
-					part = dc_mimepart_new();
+					part = dc_mimepart_new(mimeparser);
 					part->type = DC_MSG_TEXT;
 					part->int_mimetype = mime_type;
-					part->msg = simplified_txt;
-					part->msg_raw = strndup(decoded_data, decoded_data_bytes);
+					part->msg = dc_arena_strdup(&mimeparser->arena, simplified_txt);
+					part->msg_raw = dc_arena_strndup(&mimeparser->arena, decoded_data, decoded_data_bytes);
 					do_add_single_part(mimeparser, part);
 					part = NULL;
 				}
-				else
-				{
-					free(simplified_txt);
-				}
+
+				free(simplified_txt);
 
 				if (simplifier->is_forwarded) {
 					mimeparser->is_forwarded = 1;
@@ -1135,7 +1374,7 @@ static int dc_mimeparser_add_single_part_if_known(dc_mimeparser_t* mimeparser, s
 
 				dc_replace_bad_utf8_chars(desired_filename);
 
-				do_add_single_file_part(mimeparser, msg_type, mime_type, decoded_data, decoded_data_bytes, desired_filename);
+				do_add_single_file_part(mimeparser, msg_type, mime_type, mime, desired_filename);
 			}
 			break;
 
@@ -1240,12 +1479,12 @@ static int dc_mimeparser_parse_mime_recursive(dc_mimeparser_t* mimeparser, struc
 
 				case DC_MIMETYPE_MP_NOT_DECRYPTABLE:
 					{
-						dc_mimepart_t* part = dc_mimepart_new();
+						dc_mimepart_t* part = dc_mimepart_new(mimeparser);
 						part->type = DC_MSG_TEXT;
 
 						char* msg_body = dc_stock_str(mimeparser->context, DC_STR_CANTDECRYPT_MSG_BODY);
-						part->msg = dc_mprintf(DC_EDITORIAL_OPEN "%s" DC_EDITORIAL_CLOSE, msg_body);
-						part->msg_raw = dc_strdup(part->msg);
+						part->msg = dc_arena_mprintf(&mimeparser->arena, DC_EDITORIAL_OPEN "%s" DC_EDITORIAL_CLOSE, msg_body);
+						part->msg_raw = part->msg;
 						free(msg_body);
 
 						carray_add(mimeparser->parts, (void*)part, NULL);
@@ -1414,23 +1653,50 @@ static void hash_header(dc_hash_t* out, const struct mailimf_fields* in, dc_cont
  * @return None.
  */
 void dc_mimeparser_parse(dc_mimeparser_t* mimeparser, const char* body_not_terminated, size_t body_bytes)
+{
+	dc_mimeparser_parse_prepared(mimeparser, body_not_terminated, body_bytes, NULL);
+}
+
+
+/**
+ * Parse a message as dc_mimeparser_parse(), however, parsing and decryption may be already done
+ * by dc_e2ee_prepare_decrypt(); the prepared message is taken over, if possible.
+ *
+ * @private @memberof dc_mimeparser_t
+ */
+void dc_mimeparser_parse_prepared(dc_mimeparser_t* mimeparser, const char* body_not_terminated, size_t body_bytes, dc_e2ee_prepared_t* prepared)
 {
 	int    r = 0;
 	size_t index = 0;
 
 	dc_mimeparser_empty(mimeparser);
 
-	/* parse body */
-	r = mailmime_parse(body_not_terminated, body_bytes, &index, &mimeparser->mimeroot);
-	if(r!=MAILIMF_NO_ERROR || mimeparser->mimeroot==NULL) {
-		goto cleanup;
+	if (prepared)
+	{
+		if (prepared->mimeroot==NULL) {
+			goto cleanup; /* parsing failed */
+		}
+
+		/* handle Autocrypt:-header, use the prepared decryption if the keys have not changed since then */
+		dc_e2ee_decrypt_prepared(mimeparser->context, prepared, body_not_terminated, body_bytes, &mimeparser->mimeroot, mimeparser->e2ee_helper);
+		if (mimeparser->mimeroot==NULL) {
+			goto cleanup;
+		}
 	}
+	else
+	{
+		/* parse body */
+		r = mailmime_parse(body_not_terminated, body_bytes, &index, &mimeparser->mimeroot);
+		if(r!=MAILIMF_NO_ERROR || mimeparser->mimeroot==NULL) {
+			goto cleanup;
+		}
 
-	//printf("before decryption:\n"); mailmime_print(mimeparser->mimeroot);
+		//printf("before decryption:\n"); mailmime_print(mimeparser->mimeroot);
 
-	/* decrypt, if possible; handle Autocrypt:-header
-	(decryption may modifiy the given object) */
-	dc_e2ee_decrypt(mimeparser->context, mimeparser->mimeroot, mimeparser->e2ee_helper);
+		/* decrypt, if possible; handle Autocrypt:-header
+		(decryption may modifiy the given object) */
+		dc_e2ee_decrypt(mimeparser->context, mimeparser->mimeroot, mimeparser->e2ee_helper);
+	}
 
 	//printf("after decryption:\n"); mailmime_print(mimeparser->mimeroot);
 
@@ -1487,7 +1753,6 @@ void dc_mimeparser_parse(dc_mimeparser_t* mimeparser, const char* body_not_termi
 
 		if (textpart->type==DC_MSG_TEXT && DC_MSG_NEEDS_ATTACHMENT(filepart->type))
 		{
-			free(filepart->msg);
 			filepart->msg = textpart->msg;
 			textpart->msg = NULL;
 			dc_mimepart_unref(textpart);
@@ -1512,7 +1777,7 @@ void dc_mimeparser_parse(dc_mimeparser_t* mimeparser, const char* body_not_termi
 
 		if (prepend_subject)
 		{
-			char* subj = dc_strdup(mimeparser->subject);
+			char* subj = dc_arena_strdup(&mimeparser->arena, mimeparser->subject);
 			char* p = strchr(subj, '['); /* do not add any tags as "[checked by XYZ]" */
 			if (p) {
 				*p = 0;
@@ -1524,14 +1789,11 @@ void dc_mimeparser_parse(dc_mimeparser_t* mimeparser, const char* body_not_termi
 					dc_mimepart_t* part = (dc_mimepart_t*)carray_get(mimeparser->parts, i);
 					if (part->type==DC_MSG_TEXT) {
 						#define DC_NDASH "\xE2\x80\x93"
-						char* new_txt = dc_mprintf("%s " DC_NDASH " %s", subj, part->msg);
-						free(part->msg);
-						part->msg = new_txt;
+						part->msg = dc_arena_mprintf(&mimeparser->arena, "%s " DC_NDASH " %s", subj, part->msg);
 						break;
 					}
 				}
 			}
-			free(subj);
 		}
 	}
 
@@ -1623,9 +1885,9 @@ void dc_mimeparser_parse(dc_mimeparser_t* mimeparser, const char* body_not_termi
 	/* Cleanup - and try to create at least an empty part if there are no parts yet */
 cleanup:
 	if (!dc_mimeparser_has_nonmeta(mimeparser) && carray_count(mimeparser->reports)==0) {
-		dc_mimepart_t* part = dc_mimepart_new();
+		dc_mimepart_t* part = dc_mimepart_new(mimeparser);
 		part->type = DC_MSG_TEXT;
-		part->msg = dc_strdup(mimeparser->subject? mimeparser->subject : "Empty message");
+		part->msg = dc_arena_strdup(&mimeparser->arena, mimeparser->subject? mimeparser->subject : "Empty message");
 		carray_add(mimeparser->parts, (void*)part, NULL);
 	}
 }
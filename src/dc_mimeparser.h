@@ -12,9 +12,11 @@ extern "C" {
 
 #include "dc_hash.h"
 #include "dc_param.h"
+#include "dc_arena.h"
 
 
 typedef struct dc_e2ee_helper_t dc_e2ee_helper_t;
+typedef struct dc_e2ee_prepared_t dc_e2ee_prepared_t;
 
 
 typedef struct dc_mimepart_t
@@ -23,8 +25,8 @@ typedef struct dc_mimepart_t
 	int                 type; /*one of DC_MSG_* */
 	int                 is_meta; /*meta parts contain eg. profile or group images and are only present if there is at least one "normal" part*/
 	int                 int_mimetype;
-	char*               msg;
-	char*               msg_raw;
+	char*               msg;      /* allocated from the arena of the parser */
+	char*               msg_raw;  /* allocated from the arena of the parser */
 	int                 bytes;
 	dc_param_t*          param;
 
@@ -60,6 +62,8 @@ typedef struct dc_mimeparser_t
 
 	int                    is_system_message;
 
+	dc_arena_t             arena;             /* parts and their texts, reset by dc_mimeparser_empty() */
+
 } dc_mimeparser_t;
 
 
@@ -68,6 +72,7 @@ void             dc_mimeparser_unref                  (dc_mimeparser_t*);
 void             dc_mimeparser_empty                  (dc_mimeparser_t*);
 
 void             dc_mimeparser_parse                  (dc_mimeparser_t*, const char* body_not_terminated, size_t body_bytes);
+void             dc_mimeparser_parse_prepared         (dc_mimeparser_t*, const char* body_not_terminated, size_t body_bytes, dc_e2ee_prepared_t*);
 
 
 /* the following functions can be used only after a call to dc_mimeparser_parse() */
@@ -4,6 +4,8 @@
 #include "dc_job.h"
 #include "dc_pgp.h"
 #include "dc_mimefactory.h"
+#include "dc_objcache.h"
+#include "dc_midfilter.h"
 
 #define DC_MSG_MAGIC 0x11561156
 
@@ -749,12 +751,12 @@ cleanup:
 }
 
 
-#define DC_MSG_FIELDS " m.id,rfc724_mid,m.server_folder,m.server_uid,m.chat_id, " \
-                      " m.from_id,m.to_id,m.timestamp,m.timestamp_sent,m.timestamp_rcvd, m.type,m.state,m.msgrmsg,m.txt, " \
-                      " m.param,m.starred,m.hidden,c.blocked "
-
-
-static int dc_msg_set_from_stmt(dc_msg_t* msg, sqlite3_stmt* row, int row_offset) /* field order must be DC_MSG_FIELDS */
+/**
+ * Set up a message object from a row selected with DC_MSG_FIELDS.
+ *
+ * @private @memberof dc_msg_t
+ */
+int dc_msg_set_from_stmt(dc_msg_t* msg, sqlite3_stmt* row, int row_offset) /* field order must be DC_MSG_FIELDS */
 {
 	dc_msg_empty(msg);
 
@@ -789,6 +791,41 @@ static int dc_msg_set_from_stmt(dc_msg_t* msg, sqlite3_stmt* row, int row_offset
 }
 
 
+/**
+ * Copy all fields loaded from the database to another message object.
+ * The context of the destination object is not changed.
+ *
+ * @private @memberof dc_msg_t
+ */
+void dc_msg_copy(dc_msg_t* dest, const dc_msg_t* src)
+{
+	if (dest==NULL || dest->magic!=DC_MSG_MAGIC || src==NULL || src->magic!=DC_MSG_MAGIC) {
+		return;
+	}
+
+	dc_msg_empty(dest);
+
+	dest->id             = src->id;
+	dest->rfc724_mid     = dc_strdup_keep_null(src->rfc724_mid);
+	dest->server_folder  = dc_strdup_keep_null(src->server_folder);
+	dest->server_uid     = src->server_uid;
+	dest->chat_id        = src->chat_id;
+	dest->from_id        = src->from_id;
+	dest->to_id          = src->to_id;
+	dest->timestamp      = src->timestamp;
+	dest->timestamp_sent = src->timestamp_sent;
+	dest->timestamp_rcvd = src->timestamp_rcvd;
+	dest->type           = src->type;
+	dest->state          = src->state;
+	dest->is_msgrmsg     = src->is_msgrmsg;
+	dest->text           = dc_strdup_keep_null(src->text);
+	dest->starred        = src->starred;
+	dest->hidden         = src->hidden;
+	dest->chat_blocked   = src->chat_blocked;
+	dc_param_set_param(dest->param, src->param);
+}
+
+
 /**
  * Load a message from the database to the message object.
  *
@@ -803,7 +840,7 @@ int dc_msg_load_from_db(dc_msg_t* msg, dc_context_t* context, uint32_t id)
 		goto cleanup;
 	}
 
-	stmt = dc_sqlite3_prepare(context->sql,
+	stmt = dc_sqlite3_prepare_cached(context->sql,
 		"SELECT " DC_MSG_FIELDS
 		" FROM msgs m LEFT JOIN chats c ON c.id=m.chat_id"
 		" WHERE m.id=?;");
@@ -822,7 +859,7 @@ int dc_msg_load_from_db(dc_msg_t* msg, dc_context_t* context, uint32_t id)
 	success = 1;
 
 cleanup:
-	sqlite3_finalize(stmt);
+	if (stmt) { dc_sqlite3_finalize_cached(context->sql, stmt); }
 	return success;
 }
 
@@ -989,10 +1026,12 @@ void dc_msg_save_param_to_disk(dc_msg_t* msg)
 
 	sqlite3_stmt* stmt = dc_sqlite3_prepare(msg->context->sql,
 		"UPDATE msgs SET param=? WHERE id=?;");
-	sqlite3_bind_text(stmt, 1, msg->param->packed, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 1, dc_param_get_packed(msg->param), -1, SQLITE_STATIC);
 	sqlite3_bind_int (stmt, 2, msg->id);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+
+	dc_objcache_remove(msg->context->msg_cache, msg->id);
 }
 
 
@@ -1129,12 +1168,53 @@ cleanup:
 
 void dc_update_msg_chat_id(dc_context_t* context, uint32_t msg_id, uint32_t chat_id)
 {
+	uint32_t      old_chat_id = 0;
 	sqlite3_stmt* stmt = dc_sqlite3_prepare(context->sql,
+		"SELECT chat_id FROM msgs WHERE id=?;");
+	sqlite3_bind_int(stmt, 1, msg_id);
+	if (sqlite3_step(stmt)==SQLITE_ROW) {
+		old_chat_id = sqlite3_column_int(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+
+	stmt = dc_sqlite3_prepare(context->sql,
 		"UPDATE msgs SET chat_id=? WHERE id=?;");
 	sqlite3_bind_int(stmt, 1, chat_id);
 	sqlite3_bind_int(stmt, 2, msg_id);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+
+	dc_objcache_remove(context->msg_cache, msg_id);
+
+	if (old_chat_id!=chat_id) {
+		dc_recalc_chat_last_msg(context, old_chat_id);
+		dc_recalc_chat_last_msg(context, chat_id);
+	}
+}
+
+
+void dc_update_msg_fts(dc_context_t* context, uint32_t msg_id, const char* txt)
+{
+	sqlite3_stmt* stmt = NULL;
+
+	if (context->sql->fts_state==DC_FTS_NONE) {
+		return;
+	}
+
+	if (txt==NULL) {
+		stmt = dc_sqlite3_prepare_cached(context->sql, "DELETE FROM msgs_fts WHERE rowid=?;");
+		sqlite3_bind_int(stmt, 1, msg_id);
+	}
+	else if (txt[0]) {
+		stmt = dc_sqlite3_prepare_cached(context->sql, "INSERT INTO msgs_fts (rowid, txt) VALUES (?, ?);");
+		sqlite3_bind_int (stmt, 1, msg_id);
+		sqlite3_bind_text(stmt, 2, txt, -1, SQLITE_STATIC);
+	}
+
+	if (stmt) {
+		sqlite3_step(stmt);
+		dc_sqlite3_finalize_cached(context->sql, stmt);
+	}
 }
 
 
@@ -1146,6 +1226,8 @@ void dc_update_msg_state(dc_context_t* context, uint32_t msg_id, int state)
 	sqlite3_bind_int(stmt, 2, msg_id);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+
+	dc_objcache_remove(context->msg_cache, msg_id);
 }
 
 
@@ -1177,7 +1259,7 @@ void dc_set_msg_failed(dc_context_t* context, uint32_t msg_id, const char* error
 	stmt = dc_sqlite3_prepare(context->sql,
 		"UPDATE msgs SET state=?, param=? WHERE id=?;");
 	sqlite3_bind_int (stmt, 1, msg->state);
-	sqlite3_bind_text(stmt, 2, msg->param->packed, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, dc_param_get_packed(msg->param), -1, SQLITE_STATIC);
 	sqlite3_bind_int (stmt, 3, msg_id);
 	sqlite3_step(stmt);
 
@@ -1277,7 +1359,15 @@ cleanup:
 uint32_t dc_rfc724_mid_exists(dc_context_t* context, const char* rfc724_mid, char** ret_server_folder, uint32_t* ret_server_uid)
 {
 	uint32_t ret = 0;
-	sqlite3_stmt* stmt = dc_sqlite3_prepare(context->sql,
+	sqlite3_stmt* stmt = NULL;
+
+	if (!dc_midfilter_may_contain(context->mid_filter, rfc724_mid)) {
+		if (ret_server_folder) { *ret_server_folder = NULL; }
+		if (ret_server_uid)    { *ret_server_uid    = 0; }
+		goto cleanup;
+	}
+
+	stmt = dc_sqlite3_prepare(context->sql,
 		"SELECT server_folder, server_uid, id FROM msgs WHERE rfc724_mid=?;");
 	sqlite3_bind_text(stmt, 1, rfc724_mid, -1, SQLITE_STATIC);
 	if (sqlite3_step(stmt)!=SQLITE_ROW) {
@@ -1305,6 +1395,8 @@ void dc_update_server_uid(dc_context_t* context, const char* rfc724_mid, const c
 	sqlite3_bind_text(stmt, 3, rfc724_mid, -1, SQLITE_STATIC);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+
+	dc_objcache_clear(context->msg_cache); /* we do not know the IDs of the affected messages */
 }
 
 
@@ -1322,17 +1414,28 @@ void dc_update_server_uid(dc_context_t* context, const char* rfc724_mid, const c
  */
 dc_msg_t* dc_get_msg(dc_context_t* context, uint32_t msg_id)
 {
-	int success = 0;
+	int       success = 0;
 	dc_msg_t* obj = dc_msg_new_untyped(context);
+	dc_msg_t* snapshot = NULL;
+	uint32_t  generation = 0;
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
 		goto cleanup;
 	}
 
+	if (dc_objcache_get(context->msg_cache, msg_id, obj, &generation)) {
+		success = 1;
+		goto cleanup;
+	}
+
 	if (!dc_msg_load_from_db(obj, context, msg_id)) {
 		goto cleanup;
 	}
 
+	snapshot = dc_msg_new_untyped(context);
+	dc_msg_copy(snapshot, obj);
+	dc_objcache_put(context->msg_cache, msg_id, snapshot, generation);
+
 	success = 1;
 
 cleanup:
@@ -1582,6 +1685,7 @@ void dc_star_msgs(dc_context_t* context, const uint32_t* msg_ids, int msg_cnt, i
 			sqlite3_bind_int(stmt, 1, star);
 			sqlite3_bind_int(stmt, 2, msg_ids[i]);
 			sqlite3_step(stmt);
+			dc_objcache_remove(context->msg_cache, msg_ids[i]);
 		}
 		sqlite3_finalize(stmt);
 
@@ -68,6 +68,11 @@ struct _dc_msg
 
 dc_msg_t*       dc_msg_new_untyped                    (dc_context_t*);
 int             dc_msg_load_from_db                   (dc_msg_t*, dc_context_t*, uint32_t id);
+#define         DC_MSG_FIELDS " m.id,rfc724_mid,m.server_folder,m.server_uid,m.chat_id, " \
+                              " m.from_id,m.to_id,m.timestamp,m.timestamp_sent,m.timestamp_rcvd, m.type,m.state,m.msgrmsg,m.txt, " \
+                              " m.param,m.starred,m.hidden,c.blocked " /* select FROM msgs m LEFT JOIN chats c ON c.id=m.chat_id */
+int             dc_msg_set_from_stmt                  (dc_msg_t*, sqlite3_stmt* row, int row_offset);
+void            dc_msg_copy                           (dc_msg_t* dest, const dc_msg_t* src); /* copies all database fields, used for the cache */
 int             dc_msg_is_increation                  (const dc_msg_t*);
 char*           dc_msg_get_summarytext_by_raw         (int type, const char* text, dc_param_t*, int approx_bytes, dc_context_t*); /* the returned value must be free()'d */
 void            dc_msg_save_param_to_disk             (dc_msg_t*);
@@ -85,6 +90,7 @@ The value is also used for CC:-summaries */
 
 // Context functions to work with messages
 void            dc_update_msg_chat_id                      (dc_context_t*, uint32_t msg_id, uint32_t chat_id);
+void            dc_update_msg_fts                          (dc_context_t*, uint32_t msg_id, const char* txt); /* txt=NULL removes the message from the full-text index */
 void            dc_update_msg_state                        (dc_context_t*, uint32_t msg_id, int state);
 void            dc_set_msg_failed                          (dc_context_t*, uint32_t msg_id, const char* error);
 int             dc_mdn_from_ext                            (dc_context_t*, uint32_t from_id, const char* rfc724_mid, time_t, uint32_t* ret_chat_id, uint32_t* ret_msg_id); /* returns 1 if an event should be send */
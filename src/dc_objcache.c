@@ -0,0 +1,234 @@
+#include "dc_context.h"
+#include "dc_objcache.h"
+
+
+static void unlink_entry(dc_objcache_t* cache, dc_objcache_entry_t* entry)
+{
+	if (entry->prev) { entry->prev->next = entry->next; } else { cache->first = entry->next; }
+	if (entry->next) { entry->next->prev = entry->prev; } else { cache->last = entry->prev; }
+	entry->prev = NULL;
+	entry->next = NULL;
+}
+
+
+static void link_entry_first(dc_objcache_t* cache, dc_objcache_entry_t* entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->first;
+	if (cache->first) { cache->first->prev = entry; } else { cache->last = entry; }
+	cache->first = entry;
+}
+
+
+static void free_entry(dc_objcache_t* cache, dc_objcache_entry_t* entry)
+{
+	/* the caller must hold the mutex */
+	unlink_entry(cache, entry);
+	dc_hash_insert(&cache->hash, NULL, (int)entry->id, NULL);
+	cache->free(entry->obj);
+	free(entry);
+	cache->cnt--;
+}
+
+
+dc_objcache_t* dc_objcache_new(int max_cnt, dc_objcache_copy_t copy, dc_objcache_free_t free_obj)
+{
+	dc_objcache_t* cache = NULL;
+
+	if ((cache=calloc(1, sizeof(dc_objcache_t)))==NULL) {
+		exit(54);
+	}
+
+	pthread_mutex_init(&cache->mutex, NULL);
+	dc_hash_init(&cache->hash, DC_HASH_INT, 0);
+	cache->max_cnt = max_cnt;
+	cache->copy    = copy;
+	cache->free    = free_obj;
+
+	return cache;
+}
+
+
+void dc_objcache_unref(dc_objcache_t* cache)
+{
+	if (cache==NULL) {
+		return;
+	}
+
+	dc_objcache_clear(cache);
+	dc_hash_clear(&cache->hash);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache);
+}
+
+
+int dc_objcache_get(dc_objcache_t* cache, uint32_t id, void* dest, uint32_t* ret_generation)
+{
+	int                  found = 0;
+	dc_objcache_entry_t* entry = NULL;
+
+	if (cache==NULL || dest==NULL) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+		if ((entry=dc_hash_find(&cache->hash, NULL, (int)id))!=NULL) {
+			/* copy while holding the mutex, the snapshot may be invalidated by another thread otherwise */
+			cache->copy(dest, entry->obj);
+			unlink_entry(cache, entry);
+			link_entry_first(cache, entry);
+			cache->hits++;
+			found = 1;
+		}
+		else {
+			cache->misses++;
+		}
+
+		if (ret_generation) {
+			*ret_generation = cache->generation;
+		}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return found;
+}
+
+
+void dc_objcache_put(dc_objcache_t* cache, uint32_t id, void* obj, uint32_t generation)
+{
+	dc_objcache_entry_t* entry = NULL;
+
+	if (cache==NULL || obj==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+		/* if the cache was invalidated after the object was loaded, the object may be outdated */
+		if (generation!=cache->generation) {
+			cache->free(obj);
+			goto cleanup;
+		}
+
+		if ((entry=dc_hash_find(&cache->hash, NULL, (int)id))!=NULL) {
+			free_entry(cache, entry);
+		}
+
+		if ((entry=calloc(1, sizeof(dc_objcache_entry_t)))==NULL) {
+			exit(55);
+		}
+		entry->id  = id;
+		entry->obj = obj;
+		link_entry_first(cache, entry);
+		dc_hash_insert(&cache->hash, NULL, (int)id, entry);
+		cache->cnt++;
+
+		while (cache->cnt > cache->max_cnt && cache->last) {
+			free_entry(cache, cache->last);
+		}
+
+cleanup:
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+
+void dc_objcache_remove(dc_objcache_t* cache, uint32_t id)
+{
+	dc_objcache_entry_t* entry = NULL;
+
+	if (cache==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+		cache->generation++;
+		if ((entry=dc_hash_find(&cache->hash, NULL, (int)id))!=NULL) {
+			free_entry(cache, entry);
+		}
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+
+void dc_objcache_clear(dc_objcache_t* cache)
+{
+	if (cache==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+		cache->generation++;
+		while (cache->first) {
+			free_entry(cache, cache->first);
+		}
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+
+char* dc_objcache_get_info(dc_objcache_t* cache)
+{
+	char* ret = NULL;
+
+	if (cache==NULL) {
+		return dc_strdup("0");
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+		ret = dc_mprintf("%i/%i, %i hits, %i misses", cache->cnt, cache->max_cnt, cache->hits, cache->misses);
+	pthread_mutex_unlock(&cache->mutex);
+
+	return ret;
+}
+
+
+/**
+ * Invalidate the cached objects affected by an event.
+ *
+ * All functions changing messages, chats or contacts emit one of the handled events,
+ * so the caches are invalidated here at a single place.
+ * Changes that do not result in events, eg. updated message parameters,
+ * are invalidated by the functions doing the changes.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_objcache_handle_event(dc_context_t* context, int event, uintptr_t data1, uintptr_t data2)
+{
+	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
+		return;
+	}
+
+	switch (event)
+	{
+		case DC_EVENT_MSGS_CHANGED:
+			// data1=chat_id, data2=msg_id, 0 for several or unknown objects
+			if (data2) { dc_objcache_remove(context->msg_cache, data2); } else { dc_objcache_clear(context->msg_cache); }
+			if (data1) { dc_objcache_remove(context->chat_cache, data1); } else { dc_objcache_clear(context->chat_cache); }
+			break;
+
+		case DC_EVENT_INCOMING_MSG:
+		case DC_EVENT_MSG_DELIVERED:
+		case DC_EVENT_MSG_FAILED:
+		case DC_EVENT_MSG_READ:
+			// data1=chat_id, data2=msg_id; incoming messages may unarchive the chat
+			dc_objcache_remove(context->msg_cache, data2);
+			dc_objcache_remove(context->chat_cache, data1);
+			break;
+
+		case DC_EVENT_CHAT_MODIFIED:
+			// messages contain the blocked-state of their chat
+			if (data1) { dc_objcache_remove(context->chat_cache, data1); } else { dc_objcache_clear(context->chat_cache); }
+			dc_objcache_clear(context->msg_cache);
+			break;
+
+		case DC_EVENT_CONTACTS_CHANGED:
+			// changing contacts may rename or block chats, this is rare, so we do not care about details
+			dc_objcache_clear(context->contact_cache);
+			dc_objcache_clear(context->chat_cache);
+			dc_objcache_clear(context->msg_cache);
+			break;
+	}
+}
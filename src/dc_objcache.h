@@ -0,0 +1,76 @@
+/* Purpose: Keep recently loaded objects as dc_msg_t, dc_chat_t or dc_contact_t in memory.
+The cache holds private snapshots, the objects returned to the caller are always copies
+as the public objects may be modified by the caller. */
+
+
+#ifndef __DC_OBJCACHE_H__
+#define __DC_OBJCACHE_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "dc_hash.h"
+
+
+typedef void (*dc_objcache_copy_t) (void* dest, const void* src);
+typedef void (*dc_objcache_free_t) (void* obj);
+
+
+/**
+ * Library-internal.
+ * One cached snapshot, the entries are kept in a list with the most recently used one first.
+ */
+typedef struct dc_objcache_entry_t
+{
+	/** @privatesection */
+
+	uint32_t                    id;
+	void*                       obj;
+	struct dc_objcache_entry_t* prev;
+	struct dc_objcache_entry_t* next;
+} dc_objcache_entry_t;
+
+
+/**
+ * Library-internal.
+ */
+typedef struct dc_objcache_t
+{
+	/** @privatesection */
+
+	pthread_mutex_t      mutex;
+	dc_hash_t            hash;        // id -> dc_objcache_entry_t
+	dc_objcache_entry_t* first;       // most recently used
+	dc_objcache_entry_t* last;        // least recently used, evicted first
+	int                  cnt;
+	int                  max_cnt;
+	uint32_t             generation;  // incremented on each invalidation, a snapshot loaded before is not added
+	dc_objcache_copy_t   copy;
+	dc_objcache_free_t   free;
+	int                  hits;
+	int                  misses;
+} dc_objcache_t;
+
+
+#define         DC_MSG_CACHE_SIZE     256
+#define         DC_CHAT_CACHE_SIZE     64
+#define         DC_CONTACT_CACHE_SIZE 128
+
+
+dc_objcache_t*  dc_objcache_new       (int max_cnt, dc_objcache_copy_t, dc_objcache_free_t);
+void            dc_objcache_unref     (dc_objcache_t*);
+
+int             dc_objcache_get       (dc_objcache_t*, uint32_t id, void* dest, uint32_t* ret_generation); /* on hits, the snapshot is copied to dest; on misses, the generation to pass to dc_objcache_put() is returned */
+void            dc_objcache_put       (dc_objcache_t*, uint32_t id, void* obj, uint32_t generation); /* the cache takes ownership of obj */
+void            dc_objcache_remove    (dc_objcache_t*, uint32_t id);
+void            dc_objcache_clear     (dc_objcache_t*);
+char*           dc_objcache_get_info  (dc_objcache_t*); /* the returned string must be free()'d */
+
+void            dc_objcache_handle_event (dc_context_t*, int event, uintptr_t data1, uintptr_t data2); /* invalidate the caches of the context as needed */
+
+
+#ifdef __cplusplus
+} /* /extern "C" */
+#endif
+#endif /* __DC_OBJCACHE_H__ */
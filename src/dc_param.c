@@ -4,36 +4,124 @@
 #include "dc_tools.h"
 
 
-static char* find_param(char* haystack, int key, char** ret_p2)
+#define VALID_KEY(k)   ((k)>0 && (k)<DC_PARAM_SLOTS)
+#define VALUE_PTR(p,k) (&(p)->buf[(p)->offset[(k)]-1])
+
+
+static void invalidate_packed(dc_param_t* param)
+{
+	free(param->packed);
+	param->packed = NULL;
+}
+
+
+static void compact_buf(dc_param_t* param)
 {
-	char* p1 = NULL;
-	char* p2 = NULL;
-
-	/* let p1 point to the start of the */
-	p1 = haystack;
-	while (1) {
-		if (p1==NULL || *p1==0) {
-			return NULL;
+	/* copy the values in use to a new buffer, this drops the space of replaced values */
+	char*  new_buf = NULL;
+	size_t new_bytes = 0;
+	int    i = 0;
+
+	if ((new_buf=malloc(param->buf_allocated))==NULL) {
+		exit(61);
+	}
+
+	for (i = 0; i < param->key_cnt; i++) {
+		int key = param->keys[i];
+		if (param->offset[key]) {
+			size_t bytes = strlen(VALUE_PTR(param, key))+1;
+			memcpy(&new_buf[new_bytes], VALUE_PTR(param, key), bytes);
+			param->offset[key] = new_bytes+1;
+			new_bytes += bytes;
 		}
-		else if (*p1==key && p1[1]=='=') {
-			break;
+	}
+
+	free(param->buf);
+	param->buf = new_buf;
+	param->buf_bytes = new_bytes;
+	param->unused_bytes = 0;
+}
+
+
+static void reserve_buf(dc_param_t* param, size_t bytes)
+{
+	if (param->buf_bytes+bytes <= param->buf_allocated) {
+		return;
+	}
+
+	if (param->unused_bytes > param->buf_bytes/2) {
+		compact_buf(param);
+		if (param->buf_bytes+bytes <= param->buf_allocated) {
+			return;
 		}
-		else {
-			p1 = strchr(p1, '\n'); /* if `\r\n` is used, this `\r` is also skipped by this*/
-			if (p1) {
-				p1++;
-			}
+	}
+
+	size_t new_allocated = param->buf_allocated*2;
+	if (new_allocated < param->buf_bytes+bytes) {
+		new_allocated = param->buf_bytes+bytes;
+	}
+
+	if ((param->buf=realloc(param->buf, new_allocated))==NULL) {
+		exit(62);
+	}
+	param->buf_allocated = new_allocated;
+}
+
+
+static void remove_key(dc_param_t* param, int key)
+{
+	int i = 0;
+
+	param->unused_bytes += strlen(VALUE_PTR(param, key))+1;
+	param->offset[key] = 0;
+
+	for (i = 0; i < param->key_cnt; i++) {
+		if (param->keys[i]==key) {
+			memmove(&param->keys[i], &param->keys[i+1], param->key_cnt-i-1);
+			param->key_cnt--;
+			break;
 		}
 	}
+}
 
-	/* let p2 point to the character _after_ the value - eiter `\n` or `\0` */
-	p2 = strchr(p1, '\n');
-	if (p2==NULL) {
-		p2 = &p1[strlen(p1)];
+
+static void replace_line_breaks(char* value)
+{
+	while ((value=strchr(value, '\n'))!=NULL) {
+		*value = ' ';
 	}
+}
 
-	*ret_p2 = p2;
-	return p1;
+
+static void set_unpacked(dc_param_t* param, const char* packed, char separator)
+{
+	/* the packed string is copied to the buffer as a whole and the separators are replaced by null-bytes;
+	lines not in the form `k=value` are skipped, for duplicate keys, the first value is used */
+	size_t bytes = strlen(packed)+1;
+	char*  p1 = NULL;
+	char*  p2 = NULL;
+
+	reserve_buf(param, bytes);
+	memcpy(param->buf, packed, bytes);
+	param->buf_bytes = bytes;
+	param->unused_bytes = bytes;
+
+	p1 = param->buf;
+	while (p1) {
+		if ((p2=strchr(p1, separator))!=NULL) {
+			*p2 = 0;
+			p2++;
+		}
+
+		int key = (unsigned char)p1[0];
+		if (VALID_KEY(key) && p1[1]=='=' && param->offset[key]==0) {
+			param->offset[key] = (p1+2)-param->buf+1;
+			param->keys[param->key_cnt++] = key;
+			param->unused_bytes -= strlen(p1+2)+1;
+		}
+
+		p1 = p2; /* if `\r\n` is used, the `\r` is part of the value and is trimmed by dc_param_get() */
+	}
 }
 
 
@@ -51,7 +139,10 @@ dc_param_t* dc_param_new()
 		exit(28); /* cannot allocate little memory, unrecoverable error */
 	}
 
-	param->packed = calloc(1, 1);
+	param->buf_allocated = 64;
+	if ((param->buf=malloc(param->buf_allocated))==NULL) {
+		exit(60);
+	}
 
     return param;
 }
@@ -70,7 +161,7 @@ void dc_param_unref(dc_param_t* param)
 	}
 
 	dc_param_empty(param);
-	free(param->packed);
+	free(param->buf);
 	free(param);
 }
 
@@ -84,11 +175,19 @@ void dc_param_unref(dc_param_t* param)
  */
 void dc_param_empty(dc_param_t* param)
 {
+	int i = 0;
+
 	if (param==NULL) {
 		return;
 	}
 
-	param->packed[0] = 0;
+	for (i = 0; i < param->key_cnt; i++) {
+		param->offset[(int)param->keys[i]] = 0;
+	}
+	param->key_cnt = 0;
+	param->buf_bytes = 0;
+	param->unused_bytes = 0;
+	invalidate_packed(param);
 }
 
 
@@ -112,8 +211,7 @@ void dc_param_set_packed(dc_param_t* param, const char* packed)
 	dc_param_empty(param);
 
 	if (packed) {
-		free(param->packed);
-		param->packed = dc_strdup(packed);
+		set_unpacked(param, packed, '\n');
 	}
 }
 
@@ -131,10 +229,74 @@ void dc_param_set_urlencoded(dc_param_t* param, const char* urlencoded)
 	dc_param_empty(param);
 
 	if (urlencoded) {
-		free(param->packed);
-		param->packed = dc_strdup(urlencoded);
-		dc_str_replace(&param->packed, "&", "\n");
+		set_unpacked(param, urlencoded, '&');
+	}
+}
+
+
+/**
+ * Copy all parameters from another parameter object.
+ *
+ * Before the parameters are copied, _all_ existant parameters are deleted.
+ * Unlike dc_param_set_packed(dest, dc_param_get_packed(src)),
+ * the parameters are not packed and unpacked again.
+ *
+ * @private @memberof dc_param_t
+ * @param param Parameter object to modify.
+ * @param src Parameter object to copy the parameters from.
+ * @return None.
+ */
+void dc_param_set_param(dc_param_t* param, const dc_param_t* src)
+{
+	if (param==NULL || src==NULL || param==src) {
+		return;
 	}
+
+	dc_param_empty(param);
+
+	reserve_buf(param, src->buf_bytes);
+	memcpy(param->buf, src->buf, src->buf_bytes);
+	param->buf_bytes = src->buf_bytes;
+	param->unused_bytes = src->unused_bytes;
+	memcpy(param->offset, src->offset, sizeof(param->offset));
+	memcpy(param->keys, src->keys, src->key_cnt);
+	param->key_cnt = src->key_cnt;
+}
+
+
+/**
+ * Get all parameters in the packed form as `a=value1\nb=value2`,
+ * this is the form the parameters are saved to the database.
+ *
+ * @private @memberof dc_param_t
+ * @param param Parameter object to query.
+ * @return The packed parameters, an empty string if there are no parameters.
+ *     The string must not be free()'d and is valid until the object is modified.
+ */
+const char* dc_param_get_packed(dc_param_t* param)
+{
+	dc_strbuilder_t packed;
+	int             i = 0;
+
+	if (param==NULL) {
+		return "";
+	}
+
+	if (param->packed==NULL) {
+		dc_strbuilder_init(&packed, (int)(param->buf_bytes-param->unused_bytes+param->key_cnt*2+1));
+		for (i = 0; i < param->key_cnt; i++) {
+			int  key = param->keys[i];
+			char key_str[3] = { (char)key, '=', 0 };
+			if (i) {
+				dc_strbuilder_cat(&packed, "\n");
+			}
+			dc_strbuilder_cat(&packed, key_str);
+			dc_strbuilder_cat(&packed, VALUE_PTR(param, key));
+		}
+		param->packed = packed.buf;
+	}
+
+	return param->packed;
 }
 
 
@@ -148,13 +310,11 @@ void dc_param_set_urlencoded(dc_param_t* param, const char* urlencoded)
  */
 int dc_param_exists(dc_param_t* param, int key)
 {
-	char *p2 = NULL;
-
-	if (param==NULL || key==0) {
+	if (param==NULL || !VALID_KEY(key)) {
 		return 0;
 	}
 
-	return find_param(param->packed, key, &p2)? 1 : 0;
+	return param->offset[key]? 1 : 0;
 }
 
 
@@ -169,27 +329,14 @@ int dc_param_exists(dc_param_t* param, int key)
  */
 char* dc_param_get(const dc_param_t* param, int key, const char* def)
 {
-	char* p1 = NULL;
-	char* p2 = NULL;
-	char  bak = 0;
 	char* ret = NULL;
 
-	if (param==NULL || key==0) {
-		return def? dc_strdup(def) : NULL;
-	}
-
-	p1 = find_param(param->packed, key, &p2);
-	if (p1==NULL) {
+	if (param==NULL || !VALID_KEY(key) || param->offset[key]==0) {
 		return def? dc_strdup(def) : NULL;
 	}
 
-	p1 += 2; /* skip key and "=" (safe as find_param checks for its existance) */
-
-	bak = *p2;
-	*p2 = 0;
-	ret = dc_strdup(p1);
+	ret = dc_strdup(VALUE_PTR(param, key));
 	dc_rtrim(ret); /* to be safe with '\r' characters ... */
-	*p2 = bak;
 	return ret;
 }
 
@@ -205,17 +352,11 @@ char* dc_param_get(const dc_param_t* param, int key, const char* def)
  */
 int32_t dc_param_get_int(const dc_param_t* param, int key, int32_t def)
 {
-	if (param==NULL || key==0) {
+	if (param==NULL || !VALID_KEY(key) || param->offset[key]==0) {
 		return def;
 	}
 
-    char* str = dc_param_get(param, key, NULL);
-    if (str==NULL) {
-		return def;
-    }
-    int32_t ret = atol(str);
-    free(str);
-    return ret;
+	return atol(VALUE_PTR(param, key));
 }
 
 
@@ -226,59 +367,50 @@ int32_t dc_param_get_int(const dc_param_t* param, int key, int32_t def)
  * @param param Parameter object to modify.
  * @param key Key of the parameter to modify, one of the DC_PARAM_* constants.
  * @param value Value to store for key. NULL to clear the value.
+ *     Values are null-terminated strings, binary data cannot be stored.
+ *     As `\n` separates the parameters in the packed form, line breaks are replaced by spaces;
+ *     this way, the value read back after saving and loading is the same as the one in memory.
  * @return None.
  */
 void dc_param_set(dc_param_t* param, int key, const char* value)
 {
-	char* old1 = NULL;
-	char* old2 = NULL;
-	char* new1 = NULL;
-
-	if (param==NULL || key==0) {
+	if (param==NULL || !VALID_KEY(key)) {
 		return;
 	}
 
-	old1 = param->packed;
-	old2 = NULL;
-
-	/* remove existing parameter from packed string, if any */
-	if (old1) {
-		char *p1, *p2;
-		p1 = find_param(old1, key, &p2);
-		if (p1 != NULL) {
-			*p1 = 0;
-			old2 = p2;
-		}
-		else if (value==NULL) {
-			return; /* parameter does not exist and should be cleared -> done. */
+	if (value==NULL) {
+		if (param->offset[key]) {
+			remove_key(param, key);
+			invalidate_packed(param);
 		}
+		return;
 	}
 
-	dc_rtrim(old1); /* trim functions are null-pointer-safe */
-	dc_ltrim(old2);
-
-	if (old1 && old1[0]==0) { old1 = NULL; }
-	if (old2 && old2[0]==0) { old2 = NULL; }
-
-	/* create new string */
-	if (value) {
-		new1 = dc_mprintf("%s%s%c=%s%s%s",
-			old1?  old1 : "",
-			old1?  "\n" : "",
-			key,
-			value,
-			old2?  "\n" : "",
-			old2?  old2 : "");
+	size_t bytes = strlen(value)+1;
+
+	if (param->offset[key]) {
+		/* overwrite the old value if the new one fits, otherwise, the new value is appended, the key keeps its position */
+		size_t old_bytes = strlen(VALUE_PTR(param, key))+1;
+		if (bytes <= old_bytes) {
+			memcpy(VALUE_PTR(param, key), value, bytes);
+			replace_line_breaks(VALUE_PTR(param, key));
+			param->unused_bytes += old_bytes-bytes;
+			invalidate_packed(param);
+			return;
+		}
+		param->unused_bytes += old_bytes;
+		param->offset[key] = 0;
 	}
 	else {
-		new1 = dc_mprintf("%s%s%s",
-			old1?         old1 : "",
-			(old1&&old2)? "\n" : "",
-			old2?         old2 : "");
+		param->keys[param->key_cnt++] = key;
 	}
 
-	free(param->packed);
-	param->packed = new1;
+	reserve_buf(param, bytes);
+	memcpy(&param->buf[param->buf_bytes], value, bytes);
+	replace_line_breaks(&param->buf[param->buf_bytes]);
+	param->offset[key] = param->buf_bytes+1;
+	param->buf_bytes += bytes;
+	invalidate_packed(param);
 }
 
 
@@ -297,10 +429,7 @@ void dc_param_set_int(dc_param_t* param, int key, int32_t value)
 		return;
 	}
 
-    char* value_str = dc_mprintf("%i", (int)value);
-    if (value_str==NULL) {
-		return;
-    }
-    dc_param_set(param, key, value_str);
-    free(value_str);
+	char value_str[16];
+	snprintf(value_str, sizeof(value_str), "%i", (int)value);
+	dc_param_set(param, key, value_str);
 }
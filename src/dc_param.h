@@ -5,6 +5,9 @@ extern "C" {
 #endif
 
 
+#define DC_PARAM_SLOTS 128 /* keys are single ASCII characters */
+
+
 /**
  * An object for handling key=value parameter lists; for the key, curently only
  * a single character is allowed.
@@ -12,12 +15,23 @@ extern "C" {
  * The object is used eg. by dc_chat_t or dc_msg_t, for readable paramter names,
  * these classes define some DC_PARAM_* constantats.
  *
+ * In memory, the values are kept in a single buffer and are looked up by the key,
+ * the packed form `a=value1\nb=value2` is created only as needed by dc_param_get_packed(),
+ * typically when the parameters are saved to the database.
+ *
  * Only for library-internal use.
  */
 typedef struct dc_param_t
 {
 	/** @privatesection */
-	char*           packed;    /**< Always set, never NULL. */
+	char*           buf;                    /**< The null-terminated values, never NULL. */
+	size_t          buf_bytes;              /**< Bytes used in buf, including the space of replaced values. */
+	size_t          buf_allocated;
+	size_t          unused_bytes;           /**< Space of replaced values in buf, reclaimed when buf needs to grow. */
+	uint32_t        offset[DC_PARAM_SLOTS]; /**< Indexed by the key, offset of the value in buf plus one; 0 if the key is not set. */
+	char            keys[DC_PARAM_SLOTS];   /**< The set keys in the order they are packed. */
+	int             key_cnt;
+	char*           packed;                 /**< Cache for dc_param_get_packed(), NULL if not yet created or outdated. */
 } dc_param_t;
 
 
@@ -37,6 +51,7 @@ typedef struct dc_param_t
 #define DC_PARAM_CMD_ARG3          'G'  /* for msgs */
 #define DC_PARAM_CMD_ARG4          'H'  /* for msgs */
 #define DC_PARAM_ERROR             'L'  /* for msgs */
+#define DC_PARAM_SHARED_ID         'b'  /* for msgs: set by dc_send_msg_to_chats(), messages with the same ID share the signed body */
 
 #define DC_PARAM_SERVER_FOLDER     'Z'  /* for jobs */
 #define DC_PARAM_SERVER_UID        'z'  /* for jobs */
@@ -66,6 +81,8 @@ void            dc_param_empty          (dc_param_t*);
 void            dc_param_unref          (dc_param_t*);
 void            dc_param_set_packed     (dc_param_t*, const char*);
 void            dc_param_set_urlencoded (dc_param_t*, const char*);
+void            dc_param_set_param      (dc_param_t*, const dc_param_t* src); /* copy all parameters without packing them */
+const char*     dc_param_get_packed     (dc_param_t*); /* the returned string is valid until the object is modified, it must not be free()'d */
 
 
 #ifdef __cplusplus
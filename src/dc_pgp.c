@@ -16,6 +16,7 @@ one :-) */
 
 #include <netpgp-extra.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 #include "dc_context.h"
 #include "dc_key.h"
 #include "dc_keyring.h"
@@ -23,12 +24,21 @@ one :-) */
 #include "dc_hash.h"
 
 
-static int      s_io_initialized = 0;
-static pgp_io_t s_io;
+static int             s_io_initialized = 0;
+static pgp_io_t        s_io;
+static pthread_mutex_t s_context_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int             s_context_cnt = 0; /* contexts between dc_pgp_init() and dc_pgp_exit() */
+
+
+static void key_cache_clear(int secret_keys_only);
 
 
 void dc_pgp_init(void)
 {
+	pthread_mutex_lock(&s_context_cnt_mutex);
+		s_context_cnt++;
+	pthread_mutex_unlock(&s_context_cnt_mutex);
+
 	if (s_io_initialized) {
 		return;
 	}
@@ -44,6 +54,21 @@ void dc_pgp_init(void)
 
 void dc_pgp_exit(void)
 {
+	/* called when a context is unref'd. The key cache is shared by all contexts,
+	so it is cleared only when the last context goes away; do not keep secret keys in memory longer than needed.
+	Before, the keys of a context are removed by dc_key_forget_self_keys(). */
+	int last = 0;
+
+	pthread_mutex_lock(&s_context_cnt_mutex);
+		if (s_context_cnt > 0) {
+			s_context_cnt--;
+			last = (s_context_cnt==0);
+		}
+	pthread_mutex_unlock(&s_context_cnt_mutex);
+
+	if (last) {
+		key_cache_clear(0);
+	}
 }
 
 
@@ -506,42 +531,282 @@ cleanup:
 }
 
 
+/*******************************************************************************
+ * Cache of parsed keys
+ ******************************************************************************/
+
+
+/* Parsing keys by pgp_filter_keys_from_mem() is needed for every recipient and for our own key
+on each encryption and decryption; the cache keeps the parsed keys by the SHA-256 of the binary key.
+
+The cache is shared by all threads and contexts; the parsed keys are copied shallowly by pgp_keyring_add()
+to temporary keyrings that are used for a single operation.
+netpgp does not modify the keys on usage, the OpenSSL objects are created from copies of the key's numbers.
+
+Entries with secret keys are not evicted by the LRU, there are only few of them and they are needed for each message;
+they are removed when our keys are changed or a context is closed, see dc_pgp_clear_key_cache().
+All other entries are removed by dc_pgp_exit() when the last context goes away. */
+
+
+#define DC_PGP_KEY_CACHE_SIZE 128
+
+
+typedef struct dc_pgp_cached_key_t
+{
+	uint8_t                     digest[SHA256_DIGEST_LENGTH];
+	pgp_keyring_t               public_keys;
+	pgp_keyring_t               private_keys;
+	int                         refcnt;  /* 1 for the cache + 1 for each running operation */
+	struct dc_pgp_cached_key_t* prev;    /* more recently used */
+	struct dc_pgp_cached_key_t* next;    /* less recently used */
+} dc_pgp_cached_key_t;
+
+
+static pthread_mutex_t      s_key_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static dc_hash_t            s_key_cache_hash; /* digest -> dc_pgp_cached_key_t */
+static int                  s_key_cache_initialized = 0;
+static dc_pgp_cached_key_t* s_key_cache_first = NULL;
+static dc_pgp_cached_key_t* s_key_cache_last = NULL;
+static int                  s_key_cache_cnt = 0;
+static int                  s_key_cache_hits = 0;
+static int                  s_key_cache_misses = 0;
+
+
+static void free_cached_key(dc_pgp_cached_key_t* entry)
+{
+	/* pgp_keyring_purge() frees the keys, the secret numbers are cleared by netpgp's pgp_seckey_free() */
+	pgp_keyring_purge(&entry->public_keys);
+	pgp_keyring_purge(&entry->private_keys);
+	free(entry);
+}
+
+
+static void unlink_cached_key(dc_pgp_cached_key_t* entry)
+{
+	if (entry->prev) { entry->prev->next = entry->next; } else { s_key_cache_first = entry->next; }
+	if (entry->next) { entry->next->prev = entry->prev; } else { s_key_cache_last = entry->prev; }
+	entry->prev = NULL;
+	entry->next = NULL;
+}
+
+
+static void link_cached_key_first(dc_pgp_cached_key_t* entry)
+{
+	entry->prev = NULL;
+	entry->next = s_key_cache_first;
+	if (s_key_cache_first) { s_key_cache_first->prev = entry; } else { s_key_cache_last = entry; }
+	s_key_cache_first = entry;
+}
+
+
+static void release_cached_key(dc_pgp_cached_key_t* entry)
+{
+	/* the caller must hold s_key_cache_mutex */
+	entry->refcnt--;
+	if (entry->refcnt==0) {
+		free_cached_key(entry);
+	}
+}
+
+
+static void remove_cached_key(dc_pgp_cached_key_t* entry)
+{
+	/* the caller must hold s_key_cache_mutex; running operations keep their reference */
+	unlink_cached_key(entry);
+	dc_hash_insert(&s_key_cache_hash, entry->digest, sizeof(entry->digest), NULL);
+	s_key_cache_cnt--;
+	release_cached_key(entry);
+}
+
+
+static void key_cache_clear(int secret_keys_only)
+{
+	pthread_mutex_lock(&s_key_cache_mutex);
+		dc_pgp_cached_key_t* entry = s_key_cache_first;
+		while (entry) {
+			dc_pgp_cached_key_t* next = entry->next;
+			if (!secret_keys_only || entry->private_keys.keyc > 0) {
+				remove_cached_key(entry);
+			}
+			entry = next;
+		}
+	pthread_mutex_unlock(&s_key_cache_mutex);
+}
+
+
+static dc_pgp_cached_key_t* get_cached_key(const dc_key_t* raw_key)
+{
+	/* returns the parsed key with a reference that must be given back by release_cached_key();
+	the parsing itself is done without holding the mutex */
+	uint8_t              digest[SHA256_DIGEST_LENGTH];
+	dc_pgp_cached_key_t* entry = NULL;
+	dc_pgp_cached_key_t* parsed = NULL;
+	dc_pgp_cached_key_t* evict = NULL;
+	dc_pgp_cached_key_t* evict_prev = NULL;
+	pgp_memory_t*        keysmem = NULL;
+
+	if (raw_key==NULL || raw_key->binary==NULL || raw_key->bytes<=0) {
+		return NULL;
+	}
+
+	SHA256(raw_key->binary, raw_key->bytes, digest);
+
+	pthread_mutex_lock(&s_key_cache_mutex);
+
+		if (!s_key_cache_initialized) {
+			dc_hash_init(&s_key_cache_hash, DC_HASH_BINARY, 1/*copy key*/);
+			s_key_cache_initialized = 1;
+		}
+
+		if ((entry=dc_hash_find(&s_key_cache_hash, digest, sizeof(digest)))!=NULL) {
+			entry->refcnt++;
+			unlink_cached_key(entry);
+			link_cached_key_first(entry);
+			s_key_cache_hits++;
+		}
+		else {
+			s_key_cache_misses++;
+		}
+
+	pthread_mutex_unlock(&s_key_cache_mutex);
+
+	if (entry) {
+		goto cleanup;
+	}
+
+	if ((parsed=calloc(1, sizeof(dc_pgp_cached_key_t)))==NULL
+	 || (keysmem=pgp_memory_new())==NULL) {
+		goto cleanup;
+	}
+	memcpy(parsed->digest, digest, sizeof(digest));
+	pgp_memory_add(keysmem, raw_key->binary, raw_key->bytes);
+	pgp_filter_keys_from_mem(&s_io, &parsed->public_keys, &parsed->private_keys, NULL, 0, keysmem);
+
+	pthread_mutex_lock(&s_key_cache_mutex);
+
+		if ((entry=dc_hash_find(&s_key_cache_hash, digest, sizeof(digest)))!=NULL) {
+			entry->refcnt++; /* parsed by another thread in between */
+		}
+		else {
+			entry = parsed;
+			parsed = NULL;
+			entry->refcnt = 2;
+			link_cached_key_first(entry);
+			dc_hash_insert(&s_key_cache_hash, entry->digest, sizeof(entry->digest), entry);
+			s_key_cache_cnt++;
+
+			evict = s_key_cache_last;
+			while (s_key_cache_cnt > DC_PGP_KEY_CACHE_SIZE && evict) {
+				evict_prev = evict->prev;
+				if (evict!=entry && evict->private_keys.keyc==0) {
+					remove_cached_key(evict);
+				}
+				evict = evict_prev;
+			}
+		}
+
+	pthread_mutex_unlock(&s_key_cache_mutex);
+
+cleanup:
+	if (parsed) { free_cached_key(parsed); }
+	if (keysmem) { pgp_memory_free(keysmem); }
+	return entry;
+}
+
+
+static void add_cached_keys(dc_pgp_cached_key_t* entry, pgp_keyring_t* public_keys, pgp_keyring_t* private_keys)
+{
+	/* the keyrings get shallow copies of the keys, they must be freed using pgp_keyring_free(), not by pgp_keyring_purge() */
+	unsigned i = 0;
+	for (i = 0; i < entry->public_keys.keyc; i++) {
+		pgp_keyring_add(public_keys, &entry->public_keys.keys[i]);
+	}
+	for (i = 0; i < entry->private_keys.keyc; i++) {
+		pgp_keyring_add(private_keys, &entry->private_keys.keys[i]);
+	}
+}
+
+
+static void release_cached_keys(dc_array_t* entries)
+{
+	size_t i = 0, cnt = dc_array_get_cnt(entries);
+	if (cnt==0) {
+		return;
+	}
+
+	pthread_mutex_lock(&s_key_cache_mutex);
+		for (i = 0; i < cnt; i++) {
+			release_cached_key((dc_pgp_cached_key_t*)dc_array_get_uint(entries, i));
+		}
+	pthread_mutex_unlock(&s_key_cache_mutex);
+}
+
+
+static int load_keyring(dc_array_t* entries, const dc_keyring_t* raw_keys, pgp_keyring_t* public_keys, pgp_keyring_t* private_keys)
+{
+	int i = 0;
+	for (i = 0; i < raw_keys->count; i++) {
+		dc_pgp_cached_key_t* entry = get_cached_key(raw_keys->keys[i]);
+		if (entry==NULL) {
+			return 0;
+		}
+		dc_array_add_uint(entries, (uintptr_t)entry);
+		add_cached_keys(entry, public_keys, private_keys);
+	}
+	return 1;
+}
+
+
+/**
+ * Remove the parsed secret keys from the cache.
+ * To be called when our own keys are changed or forgotten.
+ * As the cache is shared by all contexts, the secret keys of other contexts
+ * are removed as well and are parsed again on their next usage;
+ * the public keys are kept.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_pgp_clear_key_cache(void)
+{
+	key_cache_clear(1);
+}
+
+
+char* dc_pgp_get_key_cache_info(void)
+{
+	char* ret = NULL;
+
+	pthread_mutex_lock(&s_key_cache_mutex);
+		ret = dc_mprintf("%i/%i, %i hits, %i misses", s_key_cache_cnt, DC_PGP_KEY_CACHE_SIZE, s_key_cache_hits, s_key_cache_misses);
+	pthread_mutex_unlock(&s_key_cache_mutex);
+
+	return ret;
+}
+
+
 /*******************************************************************************
  * Public key encrypt/decrypt
  ******************************************************************************/
 
 
-int dc_pgp_pk_encrypt( dc_context_t*       context,
-                       const void*         plain_text,
-                       size_t              plain_bytes,
-                       const dc_keyring_t* raw_public_keys_for_encryption,
-                       const dc_key_t*     raw_private_key_for_signing,
-                       int                 use_armor,
-                       void**              ret_ctext,
-                       size_t*             ret_ctext_bytes)
+static int encrypt_buf(dc_context_t* context, const void* text, size_t text_bytes, int text_is_signed_packet,
+                       const dc_keyring_t* raw_public_keys_for_encryption, int use_armor,
+                       void** ret_ctext, size_t* ret_ctext_bytes)
 {
 	pgp_keyring_t*  public_keys = calloc(1, sizeof(pgp_keyring_t));
 	pgp_keyring_t*  private_keys = calloc(1, sizeof(pgp_keyring_t));
-	pgp_keyring_t*  dummy_keys = calloc(1, sizeof(pgp_keyring_t));
-	pgp_memory_t*   keysmem = pgp_memory_new();
-	pgp_memory_t*   signedmem = NULL;
-	int             i = 0;
+	dc_array_t*     cached_keys = dc_array_new(context, 16);
+	pgp_memory_t*   outmem = NULL;
 	int             success = 0;
 
-	if (context==NULL || plain_text==NULL || plain_bytes==0 || ret_ctext==NULL || ret_ctext_bytes==NULL
-	 || raw_public_keys_for_encryption==NULL || raw_public_keys_for_encryption->count<=0
-	 || keysmem==NULL || public_keys==NULL || private_keys==NULL || dummy_keys==NULL) {
+	if (raw_public_keys_for_encryption==NULL || raw_public_keys_for_encryption->count<=0
+	 || public_keys==NULL || private_keys==NULL) {
 		goto cleanup;
 	}
 
-	*ret_ctext       = NULL;
-	*ret_ctext_bytes = 0;
-
-	/* setup keys (the keys may come from pgp_filter_keys_fileread(), see also pgp_keyring_add(rcpts, key)) */
-	for (i = 0; i < raw_public_keys_for_encryption->count; i++) {
-		pgp_memory_clear(keysmem);
-		pgp_memory_add(keysmem, raw_public_keys_for_encryption->keys[i]->binary, raw_public_keys_for_encryption->keys[i]->bytes);
-		pgp_filter_keys_from_mem(&s_io, public_keys, private_keys/*should stay empty*/, NULL, 0, keysmem);
+	/* setup keys, the keyrings get the parsed keys from the cache, see get_cached_key() */
+	if (!load_keyring(cached_keys, raw_public_keys_for_encryption, public_keys, private_keys/*should stay empty*/)) {
+		goto cleanup;
 	}
 
 	if (public_keys->keyc <=0 || private_keys->keyc!=0) {
@@ -549,70 +814,163 @@ int dc_pgp_pk_encrypt( dc_context_t*       context,
 		goto cleanup;
 	}
 
-	/* encrypt */
-	{
-		const void* signed_text = NULL;
-		size_t      signed_bytes = 0;
-		int         encrypt_raw_packet = 0;
-		clock_t     sign_clocks = 0;
-		clock_t     encrypt_clocks = 0;
-
-		if (raw_private_key_for_signing) {
-			pgp_memory_clear(keysmem);
-			pgp_memory_add(keysmem, raw_private_key_for_signing->binary, raw_private_key_for_signing->bytes);
-			pgp_filter_keys_from_mem(&s_io, dummy_keys, private_keys, NULL, 0, keysmem);
-			if (private_keys->keyc <= 0) {
-				dc_log_warning(context, 0, "No key for signing found.");
-				goto cleanup;
-			}
+	if ((outmem=pgp_encrypt_buf(&s_io, text, text_bytes, public_keys, use_armor, NULL/*cipher*/, text_is_signed_packet))==NULL) {
+		dc_log_warning(context, 0, "Encryption failed.");
+		goto cleanup;
+	}
+	*ret_ctext       = outmem->buf;
+	*ret_ctext_bytes = outmem->length;
+	free(outmem); /* do not use pgp_memory_free() as we took ownership of the buffer */
 
-			clock_t start = clock();
+	success = 1;
 
-			pgp_key_t* sk0 = &private_keys->keys[0];
-			signedmem = pgp_sign_buf(&s_io, plain_text, plain_bytes, &sk0->key.seckey, time(NULL)/*birthtime*/, 0/*duration*/,
-				NULL/*hash, defaults to sha256*/, 0/*armored*/, 0/*cleartext*/);
+cleanup:
+	if (public_keys)  { pgp_keyring_free(public_keys); free(public_keys); } /*the keys belong to the cache, pgp_keyring_free() frees the array only*/
+	if (private_keys) { pgp_keyring_free(private_keys); free(private_keys); }
+	release_cached_keys(cached_keys);
+	dc_array_unref(cached_keys);
+	return success;
+}
 
-			sign_clocks = clock()-start;
 
-			if (signedmem==NULL) {
-				dc_log_warning(context, 0, "Signing failed.");
-				goto cleanup;
-			}
-			signed_text        = signedmem->buf;
-			signed_bytes       = signedmem->length;
-			encrypt_raw_packet = 1;
-		}
-		else {
-			signed_text        = plain_text;
-			signed_bytes       = plain_bytes;
-			encrypt_raw_packet = 0;
-		}
+/**
+ * Sign a text with our private key.
+ * The result is an unarmored signed packet that can be given to dc_pgp_pk_encrypt_signed(),
+ * so a text sent to different recipients needs to be signed only once.
+ *
+ * @private @memberof dc_context_t
+ * @param context The context object.
+ * @param plain_text The text to sign.
+ * @param plain_bytes Length of the text to sign.
+ * @param raw_private_key_for_signing Our private key.
+ * @param ret_signed On success, the signed packet is returned here, must be free()'d.
+ * @param ret_signed_bytes On success, the length of the signed packet is returned here.
+ * @return 1=success, 0=error.
+ */
+int dc_pgp_sign( dc_context_t*       context,
+                 const void*         plain_text,
+                 size_t              plain_bytes,
+                 const dc_key_t*     raw_private_key_for_signing,
+                 void**              ret_signed,
+                 size_t*             ret_signed_bytes)
+{
+	pgp_keyring_t*       public_keys = calloc(1, sizeof(pgp_keyring_t));
+	pgp_keyring_t*       private_keys = calloc(1, sizeof(pgp_keyring_t));
+	dc_array_t*          cached_keys = dc_array_new(context, 1);
+	dc_pgp_cached_key_t* entry = NULL;
+	pgp_memory_t*        signedmem = NULL;
+	int                  success = 0;
+
+	if (context==NULL || plain_text==NULL || plain_bytes==0 || raw_private_key_for_signing==NULL
+	 || ret_signed==NULL || ret_signed_bytes==NULL || public_keys==NULL || private_keys==NULL) {
+		goto cleanup;
+	}
 
-		clock_t start = clock();
+	*ret_signed       = NULL;
+	*ret_signed_bytes = 0;
 
-		pgp_memory_t* outmem = pgp_encrypt_buf(&s_io, signed_text, signed_bytes, public_keys, use_armor, NULL/*cipher*/, encrypt_raw_packet);
+	if ((entry=get_cached_key(raw_private_key_for_signing))!=NULL) {
+		dc_array_add_uint(cached_keys, (uintptr_t)entry);
+		add_cached_keys(entry, public_keys, private_keys);
+	}
+	if (private_keys->keyc <= 0) {
+		dc_log_warning(context, 0, "No key for signing found.");
+		goto cleanup;
+	}
 
-		encrypt_clocks = clock()-start;
+	pgp_key_t* sk0 = &private_keys->keys[0];
+	signedmem = pgp_sign_buf(&s_io, plain_text, plain_bytes, &sk0->key.seckey, time(NULL)/*birthtime*/, 0/*duration*/,
+		NULL/*hash, defaults to sha256*/, 0/*armored*/, 0/*cleartext*/);
+	if (signedmem==NULL) {
+		dc_log_warning(context, 0, "Signing failed.");
+		goto cleanup;
+	}
+	*ret_signed       = signedmem->buf;
+	*ret_signed_bytes = signedmem->length;
+	free(signedmem); /* do not use pgp_memory_free() as we took ownership of the buffer */
 
-		dc_log_info(context, 0, "Message signed in %.3f ms and encrypted in %.3f ms.", (double)(sign_clocks)*1000.0/CLOCKS_PER_SEC, (double)(encrypt_clocks)*1000.0/CLOCKS_PER_SEC);
+	success = 1;
 
-		if (outmem==NULL) {
-			dc_log_warning(context, 0, "Encryption failed.");
-			goto cleanup;
+cleanup:
+	if (public_keys)  { pgp_keyring_free(public_keys); free(public_keys); } /*the keys belong to the cache, pgp_keyring_free() frees the array only*/
+	if (private_keys) { pgp_keyring_free(private_keys); free(private_keys); }
+	release_cached_keys(cached_keys);
+	dc_array_unref(cached_keys);
+	return success;
+}
+
+
+/**
+ * Encrypt a packet signed by dc_pgp_sign() to the given keys.
+ *
+ * @private @memberof dc_context_t
+ */
+int dc_pgp_pk_encrypt_signed( dc_context_t*       context,
+                              const void*         signed_packet,
+                              size_t              signed_bytes,
+                              const dc_keyring_t* raw_public_keys_for_encryption,
+                              int                 use_armor,
+                              void**              ret_ctext,
+                              size_t*             ret_ctext_bytes)
+{
+	if (context==NULL || signed_packet==NULL || signed_bytes==0 || ret_ctext==NULL || ret_ctext_bytes==NULL) {
+		return 0;
+	}
+
+	*ret_ctext       = NULL;
+	*ret_ctext_bytes = 0;
+
+	clock_t start = clock();
+
+	int success = encrypt_buf(context, signed_packet, signed_bytes, 1/*signed packet*/, raw_public_keys_for_encryption, use_armor, ret_ctext, ret_ctext_bytes);
+
+	dc_log_info(context, 0, "Signed message encrypted in %.3f ms.", (double)(clock()-start)*1000.0/CLOCKS_PER_SEC);
+	return success;
+}
+
+
+int dc_pgp_pk_encrypt( dc_context_t*       context,
+                       const void*         plain_text,
+                       size_t              plain_bytes,
+                       const dc_keyring_t* raw_public_keys_for_encryption,
+                       const dc_key_t*     raw_private_key_for_signing,
+                       int                 use_armor,
+                       void**              ret_ctext,
+                       size_t*             ret_ctext_bytes)
+{
+	void*   signed_text = NULL;
+	size_t  signed_bytes = 0;
+	clock_t sign_clocks = 0;
+	clock_t encrypt_clocks = 0;
+	int     success = 0;
+
+	if (context==NULL || plain_text==NULL || plain_bytes==0 || ret_ctext==NULL || ret_ctext_bytes==NULL) {
+		goto cleanup;
+	}
+
+	*ret_ctext       = NULL;
+	*ret_ctext_bytes = 0;
+
+	if (raw_private_key_for_signing) {
+		clock_t start = clock();
+		if (!dc_pgp_sign(context, plain_text, plain_bytes, raw_private_key_for_signing, &signed_text, &signed_bytes)) {
+			goto cleanup; /* error already logged */
 		}
-		*ret_ctext       = outmem->buf;
-		*ret_ctext_bytes = outmem->length;
-		free(outmem); /* do not use pgp_memory_free() as we took ownership of the buffer */
+		sign_clocks = clock()-start;
 	}
 
-	success = 1;
+	clock_t start = clock();
+
+	success = signed_text?
+		encrypt_buf(context, signed_text, signed_bytes, 1/*signed packet*/, raw_public_keys_for_encryption, use_armor, ret_ctext, ret_ctext_bytes) :
+		encrypt_buf(context, plain_text, plain_bytes, 0/*raw text*/, raw_public_keys_for_encryption, use_armor, ret_ctext, ret_ctext_bytes);
+
+	encrypt_clocks = clock()-start;
+
+	dc_log_info(context, 0, "Message signed in %.3f ms and encrypted in %.3f ms.", (double)(sign_clocks)*1000.0/CLOCKS_PER_SEC, (double)(encrypt_clocks)*1000.0/CLOCKS_PER_SEC);
 
 cleanup:
-	if (keysmem)      { pgp_memory_free(keysmem); }
-	if (signedmem)    { pgp_memory_free(signedmem); }
-	if (public_keys)  { pgp_keyring_purge(public_keys); free(public_keys); } /*pgp_keyring_free() frees the content, not the pointer itself*/
-	if (private_keys) { pgp_keyring_purge(private_keys); free(private_keys); }
-	if (dummy_keys)   { pgp_keyring_purge(dummy_keys); free(dummy_keys); }
+	free(signed_text);
 	return success;
 }
 
@@ -633,24 +991,22 @@ int dc_pgp_pk_decrypt( dc_context_t*       context,
 	pgp_validation_t* vresult = calloc(1, sizeof(pgp_validation_t));
 	key_id_t*         recipients_key_ids = NULL;
 	unsigned          recipients_cnt = 0;
-	pgp_memory_t*     keysmem = pgp_memory_new();
+	dc_array_t*       cached_keys = dc_array_new(context, 16);
 	int               i = 0;
 	int               success = 0;
 
 	if (context==NULL || ctext==NULL || ctext_bytes==0 || ret_plain==NULL || ret_plain_bytes==NULL
 	 || raw_private_keys_for_decryption==NULL || raw_private_keys_for_decryption->count<=0
-	 || vresult==NULL || keysmem==NULL || public_keys==NULL || private_keys==NULL) {
+	 || vresult==NULL || public_keys==NULL || private_keys==NULL || dummy_keys==NULL) {
 		goto cleanup;
 	}
 
 	*ret_plain             = NULL;
 	*ret_plain_bytes       = 0;
 
-	/* setup keys (the keys may come from pgp_filter_keys_fileread(), see also pgp_keyring_add(rcpts, key)) */
-	for (i = 0; i < raw_private_keys_for_decryption->count; i++) {
-		pgp_memory_clear(keysmem); /* a simple concatenate of private binary keys fails (works for public keys, however, we don't do it there either) */
-		pgp_memory_add(keysmem, raw_private_keys_for_decryption->keys[i]->binary, raw_private_keys_for_decryption->keys[i]->bytes);
-		pgp_filter_keys_from_mem(&s_io, dummy_keys/*should stay empty*/, private_keys, NULL, 0, keysmem);
+	/* setup keys, the keyrings get the parsed keys from the cache, see get_cached_key() */
+	if (!load_keyring(cached_keys, raw_private_keys_for_decryption, dummy_keys/*should stay empty*/, private_keys)) {
+		goto cleanup;
 	}
 
 	if (private_keys->keyc<=0) {
@@ -659,10 +1015,8 @@ int dc_pgp_pk_decrypt( dc_context_t*       context,
 	}
 
 	if (raw_public_keys_for_validation) {
-		for (i = 0; i < raw_public_keys_for_validation->count; i++) {
-			pgp_memory_clear(keysmem);
-			pgp_memory_add(keysmem, raw_public_keys_for_validation->keys[i]->binary, raw_public_keys_for_validation->keys[i]->bytes);
-			pgp_filter_keys_from_mem(&s_io, public_keys, dummy_keys/*should stay empty*/, NULL, 0, keysmem);
+		if (!load_keyring(cached_keys, raw_public_keys_for_validation, public_keys, dummy_keys/*should stay empty*/)) {
+			goto cleanup;
 		}
 	}
 
@@ -704,11 +1058,12 @@ int dc_pgp_pk_decrypt( dc_context_t*       context,
 	success = 1;
 
 cleanup:
-	if (keysmem)            { pgp_memory_free(keysmem); }
-	if (public_keys)        { pgp_keyring_purge(public_keys); free(public_keys); } /*pgp_keyring_free() frees the content, not the pointer itself*/
-	if (private_keys)       { pgp_keyring_purge(private_keys); free(private_keys); }
-	if (dummy_keys)         { pgp_keyring_purge(dummy_keys); free(dummy_keys); }
+	if (public_keys)        { pgp_keyring_free(public_keys); free(public_keys); } /*the keys belong to the cache, pgp_keyring_free() frees the array only*/
+	if (private_keys)       { pgp_keyring_free(private_keys); free(private_keys); }
+	if (dummy_keys)         { pgp_keyring_free(dummy_keys); free(dummy_keys); }
 	if (vresult)            { pgp_validate_result_free(vresult); }
+	release_cached_keys(cached_keys);
+	dc_array_unref(cached_keys);
 	free(recipients_key_ids);
 	return success;
 }
@@ -18,6 +18,8 @@ typedef struct dc_keyring_t dc_keyring_t;
 void dc_pgp_init             (void);
 void dc_pgp_exit             (void);
 void dc_pgp_rand_seed        (dc_context_t*, const void* buf, size_t bytes);
+void dc_pgp_clear_key_cache  (void);
+char* dc_pgp_get_key_cache_info (void); /* the returned string must be free()'d */
 int  dc_split_armored_data  (char* buf, const char** ret_headerline, const char** ret_setupcodebegin, const char** ret_preferencrypt, const char** ret_base64);
 
 /* public key encryption */
@@ -30,6 +32,8 @@ int  dc_pgp_calc_fingerprint (const dc_key_t*, uint8_t** fingerprint, size_t* fi
 int  dc_pgp_split_key        (dc_context_t*, const dc_key_t* private_in, dc_key_t* public_out);
 
 int  dc_pgp_pk_encrypt       (dc_context_t*, const void* plain, size_t plain_bytes, const dc_keyring_t*, const dc_key_t* sign_key, int use_armor, void** ret_ctext, size_t* ret_ctext_bytes);
+int  dc_pgp_sign             (dc_context_t*, const void* plain, size_t plain_bytes, const dc_key_t* sign_key, void** ret_signed, size_t* ret_signed_bytes);
+int  dc_pgp_pk_encrypt_signed (dc_context_t*, const void* signed_packet, size_t signed_bytes, const dc_keyring_t*, int use_armor, void** ret_ctext, size_t* ret_ctext_bytes);
 int  dc_pgp_pk_decrypt       (dc_context_t*, const void* ctext, size_t ctext_bytes, const dc_keyring_t*, const dc_keyring_t* validate_keys, int use_armor, void** plain, size_t* plain_bytes, dc_hash_t* ret_signature_fingerprints);
 
 
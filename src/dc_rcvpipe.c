@@ -0,0 +1,213 @@
+#include <unistd.h>
+#include "dc_context.h"
+#include "dc_rcvpipe.h"
+
+
+static void* worker_thread_entry_point(void* entry_arg)
+{
+	dc_rcvpipe_t*      rcvpipe = (dc_rcvpipe_t*)entry_arg;
+	dc_rcvpipe_item_t* item = NULL;
+	int                i = 0;
+
+	pthread_mutex_lock(&rcvpipe->mutex);
+
+		while (!rcvpipe->stop)
+		{
+			/* prepare the oldest message not yet taken by another thread */
+			item = NULL;
+			for (i = 0; i < rcvpipe->cnt; i++) {
+				dc_rcvpipe_item_t* test = rcvpipe->items[(rcvpipe->first+i)%DC_RCVPIPE_QUEUE_SIZE];
+				if (test->state==DC_RCVPIPE_QUEUED) {
+					item = test;
+					break;
+				}
+			}
+
+			if (item==NULL) {
+				pthread_cond_wait(&rcvpipe->work_cond, &rcvpipe->mutex);
+				continue;
+			}
+
+			item->state = DC_RCVPIPE_WORKING;
+			pthread_mutex_unlock(&rcvpipe->mutex);
+
+				dc_e2ee_prepare_decrypt(rcvpipe->context, item->imf_raw, item->imf_raw_bytes, &item->prepared);
+
+			pthread_mutex_lock(&rcvpipe->mutex);
+			item->state = DC_RCVPIPE_DONE;
+			pthread_cond_broadcast(&rcvpipe->done_cond);
+		}
+
+	pthread_mutex_unlock(&rcvpipe->mutex);
+
+	return NULL;
+}
+
+
+static void start_threads(dc_rcvpipe_t* rcvpipe)
+{
+	/* the IMAP thread works as well, so we use one thread less than there are processors */
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int  cnt = cpus > 1? (int)(cpus-1) : 0;
+	if (cnt > DC_RCVPIPE_MAX_THREADS) {
+		cnt = DC_RCVPIPE_MAX_THREADS;
+	}
+
+	rcvpipe->threads_started = 1;
+	for (rcvpipe->thread_cnt = 0; rcvpipe->thread_cnt < cnt; rcvpipe->thread_cnt++) {
+		if (pthread_create(&rcvpipe->threads[rcvpipe->thread_cnt], NULL, worker_thread_entry_point, rcvpipe)!=0) {
+			dc_log_warning(rcvpipe->context, 0, "Cannot create receive thread.");
+			break;
+		}
+	}
+}
+
+
+static void receive_oldest(dc_rcvpipe_t* rcvpipe)
+{
+	dc_rcvpipe_item_t* item = NULL;
+
+	pthread_mutex_lock(&rcvpipe->mutex);
+
+		if (rcvpipe->cnt==0) {
+			pthread_mutex_unlock(&rcvpipe->mutex);
+			return;
+		}
+
+		item = rcvpipe->items[rcvpipe->first];
+
+		/* if no worker took the message yet, prepare it ourself instead of waiting */
+		if (item->state==DC_RCVPIPE_QUEUED) {
+			item->state = DC_RCVPIPE_WORKING;
+			pthread_mutex_unlock(&rcvpipe->mutex);
+				dc_e2ee_prepare_decrypt(rcvpipe->context, item->imf_raw, item->imf_raw_bytes, &item->prepared);
+			pthread_mutex_lock(&rcvpipe->mutex);
+			item->state = DC_RCVPIPE_DONE;
+		}
+
+		while (item->state!=DC_RCVPIPE_DONE) {
+			pthread_cond_wait(&rcvpipe->done_cond, &rcvpipe->mutex);
+		}
+
+		rcvpipe->items[rcvpipe->first] = NULL;
+		rcvpipe->first = (rcvpipe->first+1)%DC_RCVPIPE_QUEUE_SIZE;
+		rcvpipe->cnt--;
+
+	pthread_mutex_unlock(&rcvpipe->mutex);
+
+	/* the database is modified only here, in the order the messages were added */
+	dc_receive_imf_prepared(rcvpipe->context, item->imf_raw, item->imf_raw_bytes, item->server_folder, item->server_uid, item->flags, &item->prepared);
+
+	dc_e2ee_prepared_empty(&item->prepared);
+	free(item->server_folder);
+	free(item);
+}
+
+
+dc_rcvpipe_t* dc_rcvpipe_new(dc_context_t* context)
+{
+	dc_rcvpipe_t* rcvpipe = NULL;
+
+	if ((rcvpipe=calloc(1, sizeof(dc_rcvpipe_t)))==NULL) {
+		exit(56);
+	}
+
+	rcvpipe->context = context;
+	pthread_mutex_init(&rcvpipe->mutex, NULL);
+	pthread_cond_init(&rcvpipe->work_cond, NULL);
+	pthread_cond_init(&rcvpipe->done_cond, NULL);
+
+	return rcvpipe;
+}
+
+
+void dc_rcvpipe_unref(dc_rcvpipe_t* rcvpipe)
+{
+	int i = 0;
+
+	if (rcvpipe==NULL) {
+		return;
+	}
+
+	dc_rcvpipe_flush(rcvpipe);
+
+	pthread_mutex_lock(&rcvpipe->mutex);
+		rcvpipe->stop = 1;
+		pthread_cond_broadcast(&rcvpipe->work_cond);
+	pthread_mutex_unlock(&rcvpipe->mutex);
+
+	for (i = 0; i < rcvpipe->thread_cnt; i++) {
+		pthread_join(rcvpipe->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&rcvpipe->work_cond);
+	pthread_cond_destroy(&rcvpipe->done_cond);
+	pthread_mutex_destroy(&rcvpipe->mutex);
+	free(rcvpipe);
+}
+
+
+/**
+ * Add a message to the pipeline.
+ * The message is parsed and decrypted by a worker thread and received
+ * on a subsequent call to dc_rcvpipe_add() or on dc_rcvpipe_flush().
+ * To be called from the IMAP thread only.
+ *
+ * @private @memberof dc_rcvpipe_t
+ */
+void dc_rcvpipe_add(dc_rcvpipe_t* rcvpipe, const char* imf_raw_not_terminated, size_t imf_raw_bytes,
+                    const char* server_folder, uint32_t server_uid, uint32_t flags)
+{
+	dc_rcvpipe_item_t* item = NULL;
+
+	if (rcvpipe==NULL) {
+		return;
+	}
+
+	if (!rcvpipe->threads_started) {
+		start_threads(rcvpipe);
+	}
+
+	if (rcvpipe->thread_cnt==0) {
+		dc_receive_imf(rcvpipe->context, imf_raw_not_terminated, imf_raw_bytes, server_folder, server_uid, flags);
+		return;
+	}
+
+	if (rcvpipe->cnt >= DC_RCVPIPE_QUEUE_SIZE) {
+		receive_oldest(rcvpipe);
+	}
+
+	if ((item=calloc(1, sizeof(dc_rcvpipe_item_t)))==NULL) {
+		exit(57);
+	}
+	item->imf_raw       = imf_raw_not_terminated;
+	item->imf_raw_bytes = imf_raw_bytes;
+	item->server_folder = dc_strdup(server_folder);
+	item->server_uid    = server_uid;
+	item->flags         = flags;
+	item->state         = DC_RCVPIPE_QUEUED;
+
+	pthread_mutex_lock(&rcvpipe->mutex);
+		rcvpipe->items[(rcvpipe->first+rcvpipe->cnt)%DC_RCVPIPE_QUEUE_SIZE] = item;
+		rcvpipe->cnt++;
+		pthread_cond_signal(&rcvpipe->work_cond);
+	pthread_mutex_unlock(&rcvpipe->mutex);
+}
+
+
+/**
+ * Receive all messages added to the pipeline.
+ * After the function returns, the raw messages given to dc_rcvpipe_add() are no longer used.
+ *
+ * @private @memberof dc_rcvpipe_t
+ */
+void dc_rcvpipe_flush(dc_rcvpipe_t* rcvpipe)
+{
+	if (rcvpipe==NULL) {
+		return;
+	}
+
+	while (rcvpipe->cnt > 0) {
+		receive_oldest(rcvpipe);
+	}
+}
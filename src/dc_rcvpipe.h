@@ -0,0 +1,71 @@
+/* Purpose: Parse and decrypt received messages in worker threads.
+The IMAP thread adds the fetched messages and receives them in the order they were added,
+the database is only modified by the IMAP thread, see dc_e2ee_prepare_decrypt(). */
+
+
+#ifndef __DC_RCVPIPE_H__
+#define __DC_RCVPIPE_H__
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define DC_RCVPIPE_MAX_THREADS  4
+#define DC_RCVPIPE_QUEUE_SIZE  16 // messages parsed ahead, this bounds the memory used for parsed messages
+
+
+#define DC_RCVPIPE_QUEUED  0
+#define DC_RCVPIPE_WORKING 1
+#define DC_RCVPIPE_DONE    2
+
+
+/**
+ * Library-internal.
+ * One message added to the pipeline.
+ */
+typedef struct dc_rcvpipe_item_t
+{
+	/** @privatesection */
+
+	const char*        imf_raw;        // not owned, must be valid until the message is received
+	size_t             imf_raw_bytes;
+	char*              server_folder;
+	uint32_t           server_uid;
+	uint32_t           flags;
+	int                state;          // one of DC_RCVPIPE_QUEUED, DC_RCVPIPE_WORKING or DC_RCVPIPE_DONE
+	dc_e2ee_prepared_t prepared;       // the result of dc_e2ee_prepare_decrypt()
+} dc_rcvpipe_item_t;
+
+
+/**
+ * Library-internal.
+ */
+typedef struct dc_rcvpipe_t
+{
+	/** @privatesection */
+
+	dc_context_t*       context;
+	pthread_mutex_t     mutex;
+	pthread_cond_t      work_cond;    // signalled when items are added or on stop
+	pthread_cond_t      done_cond;    // signalled when items are prepared
+	pthread_t           threads[DC_RCVPIPE_MAX_THREADS];
+	int                 thread_cnt;
+	int                 threads_started;
+	int                 stop;
+	dc_rcvpipe_item_t*  items[DC_RCVPIPE_QUEUE_SIZE]; // ring buffer, the oldest item is received first
+	int                 first;
+	int                 cnt;
+} dc_rcvpipe_t;
+
+
+dc_rcvpipe_t* dc_rcvpipe_new   (dc_context_t*);
+void          dc_rcvpipe_unref (dc_rcvpipe_t*);
+
+void          dc_rcvpipe_add   (dc_rcvpipe_t*, const char* imf_raw_not_terminated, size_t imf_raw_bytes, const char* server_folder, uint32_t server_uid, uint32_t flags); /* if the queue is full, the oldest message is received first */
+void          dc_rcvpipe_flush (dc_rcvpipe_t*); /* receive all added messages */
+
+
+#ifdef __cplusplus
+} /* /extern "C" */
+#endif
+#endif /* __DC_RCVPIPE_H__ */
@@ -7,6 +7,7 @@
 #include "dc_job.h"
 #include "dc_array.h"
 #include "dc_apeerstate.h"
+#include "dc_midfilter.h"
 
 
 /*******************************************************************************
@@ -104,8 +105,8 @@ static void dc_add_or_lookup_contacts_by_address_list(dc_context_t* context, con
 static int is_known_rfc724_mid(dc_context_t* context, const char* rfc724_mid)
 {
 	int is_known = 0;
-	if (rfc724_mid) {
-		sqlite3_stmt* stmt = dc_sqlite3_prepare(context->sql,
+	if (rfc724_mid && dc_midfilter_may_contain(context->mid_filter, rfc724_mid)) {
+		sqlite3_stmt* stmt = dc_sqlite3_prepare_cached(context->sql,
 			"SELECT m.id FROM msgs m "
 			" LEFT JOIN chats c ON m.chat_id=c.id "
 			" WHERE m.rfc724_mid=? "
@@ -115,7 +116,7 @@ static int is_known_rfc724_mid(dc_context_t* context, const char* rfc724_mid)
 		if (sqlite3_step(stmt)==SQLITE_ROW) {
 			is_known = 1;
 		}
-		sqlite3_finalize(stmt);
+		dc_sqlite3_finalize_cached(context->sql, stmt);
 	}
 	return is_known;
 }
@@ -184,8 +185,8 @@ static int dc_is_reply_to_known_message(dc_context_t* context, dc_mimeparser_t*
 static int is_msgrmsg_rfc724_mid(dc_context_t* context, const char* rfc724_mid)
 {
 	int is_msgrmsg = 0;
-	if (rfc724_mid) {
-		sqlite3_stmt* stmt = dc_sqlite3_prepare(context->sql,
+	if (rfc724_mid && dc_midfilter_may_contain(context->mid_filter, rfc724_mid)) {
+		sqlite3_stmt* stmt = dc_sqlite3_prepare_cached(context->sql,
 			"SELECT id FROM msgs "
 			" WHERE rfc724_mid=? "
 			" AND msgrmsg!=0 "
@@ -194,7 +195,7 @@ static int is_msgrmsg_rfc724_mid(dc_context_t* context, const char* rfc724_mid)
 		if (sqlite3_step(stmt)==SQLITE_ROW) {
 			is_msgrmsg = 1;
 		}
-		sqlite3_finalize(stmt);
+		dc_sqlite3_finalize_cached(context->sql, stmt);
 	}
 	return is_msgrmsg;
 }
@@ -272,7 +273,7 @@ static void calc_timestamps(dc_context_t* context, uint32_t chat_id, uint32_t fr
 	(we do this check only for fresh messages, other messages may pop up whereever, this may happen eg. when restoring old messages or synchronizing different clients) */
 	if (is_fresh_msg)
 	{
-		sqlite3_stmt* stmt = dc_sqlite3_prepare(context->sql,
+		sqlite3_stmt* stmt = dc_sqlite3_prepare_cached(context->sql,
 			"SELECT MAX(timestamp) FROM msgs WHERE chat_id=? and from_id!=? AND timestamp>=?");
 		sqlite3_bind_int  (stmt,  1, chat_id);
 		sqlite3_bind_int  (stmt,  2, from_id);
@@ -288,7 +289,7 @@ static void calc_timestamps(dc_context_t* context, uint32_t chat_id, uint32_t fr
 				}
 			}
 		}
-		sqlite3_finalize(stmt);
+		dc_sqlite3_finalize_cached(context->sql, stmt);
 	}
 
 	/* use the (smeared) current time as the MAXIMUM */
@@ -303,8 +304,7 @@ static dc_array_t* search_chat_ids_by_contact_ids(dc_context_t* context, const d
 	/* searches chat_id's by the given contact IDs, may return zero, one or more chat_id's */
 	sqlite3_stmt* stmt = NULL;
 	dc_array_t*   contact_ids = dc_array_new(context, 23);
-	char*         contact_ids_str = NULL;
-	char*         q3 = NULL;
+	dc_array_t*   candidate_ids = dc_array_new(context, 23);
 	dc_array_t*   chat_ids = dc_array_new(context, 23);
 
 	if (context==NULL || context->magic!=DC_CONTEXT_MAGIC) {
@@ -329,55 +329,49 @@ static dc_array_t* search_chat_ids_by_contact_ids(dc_context_t* context, const d
 			goto cleanup;
 		}
 
-		dc_array_sort_ids(contact_ids); /* for easy comparison, we also sort the sql result below */
+		dc_array_sort_ids(contact_ids); /* the hash is calculated over the sorted IDs */
 	}
 
-	/* collect all possible chats with the contact count as the data (as contact_ids have no doubles, this is sufficient) */
-	contact_ids_str = dc_array_get_string(contact_ids, ",");
-	q3 = sqlite3_mprintf("SELECT DISTINCT cc.chat_id, cc.contact_id "
-	                     " FROM chats_contacts cc "
-	                     " LEFT JOIN chats c ON c.id=cc.chat_id "
-	                     " WHERE cc.chat_id IN(SELECT chat_id FROM chats_contacts WHERE contact_id IN(%s))"
-	                     "   AND c.type=" DC_STRINGIFY(DC_CHAT_TYPE_GROUP) /* no verified groups and no single chats (which are equal to a group with a single member and without SELF) */
-	                     "   AND cc.contact_id!=" DC_STRINGIFY(DC_CONTACT_ID_SELF) /* ignore SELF, we've also removed it above - if the user has left the group, it is still the same group */
-	                     " ORDER BY cc.chat_id, cc.contact_id;",
-	                     contact_ids_str);
-	stmt = dc_sqlite3_prepare(context->sql, q3);
-	{
-		uint32_t last_chat_id = 0, matches = 0, mismatches = 0;
-
-		while (sqlite3_step(stmt)==SQLITE_ROW)
-		{
-			uint32_t chat_id    = sqlite3_column_int(stmt, 0);
-			uint32_t contact_id = sqlite3_column_int(stmt, 1);
-
-			if (chat_id!=last_chat_id) {
-				if (matches==dc_array_get_cnt(contact_ids) && mismatches==0) {
-					dc_array_add_id(chat_ids, last_chat_id);
-				}
-				last_chat_id = chat_id;
-				matches = 0;
-				mismatches = 0;
-			}
+	/* find the chats with exactly these members by the hash maintained by dc_recalc_chat_member_set();
+	SELF is ignored, we've also removed it above - if the user has left the group, it is still the same group */
+	stmt = dc_sqlite3_prepare(context->sql,
+		"SELECT id FROM chats WHERE member_set=? AND type=" DC_STRINGIFY(DC_CHAT_TYPE_GROUP) ";"); /* no verified groups and no single chats (which are equal to a group with a single member and without SELF) */
+	sqlite3_bind_int64(stmt, 1, (sqlite3_int64)dc_get_member_set_hash(contact_ids));
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		dc_array_add_id(candidate_ids, sqlite3_column_int(stmt, 0));
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
 
-			if (contact_id==dc_array_get_id(contact_ids, matches)) {
-				matches++;
-			}
-			else {
-				mismatches++;
+	/* different member sets may have the same hash, so the members of the found chats are compared one by one */
+	stmt = dc_sqlite3_prepare(context->sql,
+		"SELECT DISTINCT contact_id FROM chats_contacts WHERE chat_id=? AND contact_id!=" DC_STRINGIFY(DC_CONTACT_ID_SELF) " ORDER BY contact_id;");
+	for (int i = 0; i < dc_array_get_cnt(candidate_ids); i++)
+	{
+		uint32_t chat_id = dc_array_get_id(candidate_ids, i);
+		int      members_cnt = dc_array_get_cnt(contact_ids);
+		int      matching_cnt = 0;
+
+		sqlite3_reset(stmt);
+		sqlite3_bind_int(stmt, 1, chat_id);
+		while (sqlite3_step(stmt)==SQLITE_ROW) {
+			if (matching_cnt >= members_cnt
+			 || (uint32_t)sqlite3_column_int(stmt, 0)!=dc_array_get_id(contact_ids, matching_cnt)) {
+				matching_cnt = -1;
+				break;
 			}
+			matching_cnt++;
 		}
 
-		if (matches==dc_array_get_cnt(contact_ids) && mismatches==0) {
-			dc_array_add_id(chat_ids, last_chat_id);
+		if (matching_cnt==members_cnt) {
+			dc_array_add_id(chat_ids, chat_id);
 		}
 	}
 
 cleanup:
 	sqlite3_finalize(stmt);
-	free(contact_ids_str);
+	dc_array_unref(candidate_ids);
 	dc_array_unref(contact_ids);
-	sqlite3_free(q3);
 	return chat_ids;
 }
 
@@ -882,6 +876,7 @@ static void create_or_lookup_group(dc_context_t* context, dc_mimeparser_t* mime_
 				dc_add_to_chat_contacts_table(context, chat_id, to_id);
 			}
 		}
+		dc_recalc_chat_member_set(context->sql, chat_id); /* needed if no member was added at all */
 		send_EVENT_CHAT_MODIFIED = 1;
 	}
 
@@ -916,6 +911,19 @@ cleanup:
 
 void dc_receive_imf(dc_context_t* context, const char* imf_raw_not_terminated, size_t imf_raw_bytes,
                            const char* server_folder, uint32_t server_uid, uint32_t flags)
+{
+	dc_receive_imf_prepared(context, imf_raw_not_terminated, imf_raw_bytes, server_folder, server_uid, flags, NULL);
+}
+
+
+/**
+ * Receive a message as dc_receive_imf(), however, parsing and decryption may be already done
+ * by dc_e2ee_prepare_decrypt(), see dc_rcvpipe_t.
+ *
+ * @private @memberof dc_context_t
+ */
+void dc_receive_imf_prepared(dc_context_t* context, const char* imf_raw_not_terminated, size_t imf_raw_bytes,
+                             const char* server_folder, uint32_t server_uid, uint32_t flags, dc_e2ee_prepared_t* prepared)
 {
 	/* the function returns the number of created messages in the database */
 	int              incoming = 1;
@@ -972,7 +980,7 @@ void dc_receive_imf(dc_context_t* context, const char* imf_raw_not_terminated, s
 	normally, this is done by mailimf_message_parse(), however, as we also need the MIME data,
 	we use mailmime_parse() through dc_mimeparser (both call mailimf_struct_multiple_parse() somewhen, I did not found out anything
 	that speaks against this approach yet) */
-	dc_mimeparser_parse(mime_parser, imf_raw_not_terminated, imf_raw_bytes);
+	dc_mimeparser_parse_prepared(mime_parser, imf_raw_not_terminated, imf_raw_bytes, prepared);
 	if (dc_hash_cnt(&mime_parser->header)==0) {
 		dc_log_info(context, 0, "No header.");
 		goto cleanup; /* Error - even adding an empty record won't help as we do not know the message ID */
@@ -1085,9 +1093,11 @@ void dc_receive_imf(dc_context_t* context, const char* imf_raw_not_terminated, s
 				char*    old_server_folder = NULL;
 				uint32_t old_server_uid = 0;
 				if (dc_rfc724_mid_exists(context, rfc724_mid, &old_server_folder, &old_server_uid)) {
+					/* this is no error, so the transaction is committed; a rollback would also discard
+					the statements other threads have done meanwhile on the shared connection */
+					dc_sqlite3_commit(context->sql);
+					transaction_pending = 0;
 					if (strcmp(old_server_folder, server_folder)!=0 || old_server_uid!=server_uid) {
-						dc_sqlite3_rollback(context->sql);
-						transaction_pending = 0;
 						dc_update_server_uid(context, rfc724_mid, server_folder, server_uid);
 					}
 					free(old_server_folder);
@@ -1271,7 +1281,7 @@ void dc_receive_imf(dc_context_t* context, const char* imf_raw_not_terminated, s
 			and add them to the database (mails sent by other messenger clients should result
 			into only one message; mails sent by other clients may result in several messages (eg. one per attachment)) */
 			icnt = carray_count(mime_parser->parts); /* should be at least one - maybe empty - part */
-			stmt = dc_sqlite3_prepare(context->sql,
+			stmt = dc_sqlite3_prepare_cached(context->sql,
 				"INSERT INTO msgs (rfc724_mid, server_folder, server_uid, chat_id, from_id, to_id,"
 				" timestamp, timestamp_sent, timestamp_rcvd, type, state, msgrmsg, "
 				" txt, txt_raw, param, bytes, hidden, mime_headers)"
@@ -1306,7 +1316,7 @@ void dc_receive_imf(dc_context_t* context, const char* imf_raw_not_terminated, s
 				sqlite3_bind_int  (stmt, 12, msgrmsg);
 				sqlite3_bind_text (stmt, 13, part->msg? part->msg : "", -1, SQLITE_STATIC);
 				sqlite3_bind_text (stmt, 14, txt_raw? txt_raw : "", -1, SQLITE_STATIC);
-				sqlite3_bind_text (stmt, 15, part->param->packed, -1, SQLITE_STATIC);
+				sqlite3_bind_text (stmt, 15, dc_param_get_packed(part->param), -1, SQLITE_STATIC);
 				sqlite3_bind_int  (stmt, 16, part->bytes);
 				sqlite3_bind_int  (stmt, 17, hidden);
 				sqlite3_bind_text (stmt, 18, save_mime_headers? imf_raw_not_terminated : NULL, header_bytes, SQLITE_STATIC);
@@ -1314,11 +1324,16 @@ void dc_receive_imf(dc_context_t* context, const char* imf_raw_not_terminated, s
 					dc_log_info(context, 0, "Cannot write DB.");
 					goto cleanup; /* i/o error - there is nothing more we can do - in other cases, we try to write at least an empty record */
 				}
+				dc_midfilter_add(context->mid_filter, rfc724_mid);
 
 				free(txt_raw);
 				txt_raw = NULL;
 
 				int insert_msg_id = dc_sqlite3_get_rowid(context->sql, "msgs", "rfc724_mid", rfc724_mid);
+				if (!hidden) {
+					dc_set_chat_last_msg_if_newer(context, chat_id, insert_msg_id, sort_timestamp);
+				}
+				dc_update_msg_fts(context, insert_msg_id, part->msg? part->msg : "");
 
 				carray_add(created_db_entries, (void*)(uintptr_t)chat_id, NULL);
 				carray_add(created_db_entries, (void*)(uintptr_t)insert_msg_id, NULL);
@@ -1479,5 +1494,5 @@ cleanup:
 	}
 
 	free(txt_raw);
-	sqlite3_finalize(stmt);
+	dc_sqlite3_finalize_cached(context->sql, stmt);
 }
@@ -98,6 +98,8 @@ int dc_smtp_connect(dc_smtp_t* smtp, const dc_loginparam_t* lp)
 		goto cleanup;
 	}
 
+	smtp->error_etpan = 0;
+
 	free(smtp->from);
 	smtp->from = dc_strdup(lp->addr);
 
@@ -194,6 +196,7 @@ int dc_smtp_connect(dc_smtp_t* smtp, const dc_loginparam_t* lp)
 			if (r != MAILSMTP_NO_ERROR)
 			{
 				dc_log_error_if(&smtp->log_connect_errors, smtp->context, 0, "SMTP-login failed for user %s (%s)", lp->send_user, mailsmtp_strerror(r));
+				smtp->error_etpan = r;
 				goto cleanup;
 			}
 		}
@@ -1,6 +1,11 @@
 #include <assert.h>
 #include "dc_context.h"
 #include "dc_apeerstate.h"
+#include "dc_job.h"
+#include "dc_jobqueue.h"
+#include "dc_objcache.h"
+#include "dc_midfilter.h"
+#include "dc_key.h"
 
 
 /* This class wraps around SQLite.
@@ -24,7 +29,20 @@ safe. However, there are some points to keep in mind:
 3. Using sqlite3_last_insert_rowid() and sqlite3_changes() cause race conditions
    (between the query and the call another thread may insert or update a row.
    These functions MUST NOT be used;
-   dc_sqlite3_get_rowid() provides an alternative. */
+   dc_sqlite3_get_rowid() provides an alternative.
+
+4. Statements for frequently used, constant queries can be taken from a cache
+   using dc_sqlite3_prepare_cached().  A cached statement is used by only one
+   thread at a time: it is removed from the cache while checked out and
+   put back by dc_sqlite3_finalize_cached(), which resets the statement and
+   clears the bindings.  If two threads need the same query at the same
+   time, the second one gets a newly prepared statement.
+
+5. If the config-key `wal_mode` is set, the database is used in WAL mode and
+   some read-only connections are opened in addition.  Statements prepared by
+   dc_sqlite3_prepare_read() run on one of these connections, so they are not
+   blocked by a thread writing to the database.  Such statements see only
+   committed data and must therefore not be used inside a transaction. */
 
 
 void dc_sqlite3_log_error(dc_sqlite3_t* sql, const char* msg_format, ...)
@@ -62,6 +80,208 @@ sqlite3_stmt* dc_sqlite3_prepare(dc_sqlite3_t* sql, const char* querystr)
 }
 
 
+sqlite3_stmt* dc_sqlite3_prepare_cached(dc_sqlite3_t* sql, const char* querystr)
+{
+	sqlite3_stmt* stmt = NULL;
+	int           i = 0;
+
+	if (sql==NULL || querystr==NULL || sql->cobj==NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&sql->stmt_cache_mutex);
+		for (i = sql->stmt_cache_cnt-1; i >= 0; i--) {
+			if (strcmp(sqlite3_sql(sql->stmt_cache[i]), querystr)==0) {
+				stmt = sql->stmt_cache[i];
+				memmove(&sql->stmt_cache[i], &sql->stmt_cache[i+1], (sql->stmt_cache_cnt-i-1)*sizeof(sqlite3_stmt*));
+				sql->stmt_cache_cnt--;
+				break;
+			}
+		}
+	pthread_mutex_unlock(&sql->stmt_cache_mutex);
+
+	if (stmt==NULL) {
+		stmt = dc_sqlite3_prepare(sql, querystr);
+	}
+
+	return stmt;
+}
+
+
+void dc_sqlite3_finalize_cached(dc_sqlite3_t* sql, sqlite3_stmt* stmt)
+{
+	sqlite3_stmt* evicted = NULL;
+
+	if (stmt==NULL) {
+		return;
+	}
+
+	// reset the statement at once, otherwise it may keep a read transaction open
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	if (sql==NULL) {
+		sqlite3_finalize(stmt);
+		return;
+	}
+
+	pthread_mutex_lock(&sql->stmt_cache_mutex);
+		if (sql->cobj==NULL || sqlite3_db_handle(stmt)!=sql->cobj) {
+			evicted = stmt; // the database was closed or reopened while the statement was checked out
+		}
+		else {
+			if (sql->stmt_cache_cnt>=DC_STMT_CACHE_SIZE) {
+				evicted = sql->stmt_cache[0];
+				memmove(&sql->stmt_cache[0], &sql->stmt_cache[1], (sql->stmt_cache_cnt-1)*sizeof(sqlite3_stmt*));
+				sql->stmt_cache_cnt--;
+			}
+			sql->stmt_cache[sql->stmt_cache_cnt++] = stmt;
+		}
+	pthread_mutex_unlock(&sql->stmt_cache_mutex);
+
+	sqlite3_finalize(evicted);
+}
+
+
+sqlite3_stmt* dc_sqlite3_prepare_read(dc_sqlite3_t* sql, const char* querystr)
+{
+	sqlite3_stmt* stmt = NULL;
+	int           i = 0;
+
+	if (sql==NULL || querystr==NULL || sql->cobj==NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&sql->readers_mutex);
+		for (i = 0; i < DC_READER_CNT; i++) {
+			if (sql->readers[i] && !sql->readers_busy[i]) {
+				sql->readers_busy[i] = 1;
+				break;
+			}
+		}
+	pthread_mutex_unlock(&sql->readers_mutex);
+
+	if (i>=DC_READER_CNT) {
+		return dc_sqlite3_prepare(sql, querystr); // no WAL mode or all readers busy
+	}
+
+	// the reader is used by this thread only until the statement is finalized
+	if (sqlite3_prepare_v2(sql->readers[i], querystr, -1, &stmt, NULL)!=SQLITE_OK) {
+		dc_log_error(sql->context, 0, "Query failed: %s SQLite says: %s", querystr, sqlite3_errmsg(sql->readers[i]));
+		pthread_mutex_lock(&sql->readers_mutex);
+			sql->readers_busy[i] = 0;
+		pthread_mutex_unlock(&sql->readers_mutex);
+		return NULL;
+	}
+
+	return stmt;
+}
+
+
+void dc_sqlite3_finalize_read(dc_sqlite3_t* sql, sqlite3_stmt* stmt)
+{
+	sqlite3* reader = NULL;
+
+	if (stmt==NULL) {
+		return;
+	}
+
+	reader = sqlite3_db_handle(stmt);
+	sqlite3_finalize(stmt);
+
+	if (sql==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&sql->readers_mutex);
+		for (int i = 0; i < DC_READER_CNT; i++) {
+			if (sql->readers[i]==reader) {
+				sql->readers_busy[i] = 0;
+			}
+		}
+	pthread_mutex_unlock(&sql->readers_mutex);
+}
+
+
+static int wal_hook(void* userdata, sqlite3* cobj, const char* db_name, int wal_pages)
+{
+	// called after each commit on the writing connection; this replaces SQLite's wal_autocheckpoint.
+	// a passive checkpoint does not wait for the readers, pages still needed by a reader are copied on one of the next commits.
+	if (wal_pages>=DC_WAL_CHECKPOINT_PAGES) {
+		sqlite3_wal_checkpoint_v2(cobj, db_name, SQLITE_CHECKPOINT_PASSIVE, NULL, NULL);
+	}
+	return SQLITE_OK;
+}
+
+
+void dc_sqlite3_checkpoint(dc_sqlite3_t* sql)
+{
+	int wal_pages = 0, checkpointed_pages = 0;
+
+	if (sql==NULL || sql->cobj==NULL || !sql->wal_mode) {
+		return;
+	}
+
+	// copy all pages to the database and truncate the WAL-file, this waits for the readers up to the busy_timeout
+	if (sqlite3_wal_checkpoint_v2(sql->cobj, NULL, SQLITE_CHECKPOINT_TRUNCATE, &wal_pages, &checkpointed_pages)!=SQLITE_OK) {
+		dc_sqlite3_log_error(sql, "Checkpoint failed, %i of %i pages copied.", checkpointed_pages, wal_pages);
+	}
+}
+
+
+static int set_journal_mode(dc_sqlite3_t* sql, int wal_mode)
+{
+	// the journal mode can only be changed if there are no other connections,
+	// the mode is persistent, so, once set, other programs also use WAL mode.
+	int           success = 0;
+	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, wal_mode? "PRAGMA journal_mode=WAL;" : "PRAGMA journal_mode=DELETE;");
+	if (sqlite3_step(stmt)==SQLITE_ROW) {
+		const char* mode = (const char*)sqlite3_column_text(stmt, 0);
+		if (mode && strcasecmp(mode, wal_mode? "wal" : "delete")==0) {
+			success = 1;
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	if (!success) {
+		dc_log_warning(sql->context, 0, "Cannot set journal mode to %s.", wal_mode? "WAL" : "DELETE");
+	}
+	return success;
+}
+
+
+static void open_readers(dc_sqlite3_t* sql, const char* dbfile)
+{
+	pthread_mutex_lock(&sql->readers_mutex);
+		for (int i = 0; i < DC_READER_CNT; i++) {
+			// no SQLITE_OPEN_FULLMUTEX needed as a reader is used by only one thread at a time
+			if (sqlite3_open_v2(dbfile, &sql->readers[i], SQLITE_OPEN_NOMUTEX|SQLITE_OPEN_READONLY, NULL)!=SQLITE_OK) {
+				dc_log_warning(sql->context, 0, "Cannot open reader for \"%s\".", dbfile);
+				sqlite3_close(sql->readers[i]);
+				sql->readers[i] = NULL;
+				break;
+			}
+			sqlite3_busy_timeout(sql->readers[i], 10*1000);
+			sql->readers_busy[i] = 0;
+		}
+	pthread_mutex_unlock(&sql->readers_mutex);
+}
+
+
+static void close_readers(dc_sqlite3_t* sql)
+{
+	pthread_mutex_lock(&sql->readers_mutex);
+		for (int i = 0; i < DC_READER_CNT; i++) {
+			if (sql->readers[i]) {
+				sqlite3_close_v2(sql->readers[i]); // if the reader is still in use, it is closed when the statement is finalized
+				sql->readers[i] = NULL;
+				sql->readers_busy[i] = 0;
+			}
+		}
+	pthread_mutex_unlock(&sql->readers_mutex);
+}
+
+
 int dc_sqlite3_execute(dc_sqlite3_t* sql, const char* querystr)
 {
 	int           success = 0;
@@ -94,18 +314,211 @@ uint32_t dc_sqlite3_get_rowid(dc_sqlite3_t* sql, const char* table, const char*
 	// alternative to sqlite3_last_insert_rowid() which MUST NOT be used due to race conditions, see comment above.
 	// the ORDER BY ensures, this function always returns the most recent id,
 	// eg. if a Message-ID is splitted into different messages.
+	// the value is bound, so there is one cached statement per table and field.
 	uint32_t id = 0;
-	char* q3 = sqlite3_mprintf("SELECT id FROM %s WHERE %s=%Q ORDER BY id DESC;", table, field, value);
-	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, q3);
+	char* q3 = sqlite3_mprintf("SELECT id FROM %s WHERE %s=? ORDER BY id DESC;", table, field);
+	sqlite3_stmt* stmt = dc_sqlite3_prepare_cached(sql, q3);
+	sqlite3_bind_text(stmt, 1, value, -1, SQLITE_STATIC);
 	if (SQLITE_ROW==sqlite3_step(stmt)) {
 		id = sqlite3_column_int(stmt, 0);
 	}
-	sqlite3_finalize(stmt);
+	dc_sqlite3_finalize_cached(sql, stmt);
 	sqlite3_free(q3);
 	return id;
 }
 
 
+static void load_config_cache(dc_sqlite3_t* sql)
+{
+	// the cache contains all rows of the config table, so also a key not in the cache needs no SQL.
+	// before the cache is loaded, eg. while the tables are updated in dc_sqlite3_open(), the functions read from the database.
+	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, "SELECT keyname, value FROM config;");
+	if (stmt==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&sql->config_cache_mutex);
+		while (sqlite3_step(stmt)==SQLITE_ROW) {
+			const char* key = (const char*)sqlite3_column_text(stmt, 0);
+			const char* value = (const char*)sqlite3_column_text(stmt, 1);
+			if (key && value && dc_hash_find_str(&sql->config_cache, key)==NULL) {
+				dc_hash_insert(&sql->config_cache, key, strlen(key), dc_strdup(value));
+			}
+		}
+		sql->config_cache_loaded = 1;
+	pthread_mutex_unlock(&sql->config_cache_mutex);
+
+	sqlite3_finalize(stmt);
+}
+
+
+static void clear_config_cache(dc_sqlite3_t* sql)
+{
+	pthread_mutex_lock(&sql->config_cache_mutex);
+		for (dc_hashelem_t* e = dc_hash_first(&sql->config_cache); e; e = dc_hash_next(e)) {
+			free(dc_hash_data(e));
+		}
+		dc_hash_clear(&sql->config_cache);
+		sql->config_cache_loaded = 0;
+	pthread_mutex_unlock(&sql->config_cache_mutex);
+}
+
+
+static int create_fts_table(dc_sqlite3_t* sql)
+{
+	// the trigram tokenizer (SQLite 3.34+) matches any substring as LIKE does, unicode61 matches word prefixes only.
+	// errors are expected here if SQLite is compiled without FTS5, so we do not use dc_sqlite3_execute() which would log them.
+	if (sqlite3_exec(sql->cobj, "CREATE VIRTUAL TABLE msgs_fts USING fts5(txt, tokenize='trigram');", NULL, NULL, NULL)==SQLITE_OK
+	 || sqlite3_exec(sql->cobj, "CREATE VIRTUAL TABLE msgs_fts USING fts5(txt, tokenize='unicode61');", NULL, NULL, NULL)==SQLITE_OK) {
+		return 1;
+	}
+
+	dc_log_info(sql->context, 0, "No full-text index, SQLite has no FTS5 support.");
+	return 0;
+}
+
+
+static void init_fts(dc_sqlite3_t* sql)
+{
+	sqlite3_stmt* stmt = NULL;
+
+	sql->fts_state   = DC_FTS_NONE;
+	sql->fts_trigram = 0;
+
+	stmt = dc_sqlite3_prepare(sql, "SELECT sql FROM sqlite_master WHERE type='table' AND name='msgs_fts';");
+	if (sqlite3_step(stmt)!=SQLITE_ROW) {
+		goto cleanup; // no index created, eg. as FTS5 was not available on the migration
+	}
+	sql->fts_trigram = strstr((const char*)sqlite3_column_text(stmt, 0), "trigram")? 1 : 0;
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	// the database may be created on another device, check if the module is available
+	if (sqlite3_prepare_v2(sql->cobj, "SELECT rowid FROM msgs_fts LIMIT 0;", -1, &stmt, NULL)!=SQLITE_OK) {
+		dc_log_warning(sql->context, 0, "Full-text index not usable, SQLite has no FTS5 support.");
+		goto cleanup;
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	// the messages existing before the index was created are added by dc_sqlite3_fts_backfill(), searching uses LIKE until then
+	sql->fts_state = dc_sqlite3_get_config_int(sql, "fts_backfill_id", 0)>0? DC_FTS_BACKFILLING : DC_FTS_READY;
+
+cleanup:
+	sqlite3_finalize(stmt);
+}
+
+
+/**
+ * Add a chunk of the messages existing before the full-text index was created to the index.
+ * The messages are added from the newest to the oldest, each chunk in its own transaction;
+ * the progress is saved, so an interrupted backfill continues on the next call, also after a restart.
+ * Once all messages are indexed, the state changes to DC_FTS_READY and searching uses the index.
+ *
+ * Called by the job DC_JOB_FTS_BACKFILL, so opening the database and fetching messages are not blocked for long.
+ *
+ * @private @memberof dc_sqlite3_t
+ * @param sql The database connection.
+ * @return 1=there are more chunks to index, 0=the index is complete or cannot be completed.
+ */
+int dc_sqlite3_fts_backfill(dc_sqlite3_t* sql)
+{
+	sqlite3_stmt* stmt = NULL;
+	int           backfill_id = 0;
+	int           lower_id = 0;
+	int           more = 0;
+
+	if (sql==NULL || sql->fts_state!=DC_FTS_BACKFILLING) {
+		goto cleanup;
+	}
+
+	backfill_id = dc_sqlite3_get_config_int(sql, "fts_backfill_id", 0);
+	if (backfill_id > 0)
+	{
+		lower_id = DC_MAX(0, backfill_id-DC_FTS_BACKFILL_CHUNK);
+
+		dc_sqlite3_begin_transaction(sql);
+
+			stmt = dc_sqlite3_prepare(sql, "DELETE FROM msgs_fts WHERE rowid>? AND rowid<=?;"); // the chunk may be added partly before
+			sqlite3_bind_int(stmt, 1, lower_id);
+			sqlite3_bind_int(stmt, 2, backfill_id);
+			sqlite3_step(stmt);
+			sqlite3_finalize(stmt);
+
+			stmt = dc_sqlite3_prepare(sql, "INSERT INTO msgs_fts (rowid, txt) SELECT id, txt FROM msgs WHERE id>? AND id<=? AND txt!='';");
+			sqlite3_bind_int(stmt, 1, lower_id);
+			sqlite3_bind_int(stmt, 2, backfill_id);
+			if (sqlite3_step(stmt)!=SQLITE_DONE) {
+				dc_sqlite3_log_error(sql, "Cannot add messages to the full-text index.");
+				dc_sqlite3_rollback(sql);
+				goto cleanup;
+			}
+			sqlite3_finalize(stmt);
+			stmt = NULL;
+
+			backfill_id = lower_id;
+			dc_sqlite3_set_config_int(sql, "fts_backfill_id", backfill_id);
+
+		dc_sqlite3_commit(sql);
+	}
+
+	if (backfill_id > 0) {
+		more = 1;
+	}
+	else {
+		dc_sqlite3_set_config(sql, "fts_backfill_id", NULL);
+		sql->fts_state = DC_FTS_READY;
+		dc_log_info(sql->context, 0, "Full-text index complete.");
+	}
+
+cleanup:
+	sqlite3_finalize(stmt);
+	return more;
+}
+
+
+static void repair_fresh_msg_cnt(dc_sqlite3_t* sql)
+{
+	sqlite3_stmt* stmt = NULL;
+	dc_array_t*   repairs = dc_array_new(sql->context, 16); /* pairs of chat_id and counted messages */
+	int           i = 0, cnt = 0;
+
+	// the counters should always be correct as they're updated by triggers,
+	// however, the check is cheap as there are typically only few fresh messages and we have an index over the state-column.
+	// the counters are compared chat by chat, equal sums may hide differences.
+	// this also sets the initial values after the counters were added.
+	stmt = dc_sqlite3_prepare(sql,
+		"SELECT c.id, IFNULL(f.cnt, 0) FROM chats c"
+		" LEFT JOIN (SELECT chat_id, COUNT(*) AS cnt FROM msgs WHERE state=" DC_STRINGIFY(DC_STATE_IN_FRESH) " AND hidden=0 GROUP BY chat_id) f ON f.chat_id=c.id"
+		" WHERE c.fresh_msg_cnt!=IFNULL(f.cnt, 0);");
+	while (sqlite3_step(stmt)==SQLITE_ROW) {
+		dc_array_add_id(repairs, sqlite3_column_int(stmt, 0));
+		dc_array_add_id(repairs, sqlite3_column_int(stmt, 1));
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	cnt = dc_array_get_cnt(repairs)/2;
+	if (cnt==0) {
+		goto cleanup;
+	}
+
+	stmt = dc_sqlite3_prepare(sql, "UPDATE chats SET fresh_msg_cnt=? WHERE id=?;");
+	for (i = 0; i < cnt; i++) {
+		sqlite3_reset(stmt);
+		sqlite3_bind_int(stmt, 1, dc_array_get_id(repairs, i*2+1));
+		sqlite3_bind_int(stmt, 2, dc_array_get_id(repairs, i*2));
+		sqlite3_step(stmt);
+	}
+
+	dc_log_info(sql->context, 0, "Fresh message counters of %i chats repaired.", cnt);
+
+cleanup:
+	sqlite3_finalize(stmt);
+	dc_array_unref(repairs);
+}
+
+
 dc_sqlite3_t* dc_sqlite3_new(dc_context_t* context)
 {
 	dc_sqlite3_t* sql = NULL;
@@ -116,6 +529,17 @@ dc_sqlite3_t* dc_sqlite3_new(dc_context_t* context)
 
 	sql->context          = context;
 
+	pthread_mutex_init(&sql->stmt_cache_mutex, NULL);
+	pthread_mutex_init(&sql->readers_mutex, NULL);
+	pthread_mutex_init(&sql->config_cache_mutex, NULL);
+	dc_hash_init(&sql->config_cache, DC_HASH_BINARY, 1/*copy key*/);
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&sql->transaction_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+
 	return sql;
 }
 
@@ -130,6 +554,13 @@ void dc_sqlite3_unref(dc_sqlite3_t* sql)
 		dc_sqlite3_close(sql);
 	}
 
+	pthread_mutex_destroy(&sql->stmt_cache_mutex);
+	pthread_mutex_destroy(&sql->readers_mutex);
+	clear_config_cache(sql);
+	pthread_mutex_destroy(&sql->config_cache_mutex);
+	pthread_mutex_destroy(&sql->transaction_mutex);
+	dc_array_unref(sql->deferred_events);
+
 	free(sql);
 }
 
@@ -281,6 +712,7 @@ int dc_sqlite3_open(dc_sqlite3_t* sql, const char* dbfile, int flags)
 		int dbversion = dbversion_before_update;
 		int recalc_fingerprints = 0;
 		int update_file_paths = 0;
+		int recalc_member_sets = 0;
 
 		#define NEW_DB_VERSION 1
 			if (dbversion < NEW_DB_VERSION)
@@ -473,6 +905,95 @@ int dc_sqlite3_open(dc_sqlite3_t* sql, const char* dbfile, int flags)
 			}
 		#undef NEW_DB_VERSION
 
+		#define NEW_DB_VERSION 45
+			if (dbversion < NEW_DB_VERSION)
+			{
+				// the last visible message of each chat, used to sort the chatlist without looking at all messages;
+				// kept up to date by dc_set_chat_last_msg_if_newer() and dc_recalc_chat_last_msg()
+				dc_sqlite3_execute(sql, "ALTER TABLE chats ADD COLUMN last_msg_id INTEGER DEFAULT 0;");
+				dc_sqlite3_execute(sql, "ALTER TABLE chats ADD COLUMN last_msg_timestamp INTEGER DEFAULT 0;");
+				dc_sqlite3_execute(sql, "UPDATE chats SET "
+				                        " last_msg_id=IFNULL((SELECT id FROM msgs WHERE chat_id=chats.id AND hidden=0 ORDER BY timestamp DESC, id DESC LIMIT 1), 0),"
+				                        " last_msg_timestamp=IFNULL((SELECT MAX(timestamp) FROM msgs WHERE chat_id=chats.id AND hidden=0), 0);");
+
+				dbversion = NEW_DB_VERSION;
+				dc_sqlite3_set_config_int(sql, "dbversion", NEW_DB_VERSION);
+			}
+		#undef NEW_DB_VERSION
+
+		#define NEW_DB_VERSION 46
+			if (dbversion < NEW_DB_VERSION)
+			{
+				// full-text index for dc_search_msgs_ranked(), if SQLite has no FTS5, dc_search_msgs_ranked() uses LIKE.
+				// new messages are added by dc_update_msg_fts(), the existing ones are added in chunks by dc_sqlite3_fts_backfill()
+				if (create_fts_table(sql)) {
+					sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, "SELECT MAX(id) FROM msgs;");
+					if (sqlite3_step(stmt)==SQLITE_ROW) {
+						dc_sqlite3_set_config_int(sql, "fts_backfill_id", sqlite3_column_int(stmt, 0));
+					}
+					sqlite3_finalize(stmt);
+				}
+
+				dbversion = NEW_DB_VERSION;
+				dc_sqlite3_set_config_int(sql, "dbversion", NEW_DB_VERSION);
+			}
+		#undef NEW_DB_VERSION
+
+		#define NEW_DB_VERSION 47
+			if (dbversion < NEW_DB_VERSION)
+			{
+				// for dc_get_chat_msgs() and the keyset pagination of dc_get_chat_msgs_page()
+				dc_sqlite3_execute(sql, "CREATE INDEX msgs_index6 ON msgs (chat_id, hidden, timestamp, id);");
+
+				dbversion = NEW_DB_VERSION;
+				dc_sqlite3_set_config_int(sql, "dbversion", NEW_DB_VERSION);
+			}
+		#undef NEW_DB_VERSION
+
+
+		#define NEW_DB_VERSION 48
+			if (dbversion < NEW_DB_VERSION)
+			{
+				// the number of fresh messages of each chat, as returned by dc_get_fresh_msg_cnt().
+				// the counter is updated by triggers, so all state changes, moves and deletions of messages are covered;
+				// the initial values are set by repair_fresh_msg_cnt() below
+				dc_sqlite3_execute(sql, "ALTER TABLE chats ADD COLUMN fresh_msg_cnt INTEGER DEFAULT 0;");
+				dc_sqlite3_execute(sql, "CREATE TRIGGER msgs_fresh_insert AFTER INSERT ON msgs"
+				                        " WHEN new.state=" DC_STRINGIFY(DC_STATE_IN_FRESH) " AND new.hidden=0"
+				                        " BEGIN"
+				                        "  UPDATE chats SET fresh_msg_cnt=fresh_msg_cnt+1 WHERE id=new.chat_id;"
+				                        " END;");
+				dc_sqlite3_execute(sql, "CREATE TRIGGER msgs_fresh_update AFTER UPDATE OF state, hidden, chat_id ON msgs"
+				                        " WHEN old.state=" DC_STRINGIFY(DC_STATE_IN_FRESH) " OR new.state=" DC_STRINGIFY(DC_STATE_IN_FRESH)
+				                        " BEGIN"
+				                        "  UPDATE chats SET fresh_msg_cnt=fresh_msg_cnt-1 WHERE id=old.chat_id AND old.state=" DC_STRINGIFY(DC_STATE_IN_FRESH) " AND old.hidden=0;"
+				                        "  UPDATE chats SET fresh_msg_cnt=fresh_msg_cnt+1 WHERE id=new.chat_id AND new.state=" DC_STRINGIFY(DC_STATE_IN_FRESH) " AND new.hidden=0;"
+				                        " END;");
+				dc_sqlite3_execute(sql, "CREATE TRIGGER msgs_fresh_delete AFTER DELETE ON msgs"
+				                        " WHEN old.state=" DC_STRINGIFY(DC_STATE_IN_FRESH) " AND old.hidden=0"
+				                        " BEGIN"
+				                        "  UPDATE chats SET fresh_msg_cnt=fresh_msg_cnt-1 WHERE id=old.chat_id;"
+				                        " END;");
+
+				dbversion = NEW_DB_VERSION;
+				dc_sqlite3_set_config_int(sql, "dbversion", NEW_DB_VERSION);
+			}
+		#undef NEW_DB_VERSION
+
+
+		#define NEW_DB_VERSION 49
+			if (dbversion < NEW_DB_VERSION)
+			{
+				// the hash of the members of a chat, used to find ad-hoc groups, see dc_recalc_chat_member_set()
+				dc_sqlite3_execute(sql, "ALTER TABLE chats ADD COLUMN member_set INTEGER DEFAULT 0;");
+				dc_sqlite3_execute(sql, "CREATE INDEX chats_index3 ON chats (member_set);");
+				recalc_member_sets = 1;
+
+				dbversion = NEW_DB_VERSION;
+				dc_sqlite3_set_config_int(sql, "dbversion", NEW_DB_VERSION);
+			}
+		#undef NEW_DB_VERSION
+
 
 		// (2) updates that require high-level objects
 		// (the structure is complete now and all objects are usable)
@@ -492,6 +1013,15 @@ int dc_sqlite3_open(dc_sqlite3_t* sql, const char* dbfile, int flags)
 			sqlite3_finalize(stmt);
 		}
 
+		if (recalc_member_sets)
+		{
+			sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, "SELECT id FROM chats WHERE type=" DC_STRINGIFY(DC_CHAT_TYPE_GROUP) ";");
+				while (sqlite3_step(stmt)==SQLITE_ROW) {
+					dc_recalc_chat_member_set(sql, sqlite3_column_int(stmt, 0));
+				}
+			sqlite3_finalize(stmt);
+		}
+
 		if (update_file_paths)
 		{
 			// versions before 2018-08 save the absolute paths in the database files at "param.f=";
@@ -513,9 +1043,37 @@ int dc_sqlite3_open(dc_sqlite3_t* sql, const char* dbfile, int flags)
 			free(repl_from);
 			dc_sqlite3_set_config(sql, "backup_for", NULL);
 		}
+
+		init_fts(sql);
+
+		repair_fresh_msg_cnt(sql);
+
+		// WAL mode is used for the database of the context only;
+		// other databases, eg. backups, are switched back to a rollback journal so that they consist of a single file.
+		if (sql->context && sql->context->sql==sql && dc_sqlite3_get_config_int(sql, "wal_mode", 0)) {
+			if (set_journal_mode(sql, 1)) {
+				sql->wal_mode = 1;
+				sqlite3_wal_hook(sql->cobj, wal_hook, sql);
+				open_readers(sql, dbfile);
+			}
+		}
+		else {
+			set_journal_mode(sql, 0);
+		}
+	}
+
+	load_config_cache(sql);
+
+	if (sql->context && sql->context->sql==sql) {
+		dc_midfilter_build(sql->context->mid_filter, sql);
+
+		if (sql->fts_state==DC_FTS_BACKFILLING) {
+			dc_job_kill_actions(sql->context, DC_JOB_FTS_BACKFILL, 0); // a job may be left from the last session
+			dc_job_add(sql->context, DC_JOB_FTS_BACKFILL, 0, NULL, 0);
+		}
 	}
 
-	dc_log_info(sql->context, 0, "Opened \"%s\".", dbfile);
+	dc_log_info(sql->context, 0, "Opened \"%s\"%s.", dbfile, sql->wal_mode? " in WAL mode" : "");
 	return 1;
 
 cleanup:
@@ -526,14 +1084,45 @@ cleanup:
 
 void dc_sqlite3_close(dc_sqlite3_t* sql)
 {
+	sqlite3* cobj = NULL;
+
 	if (sql==NULL) {
 		return;
 	}
 
-	if (sql->cobj)
+	clear_config_cache(sql);
+	if (sql->context && sql->context->sql==sql) {
+		// the cached objects belong to the closed database, eg. on importing a backup
+		dc_objcache_clear(sql->context->msg_cache);
+		dc_objcache_clear(sql->context->chat_cache);
+		dc_objcache_clear(sql->context->contact_cache);
+		dc_key_forget_self_keys(sql->context);
+		dc_midfilter_reset(sql->context->mid_filter);
+	}
+	close_readers(sql);
+	dc_sqlite3_checkpoint(sql); // no need to keep the WAL-file, this also makes the database file complete for the backup
+	sql->wal_mode = 0;
+	sql->fts_state = DC_FTS_NONE;
+
+	pthread_mutex_lock(&sql->stmt_cache_mutex);
+		for (int i = 0; i < sql->stmt_cache_cnt; i++) {
+			sqlite3_finalize(sql->stmt_cache[i]);
+			sql->stmt_cache[i] = NULL;
+		}
+		sql->stmt_cache_cnt = 0;
+		cobj = sql->cobj;
+		sql->cobj = NULL; // statements checked out now are finalized when given back
+	pthread_mutex_unlock(&sql->stmt_cache_mutex);
+
+	if (cobj)
 	{
-		sqlite3_close(sql->cobj);
-		sql->cobj = NULL;
+		// sqlite3_close() would fail with SQLITE_BUSY and leak the connection if a statement is still checked out,
+		// eg. by another thread; sqlite3_close_v2() closes the connection when the last statement is finalized
+		sqlite3_close_v2(cobj);
+	}
+
+	if (sql->context && sql->context->sql==sql) {
+		dc_jobqueue_reset(sql->context->jobqueue); // the jobs are reloaded from the database opened next, which may be an imported one
 	}
 
 	dc_log_info(sql->context, 0, "Database closed."); /* We log the information even if not real closing took place; this is to detect logic errors. */
@@ -592,10 +1181,32 @@ cleanup:
  ******************************************************************************/
 
 
+#define SELECT_v_FROM_config_k_STATEMENT "SELECT value FROM config WHERE keyname=?;"
+
+
+/**
+ * Reload the config cache after the config table was modified
+ * without using dc_sqlite3_set_config().
+ *
+ * @private @memberof dc_sqlite3_t
+ */
+void dc_sqlite3_reload_config_cache(dc_sqlite3_t* sql)
+{
+	if (!dc_sqlite3_is_open(sql)) {
+		return;
+	}
+
+	clear_config_cache(sql);
+	load_config_cache(sql);
+}
+
+
 int dc_sqlite3_set_config(dc_sqlite3_t* sql, const char* key, const char* value)
 {
 	int           state = 0;
 	sqlite3_stmt* stmt = NULL;
+	int           cached = 0;
+	char*         cached_value = NULL;
 
 	if (key==NULL) {
 		dc_log_error(sql->context, 0, "dc_sqlite3_set_config(): Bad parameter.");
@@ -607,48 +1218,77 @@ int dc_sqlite3_set_config(dc_sqlite3_t* sql, const char* key, const char* value)
 		return 0;
 	}
 
+	pthread_mutex_lock(&sql->config_cache_mutex);
+		if (sql->config_cache_loaded) {
+			cached = 1;
+			cached_value = dc_strdup_keep_null(dc_hash_find_str(&sql->config_cache, key));
+		}
+	pthread_mutex_unlock(&sql->config_cache_mutex);
+
+	if (cached) {
+		int unchanged = (value==NULL && cached_value==NULL) || (value && cached_value && strcmp(value, cached_value)==0);
+		if (unchanged) {
+			free(cached_value);
+			return 1; /* nothing to write, eg. the last-seen-UID of a folder without new messages */
+		}
+	}
+
 	if (value)
 	{
 		/* insert/update key=value */
-		#define SELECT_v_FROM_config_k_STATEMENT "SELECT value FROM config WHERE keyname=?;"
-		stmt = dc_sqlite3_prepare(sql, SELECT_v_FROM_config_k_STATEMENT);
-		sqlite3_bind_text (stmt, 1, key, -1, SQLITE_STATIC);
-		state = sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		if (cached) {
+			state = cached_value? SQLITE_ROW : SQLITE_DONE;
+		}
+		else {
+			stmt = dc_sqlite3_prepare_cached(sql, SELECT_v_FROM_config_k_STATEMENT);
+			sqlite3_bind_text (stmt, 1, key, -1, SQLITE_STATIC);
+			state = sqlite3_step(stmt);
+			dc_sqlite3_finalize_cached(sql, stmt);
+		}
 
 		if (state==SQLITE_DONE) {
-			stmt = dc_sqlite3_prepare(sql, "INSERT INTO config (keyname, value) VALUES (?, ?);");
+			stmt = dc_sqlite3_prepare_cached(sql, "INSERT INTO config (keyname, value) VALUES (?, ?);");
 			sqlite3_bind_text (stmt, 1, key,   -1, SQLITE_STATIC);
 			sqlite3_bind_text (stmt, 2, value, -1, SQLITE_STATIC);
 			state = sqlite3_step(stmt);
-			sqlite3_finalize(stmt);
+			dc_sqlite3_finalize_cached(sql, stmt);
 		}
 		else if (state==SQLITE_ROW) {
-			stmt = dc_sqlite3_prepare(sql, "UPDATE config SET value=? WHERE keyname=?;");
+			stmt = dc_sqlite3_prepare_cached(sql, "UPDATE config SET value=? WHERE keyname=?;");
 			sqlite3_bind_text (stmt, 1, value, -1, SQLITE_STATIC);
 			sqlite3_bind_text (stmt, 2, key,   -1, SQLITE_STATIC);
 			state = sqlite3_step(stmt);
-			sqlite3_finalize(stmt);
+			dc_sqlite3_finalize_cached(sql, stmt);
 		}
 		else {
 			dc_log_error(sql->context, 0, "dc_sqlite3_set_config(): Cannot read value.");
+			free(cached_value);
 			return 0;
 		}
 	}
 	else
 	{
 		/* delete key */
-		stmt = dc_sqlite3_prepare(sql, "DELETE FROM config WHERE keyname=?;");
+		stmt = dc_sqlite3_prepare_cached(sql, "DELETE FROM config WHERE keyname=?;");
 		sqlite3_bind_text (stmt, 1, key,   -1, SQLITE_STATIC);
 		state = sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		dc_sqlite3_finalize_cached(sql, stmt);
 	}
 
+	free(cached_value);
+
 	if (state != SQLITE_DONE)  {
 		dc_log_error(sql->context, 0, "dc_sqlite3_set_config(): Cannot change value.");
 		return 0;
 	}
 
+	/* write through; the old value is returned by dc_hash_insert() */
+	pthread_mutex_lock(&sql->config_cache_mutex);
+		if (sql->config_cache_loaded) {
+			free(dc_hash_insert(&sql->config_cache, key, strlen(key), value? dc_strdup(value) : NULL));
+		}
+	pthread_mutex_unlock(&sql->config_cache_mutex);
+
 	return 1;
 }
 
@@ -656,12 +1296,22 @@ int dc_sqlite3_set_config(dc_sqlite3_t* sql, const char* key, const char* value)
 char* dc_sqlite3_get_config(dc_sqlite3_t* sql, const char* key, const char* def) /* the returned string must be free()'d, NULL is only returned if def is NULL */
 {
 	sqlite3_stmt* stmt = NULL;
+	char*         ret = NULL;
 
 	if (!dc_sqlite3_is_open(sql) || key==NULL) {
 		return dc_strdup_keep_null(def);
 	}
 
-	stmt = dc_sqlite3_prepare(sql, SELECT_v_FROM_config_k_STATEMENT);
+	pthread_mutex_lock(&sql->config_cache_mutex);
+		if (sql->config_cache_loaded) {
+			const char* value = dc_hash_find_str(&sql->config_cache, key);
+			ret = dc_strdup_keep_null(value? value : def);
+			pthread_mutex_unlock(&sql->config_cache_mutex);
+			return ret;
+		}
+	pthread_mutex_unlock(&sql->config_cache_mutex);
+
+	stmt = dc_sqlite3_prepare_cached(sql, SELECT_v_FROM_config_k_STATEMENT);
 	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
 	if (sqlite3_step(stmt)==SQLITE_ROW)
 	{
@@ -669,14 +1319,14 @@ char* dc_sqlite3_get_config(dc_sqlite3_t* sql, const char* key, const char* def)
 		if (ptr)
 		{
 			/* success, fall through below to free objects */
-			char* ret = dc_strdup((const char*)ptr);
-			sqlite3_finalize(stmt);
+			ret = dc_strdup((const char*)ptr);
+			dc_sqlite3_finalize_cached(sql, stmt);
 			return ret;
 		}
 	}
 
 	/* return the default value */
-	sqlite3_finalize(stmt);
+	dc_sqlite3_finalize_cached(sql, stmt);
 	return dc_strdup_keep_null(def);
 }
 
@@ -710,43 +1360,145 @@ int dc_sqlite3_set_config_int(dc_sqlite3_t* sql, const char* key, int32_t value)
  ******************************************************************************/
 
 
-#undef USE_TRANSACTIONS
+/* Transactions were disabled for a long time as the connection is shared between threads
+and so a transaction of one thread would contain the statements of the others.
+Now, the transactions are scoped by a recursive mutex:
+only one thread may have a transaction, other threads wait in dc_sqlite3_begin_transaction()
+and the owner may nest transactions, the inner ones are savepoints.
+Statements of other threads that do not use transactions may still become a part of an open transaction
+and a rollback would discard them. Therefore, transactions are kept short, they do not span eg. a whole
+fetch of messages, and they are rolled back only on errors, never on ordinary paths.
+Events sent by the owner of a transaction are deferred until the outermost transaction is committed,
+so that the UI does not see changes that may be rolled back. */
 
 
-void dc_sqlite3_begin_transaction(dc_sqlite3_t* sql)
+static void execute_transaction_stmt(dc_sqlite3_t* sql, const char* stmt_fmt, int depth, const char* error)
 {
-#ifdef USE_TRANSACTIONS
-	// `BEGIN IMMEDIATE` ensures, only one thread may write.
-	// all other calls to `BEGIN IMMEDIATE` will try over until sqlite3_busy_timeout() is reached.
-	// CAVE: This also implies that transactions MUST NOT be nested.
-	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, "BEGIN IMMEDIATE;");
-	if (sqlite3_step(stmt) != SQLITE_DONE) {
-		dc_sqlite3_log_error(sql, "Cannot begin transaction.");
+	char*         q3 = sqlite3_mprintf(stmt_fmt, depth);
+	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, q3);
+	if (stmt==NULL || sqlite3_step(stmt)!=SQLITE_DONE) {
+		dc_sqlite3_log_error(sql, error);
 	}
 	sqlite3_finalize(stmt);
-#endif
+	sqlite3_free(q3);
 }
 
 
-void dc_sqlite3_rollback(dc_sqlite3_t* sql)
+void dc_sqlite3_begin_transaction(dc_sqlite3_t* sql)
 {
-#ifdef USE_TRANSACTIONS
-	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, "ROLLBACK;");
-	if (sqlite3_step(stmt) != SQLITE_DONE) {
-		dc_sqlite3_log_error(sql, "Cannot rollback transaction.");
+	if (sql==NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&sql->transaction_mutex); // unlocked by the outermost dc_sqlite3_commit() or dc_sqlite3_rollback()
+
+	sql->transaction_depth++;
+	if (sql->transaction_depth==1) {
+		// `BEGIN IMMEDIATE` ensures, only one connection may write; the readers used in WAL mode do not write.
+		sql->transaction_owner = pthread_self();
+		execute_transaction_stmt(sql, "BEGIN IMMEDIATE;", 0, "Cannot begin transaction.");
+	}
+	else {
+		execute_transaction_stmt(sql, "SAVEPOINT dc%i;", sql->transaction_depth, "Cannot begin nested transaction.");
 	}
-	sqlite3_finalize(stmt);
-#endif
+}
+
+
+static void end_transaction(dc_sqlite3_t* sql, int commit)
+{
+	int         outermost = 0;
+	dc_array_t* events = NULL;
+	size_t      i = 0, cnt = 0;
+
+	if (!dc_sqlite3_in_transaction(sql)) {
+		dc_log_error(sql->context, 0, "No transaction to end.");
+		return;
+	}
+
+	if (sql->transaction_depth==1) {
+		outermost = 1;
+		execute_transaction_stmt(sql, commit? "COMMIT;" : "ROLLBACK;", 0,
+			commit? "Cannot commit transaction." : "Cannot rollback transaction.");
+		events = sql->deferred_events;
+		sql->deferred_events = NULL;
+	}
+	else if (commit) {
+		execute_transaction_stmt(sql, "RELEASE dc%i;", sql->transaction_depth, "Cannot commit nested transaction.");
+	}
+	else {
+		execute_transaction_stmt(sql, "ROLLBACK TO dc%i;", sql->transaction_depth, "Cannot rollback nested transaction.");
+		execute_transaction_stmt(sql, "RELEASE dc%i;", sql->transaction_depth, "Cannot end nested transaction.");
+	}
+	sql->transaction_depth--;
+
+	if (!commit) {
+		// the config cache is written through by dc_sqlite3_set_config(), so it may contain values that are gone now
+		dc_sqlite3_reload_config_cache(sql);
+	}
+
+	if (outermost && sql->context && sql->context->sql==sql) {
+		// still inside the transaction mutex, so that no other transaction adds jobs meanwhile
+		dc_jobqueue_end_transaction(sql->context->jobqueue, commit);
+	}
+
+	pthread_mutex_unlock(&sql->transaction_mutex);
+
+	if (outermost && commit) {
+		cnt = dc_array_get_cnt(events);
+		for (i = 0; i+2 < cnt; i += 3) {
+			sql->context->cb(sql->context, (int)dc_array_get_uint(events, i), dc_array_get_uint(events, i+1), dc_array_get_uint(events, i+2));
+		}
+	}
+	else if (outermost && sql->context && sql->context->sql==sql) {
+		// the events of the transaction are dropped, the caches are not invalidated by them;
+		// moreover, other threads may have loaded changes that are gone now
+		dc_objcache_clear(sql->context->msg_cache);
+		dc_objcache_clear(sql->context->chat_cache);
+		dc_objcache_clear(sql->context->contact_cache);
+	}
+
+	dc_array_unref(events);
 }
 
 
 void dc_sqlite3_commit(dc_sqlite3_t* sql)
 {
-#ifdef USE_TRANSACTIONS
-	sqlite3_stmt* stmt = dc_sqlite3_prepare(sql, "COMMIT;");
-	if (sqlite3_step(stmt) != SQLITE_DONE) {
-		dc_sqlite3_log_error(sql, "Cannot commit transaction.");
+	if (sql==NULL) {
+		return;
 	}
-	sqlite3_finalize(stmt);
-#endif
+
+	end_transaction(sql, 1);
+}
+
+
+void dc_sqlite3_rollback(dc_sqlite3_t* sql)
+{
+	if (sql==NULL) {
+		return;
+	}
+
+	end_transaction(sql, 0);
+}
+
+
+int dc_sqlite3_in_transaction(dc_sqlite3_t* sql)
+{
+	// the owner is only compared if there is a transaction, for other threads, the owner is never equal to themselves
+	return (sql && sql->transaction_depth>0 && pthread_equal(sql->transaction_owner, pthread_self()))? 1 : 0;
+}
+
+
+void dc_sqlite3_defer_event(dc_sqlite3_t* sql, int event, uintptr_t data1, uintptr_t data2)
+{
+	if (!dc_sqlite3_in_transaction(sql)) {
+		return;
+	}
+
+	if (sql->deferred_events==NULL) {
+		sql->deferred_events = dc_array_new(sql->context, 48);
+	}
+
+	dc_array_add_uint(sql->deferred_events, event);
+	dc_array_add_uint(sql->deferred_events, data1);
+	dc_array_add_uint(sql->deferred_events, data2);
 }
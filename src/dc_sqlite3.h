@@ -10,6 +10,18 @@ extern "C" {
 #include <sqlite3.h>
 #include <libetpan/libetpan.h>
 #include <pthread.h>
+#include "dc_hash.h"
+#include "dc_array.h"
+
+
+#define DC_STMT_CACHE_SIZE 32
+#define DC_READER_CNT       3    // read-only connections used in WAL mode
+#define DC_WAL_CHECKPOINT_PAGES 1000 // the default of SQLite's wal_autocheckpoint
+
+#define DC_FTS_NONE         0    // no full-text index, SQLite may be compiled without FTS5
+#define DC_FTS_BACKFILLING  1    // new messages are indexed, but not all old ones yet; searching uses LIKE
+#define DC_FTS_READY        2
+#define DC_FTS_BACKFILL_CHUNK 5000 // number of message IDs indexed at once when filling the index for existing messages
 
 
 /**
@@ -21,6 +33,27 @@ typedef struct dc_sqlite3_t
 	sqlite3*        cobj;               /**< is the database given as dbfile to Open() */
 	dc_context_t*   context;            /**< used for logging and to acquire wakelocks, there may be N dc_sqlite3_t objects per context! In practise, we use 2 on backup, 1 otherwise. */
 
+	pthread_mutex_t stmt_cache_mutex;
+	sqlite3_stmt*   stmt_cache[DC_STMT_CACHE_SIZE]; /**< prepared statements not checked out by dc_sqlite3_prepare_cached(), the least recently used first */
+	int             stmt_cache_cnt;
+
+	int             wal_mode;           /**< 1=the database is in WAL mode and the readers are opened */
+	pthread_mutex_t readers_mutex;
+	sqlite3*        readers[DC_READER_CNT]; /**< read-only connections used by dc_sqlite3_prepare_read() */
+	int             readers_busy[DC_READER_CNT];
+
+	int             fts_state;          /**< DC_FTS_*, state of the full-text index msgs_fts */
+	int             fts_trigram;        /**< 1=msgs_fts uses the trigram tokenizer and matches substrings, 0=unicode61, matching word prefixes */
+
+	pthread_mutex_t config_cache_mutex;
+	dc_hash_t       config_cache;       /**< all rows of the config table, keyname to value, loaded when the database is opened */
+	int             config_cache_loaded;
+
+	pthread_mutex_t transaction_mutex;  /**< recursive, held by the thread owning the transaction from dc_sqlite3_begin_transaction() to dc_sqlite3_commit() or dc_sqlite3_rollback() */
+	int             transaction_depth;  /**< 0=no transaction, 1=BEGIN IMMEDIATE, >1=nested transactions as savepoints */
+	pthread_t       transaction_owner;
+	dc_array_t*     deferred_events;    /**< events sent by the owner of the transaction, event/data1/data2 triples sent on commit */
+
 } dc_sqlite3_t;
 
 
@@ -38,17 +71,26 @@ int           dc_sqlite3_set_config       (dc_sqlite3_t*, const char* key, const
 int           dc_sqlite3_set_config_int   (dc_sqlite3_t*, const char* key, int32_t value);
 char*         dc_sqlite3_get_config       (dc_sqlite3_t*, const char* key, const char* def); /* the returned string must be free()'d, returns NULL on errors */
 int32_t       dc_sqlite3_get_config_int   (dc_sqlite3_t*, const char* key, int32_t def);
+void          dc_sqlite3_reload_config_cache (dc_sqlite3_t*); /* call after the config table is modified directly */
 
 /* tools, these functions are compatible to the corresponding sqlite3_* functions */
 sqlite3_stmt* dc_sqlite3_prepare          (dc_sqlite3_t*, const char* sql); /* the result mus be freed using sqlite3_finalize() */
+sqlite3_stmt* dc_sqlite3_prepare_cached   (dc_sqlite3_t*, const char* sql); /* the result must be given back using dc_sqlite3_finalize_cached(), use for constant queries only */
+void          dc_sqlite3_finalize_cached  (dc_sqlite3_t*, sqlite3_stmt*);
+sqlite3_stmt* dc_sqlite3_prepare_read     (dc_sqlite3_t*, const char* sql); /* the result must be freed using dc_sqlite3_finalize_read(), use for SELECT only */
+void          dc_sqlite3_finalize_read    (dc_sqlite3_t*, sqlite3_stmt*);
+void          dc_sqlite3_checkpoint       (dc_sqlite3_t*);
 int           dc_sqlite3_execute          (dc_sqlite3_t*, const char* sql);
 int           dc_sqlite3_table_exists     (dc_sqlite3_t*, const char* name);
+int           dc_sqlite3_fts_backfill     (dc_sqlite3_t*); /* index a chunk of old messages, returns 1 if there are more */
 void          dc_sqlite3_log_error        (dc_sqlite3_t*, const char* msg, ...);
 uint32_t      dc_sqlite3_get_rowid        (dc_sqlite3_t*, const char* table, const char* field, const char* value);
 
-void          dc_sqlite3_begin_transaction  (dc_sqlite3_t*);
+void          dc_sqlite3_begin_transaction  (dc_sqlite3_t*); /* transactions may be nested, other threads wait on begin until the outermost transaction ends */
 void          dc_sqlite3_commit             (dc_sqlite3_t*);
 void          dc_sqlite3_rollback           (dc_sqlite3_t*);
+int           dc_sqlite3_in_transaction     (dc_sqlite3_t*); /* 1=the calling thread owns a transaction */
+void          dc_sqlite3_defer_event        (dc_sqlite3_t*, int event, uintptr_t data1, uintptr_t data2); /* only for the owner of a transaction */
 
 
 #ifdef __cplusplus
@@ -242,10 +242,13 @@ uint32_t        dc_get_chat_id_by_contact_id (dc_context_t*, uint32_t contact_id
 
 uint32_t        dc_send_msg                  (dc_context_t*, uint32_t chat_id, dc_msg_t*);
 uint32_t        dc_send_text_msg             (dc_context_t*, uint32_t chat_id, const char* text_to_send);
+dc_array_t*     dc_send_msg_to_chats         (dc_context_t*, const uint32_t* chat_ids, int chat_cnt, dc_msg_t*);
 void            dc_set_text_draft            (dc_context_t*, uint32_t chat_id, const char*);
 
 #define         DC_GCM_ADDDAYMARKER          0x01
+#define         DC_GCM_NEWER                 0x02
 dc_array_t*     dc_get_chat_msgs             (dc_context_t*, uint32_t chat_id, uint32_t flags, uint32_t marker1before);
+dc_array_t*     dc_get_chat_msgs_page        (dc_context_t*, uint32_t chat_id, uint32_t flags, uint32_t marker1before, uint32_t anchor_msg_id, int cnt);
 int             dc_get_msg_cnt               (dc_context_t*, uint32_t chat_id);
 int             dc_get_fresh_msg_cnt         (dc_context_t*, uint32_t chat_id);
 dc_array_t*     dc_get_fresh_msgs            (dc_context_t*);
@@ -259,6 +262,7 @@ void            dc_delete_chat               (dc_context_t*, uint32_t chat_id);
 
 dc_array_t*     dc_get_chat_contacts         (dc_context_t*, uint32_t chat_id);
 dc_array_t*     dc_search_msgs               (dc_context_t*, uint32_t chat_id, const char* query);
+dc_array_t*     dc_search_msgs_ranked        (dc_context_t*, uint32_t chat_id, const char* query, int offset, int limit);
 
 dc_chat_t*      dc_get_chat                  (dc_context_t*, uint32_t chat_id);
 
@@ -289,6 +293,12 @@ uint32_t        dc_lookup_contact_id_by_addr (dc_context_t*, const char* addr);
 uint32_t        dc_create_contact            (dc_context_t*, const char* name, const char* addr);
 int             dc_add_address_book          (dc_context_t*, const char*);
 
+#define         DC_IMPORT_INVALID            0
+#define         DC_IMPORT_UNCHANGED          1
+#define         DC_IMPORT_MODIFIED           2
+#define         DC_IMPORT_CREATED            3
+dc_array_t*     dc_import_address_book       (dc_context_t*, const char* adr_book);
+
 #define         DC_GCL_VERIFIED_ONLY         0x01
 #define         DC_GCL_ADD_SELF              0x02
 dc_array_t*     dc_get_contacts              (dc_context_t*, uint32_t flags, const char* query);
@@ -388,6 +398,7 @@ size_t           dc_chatlist_get_cnt         (const dc_chatlist_t*);
 uint32_t         dc_chatlist_get_chat_id     (const dc_chatlist_t*, size_t index);
 uint32_t         dc_chatlist_get_msg_id      (const dc_chatlist_t*, size_t index);
 dc_lot_t*        dc_chatlist_get_summary     (const dc_chatlist_t*, size_t index, dc_chat_t*);
+void             dc_chatlist_load_summaries  (dc_chatlist_t*, size_t index, size_t cnt);
 dc_context_t*    dc_chatlist_get_context     (dc_chatlist_t*);
 
 